@@ -40,6 +40,7 @@
 
 #include "contiki.h"
 #include "shell-memdebug.h"
+#include "lib/memb.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -55,6 +56,11 @@ SHELL_COMMAND(peek_command,
 	      "peek",
 	      "peek <address>: read a byte from address <address>",
 	      &shell_peek_process);
+PROCESS(shell_memb_process, "memb");
+SHELL_COMMAND(memb_command,
+	      "memb",
+	      "memb: show the usage of the memory block pools",
+	      &shell_memb_process);
 /*---------------------------------------------------------------------------*/
 PROCESS_THREAD(shell_poke_process, ev, data)
 {
@@ -119,10 +125,34 @@ PROCESS_THREAD(shell_peek_process, ev, data)
   PROCESS_END();
 }
 /*---------------------------------------------------------------------------*/
+PROCESS_THREAD(shell_memb_process, ev, data)
+{
+#if MEMB_STATS
+  struct memb *m;
+  char buf[48];
+#endif
+
+  PROCESS_BEGIN();
+
+#if MEMB_STATS
+  shell_output_str(&memb_command, "name: used/num max failed size", "");
+  for(m = memb_pools(); m != NULL; m = m->next) {
+    snprintf(buf, sizeof(buf), ": %u/%u %u %u %u",
+             m->used, m->num, m->max_used, m->failed, m->size);
+    shell_output_str(&memb_command, (char *)m->name, buf);
+  }
+#else
+  shell_output_str(&memb_command, "memb statistics are disabled, set MEMB_CONF_STATS", "");
+#endif
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
 void
 shell_memdebug_init(void)
 {
   shell_register_command(&poke_command);
   shell_register_command(&peek_command);
+  shell_register_command(&memb_command);
 }
 /*---------------------------------------------------------------------------*/
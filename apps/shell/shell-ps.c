@@ -58,8 +58,20 @@ PROCESS_THREAD(shell_ps_process, ev, data)
   shell_output_str(&ps_command, "Processes:", "");
   for(p = PROCESS_LIST(); p != NULL; p = p->next) {
     char namebuf[30];
+#if PROCESS_CONF_LATENCY_STATS
+    char statbuf[40];
+#endif
     strncpy(namebuf, PROCESS_NAME_STRING(p), sizeof(namebuf));
+#if PROCESS_CONF_LATENCY_STATS
+    /* Priority, events, mean and maximum latency in rtimer ticks */
+    snprintf(statbuf, sizeof(statbuf), " prio %u events %u latency %lu/%lu",
+             p->priority, p->events,
+             p->events ? p->latency / p->events : 0,
+             (unsigned long)p->max_latency);
+    shell_output_str(&ps_command, namebuf, statbuf);
+#else
     shell_output_str(&ps_command, namebuf, "");
+#endif
   }
 
   PROCESS_END();
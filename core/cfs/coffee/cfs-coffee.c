@@ -91,6 +91,60 @@
 #define COFFEE_EXTENDED_WEAR_LEVELLING	1
 #endif
 
+/*
+ * Remember the start pages of up to this many files by a hash of their
+ * names. find_file() then only reads the headers of the files with a
+ * matching hash instead of scanning the whole storage, and it knows that
+ * a file does not exist if all files fit into the index.
+ */
+#ifndef COFFEE_NAME_INDEX_SIZE
+#define COFFEE_NAME_INDEX_SIZE	0
+#endif
+
+/*
+ * Keep two bits per sector that tell whether a sector is free and whether
+ * it may contain obsolete pages. Free sectors are skipped without reading
+ * their headers and the garbage collector returns early if no sector
+ * contains obsolete pages.
+ */
+#ifndef COFFEE_SECTOR_SUMMARY
+#define COFFEE_SECTOR_SUMMARY	0
+#endif
+
+/*
+ * Reclaim sectors in a background process when the free pages run low,
+ * so that reserve() rarely has to collect garbage synchronously. Each
+ * step of the process examines sectors for at most COFFEE_GC_TIME_BUDGET
+ * clock ticks and erases at most one sector. Sectors that contain only
+ * obsolete pages are erased first, partially free ones are erased one
+ * per pass, the one with the most obsolete pages first.
+ */
+#ifndef COFFEE_BACKGROUND_GC
+#define COFFEE_BACKGROUND_GC	0
+#endif
+
+#if COFFEE_BACKGROUND_GC
+#include "sys/process.h"
+#include "sys/clock.h"
+
+/* Run the background collector while fewer pages are free. */
+#ifndef COFFEE_GC_WATERMARK
+#define COFFEE_GC_WATERMARK	(COFFEE_PAGE_COUNT / 8)
+#endif
+
+#ifndef COFFEE_GC_TIME_BUDGET
+#define COFFEE_GC_TIME_BUDGET	(CLOCK_SECOND / 50)
+#endif
+#endif /* COFFEE_BACKGROUND_GC */
+
+/*
+ * Storage drivers that buffer writes can define COFFEE_FLUSH() to write
+ * out the buffered data when a file is closed.
+ */
+#ifndef COFFEE_FLUSH
+#define COFFEE_FLUSH()
+#endif
+
 #if COFFEE_START & (COFFEE_SECTOR_SIZE - 1)
 #error COFFEE_START must point to the first byte in a sector.
 #endif
@@ -218,12 +272,70 @@ static struct file_desc * const coffee_fd_set = protected_mem.coffee_fd_set;
 static coffee_page_t * const next_free = &protected_mem.next_free;
 static char * const gc_wait = &protected_mem.gc_wait;
 
+#if COFFEE_NAME_INDEX_SIZE
+#define NAME_INDEX_INVALID	0
+#define NAME_INDEX_VALID	1
+
+struct name_index_entry {
+  coffee_page_t page;
+  uint8_t hash;
+};
+
+static struct name_index_entry name_index[COFFEE_NAME_INDEX_SIZE];
+static uint8_t name_index_state;
+/* Number of files that did not fit into the index. */
+static coffee_page_t name_index_overflow;
+#endif /* COFFEE_NAME_INDEX_SIZE */
+
+#if COFFEE_SECTOR_SUMMARY
+#define SECTOR_BIT(map, sector)	((map)[(sector) >> 3] & (1 << ((sector) & 7)))
+#define SECTOR_FREE(sector)	SECTOR_BIT(sector_free, sector)
+#define SECTOR_OBSOLETE(sector)	SECTOR_BIT(sector_obsolete, sector)
+
+/* Free sectors contain no allocated page, not even one of a reserved
+   file extent that starts in an earlier sector. */
+static uint8_t sector_free[(COFFEE_SECTOR_COUNT + 7) / 8];
+static uint8_t sector_obsolete[(COFFEE_SECTOR_COUNT + 7) / 8];
+static uint8_t sector_summary_valid;
+#endif /* COFFEE_SECTOR_SUMMARY */
+
+#if COFFEE_BACKGROUND_GC
+#define GC_NO_SECTOR		((uint16_t)-1)
+
+/* Changes when a header is written or a sector scan starts, which
+   invalidates a scan of the background collector. */
+static uint8_t gc_generation;
+
+static struct {
+  /* The next sector to examine and the generation of the scan. */
+  uint16_t sector;
+  uint8_t generation;
+  /* The partially free sector to erase in this pass, and the best
+     candidate found so far for the next pass. */
+  uint16_t target;
+  uint16_t best;
+  coffee_page_t best_obsolete;
+  /* Free pages counted in this pass and the estimate of the last one. */
+  coffee_page_t pass_free;
+  coffee_page_t free_pages;
+  uint8_t free_known;
+  uint8_t reclaimed;
+  /* Cleared if a pass found nothing to reclaim, set by file removals. */
+  uint8_t obsolete_hint;
+} gc_state = { 0, 0, GC_NO_SECTOR, GC_NO_SECTOR, 0, 0, 0, 0, 0, 1 };
+
+PROCESS(coffee_gc_process, "Coffee GC");
+#endif /* COFFEE_BACKGROUND_GC */
+
 /*---------------------------------------------------------------------------*/
 static void
 write_header(struct file_header *hdr, coffee_page_t page)
 {
   hdr->flags |= HDR_FLAG_VALID;
   COFFEE_WRITE(hdr, sizeof(*hdr), page * COFFEE_PAGE_SIZE);
+#if COFFEE_BACKGROUND_GC
+  gc_generation++;
+#endif
 	PRINTF("hdr.flags = %x\n", hdr->flags);
 }
 /*---------------------------------------------------------------------------*/
@@ -266,8 +378,20 @@ get_sector_status(uint16_t sector, struct sector_status *stats)
   if(sector == 0) {
     skip_pages = 0;
     last_pages_are_active = 0;
+#if COFFEE_BACKGROUND_GC
+    gc_generation++;
+#endif
   }
 
+#if COFFEE_SECTOR_SUMMARY
+  /* No file extent reaches into a free sector, so skip_pages is 0. */
+  if(sector_summary_valid && SECTOR_FREE(sector)) {
+    stats->free = COFFEE_PAGES_PER_SECTOR;
+    last_pages_are_active = 0;
+    return 0;
+  }
+#endif
+
   sector_start = sector * COFFEE_PAGES_PER_SECTOR;
   sector_end = sector_start + COFFEE_PAGES_PER_SECTOR;
 
@@ -363,6 +487,93 @@ isolate_pages(coffee_page_t start, coffee_page_t skip_pages)
   PRINTF("Coffee: Isolated %u pages starting in sector %d\n",
          (unsigned)skip_pages, (int)start / COFFEE_PAGES_PER_SECTOR);
 
+}
+/*---------------------------------------------------------------------------*/
+#if COFFEE_SECTOR_SUMMARY
+static void
+set_sector_bit(uint8_t *map, uint16_t sector, int value)
+{
+  if(value) {
+    map[sector >> 3] |= 1 << (sector & 7);
+  } else {
+    map[sector >> 3] &= ~(1 << (sector & 7));
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+update_sector_summary(uint16_t sector, struct sector_status *stats)
+{
+  set_sector_bit(sector_free, sector, stats->free == COFFEE_PAGES_PER_SECTOR);
+  set_sector_bit(sector_obsolete, sector, stats->obsolete > 0);
+}
+/*---------------------------------------------------------------------------*/
+static void
+mark_sectors(uint8_t *map, coffee_page_t page, coffee_page_t count, int value)
+{
+  uint16_t sector;
+
+  for(sector = page / COFFEE_PAGES_PER_SECTOR;
+      sector <= (page + count - 1) / COFFEE_PAGES_PER_SECTOR;
+      sector++) {
+    set_sector_bit(map, sector, value);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+build_sector_summary(void)
+{
+  uint16_t sector;
+  struct sector_status stats;
+
+  if(sector_summary_valid) {
+    return;
+  }
+
+  for(sector = 0; sector < COFFEE_SECTOR_COUNT; sector++) {
+    get_sector_status(sector, &stats);
+    update_sector_summary(sector, &stats);
+  }
+  sector_summary_valid = 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+obsolete_sectors_exist(void)
+{
+  unsigned i;
+
+  for(i = 0; i < sizeof(sector_obsolete); i++) {
+    if(sector_obsolete[i]) {
+      return 1;
+    }
+  }
+  return 0;
+}
+#endif /* COFFEE_SECTOR_SUMMARY */
+/*---------------------------------------------------------------------------*/
+static void
+reclaim_sector(uint16_t sector, struct sector_status *stats,
+               coffee_page_t isolation_count)
+{
+  coffee_page_t first_page;
+
+  first_page = sector * COFFEE_PAGES_PER_SECTOR;
+  if(first_page < *next_free) {
+    *next_free = first_page;
+  }
+
+  if(isolation_count > 0) {
+    isolate_pages(first_page + COFFEE_PAGES_PER_SECTOR, isolation_count);
+  }
+
+  COFFEE_ERASE(sector);
+  PRINTF("Coffee: Erased sector %d!\n", sector);
+#if COFFEE_SECTOR_SUMMARY
+  set_sector_bit(sector_free, sector, 1);
+  set_sector_bit(sector_obsolete, sector, 0);
+#endif
+#if COFFEE_BACKGROUND_GC
+  gc_state.free_pages += COFFEE_PAGES_PER_SECTOR - stats->free;
+#endif
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -370,10 +581,19 @@ collect_garbage(int mode)
 {
   uint16_t sector;
   struct sector_status stats;
-  coffee_page_t first_page, isolation_count;
+  coffee_page_t isolation_count;
 
   PRINTF("Coffee: Running the file system garbage collector in %s mode\n",
 	 mode == GC_RELUCTANT ? "reluctant" : "greedy");
+
+#if COFFEE_SECTOR_SUMMARY
+  /* Both modes only erase sectors that contain obsolete pages. */
+  build_sector_summary();
+  if(!obsolete_sectors_exist()) {
+    return;
+  }
+#endif
+
   /*
    * The garbage collector erases as many sectors as possible. A sector is
    * erasable if there are only free or obsolete pages in it.
@@ -383,6 +603,9 @@ collect_garbage(int mode)
     PRINTF("Coffee: Sector %u has %u active, %u obsolete, and %u free pages.\n",
         sector, (unsigned)stats.active,
 	(unsigned)stats.obsolete, (unsigned)stats.free);
+#if COFFEE_SECTOR_SUMMARY
+    update_sector_summary(sector, &stats);
+#endif
 
     if(stats.active > 0) {
       continue;
@@ -390,24 +613,118 @@ collect_garbage(int mode)
 
     if((mode == GC_RELUCTANT && stats.free == 0) ||
        (mode == GC_GREEDY && stats.obsolete > 0)) {
-      first_page = sector * COFFEE_PAGES_PER_SECTOR;
-      if(first_page < *next_free) {
-        *next_free = first_page;
-      }
+      reclaim_sector(sector, &stats, isolation_count);
 
-      if(isolation_count > 0) {
-        isolate_pages(first_page + COFFEE_PAGES_PER_SECTOR, isolation_count);
+      if(mode == GC_RELUCTANT && isolation_count > 0) {
+        break;
       }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+#if COFFEE_BACKGROUND_GC
+static int
+gc_needed(void)
+{
+  return gc_state.obsolete_hint &&
+    (!gc_state.free_known || gc_state.free_pages < COFFEE_GC_WATERMARK);
+}
+/*---------------------------------------------------------------------------*/
+static void
+gc_poke(void)
+{
+  if(gc_needed()) {
+    if(!process_is_running(&coffee_gc_process)) {
+      process_start(&coffee_gc_process, NULL);
+    }
+    process_poll(&coffee_gc_process);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Returns 0 when there is nothing left to do. */
+static int
+gc_step(void)
+{
+  clock_time_t start;
+  struct sector_status stats;
+  coffee_page_t isolation_count;
+  int erased;
 
-      COFFEE_ERASE(sector);
-      PRINTF("Coffee: Erased sector %d!\n", sector);
+  if(!gc_needed()) {
+    return 0;
+  }
 
-      if(mode == GC_RELUCTANT && isolation_count > 0) {
-        break;
+  /*
+   * get_sector_status() keeps the state of a scan in static variables
+   * and files may have been reserved or removed behind the cursor, so
+   * any change since the last step restarts the pass.
+   */
+  if(gc_state.generation != gc_generation) {
+    gc_state.sector = 0;
+    gc_state.pass_free = 0;
+    gc_state.reclaimed = 0;
+  }
+
+  start = clock_time();
+  erased = 0;
+  do {
+    isolation_count = get_sector_status(gc_state.sector, &stats);
+#if COFFEE_SECTOR_SUMMARY
+    update_sector_summary(gc_state.sector, &stats);
+#endif
+    gc_state.pass_free += stats.free;
+
+    if(stats.active == 0 && stats.obsolete > 0) {
+      if(stats.free == 0 || gc_state.sector == gc_state.target) {
+        reclaim_sector(gc_state.sector, &stats, isolation_count);
+        gc_state.pass_free += COFFEE_PAGES_PER_SECTOR - stats.free;
+        gc_state.reclaimed = 1;
+        *gc_wait = 0;
+        erased = 1;
+      } else if(stats.obsolete > gc_state.best_obsolete) {
+        gc_state.best = gc_state.sector;
+        gc_state.best_obsolete = stats.obsolete;
       }
     }
+
+    if(++gc_state.sector == COFFEE_SECTOR_COUNT) {
+      PRINTF("Coffee: GC pass done, %u pages free\n",
+             (unsigned)gc_state.pass_free);
+      gc_state.free_pages = gc_state.pass_free;
+      gc_state.free_known = 1;
+      if(!gc_state.reclaimed && gc_state.best == GC_NO_SECTOR) {
+        gc_state.obsolete_hint = 0;
+      }
+      gc_state.target = gc_state.best;
+      gc_state.best = GC_NO_SECTOR;
+      gc_state.best_obsolete = 0;
+      gc_state.pass_free = 0;
+      gc_state.reclaimed = 0;
+      gc_state.sector = 0;
+      break;
+    }
+  } while(!erased && clock_time() - start < COFFEE_GC_TIME_BUDGET);
+
+  gc_state.generation = gc_generation;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(coffee_gc_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  process_set_priority(&coffee_gc_process, PROCESS_PRIO_BACKGROUND);
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_POLL);
+    while(gc_step()) {
+      PROCESS_PAUSE();
+    }
   }
+
+  PROCESS_END();
 }
+#endif /* COFFEE_BACKGROUND_GC */
 /*---------------------------------------------------------------------------*/
 static coffee_page_t
 next_file(coffee_page_t page, struct file_header *hdr)
@@ -472,13 +789,127 @@ load_file(coffee_page_t start, struct file_header *hdr)
   return file;
 }
 /*---------------------------------------------------------------------------*/
+#if COFFEE_NAME_INDEX_SIZE
+static uint8_t
+name_hash(const char *name)
+{
+  uint8_t hash;
+  int i;
+
+  /* Only the part of the name that fits into the header counts. */
+  hash = 0;
+  for(i = 0; i < COFFEE_NAME_LENGTH - 1 && name[i] != '\0'; i++) {
+    hash = hash * 31 + name[i];
+  }
+  return hash;
+}
+/*---------------------------------------------------------------------------*/
+static void
+name_index_add(coffee_page_t page, const char *name)
+{
+  int i;
+
+  if(name_index_state == NAME_INDEX_INVALID) {
+    return;
+  }
+
+  for(i = 0; i < COFFEE_NAME_INDEX_SIZE; i++) {
+    if(name_index[i].page == INVALID_PAGE) {
+      name_index[i].page = page;
+      name_index[i].hash = name_hash(name);
+      return;
+    }
+  }
+  name_index_overflow++;
+}
+/*---------------------------------------------------------------------------*/
+static void
+name_index_remove(coffee_page_t page)
+{
+  int i;
+
+  for(i = 0; i < COFFEE_NAME_INDEX_SIZE; i++) {
+    if(name_index[i].page == page) {
+      name_index[i].page = INVALID_PAGE;
+      return;
+    }
+  }
+
+  /* The file was one of those that did not fit. */
+  if(name_index_overflow > 0) {
+    name_index_overflow--;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+name_index_reset(void)
+{
+  int i;
+
+  for(i = 0; i < COFFEE_NAME_INDEX_SIZE; i++) {
+    name_index[i].page = INVALID_PAGE;
+  }
+  name_index_overflow = 0;
+  name_index_state = NAME_INDEX_VALID;
+}
+/*---------------------------------------------------------------------------*/
+static coffee_page_t
+name_index_find(const char *name, struct file_header *hdr)
+{
+  coffee_page_t page;
+  uint8_t hash;
+  int i;
+
+  if(name_index_state == NAME_INDEX_INVALID) {
+    /* Active files never move, so one scan serves until the next format. */
+    name_index_reset();
+    for(page = 0; page < COFFEE_PAGE_COUNT; page = next_file(page, hdr)) {
+      read_header(hdr, page);
+      if(HDR_ACTIVE(*hdr) && !HDR_LOG(*hdr)) {
+        name_index_add(page, hdr->name);
+      }
+    }
+  }
+
+  hash = name_hash(name);
+  for(i = 0; i < COFFEE_NAME_INDEX_SIZE; i++) {
+    if(name_index[i].page == INVALID_PAGE || name_index[i].hash != hash) {
+      continue;
+    }
+    read_header(hdr, name_index[i].page);
+    if(HDR_ACTIVE(*hdr) && !HDR_LOG(*hdr) && strcmp(name, hdr->name) == 0) {
+      return name_index[i].page;
+    }
+  }
+
+  return INVALID_PAGE;
+}
+#endif /* COFFEE_NAME_INDEX_SIZE */
+/*---------------------------------------------------------------------------*/
 static struct file *
 find_file(const char *name)
 {
   int i;
   struct file_header hdr;
   coffee_page_t page;
-  
+
+#if COFFEE_NAME_INDEX_SIZE
+  page = name_index_find(name, &hdr);
+  if(page != INVALID_PAGE) {
+    for(i = 0; i < COFFEE_MAX_OPEN_FILES; i++) {
+      if(!FILE_FREE(&coffee_files[i]) && coffee_files[i].page == page) {
+        return &coffee_files[i];
+      }
+    }
+    return load_file(page, &hdr);
+  }
+
+  if(name_index_overflow == 0) {
+    /* All files are in the index. */
+    return NULL;
+  }
+#endif
+
   /* First check if the file metadata is cached. */
   for(i = 0; i < COFFEE_MAX_OPEN_FILES; i++) {
     if(FILE_FREE(&coffee_files[i])) {
@@ -542,8 +973,18 @@ find_contiguous_pages(coffee_page_t amount)
   coffee_page_t page, start;
   struct file_header hdr;
 
+#if COFFEE_SECTOR_SUMMARY
+  build_sector_summary();
+#endif
+
   start = INVALID_PAGE;
   for(page = *next_free; page < COFFEE_PAGE_COUNT;) {
+#if COFFEE_SECTOR_SUMMARY
+    if(SECTOR_FREE(page / COFFEE_PAGES_PER_SECTOR)) {
+      /* Free headers contain nothing else of interest. */
+      hdr.flags = 0;
+    } else
+#endif
     read_header(&hdr, page);
     if(HDR_FREE(hdr)) {
       if(start == INVALID_PAGE) {
@@ -593,6 +1034,19 @@ remove_by_page(coffee_page_t page, int remove_log, int close_fds,
   hdr.flags |= HDR_FLAG_OBSOLETE;
   write_header(&hdr, page);
 
+#if COFFEE_NAME_INDEX_SIZE
+  if(!HDR_LOG(hdr)) {
+    name_index_remove(page);
+  }
+#endif
+#if COFFEE_SECTOR_SUMMARY
+  mark_sectors(sector_obsolete, page, hdr.max_pages, 1);
+#endif
+#if COFFEE_BACKGROUND_GC
+  gc_state.obsolete_hint = 1;
+  gc_poke();
+#endif
+
   *gc_wait = 0;
 
   /* Close all file descriptors that reference the removed file. */
@@ -659,6 +1113,20 @@ reserve(const char *name, coffee_page_t pages,
   hdr.flags = HDR_FLAG_ALLOCATED | flags;
   write_header(&hdr, page);
 
+#if COFFEE_NAME_INDEX_SIZE
+  if(!(flags & HDR_FLAG_LOG)) {
+    name_index_add(page, hdr.name);
+  }
+#endif
+#if COFFEE_SECTOR_SUMMARY
+  mark_sectors(sector_free, page, pages, 0);
+#endif
+#if COFFEE_BACKGROUND_GC
+  gc_state.free_pages = gc_state.free_pages > pages ?
+    gc_state.free_pages - pages : 0;
+  gc_poke();
+#endif
+
   PRINTF("Coffee: Reserved %u pages starting from %u for file %s\n",
       pages, page, name);
 
@@ -1039,6 +1507,7 @@ cfs_close(int fd)
     coffee_fd_set[fd].flags = COFFEE_FD_FREE;
     coffee_fd_set[fd].file->references--;
     coffee_fd_set[fd].file = NULL;
+    COFFEE_FLUSH();
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -1363,6 +1832,24 @@ cfs_coffee_format(void)
   /* Formatting invalidates the file information. */
   memset(&protected_mem, 0, sizeof(protected_mem));
 
+#if COFFEE_NAME_INDEX_SIZE
+  name_index_reset();
+#endif
+#if COFFEE_SECTOR_SUMMARY
+  memset(sector_free, 0xFF, sizeof(sector_free));
+  memset(sector_obsolete, 0, sizeof(sector_obsolete));
+  sector_summary_valid = 1;
+#endif
+#if COFFEE_BACKGROUND_GC
+  gc_generation++;
+  gc_state.free_pages = COFFEE_PAGE_COUNT;
+  gc_state.free_known = 1;
+  gc_state.obsolete_hint = 0;
+  gc_state.target = GC_NO_SECTOR;
+  gc_state.best = GC_NO_SECTOR;
+  gc_state.best_obsolete = 0;
+#endif
+
   PRINTF(" done!\n");
 
   return 0;
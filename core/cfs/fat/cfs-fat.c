@@ -80,9 +80,31 @@
 #define FAT_FLAG_FREE     0x00
 #define FAT_FLAG_DELETED  0xE5
 
-uint8_t sector_buffer[512];
+#define SECTOR_CACHE_VALID  0x01
+#define SECTOR_CACHE_DIRTY  0x02
+
+/** One cached sector of the mounted device. */
+struct sector_cache_entry {
+  uint32_t addr;
+  /** Value of sector_cache_tick at last access, used for LRU eviction */
+  uint32_t last_use;
+  /** Eviction bonus, one of FAT_CACHE_PRIO_{DATA,DIR,FAT} */
+  uint8_t prio;
+  uint8_t flags;
+  uint8_t data[512];
+};
+
+static struct sector_cache_entry sector_cache[FAT_CACHE_SIZE];
+static uint32_t sector_cache_tick = 0;
+static struct fat_cache_stats sector_cache_stats;
+
+/* The sector most recently loaded by read_sector(). All sector based
+ * operations work on this entry, just like on a single sector buffer. */
+static struct sector_cache_entry *sector_cache_cur = &sector_cache[0];
+uint8_t *sector_buffer = sector_cache[0].data;
 uint32_t sector_buffer_addr = 0;
-uint8_t sector_buffer_dirty = 0;
+
+#define MARK_SECTOR_BUFFER_DIRTY() (sector_cache_cur->flags |= SECTOR_CACHE_DIRTY)
 
 uint16_t cfs_readdir_offset = 0;
 
@@ -90,8 +112,73 @@ struct file_system {
   struct diskio_device_info *dev;
   struct FAT_Info info;
   uint32_t first_data_sector;
+  /** Number of data clusters, valid cluster numbers are 2 to num_clusters + 1 */
+  uint32_t num_clusters;
+  /** Sector of the FAT32 FSInfo structure, 0 if there is none */
+  uint32_t fsinfo_sector;
+  /** Number of free clusters, FAT_FREE_COUNT_UNKNOWN if not known */
+  uint32_t free_count;
+  /** Next fit cursor, free cluster searches start here */
+  uint32_t next_free;
+  /** Set if free_count or next_free changed since the FSInfo was written */
+  uint8_t fsinfo_dirty;
+#if FAT_FREE_MAP_SIZE > 0
+  /** log2 of the number of FAT sectors covered by one bit of free_map */
+  uint8_t free_map_shift;
+#endif
 } mounted; // TODO: volume?
 
+#define FAT_FREE_COUNT_UNKNOWN 0xFFFFFFFF
+#define FAT_ENTRY_SIZE() (mounted.info.type == FAT16 ? 2 : 4)
+
+#define FSINFO_LEAD_SIG   0x41615252
+#define FSINFO_STRUC_SIG  0x61417272
+#define FSINFO_LEAD_SIG_OFFSET   0
+#define FSINFO_STRUC_SIG_OFFSET  484
+#define FSINFO_FREE_COUNT_OFFSET 488
+#define FSINFO_NXT_FREE_OFFSET   492
+
+#if FAT_FREE_MAP_SIZE > 0
+/* One bit per group of FAT sectors, set if the group has no free cluster */
+static uint8_t free_map[FAT_FREE_MAP_SIZE];
+#endif
+
+#if FAT_PREALLOC_CLUSTERS > 0
+/** Free clusters reserved for appending to a file. */
+struct cluster_reservation {
+  /** First cluster of the owning file, 0 if unused */
+  uint32_t owner;
+  uint32_t cluster;
+  uint16_t count;
+};
+
+static struct cluster_reservation reservations[FAT_PREALLOC_FILES];
+static uint8_t reservation_next = 0;
+#endif
+
+#if FAT_DENTRY_CACHE_SIZE > 0
+#define DENTRY_CACHE_VALID    0x01
+/* The name does not exist, sector is where the directory scan ended */
+#define DENTRY_CACHE_NEGATIVE 0x02
+
+/** Result of a directory lookup */
+struct dentry_cache_entry {
+  /** First cluster of the directory, 0 for the FAT16 root directory */
+  uint32_t parent;
+  /** Sector holding the directory entry */
+  uint32_t sector;
+  /** First cluster of the file or directory */
+  uint32_t cluster;
+  uint16_t offset;
+  uint16_t hash;
+  char name[11];
+  uint8_t flags;
+};
+
+/* Most recently used first */
+static struct dentry_cache_entry dentry_cache[FAT_DENTRY_CACHE_SIZE];
+#endif
+
 #define CLUSTER_TO_SECTOR(cluster_num) (((cluster_num - 2) * mounted.info.BPB_SecPerClus) + mounted.first_data_sector)
 #define SECTOR_TO_CLUSTER(sector_num) (((sector_num - mounted.first_data_sector) / mounted.info.BPB_SecPerClus) + 2)
 
@@ -104,30 +191,26 @@ struct PathResolver {
 struct file fat_file_pool[FAT_FD_POOL_SIZE];
 struct file_desc fat_fd_pool[FAT_FD_POOL_SIZE];
 
-#ifdef FAT_COOPERATIVE
-#include "fat_coop.h"
-extern void coop_switch_sp();
-extern uint8_t coop_step_allowed;
-extern uint8_t next_step_type;
-
-enum {
-  READ = 1,
-  WRITE,
-  INTERNAL
-};
-
-extern QueueEntry queue[FAT_COOP_QUEUE_SIZE];
-extern uint16_t queue_start, queue_len;
-#endif
 
 /* Declerations */
 static uint8_t is_EOC(uint32_t fat_entry);
+static uint8_t is_reserved_cluster(uint32_t cluster);
 static uint32_t get_free_cluster(uint32_t start_cluster);
-static uint16_t _get_free_cluster_16();
-static uint16_t _get_free_cluster_32();
+static uint8_t _is_free_entry(uint16_t offset);
+static void cluster_allocated(uint32_t cluster);
+static void cluster_freed(uint32_t cluster);
+static uint32_t allocate_cluster(uint32_t hint);
+#if FAT_PREALLOC_CLUSTERS > 0
+static struct cluster_reservation *find_reservation(uint32_t owner);
+static struct cluster_reservation *reserve_clusters(uint32_t hint);
+#endif
+static void load_fsinfo();
+static void store_fsinfo();
 static uint32_t find_nth_cluster(uint32_t start_cluster, uint32_t n);
+static struct cluster_run *add_cluster_run(struct file *file, uint32_t index, uint32_t cluster);
+static uint32_t find_cluster_of_file(int fd, uint32_t n);
 static void reset_cluster_chain(struct dir_entry *dir_ent);
-static void add_cluster_to_file(int fd);
+static uint8_t add_cluster_to_file(int fd);
 static uint32_t read_fat_entry(uint32_t cluster_num);
 static void write_fat_entry(uint32_t cluster_num, uint32_t value);
 static void calc_fat_block(uint32_t cur_cluster, uint32_t *fat_sec_num, uint32_t *ent_offset);
@@ -136,13 +219,24 @@ static void pr_reset(struct PathResolver *rsolv);
 static uint8_t pr_get_next_path_part(struct PathResolver *rsolv);
 static uint8_t pr_is_current_path_part_a_file(struct PathResolver *rsolv);
 static uint8_t read_sector(uint32_t sector_addr);
+static uint8_t read_dir_sector(uint32_t sector_addr);
 static uint8_t read_next_sector();
+#if FAT_DENTRY_CACHE_SIZE > 0
+static uint16_t dentry_hash(const char *name);
+static struct dentry_cache_entry *dentry_cache_find(uint32_t parent, const char *name);
+static struct dentry_cache_entry *dentry_cache_add(uint32_t parent, const char *name);
+static void dentry_cache_forget_name(const char *name);
+static void dentry_cache_forget_entry(uint32_t sector, uint16_t offset);
+#endif
 static uint8_t lookup(const char *name, struct dir_entry *dir_entry, uint32_t *dir_entry_sector, uint16_t *dir_entry_offset);
 static uint8_t get_dir_entry(const char *path, struct dir_entry *dir_ent, uint32_t *dir_entry_sector, uint16_t *dir_entry_offset, uint8_t create);
 static uint8_t add_directory_entry_to_current(struct dir_entry *dir_ent, uint32_t *dir_entry_sector, uint16_t *dir_entry_offset);
 static void update_dir_entry(int fd);
 static void remove_dir_entry(uint32_t dir_entry_sector, uint16_t dir_entry_offset);
+static uint32_t get_cluster_of_file(int fd, uint32_t clusters, uint8_t write);
 static uint8_t load_next_sector_of_file(int fd, uint32_t clusters, uint8_t clus_offset, uint8_t write);
+static uint32_t read_sectors_of_file(int fd, uint32_t clusters, uint8_t clus_offset, uint8_t *buffer, uint32_t max_sectors);
+static uint32_t write_sectors_of_file(int fd, uint32_t clusters, uint8_t clus_offset, const uint8_t *buffer, uint32_t max_sectors);
 static void make_readable_entry(struct dir_entry *dir, struct cfs_dirent *dirent);
 static uint8_t _is_file(struct dir_entry *dir_ent);
 static uint8_t _cfs_flags_ok(int flags, struct dir_entry *dir_ent);
@@ -167,93 +261,296 @@ is_EOC(uint32_t fat_entry)
   return 0;
 }
 /*----------------------------------------------------------------------------*/
+/*
+ * Returns 1 if the cluster is reserved for appending to any file.
+ */
+static uint8_t
+is_reserved_cluster(uint32_t cluster)
+{
+#if FAT_PREALLOC_CLUSTERS > 0
+  uint8_t i;
+
+  for (i = 0; i < FAT_PREALLOC_FILES; i++) {
+    if (reservations[i].owner != 0
+        && cluster >= reservations[i].cluster
+        && cluster < reservations[i].cluster + reservations[i].count) {
+      return 1;
+    }
+  }
+#endif
+
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
+#if FAT_FREE_MAP_SIZE > 0
+#define FREE_MAP_GROUP(fat_sec_num) (((fat_sec_num) - mounted.info.BPB_RsvdSecCnt) >> mounted.free_map_shift)
+#define FREE_MAP_IS_FULL(group) (free_map[(group) >> 3] & (1 << ((group) & 7)))
+#define FREE_MAP_SET_FULL(group) (free_map[(group) >> 3] |= (1 << ((group) & 7)))
+#define FREE_MAP_CLEAR_FULL(group) (free_map[(group) >> 3] &= ~(1 << ((group) & 7)))
+#endif
+/*----------------------------------------------------------------------------*/
 /**
- * \brief Looks through the FAT to find a free cluster. Sets the sector adress pointer to the start
- * of the new cluster.
+ * \brief Looks through the FAT to find a free cluster which is not reserved
+ * for appending to a file.
+ *
+ * The search starts at start_cluster, or at the next free cursor if
+ * start_cluster is not a valid cluster number, and wraps around at the end
+ * of the FAT.
  *
- * \TODO Check for end of FAT and no free clusters.
  * \param start_cluster cluster number to start for searching
- * \return Returns the number of a free cluster.
+ * \return Returns the number of a free cluster, 0 if the disk is full.
  */
 static uint32_t
 get_free_cluster(uint32_t start_cluster)
 {
+  uint32_t last_cluster = mounted.num_clusters + 1;
+  uint32_t cluster;
+  uint32_t scanned = 0;
   uint32_t fat_sec_num = 0;
   uint32_t ent_offset = 0;
   uint16_t i = 0;
+#if FAT_FREE_MAP_SIZE > 0
+  uint32_t next_cluster;
+  uint32_t group;
+  uint8_t group_full = 0;
+#endif
 
-  /* calculate sector to start search from */
-  calc_fat_block(start_cluster, &fat_sec_num, &ent_offset);
+  if (start_cluster < 2 || start_cluster > last_cluster) {
+    start_cluster = mounted.next_free;
+  }
+  cluster = start_cluster;
+
+  while (scanned < mounted.num_clusters) {
+    calc_fat_block(cluster, &fat_sec_num, &ent_offset);
+
+#if FAT_FREE_MAP_SIZE > 0
+    group = FREE_MAP_GROUP(fat_sec_num);
+    if (FREE_MAP_IS_FULL(group)) {
+      /* Skip to the first cluster of the next group */
+      next_cluster = ((group + 1) << mounted.free_map_shift) * (mounted.info.BPB_BytesPerSec / FAT_ENTRY_SIZE());
+      if (next_cluster > last_cluster) {
+        scanned += last_cluster + 1 - cluster;
+        cluster = 2;
+      } else {
+        scanned += next_cluster - cluster;
+        cluster = next_cluster;
+      }
+      continue;
+    }
+
+    /* The group is only known to be full if it is scanned from its start */
+    if ((((fat_sec_num - mounted.info.BPB_RsvdSecCnt) & ((1 << mounted.free_map_shift) - 1)) == 0)
+        && (ent_offset == 0 || cluster == 2)) {
+      group_full = 1;
+    }
+#endif
 
-  /* iterate over fat sectors until free sector found */
-  do {
-    //    printf("\nfat_sec_num: %lu", fat_sec_num);
     if (read_sector(fat_sec_num) != 0) {
       PRINTERROR("\nERROR: read_sector() failed!");
-      fat_sec_num++;
-      continue;
+      return 0;
     }
-    if (mounted.info.type == FAT16) {
-      i = _get_free_cluster_16();
-    } else if (mounted.info.type == FAT32) {
-      i = _get_free_cluster_32();
+
+    for (i = ent_offset; i < mounted.info.BPB_BytesPerSec && cluster <= last_cluster; i += FAT_ENTRY_SIZE()) {
+      if (_is_free_entry(i)) {
+        if (!is_reserved_cluster(cluster)) {
+          PRINTF("\nfat.c: get_free_cluster(start_cluster = %lu) = %lu", start_cluster, cluster);
+          return cluster;
+        }
+#if FAT_FREE_MAP_SIZE > 0
+        group_full = 0;
+#endif
+      }
+      cluster++;
+      scanned++;
     }
-    fat_sec_num++;
-  } while (i == 512);
 
-  ent_offset = ((fat_sec_num - 1) - mounted.info.BPB_RsvdSecCnt) * mounted.info.BPB_BytesPerSec + i;
+#if FAT_FREE_MAP_SIZE > 0
+    /* Mark the group if its last sector was scanned without success */
+    if (group_full
+        && (cluster > last_cluster
+            || (((fat_sec_num + 1 - mounted.info.BPB_RsvdSecCnt) & ((1 << mounted.free_map_shift) - 1)) == 0))) {
+      FREE_MAP_SET_FULL(group);
+      group_full = 0;
+    }
+#endif
+
+    if (cluster > last_cluster) {
+      cluster = 2;
+#if FAT_FREE_MAP_SIZE > 0
+      group_full = 0;
+#endif
+    }
+  }
+
+  PRINTERROR("\nfat.c: get_free_cluster(): no free cluster left!");
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
+/**
+ * Checks the FAT entry at the given byte offset of the currently loaded
+ * (FAT) sector.
+ * \return 1 if the entry marks a free cluster, 0 otherwise
+ */
+static uint8_t
+_is_free_entry(uint16_t offset)
+{
   if (mounted.info.type == FAT16) {
-    ent_offset /= 2;
-  } else if (mounted.info.type == FAT32) {
-    ent_offset /= 4;
+    return sector_buffer[offset] == 0 && sector_buffer[offset + 1] == 0;
   }
 
-  PRINTF("\nfat.c: get_free_cluster(start_cluster = %lu) = %lu", start_cluster, ent_offset);
-  return ent_offset;
+  return sector_buffer[offset] == 0 && sector_buffer[offset + 1] == 0
+          && sector_buffer[offset + 2] == 0 && (sector_buffer[offset + 3] & 0x0F) == 0;
 }
 /*----------------------------------------------------------------------------*/
-static uint16_t
-_get_free_cluster_16()
+/*
+ * Updates the free space information after the given cluster was taken
+ * from the free clusters.
+ */
+static void
+cluster_allocated(uint32_t cluster)
 {
-  uint16_t entry = 0;
-  uint16_t i = 0;
+  if (mounted.free_count != FAT_FREE_COUNT_UNKNOWN && mounted.free_count != 0) {
+    mounted.free_count--;
+  }
+
+  mounted.next_free = cluster + 1;
+  if (mounted.next_free > mounted.num_clusters + 1) {
+    mounted.next_free = 2;
+  }
+  mounted.fsinfo_dirty = 1;
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Updates the free space information after the given cluster was released.
+ */
+static void
+cluster_freed(uint32_t cluster)
+{
+#if FAT_FREE_MAP_SIZE > 0
+  uint32_t fat_sec_num;
+  uint32_t ent_offset;
+
+  calc_fat_block(cluster, &fat_sec_num, &ent_offset);
+  FREE_MAP_CLEAR_FULL(FREE_MAP_GROUP(fat_sec_num));
+#endif
+
+  if (mounted.free_count != FAT_FREE_COUNT_UNKNOWN) {
+    mounted.free_count++;
+  }
+  mounted.fsinfo_dirty = 1;
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Takes a free cluster from the disk and marks it as end of a chain.
+ * The cluster following hint is preferred to keep files contiguous,
+ * otherwise the search continues at the next free cursor. If only reserved
+ * clusters are left, all reservations are dropped.
+ * Returns the new cluster, 0 if the disk is full.
+ */
+static uint32_t
+allocate_cluster(uint32_t hint)
+{
+  uint32_t cluster = 0;
+
+  if (hint >= 2 && hint <= mounted.num_clusters + 1
+      && read_fat_entry(hint) == 0 && !is_reserved_cluster(hint)) {
+    cluster = hint;
+  } else {
+    cluster = get_free_cluster(0);
+  }
+
+#if FAT_PREALLOC_CLUSTERS > 0
+  if (cluster == 0) {
+    memset(reservations, 0, sizeof (reservations));
+    cluster = get_free_cluster(0);
+  }
+#endif
+
+  if (cluster == 0) {
+    return 0;
+  }
+
+  write_fat_entry(cluster, EOC);
+  cluster_allocated(cluster);
+  return cluster;
+}
+/*----------------------------------------------------------------------------*/
+#if FAT_PREALLOC_CLUSTERS > 0
+/*
+ * Returns the reservation of the file starting at the given cluster,
+ * NULL if it has none.
+ */
+static struct cluster_reservation *
+find_reservation(uint32_t owner)
+{
+  uint8_t i;
+
+  if (owner == 0) {
+    return NULL;
+  }
 
-  for (i = 0; i < 512; i += 2) {
-    entry = (((uint16_t) sector_buffer[i]) << 8) + ((uint16_t) sector_buffer[i + 1]);
-    if (entry == 0) {
-      return i;
+  for (i = 0; i < FAT_PREALLOC_FILES; i++) {
+    if (reservations[i].owner == owner) {
+      return &reservations[i];
     }
   }
 
-  return 512;
+  return NULL;
 }
 /*----------------------------------------------------------------------------*/
-/**
- * Iterates over currently loaded (FAT) sector and searches for free cluster.
- * \return 0,4,...,511: cluster number offset relative to current fat sector,
- * 512: no free cluster found
+/*
+ * Reserves up to FAT_PREALLOC_CLUSTERS contiguous free clusters, preferably
+ * starting at hint. Only the RAM reservation is made, the FAT is not touched
+ * before a cluster is used.
+ * Returns the reservation, NULL if there is no free cluster.
  */
-static uint16_t
-_get_free_cluster_32()
+static struct cluster_reservation *
+reserve_clusters(uint32_t hint)
 {
-  uint32_t entry = 0;
-  uint16_t i = 0;
+  struct cluster_reservation *res = NULL;
+  uint32_t cluster = 0;
+  uint16_t count = 1;
+  uint8_t i;
 
-  // TODO check...
-  //if (sector_buffer_addr > data start sector) .... ERROR
+  if (hint >= 2 && hint <= mounted.num_clusters + 1
+      && read_fat_entry(hint) == 0 && !is_reserved_cluster(hint)) {
+    cluster = hint;
+  } else {
+    cluster = get_free_cluster(0);
+  }
 
-  for (i = 0; i < 512; i += 4) {
-    entry = (((uint32_t) sector_buffer[i + 3]) << 24) + (((uint32_t) sector_buffer[i + 2]) << 16) + (((uint32_t) sector_buffer[i + 1]) << 8) + ((uint32_t) sector_buffer[i]);
+  if (cluster == 0) {
+    return NULL;
+  }
 
-    if ((entry & 0x0FFFFFFF) == 0) {
-      return i;
+  while (count < FAT_PREALLOC_CLUSTERS
+         && cluster + count <= mounted.num_clusters + 1
+         && read_fat_entry(cluster + count) == 0
+         && !is_reserved_cluster(cluster + count)) {
+    count++;
+  }
+
+  /* Take an unused slot, otherwise replace the slots round robin */
+  for (i = 0; i < FAT_PREALLOC_FILES; i++) {
+    if (reservations[i].owner == 0) {
+      res = &reservations[i];
+      break;
     }
   }
+  if (res == NULL) {
+    res = &reservations[reservation_next];
+    reservation_next = (reservation_next + 1) % FAT_PREALLOC_FILES;
+  }
 
-  return 512;
+  res->cluster = cluster;
+  res->count = count;
+  PRINTF("\nfat.c: reserve_clusters( hint = %lu ): %u clusters at %lu", hint, count, cluster);
+  return res;
 }
+#endif
 /*----------------------------------------------------------------------------*/
 /* With a given start cluster it looks for the nth cluster in the corresponding chain
+ * Returns 0 if the chain is shorter.
  */
 static uint32_t
 find_nth_cluster(uint32_t start_cluster, uint32_t n)
@@ -261,14 +558,108 @@ find_nth_cluster(uint32_t start_cluster, uint32_t n)
   uint32_t cluster = start_cluster,
           i = 0;
 
-  for (i = 0; i < n; i++) {
+  for (i = 0; i < n && cluster >= 2 && !is_EOC(cluster); i++) {
     cluster = read_fat_entry(cluster);
   }
 
+  if (cluster < 2 || is_EOC(cluster)) {
+    cluster = 0;
+  }
+
   PRINTF("\nfat.c: find_nth_cluster( start_cluster = %lu, n = %lu ) = %lu", start_cluster, n, cluster);
   return cluster;
 }
 /*----------------------------------------------------------------------------*/
+/*
+ * Inserts a new run of length 1 as most recently used run of the file,
+ * dropping the least recently used one.
+ */
+static struct cluster_run *
+add_cluster_run(struct file *file, uint32_t index, uint32_t cluster)
+{
+  memmove(&file->runs[1], &file->runs[0], (FAT_RUN_CACHE_SIZE - 1) * sizeof (struct cluster_run));
+  file->runs[0].index = index;
+  file->runs[0].cluster = cluster;
+  file->runs[0].length = 1;
+  return &file->runs[0];
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Returns the disk cluster of the nth cluster of the file.
+ * Known runs of the cluster chain are used to skip over contiguous parts,
+ * the FAT is only walked from the closest known run on. Walked parts of
+ * the chain are remembered as runs.
+ * If the chain ends before the nth cluster, EOC is returned and the last
+ * cluster of the chain is stored as nth_cluster of the file.
+ */
+static uint32_t
+find_cluster_of_file(int fd, uint32_t n)
+{
+  struct file *file = &fat_file_pool[fd];
+  struct cluster_run *run = NULL;
+  struct cluster_run tmp;
+  uint32_t index, cluster, next;
+  uint8_t i;
+
+  if (file->cluster == 0) {
+    return EOC;
+  }
+
+  for (i = 0; i < FAT_RUN_CACHE_SIZE && file->runs[i].length != 0; i++) {
+    if (n < file->runs[i].index) {
+      continue;
+    }
+
+    if (n - file->runs[i].index < file->runs[i].length) {
+      sector_cache_stats.run_hits++;
+      cluster = file->runs[i].cluster + (n - file->runs[i].index);
+      /* move to front */
+      memcpy(&tmp, &file->runs[i], sizeof (struct cluster_run));
+      memmove(&file->runs[1], &file->runs[0], i * sizeof (struct cluster_run));
+      memcpy(&file->runs[0], &tmp, sizeof (struct cluster_run));
+      return cluster;
+    }
+
+    /* remember closest run below n */
+    if (run == NULL || file->runs[i].index > run->index) {
+      run = &file->runs[i];
+    }
+  }
+
+  sector_cache_stats.run_misses++;
+
+  if (run == NULL) {
+    run = add_cluster_run(file, 0, file->cluster);
+  } else {
+    memcpy(&tmp, run, sizeof (struct cluster_run));
+    memmove(&file->runs[1], &file->runs[0], (run - file->runs) * sizeof (struct cluster_run));
+    memcpy(&file->runs[0], &tmp, sizeof (struct cluster_run));
+    run = &file->runs[0];
+  }
+
+  index = run->index + run->length - 1;
+  cluster = run->cluster + run->length - 1;
+  while (index < n) {
+    next = read_fat_entry(cluster);
+    if (is_EOC(next) || next < 2) {
+      file->n = index;
+      file->nth_cluster = cluster;
+      return EOC;
+    }
+
+    index++;
+    if (next == cluster + 1 && run->length < 0xFFFF) {
+      run->length++;
+    } else {
+      run = add_cluster_run(file, index, next);
+    }
+    cluster = next;
+  }
+
+  PRINTF("\nfat.c: find_cluster_of_file( fd = %d, n = %lu ) = %lu", fd, n, cluster);
+  return cluster;
+}
+/*----------------------------------------------------------------------------*/
 /*
  * Iterates over a cluster chain corresponding to a given dir entry and removes all entries.
  */
@@ -276,56 +667,114 @@ static void
 reset_cluster_chain(struct dir_entry *dir_ent)
 {
   uint32_t cluster = (((uint32_t) dir_ent->DIR_FstClusHI) << 16) + dir_ent->DIR_FstClusLO;
-  uint32_t next_cluster = read_fat_entry(cluster);
+  uint32_t next_cluster;
+#if FAT_PREALLOC_CLUSTERS > 0
+  struct cluster_reservation *res = find_reservation(cluster);
 
-  while (!is_EOC(cluster) && cluster >= 2) {
+  if (res != NULL) {
+    res->owner = 0;
+  }
+#endif
+
+  while (cluster >= 2 && cluster <= mounted.num_clusters + 1) {
+    next_cluster = read_fat_entry(cluster);
     write_fat_entry(cluster, 0L);
+    cluster_freed(cluster);
     cluster = next_cluster;
-    next_cluster = read_fat_entry(cluster);
   }
-
-  write_fat_entry(cluster, 0L);
 }
 /*----------------------------------------------------------------------------*/
 /*
  * Searches for next free cluster to add id to the file associated with the
- * given file descriptor.
+ * given file descriptor. Files opened for appending take their clusters from
+ * a contiguous reservation which is kept beyond closing the file.
+ * Returns 0 on success, 1 if the disk is full.
  */
-static void
+static uint8_t
 add_cluster_to_file(int fd)
 {
-  /* get the address of any free cluster */
-  uint32_t free_cluster = get_free_cluster(0);
-  uint32_t cluster = fat_file_pool[fd].nth_cluster;
+  struct file *file = &fat_file_pool[fd];
+#if FAT_PREALLOC_CLUSTERS > 0
+  struct cluster_reservation *res = NULL;
+#endif
+  uint32_t free_cluster = 0;
+  uint32_t cluster = file->nth_cluster;
   uint32_t n = cluster;
-  PRINTF("\nfat.c: add_cluster_to_file( fd = %d ) = void", fd);
+  PRINTF("\nfat.c: add_cluster_to_file( fd = %d ) = ?", fd);
 
-  // if file has no cluster yet, add first
-  if (fat_file_pool[fd].cluster == 0) {
+  if (file->cluster != 0) {
+    while (!is_EOC(n)) {
+      cluster = n;
+      n = read_fat_entry(cluster);
+      file->n++;
+    }
+  }
+
+#if FAT_PREALLOC_CLUSTERS > 0
+  if (fat_fd_pool[fd].flags & CFS_APPEND) {
+    res = find_reservation(file->cluster);
+    if (res == NULL) {
+      res = reserve_clusters(file->cluster != 0 ? cluster + 1 : 0);
+    }
+  }
+
+  if (res != NULL) {
+    free_cluster = res->cluster;
     write_fat_entry(free_cluster, EOC);
-    fat_file_pool[fd].dir_entry.DIR_FstClusHI = (uint16_t) (free_cluster >> 16);
-    fat_file_pool[fd].dir_entry.DIR_FstClusLO = (uint16_t) (free_cluster);
+    cluster_allocated(free_cluster);
+
+    /* The reservation belongs to the file starting at its first cluster */
+    res->owner = file->cluster != 0 ? file->cluster : free_cluster;
+    res->cluster++;
+    if (--res->count == 0) {
+      res->owner = 0;
+    }
+  } else
+#endif
+  {
+    free_cluster = allocate_cluster(file->cluster != 0 ? cluster + 1 : 0);
+  }
+
+  if (free_cluster == 0) {
+    PRINTERROR("\nfat.c: add_cluster_to_file(): disk full!");
+    if (file->cluster != 0) {
+      file->n--;
+      file->nth_cluster = cluster;
+    }
+    return 1;
+  }
+
+  // if file has no cluster yet, add first
+  if (file->cluster == 0) {
+    file->dir_entry.DIR_FstClusHI = (uint16_t) (free_cluster >> 16);
+    file->dir_entry.DIR_FstClusLO = (uint16_t) (free_cluster);
 
     update_dir_entry(fd);
 
-    fat_file_pool[fd].cluster = free_cluster;
-    fat_file_pool[fd].n = 0;
-    fat_file_pool[fd].nth_cluster = free_cluster;
+    file->cluster = free_cluster;
+    file->n = 0;
+    file->nth_cluster = free_cluster;
+    memset(file->runs, 0, sizeof (file->runs));
+    add_cluster_run(file, 0, free_cluster);
 
     PRINTF("\n\tfat.c: File was empty, now has first cluster %lu added to Chain", free_cluster);
-    return;
-  }
-
-  while (!is_EOC(n)) {
-    cluster = n;
-    n = read_fat_entry(cluster);
-    fat_file_pool[fd].n++;
+    return 0;
   }
 
   write_fat_entry(cluster, free_cluster);
-  write_fat_entry(free_cluster, EOC);
-  fat_file_pool[fd].nth_cluster = free_cluster;
-  PRINTF("\n\tfat.c: File was NOT empty, now has cluster %lu as %lu. cluster to Chain", free_cluster, fat_file_pool[fd].n);
+  file->nth_cluster = free_cluster;
+
+  /* Extend the run ending at the previous last cluster or start a new one */
+  if (file->runs[0].length != 0
+      && file->runs[0].index + file->runs[0].length == file->n
+      && file->runs[0].cluster + file->runs[0].length == free_cluster
+      && file->runs[0].length < 0xFFFF) {
+    file->runs[0].length++;
+  } else {
+    add_cluster_run(file, file->n, free_cluster);
+  }
+  PRINTF("\n\tfat.c: File was NOT empty, now has cluster %lu as %lu. cluster to Chain", free_cluster, file->n);
+  return 0;
 }
 /*----------------------------------------------------------------------------*/
 /*Debug Functions*/
@@ -492,7 +941,7 @@ write_fat_entry(uint32_t cluster_num, uint32_t value)
     sector_buffer[ent_offset] = (uint8_t) (value);
   }
 
-  sector_buffer_dirty = 1;
+  MARK_SECTOR_BUFFER_DIRTY();
 }
 /*----------------------------------------------------------------------------*/
 /*
@@ -606,83 +1055,239 @@ pr_is_current_path_part_a_file(struct PathResolver *rsolv)
   return 0;
 }
 /*----------------------------------------------------------------------------*/
-/*Sector Buffer Functions*/
-/**
- * Writes the current buffered block back to the disk if it was changed.
- */
-void
-cfs_fat_flush()
+/*Sector Cache Functions*/
+/* Writes a single cache entry back to the disk if it was changed. */
+static void
+sector_cache_write_back(struct sector_cache_entry *entry)
 {
-  if (!sector_buffer_dirty) {
+  if ((entry->flags & (SECTOR_CACHE_VALID | SECTOR_CACHE_DIRTY)) != (SECTOR_CACHE_VALID | SECTOR_CACHE_DIRTY)) {
     return;
   }
 
-#ifdef FAT_COOPERATIVE
-  if (!coop_step_allowed) {
-    next_step_type = WRITE;
-    coop_switch_sp();
+  PRINTF("\nfat.c: sector_cache_write_back(): Flushing sector %lu", entry->addr);
+  if (diskio_write_block(mounted.dev, entry->addr, entry->data) != DISKIO_SUCCESS) {
+    PRINTERROR("\nfat.c: sector_cache_write_back(): DiskIO-Error occured");
+  }
+
+  sector_cache_stats.flushes++;
+  entry->flags &= ~SECTOR_CACHE_DIRTY;
+}
+/*----------------------------------------------------------------------------*/
+/* Returns the cache entry holding the given sector or NULL. */
+static struct sector_cache_entry *
+sector_cache_find(uint32_t sector_addr)
+{
+  uint8_t i;
+
+  for (i = 0; i < FAT_CACHE_SIZE; i++) {
+    if ((sector_cache[i].flags & SECTOR_CACHE_VALID) && sector_cache[i].addr == sector_addr) {
+      return &sector_cache[i];
+    }
+  }
+
+  return NULL;
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Selects the entry to be replaced next. Free entries are used first,
+ * otherwise the entry with the highest age reduced by its priority bonus
+ * is chosen, i.e. LRU within each priority class.
+ */
+static struct sector_cache_entry *
+sector_cache_victim()
+{
+  struct sector_cache_entry *victim = NULL;
+  int32_t victim_score = 0;
+  int32_t score;
+  uint8_t i;
+
+  for (i = 0; i < FAT_CACHE_SIZE; i++) {
+    if (!(sector_cache[i].flags & SECTOR_CACHE_VALID)) {
+      return &sector_cache[i];
+    }
+
+    score = (int32_t) (sector_cache_tick - sector_cache[i].last_use) - sector_cache[i].prio;
+    if (victim == NULL || score > victim_score) {
+      victim = &sector_cache[i];
+      victim_score = score;
+    }
+  }
+
+  return victim;
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Makes the given sector the current sector buffer.
+ * If load is 0 the sector is not read from the disk if not cached, the
+ * caller is expected to overwrite it completely.
+ */
+static uint8_t
+sector_cache_select(uint32_t sector_addr, uint8_t prio, uint8_t load)
+{
+  struct sector_cache_entry *entry = sector_cache_find(sector_addr);
+
+  if (entry != NULL) {
+    sector_cache_stats.hits++;
+    if (prio > entry->prio) {
+      entry->prio = prio;
+    }
   } else {
-    coop_step_allowed = 0;
+    sector_cache_stats.misses++;
+    entry = sector_cache_victim();
+    sector_cache_write_back(entry);
+    entry->flags = 0;
+
+    if (load) {
+      if (diskio_read_block(mounted.dev, sector_addr, entry->data) != 0) {
+        PRINTERROR("\nfat.c: Error while reading sector 0x%lX", sector_addr);
+        sector_cache_cur = entry;
+        sector_buffer = entry->data;
+        sector_buffer_addr = 0;
+        return 1;
+      }
+    }
+
+    entry->addr = sector_addr;
+    entry->flags = SECTOR_CACHE_VALID;
+    entry->prio = prio;
   }
-#endif
 
-  PRINTF("\nfat.c: fat_flush(): Flushing sector %lu", sector_buffer_addr);
-  if (diskio_write_block(mounted.dev, sector_buffer_addr, sector_buffer) != DISKIO_SUCCESS) {
-    PRINTERROR("\nfat.c: fat_flush(): DiskIO-Error occured");
+  entry->last_use = ++sector_cache_tick;
+
+  sector_cache_cur = entry;
+  sector_buffer = entry->data;
+  sector_buffer_addr = sector_addr;
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
+/* Drops all cached sectors without writing them back. */
+static void
+sector_cache_invalidate()
+{
+  uint8_t i;
+
+  for (i = 0; i < FAT_CACHE_SIZE; i++) {
+    sector_cache[i].flags = 0;
+  }
+  sector_buffer_addr = 0;
+}
+/*----------------------------------------------------------------------------*/
+/* Writes back cached sectors within the given range, e.g. before the range
+ * is read bypassing the cache. */
+static void
+sector_cache_write_back_range(uint32_t first_sector, uint32_t num_sectors)
+{
+  uint8_t i;
+
+  for (i = 0; i < FAT_CACHE_SIZE; i++) {
+    if (sector_cache[i].addr >= first_sector && sector_cache[i].addr - first_sector < num_sectors) {
+      sector_cache_write_back(&sector_cache[i]);
+    }
+  }
+}
+/*----------------------------------------------------------------------------*/
+/* Drops cached sectors within the given range without writing them back,
+ * e.g. before the range is overwritten bypassing the cache. */
+static void
+sector_cache_invalidate_range(uint32_t first_sector, uint32_t num_sectors)
+{
+  uint8_t i;
+
+  for (i = 0; i < FAT_CACHE_SIZE; i++) {
+    if (sector_cache[i].addr >= first_sector && sector_cache[i].addr - first_sector < num_sectors) {
+      sector_cache[i].flags = 0;
+    }
+  }
+
+  if (sector_buffer_addr >= first_sector && sector_buffer_addr - first_sector < num_sectors) {
+    sector_buffer_addr = 0;
+  }
+}
+/*----------------------------------------------------------------------------*/
+/* Returns the cache priority for a sector derived from the region it is in. */
+static uint8_t
+sector_prio(uint32_t sector_addr)
+{
+  if (sector_addr >= mounted.first_data_sector) {
+    return FAT_CACHE_PRIO_DATA;
   }
 
-  sector_buffer_dirty = 0;
+  if (sector_addr >= mounted.info.BPB_RsvdSecCnt + mounted.info.BPB_NumFATs * mounted.info.BPB_FATSz) {
+    /* FAT16 root directory region */
+    return FAT_CACHE_PRIO_DIR;
+  }
+
+  return FAT_CACHE_PRIO_FAT;
+}
+/*----------------------------------------------------------------------------*/
+/**
+ * Writes the FSInfo and all changed cached sectors back to the disk.
+ */
+void
+cfs_fat_flush()
+{
+  uint8_t i;
+
+  store_fsinfo();
+
+  for (i = 0; i < FAT_CACHE_SIZE; i++) {
+    sector_cache_write_back(&sector_cache[i]);
+  }
+}
+/*----------------------------------------------------------------------------*/
+void
+cfs_fat_get_cache_stats(struct fat_cache_stats *stats)
+{
+  memcpy(stats, &sector_cache_stats, sizeof (struct fat_cache_stats));
+}
+/*----------------------------------------------------------------------------*/
+void
+cfs_fat_reset_cache_stats()
+{
+  memset(&sector_cache_stats, 0, sizeof (struct fat_cache_stats));
 }
 /*----------------------------------------------------------------------------*/
 /* Reads sector at given address.
- * If sector is already loaded, this version is used.
- * If sector is not loaded, previous sector is flushed and new sector is loaded
- * from medium.
+ * If sector is already cached, the cached version is used.
+ * If sector is not cached, the least recently used entry is written back
+ * if required and replaced by the sector loaded from medium.
  */
 static uint8_t
 read_sector(uint32_t sector_addr)
 {
-  if (sector_buffer_addr == sector_addr && sector_addr != 0) {
-    PRINTF("\nfat.c: fat_read_sector( sector_addr = 0x%lX ) = 0", sector_addr);
-    return 0;
-  }
-
-  cfs_fat_flush();
-
-  sector_buffer_addr = sector_addr;
-
-#ifdef FAT_COOPERATIVE
-  if (!coop_step_allowed) {
-    next_step_type = READ;
-    coop_switch_sp();
-  } else {
-    coop_step_allowed = 0;
-  }
-#endif
-
-  if (diskio_read_block(mounted.dev, sector_addr, sector_buffer) != 0) {
-    PRINTERROR("\nfat.c: Error while reading sector 0x%lX", sector_addr);
-    sector_buffer_addr = 0;
-    return 1;
-  }
-
-  PRINTF("\nfat.c: read_sector( sector_addr = 0x%lX ) = 0", sector_addr);
-  return 0;
+  PRINTF("\nfat.c: read_sector( sector_addr = 0x%lX )", sector_addr);
+  return sector_cache_select(sector_addr, sector_prio(sector_addr), 1);
+}
+/*----------------------------------------------------------------------------*/
+/* Reads a sector that is known to contain directory entries. */
+static uint8_t
+read_dir_sector(uint32_t sector_addr)
+{
+  PRINTF("\nfat.c: read_dir_sector( sector_addr = 0x%lX )", sector_addr);
+  return sector_cache_select(sector_addr, FAT_CACHE_PRIO_DIR, 1);
 }
 /*----------------------------------------------------------------------------*/
 /** Loads the next sector of current sector_buffer_addr.
  * \return
  *  Returns 0 if sector could be read
- *  If this was the last sector in a cluster chain, it returns error code 128.
+ *  If this was the last sector in a cluster chain or of the FAT16 root
+ *  directory, it returns error code 128.
  */
 static uint8_t
 read_next_sector()
 {
   PRINTF("\nread_next_sector()");
-  cfs_fat_flush();
 
   /* To restore start sector buffer address if reading next sector failed. */
   uint32_t save_sbuff_addr = sector_buffer_addr;
+  /* The FAT16 root directory is a fixed region in front of the data
+   * region, it has no clusters */
+  if (sector_buffer_addr < mounted.first_data_sector) {
+    if (sector_buffer_addr + 1 == mounted.first_data_sector) {
+      return 128;
+    }
+    return read_dir_sector(sector_buffer_addr + 1);
+  }
   /* Are we on a Cluster edge? */
   if ((sector_buffer_addr - mounted.first_data_sector + 1) % mounted.info.BPB_SecPerClus == 0) {
     PRINTDEBUG("\nCluster end, trying to load next");
@@ -692,15 +1297,15 @@ read_next_sector()
     if (is_EOC(entry)) {
       PRINTDEBUG("\nis_EOC! (%ld)", sector_buffer_addr);
       /* Restore previous sector adress. */
-      read_sector(save_sbuff_addr);
+      read_dir_sector(save_sbuff_addr);
       return 128;
     }
 
     /* The entry is valid and we calculate the first sector number of this new cluster and read it */
-    return read_sector(CLUSTER_TO_SECTOR(entry));
+    return read_dir_sector(CLUSTER_TO_SECTOR(entry));
   } else {
     /* We are still inside a cluster, so we only need to read the next sector */
-    return read_sector(sector_buffer_addr + 1);
+    return read_dir_sector(sector_buffer_addr + 1);
   }
 }
 /*----------------------------------------------------------------------------*/
@@ -814,13 +1419,17 @@ cfs_fat_mount_device(struct diskio_device_info *dev)
   }
 
   //read first sector into buffer
-  diskio_read_block(dev, 0, sector_buffer);
+  sector_cache_invalidate();
+  diskio_read_block(dev, 0, sector_cache[0].data);
 
   //parse bootsector
-  if (parse_bootsector(sector_buffer, &(mounted.info)) != 0) {
+  if (parse_bootsector(sector_cache[0].data, &(mounted.info)) != 0) {
     return 1;
   }
 
+  // BPB_FSInfo, only present for FAT32
+  mounted.fsinfo_sector = sector_cache[0].data[48] + (((uint16_t) sector_cache[0].data[49]) << 8);
+
   //return 2 if unsupported
   if (mounted.info.type != FAT16 && mounted.info.type != FAT32) {
     return 2;
@@ -836,9 +1445,127 @@ cfs_fat_mount_device(struct diskio_device_info *dev)
   RootDirSectors = ((mounted.info.BPB_RootEntCnt * DIR_ENTRY_SIZE) + (mounted.info.BPB_BytesPerSec - 1)) / mounted.info.BPB_BytesPerSec;
   mounted.first_data_sector = mounted.info.BPB_RsvdSecCnt + (mounted.info.BPB_NumFATs * mounted.info.BPB_FATSz) + RootDirSectors;
 
+  //Number of data clusters, limited by the number of FAT entries
+  mounted.num_clusters = (mounted.info.BPB_TotSec - mounted.first_data_sector) / mounted.info.BPB_SecPerClus;
+  if (mounted.num_clusters > mounted.info.BPB_FATSz * (mounted.info.BPB_BytesPerSec / FAT_ENTRY_SIZE()) - 2) {
+    mounted.num_clusters = mounted.info.BPB_FATSz * (mounted.info.BPB_BytesPerSec / FAT_ENTRY_SIZE()) - 2;
+  }
+
+#if FAT_FREE_MAP_SIZE > 0
+  memset(free_map, 0, sizeof (free_map));
+  mounted.free_map_shift = 0;
+  while ((mounted.info.BPB_FATSz >> mounted.free_map_shift) > FAT_FREE_MAP_SIZE * 8UL) {
+    mounted.free_map_shift++;
+  }
+#endif
+
+#if FAT_PREALLOC_CLUSTERS > 0
+  memset(reservations, 0, sizeof (reservations));
+#endif
+#if FAT_DENTRY_CACHE_SIZE > 0
+  memset(dentry_cache, 0, sizeof (dentry_cache));
+#endif
+
+  load_fsinfo();
+
   return 0;
 }
 /*----------------------------------------------------------------------------*/
+static uint32_t
+get_uint32(uint8_t *buffer)
+{
+  return buffer[0] + (((uint32_t) buffer[1]) << 8) + (((uint32_t) buffer[2]) << 16) + (((uint32_t) buffer[3]) << 24);
+}
+/*----------------------------------------------------------------------------*/
+static void
+set_uint32(uint8_t *buffer, uint32_t value)
+{
+  buffer[0] = (uint8_t) value;
+  buffer[1] = (uint8_t) (value >> 8);
+  buffer[2] = (uint8_t) (value >> 16);
+  buffer[3] = (uint8_t) (value >> 24);
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Initializes the free space information of the mounted device. For FAT32
+ * the free count and next free hint are taken from the FSInfo sector, both
+ * are only hints and checked for plausibility.
+ */
+static void
+load_fsinfo()
+{
+  uint32_t value;
+
+  mounted.free_count = FAT_FREE_COUNT_UNKNOWN;
+  mounted.next_free = 2;
+  mounted.fsinfo_dirty = 0;
+
+  if (mounted.info.type != FAT32
+      || mounted.fsinfo_sector == 0
+      || mounted.fsinfo_sector >= mounted.info.BPB_RsvdSecCnt) {
+    mounted.fsinfo_sector = 0;
+    return;
+  }
+
+  if (read_sector(mounted.fsinfo_sector) != 0
+      || get_uint32(&sector_buffer[FSINFO_LEAD_SIG_OFFSET]) != FSINFO_LEAD_SIG
+      || get_uint32(&sector_buffer[FSINFO_STRUC_SIG_OFFSET]) != FSINFO_STRUC_SIG) {
+    PRINTERROR("\nfat.c: load_fsinfo(): invalid FSInfo sector");
+    mounted.fsinfo_sector = 0;
+    return;
+  }
+
+  value = get_uint32(&sector_buffer[FSINFO_FREE_COUNT_OFFSET]);
+  if (value <= mounted.num_clusters) {
+    mounted.free_count = value;
+  }
+
+  value = get_uint32(&sector_buffer[FSINFO_NXT_FREE_OFFSET]);
+  if (value >= 2 && value <= mounted.num_clusters + 1) {
+    mounted.next_free = value;
+  }
+
+  PRINTF("\nfat.c: load_fsinfo(): free_count = %lu, next_free = %lu", mounted.free_count, mounted.next_free);
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Writes the current free count and next free hint into the FSInfo sector.
+ */
+static void
+store_fsinfo()
+{
+  if (!mounted.fsinfo_dirty || mounted.fsinfo_sector == 0) {
+    return;
+  }
+
+  if (read_sector(mounted.fsinfo_sector) != 0) {
+    return;
+  }
+
+  set_uint32(&sector_buffer[FSINFO_FREE_COUNT_OFFSET], mounted.free_count);
+  set_uint32(&sector_buffer[FSINFO_NXT_FREE_OFFSET], mounted.next_free);
+  MARK_SECTOR_BUFFER_DIRTY();
+  mounted.fsinfo_dirty = 0;
+}
+/*----------------------------------------------------------------------------*/
+uint32_t
+cfs_fat_free_clusters()
+{
+  uint32_t cluster;
+
+  if (mounted.free_count == FAT_FREE_COUNT_UNKNOWN) {
+    mounted.free_count = 0;
+    for (cluster = 2; cluster <= mounted.num_clusters + 1; cluster++) {
+      if (read_fat_entry(cluster) == 0) {
+        mounted.free_count++;
+      }
+    }
+    mounted.fsinfo_dirty = 1;
+  }
+
+  return mounted.free_count;
+}
+/*----------------------------------------------------------------------------*/
 void
 cfs_fat_umount_device()
 {
@@ -857,9 +1584,9 @@ cfs_fat_umount_device()
     fat_fd_pool[i].file = 0;
   }
 
-  // Reset the device pointer and sector buffer
+  // Reset the device pointer and sector cache
   mounted.dev = 0;
-  sector_buffer_addr = 0;
+  sector_cache_invalidate();
 }
 /*----------------------------------------------------------------------------*/
 /*CFS frontend functions*/
@@ -872,7 +1599,6 @@ cfs_open(const char *name, int flags)
   struct dir_entry dir_ent;
   PRINTF("\nfat.c: cfs_open( name = %s, flags = %x) = ?", name, flags);
 
-#ifndef FAT_COOPERATIVE
   for (i = 0; i < FAT_FD_POOL_SIZE; i++) {
     if (fat_fd_pool[i].file == 0) {
       fd = i;
@@ -885,9 +1611,6 @@ cfs_open(const char *name, int flags)
     PRINTF("\nfat.c: cfs_open(): No free FileDescriptors available!");
     return fd;
   }
-#else /* !FAT_COOPERATIVE */
-  fd = queue[queue_start].ret_value;
-#endif /* !FAT_COOPERATIVE */
 
   /* Reset entry for overwriting */
   if (flags & CFS_WRITE) {
@@ -913,6 +1636,7 @@ cfs_open(const char *name, int flags)
   fat_file_pool[fd].cluster = dir_ent.DIR_FstClusLO + (((uint32_t) dir_ent.DIR_FstClusHI) << 16);
   fat_file_pool[fd].nth_cluster = fat_file_pool[fd].cluster;
   fat_file_pool[fd].n = 0;
+  memset(fat_file_pool[fd].runs, 0, sizeof (fat_file_pool[fd].runs));
   fat_fd_pool[fd].file = &(fat_file_pool[fd]);
   fat_fd_pool[fd].flags = (uint8_t) flags;
 
@@ -922,7 +1646,8 @@ cfs_open(const char *name, int flags)
 
   if (flags & CFS_APPEND) {
     PRINTF("\nfat.c: cfs_open(): Seek to end of file (APPEND)!");
-    cfs_seek(fd, 0, CFS_SEEK_END);
+    /* cfs_seek() limits the offset to the last byte of the file */
+    fat_fd_pool[fd].offset = fat_file_pool[fd].dir_entry.DIR_FileSize;
   }
 
   // return FileDescriptor
@@ -975,7 +1700,8 @@ fat_read_write(int fd, const void *buf, unsigned int len, unsigned char write)
   uint32_t clusters = (fat_fd_pool[fd].offset / mounted.info.BPB_BytesPerSec) / mounted.info.BPB_SecPerClus;
   /* offset within cluster [sectors] */
   uint8_t clus_offset = (fat_fd_pool[fd].offset / mounted.info.BPB_BytesPerSec) % mounted.info.BPB_SecPerClus;
-  uint16_t i, j = 0;
+  uint16_t i;
+  uint32_t j = 0;
   uint8_t *buffer = (uint8_t *) buf;
 
   /* For read acces, check file length. */
@@ -994,15 +1720,37 @@ fat_read_write(int fd, const void *buf, unsigned int len, unsigned char write)
     }
   }
 
-  while (load_next_sector_of_file(fd, clusters, clus_offset, write) == 0) {
-    PRINTF("\nfat.c: cfs_write(): Writing in sector %lu", sector_buffer_addr);
+  while (j < len) {
+    /* Sector aligned transfers of more than one sector bypass the sector
+     * cache, only unaligned head and tail bytes go through it. */
+    if (offset == 0 && len - j >= 2 * (uint32_t) mounted.info.BPB_BytesPerSec) {
+      uint32_t sectors;
+      if (write) {
+        sectors = write_sectors_of_file(fd, clusters, clus_offset, &buffer[j], (len - j) / mounted.info.BPB_BytesPerSec);
+      } else {
+        sectors = read_sectors_of_file(fd, clusters, clus_offset, &buffer[j], (len - j) / mounted.info.BPB_BytesPerSec);
+      }
+      if (sectors > 0) {
+        j += sectors * mounted.info.BPB_BytesPerSec;
+        fat_fd_pool[fd].offset += sectors * mounted.info.BPB_BytesPerSec;
+        clusters += (clus_offset + sectors) / mounted.info.BPB_SecPerClus;
+        clus_offset = (clus_offset + sectors) % mounted.info.BPB_SecPerClus;
+        /* Enlarge file size if required */
+        if (write && fat_fd_pool[fd].offset > fat_file_pool[fd].dir_entry.DIR_FileSize) {
+          fat_file_pool[fd].dir_entry.DIR_FileSize = fat_fd_pool[fd].offset;
+        }
+        continue;
+      }
+    }
+
+    if (load_next_sector_of_file(fd, clusters, clus_offset, write) != 0) {
+      break;
+    }
+
+    PRINTF("\nfat.c: fat_read_write(): Accessing sector %lu", sector_buffer_addr);
     for (i = offset; i < mounted.info.BPB_BytesPerSec && j < len; i++, j++, fat_fd_pool[fd].offset++) {
       if (write) {
-#ifndef FAT_COOPERATIVE
         sector_buffer[i] = buffer[j];
-#else
-        sector_buffer[i] = get_item_from_buffer(buffer, j);
-#endif
         /* Enlarge file size if required */
         if (fat_fd_pool[fd].offset == fat_file_pool[fd].dir_entry.DIR_FileSize) {
           fat_file_pool[fd].dir_entry.DIR_FileSize++;
@@ -1015,7 +1763,7 @@ fat_read_write(int fd, const void *buf, unsigned int len, unsigned char write)
     }
 
     if (write) {
-      sector_buffer_dirty = 1;
+      MARK_SECTOR_BUFFER_DIRTY();
     }
     
     offset = 0;
@@ -1023,10 +1771,6 @@ fat_read_write(int fd, const void *buf, unsigned int len, unsigned char write)
     if (clus_offset == 0) {
       clusters++;
     }
-
-    if (j >= len) {
-      break;
-    }
   }
 
   return j;
@@ -1091,10 +1835,23 @@ cfs_opendir(struct cfs_dir *dirp, const char *name)
   struct dir_entry dir_ent;
   uint32_t sector;
   uint16_t offset;
-  uint32_t dir_cluster = get_dir_entry(name, &dir_ent, &sector, &offset, 0);
+  uint32_t dir_cluster;
 
   cfs_readdir_offset = 0;
 
+  /* The root directory has no entry of its own, FAT16 keeps it in a fixed
+   * region which is marked by cluster 0 */
+  if (name[0] == '\0' || (name[0] == '/' && name[1] == '\0')) {
+    memset(&dir_ent, 0, sizeof (struct dir_entry));
+    if (mounted.info.type == FAT32) {
+      dir_ent.DIR_FstClusLO = (uint16_t) mounted.info.BPB_RootClus;
+      dir_ent.DIR_FstClusHI = (uint16_t) (mounted.info.BPB_RootClus >> 16);
+    }
+    memcpy(dirp, &dir_ent, sizeof (struct dir_entry));
+    return 0;
+  }
+
+  dir_cluster = get_dir_entry(name, &dir_ent, &sector, &offset, 0);
   if (dir_cluster == 0) {
     return -1;
   }
@@ -1108,27 +1865,45 @@ cfs_readdir(struct cfs_dir *dirp, struct cfs_dirent *dirent)
 {
   struct dir_entry *dir_ent = (struct dir_entry *) dirp;
   struct dir_entry entry;
+  uint32_t first_cluster = (((uint32_t) dir_ent->DIR_FstClusHI) << 16) + dir_ent->DIR_FstClusLO;
+  uint32_t cluster_size = (uint32_t) mounted.info.BPB_BytesPerSec * mounted.info.BPB_SecPerClus;
 
-  { /* Get the next directory_entry */
-    uint32_t dir_off = cfs_readdir_offset * 32;
-    uint16_t cluster_num = dir_off / mounted.info.BPB_SecPerClus;
-    uint32_t cluster;
+  do {
+    uint32_t dir_off = (uint32_t) cfs_readdir_offset * DIR_ENTRY_SIZE;
+    uint32_t sector;
 
-    cluster = find_nth_cluster((((uint32_t) dir_ent->DIR_FstClusHI) << 16) + dir_ent->DIR_FstClusLO, (uint32_t) cluster_num);
-    if (cluster == 0) {
-      return -1;
+    if (first_cluster == 0) {
+      if (cfs_readdir_offset >= mounted.info.BPB_RootEntCnt) {
+        return -1;
+      }
+      sector = mounted.info.BPB_RsvdSecCnt + (mounted.info.BPB_NumFATs * mounted.info.BPB_FATSz) + dir_off / mounted.info.BPB_BytesPerSec;
+    } else {
+      uint32_t cluster = find_nth_cluster(first_cluster, dir_off / cluster_size);
+
+      if (cluster == 0) {
+        return -1;
+      }
+      sector = CLUSTER_TO_SECTOR(cluster) + (dir_off % cluster_size) / mounted.info.BPB_BytesPerSec;
     }
 
-    if (read_sector(CLUSTER_TO_SECTOR(cluster) + dir_off / mounted.info.BPB_BytesPerSec) != 0) {
+    if (read_dir_sector(sector) != 0) {
       return -1;
     }
 
     memcpy(&entry, &(sector_buffer[dir_off % mounted.info.BPB_BytesPerSec]), sizeof (struct dir_entry));
-  }
+
+    /* A free entry marks the end of the directory */
+    if (entry.DIR_Name[0] == FAT_FLAG_FREE) {
+      return -1;
+    }
+
+    cfs_readdir_offset++;
+
+    /* Skip deleted entries, long name parts and the volume label */
+  } while (entry.DIR_Name[0] == FAT_FLAG_DELETED || (entry.DIR_Attr & ATTR_VOLUME_ID));
 
   make_readable_entry(&entry, dirent);
   dirent->size = entry.DIR_FileSize;
-  cfs_readdir_offset++;
   return 0;
 }
 /*----------------------------------------------------------------------------*/
@@ -1138,6 +1913,104 @@ cfs_closedir(struct cfs_dir *dirp)
   cfs_readdir_offset = 0;
 }
 /*----------------------------------------------------------------------------*/
+#if FAT_DENTRY_CACHE_SIZE > 0
+static uint16_t
+dentry_hash(const char *name)
+{
+  uint16_t hash = 0;
+  uint8_t i;
+
+  for (i = 0; i < 11; i++) {
+    hash = (hash << 5) + hash + (uint8_t) name[i];
+  }
+
+  return hash;
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Returns the cached lookup result of name in the directory starting at
+ * cluster parent and moves it to the front, NULL if there is none.
+ */
+static struct dentry_cache_entry *
+dentry_cache_find(uint32_t parent, const char *name)
+{
+  struct dentry_cache_entry tmp;
+  uint16_t hash = dentry_hash(name);
+  uint8_t i;
+
+  for (i = 0; i < FAT_DENTRY_CACHE_SIZE; i++) {
+    if ((dentry_cache[i].flags & DENTRY_CACHE_VALID)
+        && dentry_cache[i].hash == hash
+        && dentry_cache[i].parent == parent
+        && memcmp(dentry_cache[i].name, name, 11) == 0) {
+      if (i != 0) {
+        memcpy(&tmp, &dentry_cache[i], sizeof (struct dentry_cache_entry));
+        memmove(&dentry_cache[1], &dentry_cache[0], i * sizeof (struct dentry_cache_entry));
+        memcpy(&dentry_cache[0], &tmp, sizeof (struct dentry_cache_entry));
+      }
+      return &dentry_cache[0];
+    }
+  }
+
+  return NULL;
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Inserts a new entry for name in front of the cache, dropping the least
+ * recently used one. The caller fills in the lookup result.
+ */
+static struct dentry_cache_entry *
+dentry_cache_add(uint32_t parent, const char *name)
+{
+  struct dentry_cache_entry *entry = dentry_cache_find(parent, name);
+
+  if (entry == NULL) {
+    memmove(&dentry_cache[1], &dentry_cache[0], (FAT_DENTRY_CACHE_SIZE - 1) * sizeof (struct dentry_cache_entry));
+    entry = &dentry_cache[0];
+    entry->parent = parent;
+    entry->hash = dentry_hash(name);
+    memcpy(entry->name, name, 11);
+  }
+
+  entry->flags = DENTRY_CACHE_VALID;
+  return entry;
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Drops all entries of the given name, called when it is added to any
+ * directory.
+ */
+static void
+dentry_cache_forget_name(const char *name)
+{
+  uint16_t hash = dentry_hash(name);
+  uint8_t i;
+
+  for (i = 0; i < FAT_DENTRY_CACHE_SIZE; i++) {
+    if (dentry_cache[i].hash == hash && memcmp(dentry_cache[i].name, name, 11) == 0) {
+      dentry_cache[i].flags = 0;
+    }
+  }
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Drops the entry pointing to the given directory entry position, called
+ * when the directory entry is removed.
+ */
+static void
+dentry_cache_forget_entry(uint32_t sector, uint16_t offset)
+{
+  uint8_t i;
+
+  for (i = 0; i < FAT_DENTRY_CACHE_SIZE; i++) {
+    if (!(dentry_cache[i].flags & DENTRY_CACHE_NEGATIVE)
+        && dentry_cache[i].sector == sector && dentry_cache[i].offset == offset) {
+      dentry_cache[i].flags = 0;
+    }
+  }
+}
+#endif
+/*----------------------------------------------------------------------------*/
 /*Dir_entry Functions*/
 /**
  * Looks for file name starting at current sector buffer address.
@@ -1201,8 +2074,13 @@ get_dir_entry(const char *path, struct dir_entry *dir_ent, uint32_t *dir_entry_s
 {
   uint32_t first_root_dir_sec_num = 0;
   uint32_t file_sector_num = 0;
+  uint32_t dir_cluster = 0;
+  uint8_t found = 0;
   uint8_t i = 0;
   struct PathResolver pr;
+#if FAT_DENTRY_CACHE_SIZE > 0
+  struct dentry_cache_entry *entry;
+#endif
   PRINTF("\nfat.c: get_dir_entry( path = %s, dir_ent = %p, *dir_entry_sector = %lu, *dir_entry_offset = %u, create = %u ) = ?", path, dir_ent, *dir_entry_sector, *dir_entry_offset, create);
 
   pr_reset(&pr);
@@ -1214,24 +2092,83 @@ get_dir_entry(const char *path, struct dir_entry *dir_ent, uint32_t *dir_entry_s
   } else if (mounted.info.type == FAT32) {
     // BPB_RootClus is the first cluster of the root dir
     first_root_dir_sec_num = CLUSTER_TO_SECTOR(mounted.info.BPB_RootClus);
+    dir_cluster = mounted.info.BPB_RootClus;
   }
   PRINTF("\nfat.c: get_dir_entry(): first_root_dir_sec_num = %lu", first_root_dir_sec_num);
 
   file_sector_num = first_root_dir_sec_num;
   for (i = 0; pr_get_next_path_part(&pr) == 0 && i < 255; i++) {
-    read_sector(file_sector_num);
-    if (lookup(pr.name, dir_ent, dir_entry_sector, dir_entry_offset) != 0) {
+#if FAT_DENTRY_CACHE_SIZE > 0
+    entry = dentry_cache_find(dir_cluster, pr.name);
+    if (entry != NULL && !(entry->flags & DENTRY_CACHE_NEGATIVE)) {
+      if (read_dir_sector(entry->sector) == 0 && memcmp(&(sector_buffer[entry->offset]), pr.name, 11) == 0) {
+        memcpy(dir_ent, &(sector_buffer[entry->offset]), sizeof (struct dir_entry));
+        *dir_entry_sector = entry->sector;
+        *dir_entry_offset = entry->offset;
+        entry->cluster = dir_ent->DIR_FstClusLO + (((uint32_t) dir_ent->DIR_FstClusHI) << 16);
+        found = 1;
+      } else {
+        entry->flags = 0;
+        entry = NULL;
+      }
+    } else if (entry != NULL) {
+      /* Continue at the end of the last scan in case the name is added */
+      read_dir_sector(entry->sector);
+      found = 0;
+    }
+
+    if (entry != NULL) {
+      sector_cache_stats.dentry_hits++;
+    } else {
+      sector_cache_stats.dentry_misses++;
+      read_dir_sector(file_sector_num);
+      found = (lookup(pr.name, dir_ent, dir_entry_sector, dir_entry_offset) == 0);
+      entry = dentry_cache_add(dir_cluster, pr.name);
+      if (found) {
+        entry->sector = *dir_entry_sector;
+        entry->offset = *dir_entry_offset;
+        entry->cluster = dir_ent->DIR_FstClusLO + (((uint32_t) dir_ent->DIR_FstClusHI) << 16);
+      } else {
+        entry->flags |= DENTRY_CACHE_NEGATIVE;
+        entry->sector = sector_buffer_addr;
+      }
+    }
+#else
+    read_dir_sector(file_sector_num);
+    found = (lookup(pr.name, dir_ent, dir_entry_sector, dir_entry_offset) == 0);
+#endif
+
+    if (!found) {
       PRINTF("\nfat.c: get_dir_entry(): Current path part doesn't exist!");
       if (pr_is_current_path_part_a_file(&pr) && create) {
         PRINTF("\nfat.c: get_dir_entry(): Current path part describes a file and it should be created!");
         memset(dir_ent, 0, sizeof (struct dir_entry));
         memcpy(dir_ent->DIR_Name, pr.name, 11);
         dir_ent->DIR_Attr = 0;
-        return add_directory_entry_to_current(dir_ent, dir_entry_sector, dir_entry_offset);
+        if (!add_directory_entry_to_current(dir_ent, dir_entry_sector, dir_entry_offset)) {
+          /* The scan ended in the last sector of a directory that can not
+           * grow, reuse the entries of deleted files in front of it */
+          if (read_dir_sector(file_sector_num) != 0 ||
+              !add_directory_entry_to_current(dir_ent, dir_entry_sector, dir_entry_offset)) {
+            return 0;
+          }
+        }
+#if FAT_DENTRY_CACHE_SIZE > 0
+        entry = dentry_cache_add(dir_cluster, pr.name);
+        entry->sector = *dir_entry_sector;
+        entry->offset = *dir_entry_offset;
+        entry->cluster = 0;
+#endif
+        return 1;
       }
       return 0;
     }
-    file_sector_num = CLUSTER_TO_SECTOR(dir_ent->DIR_FstClusLO + (((uint32_t) dir_ent->DIR_FstClusHI) << 16));
+#if FAT_DENTRY_CACHE_SIZE > 0
+    dir_cluster = entry->cluster;
+#else
+    dir_cluster = dir_ent->DIR_FstClusLO + (((uint32_t) dir_ent->DIR_FstClusHI) << 16);
+#endif
+    file_sector_num = CLUSTER_TO_SECTOR(dir_cluster);
     PRINTF("\nfat.c: get_dir_entry(): file_sector_num = %lu", file_sector_num);
   }
 
@@ -1259,12 +2196,15 @@ add_directory_entry_to_current(struct dir_entry *dir_ent, uint32_t *dir_entry_se
   // if (sector_buffer_addr < first data sector) ... Error, we try to write dir into FAT region...
 
   PRINTF("\nfat.c: add_directory_entry_to_current( dir_ent = %p, *dir_entry_sector = %lu, *dir_entry_offset = %u ) = ?", dir_ent, *dir_entry_sector, *dir_entry_offset);
+#if FAT_DENTRY_CACHE_SIZE > 0
+  dentry_cache_forget_name((const char *) dir_ent->DIR_Name);
+#endif
   for (;;) {
     /* iterate over all directory entries in current sector */
     for (i = 0; i < 512; i += 32) {
       if (sector_buffer[i] == FAT_FLAG_FREE || sector_buffer[i] == FAT_FLAG_DELETED) {
         memcpy(&(sector_buffer[i]), dir_ent, sizeof (struct dir_entry));
-        sector_buffer_dirty = 1;
+        MARK_SECTOR_BUFFER_DIRTY();
         *dir_entry_sector = sector_buffer_addr;
         *dir_entry_offset = i;
         PRINTF("\nfat.c: add_directory_entry_to_current(): Found empty directory entry! *dir_entry_sector = %lu, *dir_entry_offset = %u", *dir_entry_sector, *dir_entry_offset);
@@ -1275,29 +2215,31 @@ add_directory_entry_to_current(struct dir_entry *dir_ent, uint32_t *dir_entry_se
     /* If no free directory entry was found, switch to next sector */
     PRINTF("\nfat.c: add_directory_entry_to_current(): No free entry in current sector (sector_buffer_addr = %lu) reading next sector!", sector_buffer_addr);
     if ((ret = read_next_sector()) != 0) {
-      /* if end of cluster reached, get free cluster */
-      if (ret == 128) {
+      /* if end of cluster reached, get free cluster, the FAT16 root
+       * directory can not grow */
+      if (ret == 128 && sector_buffer_addr >= mounted.first_data_sector) {
         uint32_t last_sector = sector_buffer_addr;
-        uint32_t free_cluster = get_free_cluster(SECTOR_TO_CLUSTER(sector_buffer_addr)); // TODO: any free cluster? start at (0)
+        uint32_t free_cluster = allocate_cluster(SECTOR_TO_CLUSTER(last_sector) + 1);
         PRINTF("\nfat.c: add_directory_entry_to_current(): The directory cluster chain is too short, we need to add another cluster!");
 
+        if (free_cluster == 0) {
+          return 0;
+        }
         write_fat_entry(SECTOR_TO_CLUSTER(last_sector), free_cluster);
-        write_fat_entry(free_cluster, EOC);
         PRINTF("\nfat.c: add_directory_entry_to_current(): cluster %lu added to chain of sector_buffer_addr cluster %lu", free_cluster, SECTOR_TO_CLUSTER(sector_buffer_addr));
 
-        cfs_fat_flush();
-        /* Iterate over all sectors in new allocated cluster and clear them. */
+        /* Iterate over all sectors in new allocated cluster and clear them.
+         * The sectors are not loaded as they are overwritten completely. */
         uint32_t first_free_sector = CLUSTER_TO_SECTOR(free_cluster);
-        memset(sector_buffer, 0x00, 512);
         for (i = 0; i < mounted.info.BPB_SecPerClus; i++) {
-          sector_buffer_addr = first_free_sector + i;
-          sector_buffer_dirty = 1;
-          cfs_fat_flush();
+          sector_cache_select(first_free_sector + i, FAT_CACHE_PRIO_DIR, 0);
+          memset(sector_buffer, 0x00, 512);
+          MARK_SECTOR_BUFFER_DIRTY();
         }
 
-        if (read_sector(CLUSTER_TO_SECTOR(free_cluster)) == 0) {
+        if (read_dir_sector(CLUSTER_TO_SECTOR(free_cluster)) == 0) {
           memcpy(&(sector_buffer[0]), dir_ent, sizeof (struct dir_entry));
-          sector_buffer_dirty = 1;
+          MARK_SECTOR_BUFFER_DIRTY();
           *dir_entry_sector = sector_buffer_addr;
           *dir_entry_offset = 0;
           PRINTF("\nfat.c: add_directory_entry_to_current(): read of the newly added cluster successful! *dir_entry_sector = %lu, *dir_entry_offset = %u", *dir_entry_sector, *dir_entry_offset);
@@ -1315,70 +2257,219 @@ static void
 update_dir_entry(int fd)
 {
   PRINTF("\nfat.c: update_dir_entry( fd = %d ) = void ", fd);
-  if (read_sector(fat_file_pool[fd].dir_entry_sector) != 0) {
+  if (read_dir_sector(fat_file_pool[fd].dir_entry_sector) != 0) {
     PRINTERROR("\nfat.c: update_dir_entry(): error reading the sector containing the directory entry");
     return;
   }
 
   memcpy(&(sector_buffer[fat_file_pool[fd].dir_entry_offset]), &(fat_file_pool[fd].dir_entry), sizeof (struct dir_entry));
-  sector_buffer_dirty = 1;
+  MARK_SECTOR_BUFFER_DIRTY();
 }
 /*----------------------------------------------------------------------------*/
 static void
 remove_dir_entry(uint32_t dir_entry_sector, uint16_t dir_entry_offset)
 {
   PRINTF("\nfat.c: remove_dir_entry( dir_entry_sector = %lu, dir_entry_offset = %u ) = void ", dir_entry_sector, dir_entry_offset);
-  if (read_sector(dir_entry_sector) != 0) {
+  if (read_dir_sector(dir_entry_sector) != 0) {
     PRINTERROR("\nfat.c: remove_dir_entry(): error reading the sector containing the directory entry");
     return;
   }
 
   memset(&(sector_buffer[dir_entry_offset]), 0, sizeof (struct dir_entry));
   sector_buffer[dir_entry_offset] = FAT_FLAG_DELETED;
-  sector_buffer_dirty = 1;
+  MARK_SECTOR_BUFFER_DIRTY();
+#if FAT_DENTRY_CACHE_SIZE > 0
+  dentry_cache_forget_entry(dir_entry_sector, dir_entry_offset);
+#endif
 }
 /*----------------------------------------------------------------------------*/
 /*FAT Implementation Functions*/
-static uint8_t
-load_next_sector_of_file(int fd, uint32_t clusters, uint8_t clus_offset, uint8_t write)
+/*
+ * Returns the disk cluster holding the given cluster index of the file.
+ * If write is set, missing clusters are added to the file.
+ * Returns 0 if there is no such cluster.
+ */
+static uint32_t
+get_cluster_of_file(int fd, uint32_t clusters, uint8_t write)
 {
   uint32_t cluster = 0;
-  PRINTF("\nfat.c: load_next_sector_of_file( fd = %d, clusters = %lu, clus_offset = %u, write = %u ) = ?", fd, clusters, clus_offset, write);
+  PRINTF("\nfat.c: get_cluster_of_file( fd = %d, clusters = %lu, write = %u ) = ?", fd, clusters, write);
 
   //If we know the nth Cluster already we do not have to recalculate it
   if (clusters == fat_file_pool[fd].n) {
-    PRINTF("\nfat.c: load_next_sector_of_file(): we know nth cluster already");
+    PRINTF("\nfat.c: get_cluster_of_file(): we know nth cluster already");
     cluster = fat_file_pool[fd].nth_cluster;
     //If we are now at the nth-1 Cluster it is easy to get the next cluster
   } else if (clusters == fat_file_pool[fd].n + 1) {
-    PRINTF("\nfat.c: load_next_sector_of_file(): we need the cluster n and are at n-1");
+    PRINTF("\nfat.c: get_cluster_of_file(): we need the cluster n and are at n-1");
     cluster = read_fat_entry(fat_file_pool[fd].nth_cluster);
     //Somehow our cluster-information is out of sync. We have to calculate the cluster the hard way.
   } else {
-    PRINTF("\nfat.c: load_next_sector_of_file(): We are somewhere else, need to iterate the chain until nth cluster");
-    cluster = find_nth_cluster(fat_file_pool[fd].cluster, clusters);
+    PRINTF("\nfat.c: get_cluster_of_file(): We are somewhere else, need to look up the nth cluster");
+    cluster = find_cluster_of_file(fd, clusters);
   }
-  PRINTF("\nfat.c: load_next_sector_of_file(): fat_file_pool[%d].nth_cluster = %lu, fat_file_pool[%d].n = %lu", fd, fat_file_pool[fd].nth_cluster, fd, fat_file_pool[fd].n);
+  PRINTF("\nfat.c: get_cluster_of_file(): fat_file_pool[%d].nth_cluster = %lu, fat_file_pool[%d].n = %lu", fd, fat_file_pool[fd].nth_cluster, fd, fat_file_pool[fd].n);
 
   // If there is no cluster allocated to the file or the current cluster is EOC then add another cluster to the file
   if (cluster == 0 || is_EOC(cluster)) {
-    PRINTF("\nfat.c: load_next_sector_of_file(): Either file is empty or current cluster is EOC!");
+    PRINTF("\nfat.c: get_cluster_of_file(): Either file is empty or current cluster is EOC!");
     if (write) {
-      PRINTF("\nfat.c: load_next_sector_of_file(): write flag enabled! adding cluster to file!");
-      add_cluster_to_file(fd);
+      PRINTF("\nfat.c: get_cluster_of_file(): write flag enabled! adding cluster to file!");
+      if (add_cluster_to_file(fd) != 0) {
+        return 0;
+      }
       // Remember that after the add_cluster_to_file-Function the nth_cluster and n is set to the added cluster
       cluster = fat_file_pool[fd].nth_cluster;
     } else {
-      return 1;
+      return 0;
     }
   } else {
     fat_file_pool[fd].nth_cluster = cluster;
     fat_file_pool[fd].n = clusters;
   }
 
+  return cluster;
+}
+/*----------------------------------------------------------------------------*/
+static uint8_t
+load_next_sector_of_file(int fd, uint32_t clusters, uint8_t clus_offset, uint8_t write)
+{
+  uint32_t cluster = get_cluster_of_file(fd, clusters, write);
+
+  if (cluster == 0) {
+    return 1;
+  }
+
   return read_sector(CLUSTER_TO_SECTOR(cluster) + clus_offset);
 }
 /*----------------------------------------------------------------------------*/
+/*
+ * Reads whole sectors of a file, starting at the given position, directly
+ * into buffer using a multi block read. Reading stops at max_sectors or at
+ * the end of the contiguous cluster run.
+ * Returns the number of sectors read, 0 if the caller should use the
+ * sector cache instead.
+ */
+static uint32_t
+read_sectors_of_file(int fd, uint32_t clusters, uint8_t clus_offset, uint8_t *buffer, uint32_t max_sectors)
+{
+  uint32_t first_cluster = get_cluster_of_file(fd, clusters, 0);
+  uint32_t cluster = first_cluster;
+  uint32_t next_cluster;
+  uint32_t count;
+
+  if (cluster == 0) {
+    return 0;
+  }
+
+  /* Extend transfer as long as the cluster chain is contiguous */
+  count = mounted.info.BPB_SecPerClus - clus_offset;
+  while (count < max_sectors && (next_cluster = find_cluster_of_file(fd, clusters + (clus_offset + count) / mounted.info.BPB_SecPerClus)) == cluster + 1) {
+    cluster = next_cluster;
+    count += mounted.info.BPB_SecPerClus;
+  }
+
+  if (count > max_sectors) {
+    count = max_sectors;
+  }
+
+  if (count < 2) {
+    return 0;
+  }
+
+  sector_cache_write_back_range(CLUSTER_TO_SECTOR(first_cluster) + clus_offset, count);
+  if (diskio_read_blocks(mounted.dev, CLUSTER_TO_SECTOR(first_cluster) + clus_offset, count, buffer) != DISKIO_SUCCESS) {
+    PRINTERROR("\nfat.c: read_sectors_of_file(): DiskIO-Error occured");
+    return 0;
+  }
+
+  /* Remember the cluster holding the last sector read */
+  fat_file_pool[fd].n = clusters + (clus_offset + count - 1) / mounted.info.BPB_SecPerClus;
+  fat_file_pool[fd].nth_cluster = first_cluster + (clus_offset + count - 1) / mounted.info.BPB_SecPerClus;
+
+  PRINTF("\nfat.c: read_sectors_of_file( fd = %d, clusters = %lu, clus_offset = %u ) = %lu", fd, clusters, clus_offset, count);
+  return count;
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Writes whole sectors of a file, starting at the given position, directly
+ * from buffer using a multi block write. Missing clusters are added to the
+ * file, writing stops at max_sectors or at the end of the contiguous
+ * cluster run.
+ * Returns the number of sectors written, 0 if the caller should use the
+ * sector cache instead.
+ */
+static uint32_t
+write_sectors_of_file(int fd, uint32_t clusters, uint8_t clus_offset, const uint8_t *buffer, uint32_t max_sectors)
+{
+  uint32_t first_cluster = get_cluster_of_file(fd, clusters, 1);
+  uint32_t cluster = first_cluster;
+  uint32_t next_cluster;
+  uint32_t first_sector;
+  uint32_t count, i;
+
+  if (cluster == 0) {
+    return 0;
+  }
+
+  /* Extend transfer as long as the cluster chain is (or can be made) contiguous */
+  count = mounted.info.BPB_SecPerClus - clus_offset;
+  while (count < max_sectors) {
+    next_cluster = find_cluster_of_file(fd, clusters + (clus_offset + count) / mounted.info.BPB_SecPerClus);
+    if (is_EOC(next_cluster)) {
+      /* find_cluster_of_file() left nth_cluster at the end of the chain */
+      if (add_cluster_to_file(fd) != 0) {
+        break;
+      }
+      next_cluster = fat_file_pool[fd].nth_cluster;
+    }
+
+    if (next_cluster != cluster + 1) {
+      break;
+    }
+
+    cluster = next_cluster;
+    count += mounted.info.BPB_SecPerClus;
+  }
+
+  if (count > max_sectors) {
+    count = max_sectors;
+  }
+
+  if (count < 2) {
+    return 0;
+  }
+
+  first_sector = CLUSTER_TO_SECTOR(first_cluster) + clus_offset;
+  sector_cache_invalidate_range(first_sector, count);
+
+  /* The sector count allows the card to pre-erase the blocks */
+  if (diskio_write_blocks_start(mounted.dev, first_sector, count) != DISKIO_SUCCESS) {
+    PRINTERROR("\nfat.c: write_sectors_of_file(): DiskIO-Error occured");
+    return 0;
+  }
+
+  for (i = 0; i < count; i++) {
+    if (diskio_write_blocks_next(mounted.dev, (uint8_t *) &buffer[i * mounted.info.BPB_BytesPerSec]) != DISKIO_SUCCESS) {
+      PRINTERROR("\nfat.c: write_sectors_of_file(): DiskIO-Error occured");
+      diskio_write_blocks_done(mounted.dev);
+      return 0;
+    }
+  }
+
+  if (diskio_write_blocks_done(mounted.dev) != DISKIO_SUCCESS) {
+    PRINTERROR("\nfat.c: write_sectors_of_file(): DiskIO-Error occured");
+    return 0;
+  }
+
+  /* Remember the cluster holding the last sector written */
+  fat_file_pool[fd].n = clusters + (clus_offset + count - 1) / mounted.info.BPB_SecPerClus;
+  fat_file_pool[fd].nth_cluster = first_cluster + (clus_offset + count - 1) / mounted.info.BPB_SecPerClus;
+
+  PRINTF("\nfat.c: write_sectors_of_file( fd = %d, clusters = %lu, clus_offset = %u ) = %lu", fd, clusters, clus_offset, count);
+  return count;
+}
+/*----------------------------------------------------------------------------*/
 /*FAT Interface Functions*/
 uint32_t
 cfs_fat_file_size(int fd)
@@ -1403,12 +2494,16 @@ cfs_fat_sync_fats()
   uint8_t fat_number;
   uint32_t fat_block;
 
+  uint8_t *buffer = sector_cache[0].data;
+
+  /* Use the first cache entry as transfer buffer */
   cfs_fat_flush();
+  sector_cache_invalidate();
 
   for (fat_block = 0; fat_block < mounted.info.BPB_FATSz; fat_block++) {
-    diskio_read_block(mounted.dev, fat_block + mounted.info.BPB_RsvdSecCnt, sector_buffer);
+    diskio_read_block(mounted.dev, fat_block + mounted.info.BPB_RsvdSecCnt, buffer);
     for (fat_number = 2; fat_number <= mounted.info.BPB_NumFATs; fat_number++) {
-      diskio_write_block(mounted.dev, (fat_block + mounted.info.BPB_RsvdSecCnt) + ((fat_number - 1) * mounted.info.BPB_FATSz), sector_buffer);
+      diskio_write_block(mounted.dev, (fat_block + mounted.info.BPB_RsvdSecCnt) + ((fat_number - 1) * mounted.info.BPB_FATSz), buffer);
     }
   }
 }
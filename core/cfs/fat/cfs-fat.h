@@ -65,12 +65,6 @@
 #include "cfs/cfs.h"
 
 
-#ifdef FAT_CONF_COOPERATIVE
-#define FAT_COOPERATIVE FAT_CONF_COOPERATIVE
-#else
-#undef FAT_COOPERATIVE
-#endif
-
 /** Allows to enable synchronization of FATs when unmounting device.
  * This may allow to restore a corrupted primary FAT but
  * note that this will lead to poor performance and decreases flash life because
@@ -80,8 +74,6 @@
 #define FAT_SYNC 0
 #endif
 
-#define FAT_COOP_QUEUE_SIZE 15
-
 #define FAT12 0
 #define FAT16 1
 #define FAT32 2
@@ -94,6 +86,73 @@
 #define FAT_FD_POOL_SIZE 5
 #endif
 
+/** Number of sectors (512 bytes each) held in the write-back sector cache.
+ * A size of 1 behaves like the former single sector buffer. */
+#ifdef FAT_CONF_CACHE_SIZE
+#define FAT_CACHE_SIZE FAT_CONF_CACHE_SIZE
+#else
+#define FAT_CACHE_SIZE 2
+#endif
+
+/** Number of contiguous cluster runs remembered per open file.
+ * Allows to locate clusters of large files without walking the FAT. */
+#ifdef FAT_CONF_RUN_CACHE_SIZE
+#define FAT_RUN_CACHE_SIZE FAT_CONF_RUN_CACHE_SIZE
+#else
+#define FAT_RUN_CACHE_SIZE 4
+#endif
+
+/** Number of contiguous clusters reserved at once for files opened with
+ * CFS_APPEND. The reservation only exists in RAM, it is kept after closing
+ * the file until it is used up, the file is removed, the device is unmounted
+ * or the space is needed by other files. 0 disables preallocation. */
+#ifdef FAT_CONF_PREALLOC_CLUSTERS
+#define FAT_PREALLOC_CLUSTERS FAT_CONF_PREALLOC_CLUSTERS
+#else
+#define FAT_PREALLOC_CLUSTERS 8
+#endif
+
+/** Number of files that can hold a cluster reservation at the same time */
+#ifdef FAT_CONF_PREALLOC_FILES
+#define FAT_PREALLOC_FILES FAT_CONF_PREALLOC_FILES
+#else
+#define FAT_PREALLOC_FILES FAT_FD_POOL_SIZE
+#endif
+
+/** Size in bytes of the in-RAM summary of completely allocated FAT sectors.
+ * Each bit covers a group of FAT sectors which is skipped when searching
+ * free clusters. 0 disables the summary. */
+#ifdef FAT_CONF_FREE_MAP_SIZE
+#define FAT_FREE_MAP_SIZE FAT_CONF_FREE_MAP_SIZE
+#else
+#define FAT_FREE_MAP_SIZE 0
+#endif
+
+/** Number of directory entry lookups remembered, including lookups of
+ * names that do not exist. 0 disables the directory entry cache. */
+#ifdef FAT_CONF_DENTRY_CACHE_SIZE
+#define FAT_DENTRY_CACHE_SIZE FAT_CONF_DENTRY_CACHE_SIZE
+#else
+#define FAT_DENTRY_CACHE_SIZE 8
+#endif
+
+/** \name Sector cache priorities
+ * A cached sector of higher priority stays in the cache that many
+ * sector accesses longer than an equally old data sector.
+ * @{ */
+#define FAT_CACHE_PRIO_DATA 0
+#ifdef FAT_CONF_CACHE_PRIO_DIR
+#define FAT_CACHE_PRIO_DIR FAT_CONF_CACHE_PRIO_DIR
+#else
+#define FAT_CACHE_PRIO_DIR 8
+#endif
+#ifdef FAT_CONF_CACHE_PRIO_FAT
+#define FAT_CACHE_PRIO_FAT FAT_CONF_CACHE_PRIO_FAT
+#else
+#define FAT_CACHE_PRIO_FAT 16
+#endif
+/** @} */
+
 /** Holds boot sector information. */
 struct FAT_Info {
   uint8_t type; /** Either FAT16, FAT32 or FAT_INVALID */
@@ -129,6 +188,16 @@ struct dir_entry {
   uint32_t DIR_FileSize;
 };
 
+/** Contiguous part of a file's cluster chain */
+struct cluster_run {
+  /** Index of the first cluster of the run within the file */
+  uint32_t index;
+  /** Disk cluster number of the first cluster of the run */
+  uint32_t cluster;
+  /** Number of clusters in the run, 0 if unused */
+  uint16_t length;
+};
+
 struct file {
   //metadata
   /** Cluster Position on disk */
@@ -138,6 +207,26 @@ struct file {
   struct dir_entry dir_entry;
   uint32_t nth_cluster;
   uint32_t n;
+  /** Known runs of the cluster chain, most recently used first */
+  struct cluster_run runs[FAT_RUN_CACHE_SIZE];
+};
+
+/** Sector cache counters */
+struct fat_cache_stats {
+  /** Sector accesses served from the cache */
+  uint32_t hits;
+  /** Sector accesses that required a replacement */
+  uint32_t misses;
+  /** Sectors written back to the disk */
+  uint32_t flushes;
+  /** Cluster lookups resolved by the per file cluster run cache */
+  uint32_t run_hits;
+  /** Cluster lookups that required walking the FAT */
+  uint32_t run_misses;
+  /** Path parts resolved by the directory entry cache */
+  uint32_t dentry_hits;
+  /** Path parts that required scanning the directory */
+  uint32_t dentry_misses;
 };
 
 struct file_desc {
@@ -219,10 +308,30 @@ uint16_t cfs_fat_get_create_time(int fd);
 void cfs_fat_sync_fats();
 
 /**
- * Writes the current buffered block back to the disk if it was changed.
+ * Writes all cached sectors back to the disk that were changed.
  */
 void cfs_fat_flush();
 
+/**
+ * Populates the given struct with the sector cache counters.
+ *
+ * \param *stats The fat_cache_stats struct which should be populated.
+ */
+void cfs_fat_get_cache_stats(struct fat_cache_stats *stats);
+
+/**
+ * Resets all sector cache counters to 0.
+ */
+void cfs_fat_reset_cache_stats();
+
+/**
+ * Returns the number of free clusters of the mounted device.
+ *
+ * The value is taken from the FAT32 FSInfo sector and kept up to date
+ * afterwards. If it is not known yet the whole FAT is scanned once.
+ */
+uint32_t cfs_fat_free_clusters();
+
 /**
  * Returns the file size of the associated file
  * 
@@ -46,6 +46,7 @@
 
 #include "diskio.h"
 #include "mbr.h"
+#include <stdio.h>
 #include <string.h>
 #include "diskio-arch.h"
 
@@ -167,16 +168,7 @@ diskio_rw_op(struct diskio_device_info *dev, uint32_t block_start_address, uint3
               //PRINTF("\nret_code: %u", ret_code);
             }
 
-#ifdef FAT_COOPERATIVE
-            if (!coop_step_allowed) {
-              next_step_type = READ;
-              coop_switch_sp();
-            } else {
-              coop_step_allowed = 0;
-            }
-#else /* FAT_COOPERATIVE */
             _delay_ms(DISKIO_RW_DELAY_MS);
-#endif /* FAT_COOPERATIVE */
 
             /* Try once to reinit sd card if access failed. */
             if ((reinit == 0) && (tries == DISKIO_RW_RETRIES - 1)) {
@@ -197,7 +189,33 @@ diskio_rw_op(struct diskio_device_info *dev, uint32_t block_start_address, uint3
           break;
 
         case DISKIO_OP_READ_BLOCKS:
-          return DISKIO_ERROR_TO_BE_IMPLEMENTED;
+#ifdef SD_READ_BLOCKS_START
+          if (SD_READ_BLOCKS_START(block_start_address) == 0) {
+            while (num_blocks > 0) {
+              if (SD_READ_BLOCKS_NEXT(buffer) != 0) {
+                PRINTF("\ndiskio_rw_op(): Multi block read failed at %lu", block_start_address);
+                break;
+              }
+              buffer += 512;
+              block_start_address++;
+              num_blocks--;
+            }
+            if ((SD_READ_BLOCKS_DONE() == 0) && (num_blocks == 0)) {
+              return DISKIO_SUCCESS;
+            }
+          }
+#endif /* SD_READ_BLOCKS_START */
+          /* Read remaining blocks one by one to benefit from retry handling */
+          while (num_blocks > 0) {
+            ret_code = diskio_rw_op(dev, block_start_address - dev->first_sector, 1, buffer, DISKIO_OP_READ_BLOCK);
+            if (ret_code != DISKIO_SUCCESS) {
+              return ret_code;
+            }
+            buffer += 512;
+            block_start_address++;
+            num_blocks--;
+          }
+          return DISKIO_SUCCESS;
           break;
 
         case DISKIO_OP_WRITE_BLOCK:
@@ -208,16 +226,7 @@ diskio_rw_op(struct diskio_device_info *dev, uint32_t block_start_address, uint3
               return DISKIO_SUCCESS;
             }
 
-#ifdef FAT_COOPERATIVE
-            if (!coop_step_allowed) {
-              next_step_type = WRITE;
-              coop_switch_sp();
-            } else {
-              coop_step_allowed = 0;
-            }
-#else /* FAT_COOPERATIVE */
             _delay_ms(DISKIO_RW_DELAY_MS);
-#endif /* FAT_COOPERATIVE */
             if ((reinit == 0) && (tries == DISKIO_RW_RETRIES - 1)) {
               PRINTF("\nReinit");
               tries = 0;
@@ -277,7 +286,13 @@ diskio_rw_op(struct diskio_device_info *dev, uint32_t block_start_address, uint3
           return DISKIO_SUCCESS;
           break;
         case DISKIO_OP_READ_BLOCKS:
-          return DISKIO_ERROR_TO_BE_IMPLEMENTED;
+          while (num_blocks > 0) {
+            FLASH_READ_BLOCK(block_start_address, 0, buffer, 512);
+            buffer += 512;
+            block_start_address++;
+            num_blocks--;
+          }
+          return DISKIO_SUCCESS;
           break;
         case DISKIO_OP_WRITE_BLOCK:
           FLASH_WRITE_BLOCK(block_start_address, 0, buffer, 512);
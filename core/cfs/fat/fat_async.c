@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2013, Institute of Operating Systems and Computer Networks (TU Braunschweig).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \addtogroup cfs
+ * @{
+ *
+ * \addtogroup fat_async_driver
+ * @{
+ */
+
+/**
+ * \file
+ *      FAT driver asynchronous I/O implementation
+ */
+
+#include "fat_async.h"
+#include "lib/list.h"
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+process_event_t cfs_fat_async_event;
+
+/* Requests in order of submission, the head is processed. LIST() starts
+ * out empty, so the queue needs no initialization */
+LIST(request_queue);
+
+PROCESS(fat_async_process, "FAT async I/O");
+/*----------------------------------------------------------------------------*/
+static int
+fat_async_submit(struct cfs_fat_async_req *req, int fd, struct cfs_fat_iovec *iov, uint8_t iovcnt, uint8_t write)
+{
+  if (req == NULL || fd < 0 || fd >= FAT_FD_POOL_SIZE || (iov == NULL && iovcnt != 0)) {
+    return -1;
+  }
+
+  if (cfs_fat_async_event == 0) {
+    cfs_fat_async_event = process_alloc_event();
+  }
+
+  req->owner = PROCESS_CURRENT();
+  req->iov = iov;
+  req->iovcnt = iovcnt;
+  req->write = write;
+  req->fd = fd;
+  req->result = 0;
+  req->iov_index = 0;
+  req->iov_offset = 0;
+  req->state = CFS_FAT_ASYNC_QUEUED;
+
+  list_add(request_queue, req);
+
+  process_start(&fat_async_process, NULL);
+  process_poll(&fat_async_process);
+
+  PRINTF("fat_async: queued %s request %p on fd %d\n", write ? "write" : "read", req, fd);
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
+int
+cfs_fat_read_async(struct cfs_fat_async_req *req, int fd, struct cfs_fat_iovec *iov, uint8_t iovcnt)
+{
+  return fat_async_submit(req, fd, iov, iovcnt, 0);
+}
+/*----------------------------------------------------------------------------*/
+int
+cfs_fat_write_async(struct cfs_fat_async_req *req, int fd, struct cfs_fat_iovec *iov, uint8_t iovcnt)
+{
+  return fat_async_submit(req, fd, iov, iovcnt, 1);
+}
+/*----------------------------------------------------------------------------*/
+int
+cfs_fat_async_cancel(struct cfs_fat_async_req *req)
+{
+  /* Nothing was submitted yet, req can not be queued */
+  if (cfs_fat_async_event == 0 || req->state != CFS_FAT_ASYNC_QUEUED) {
+    return -1;
+  }
+
+  list_remove(request_queue, req);
+  req->state = CFS_FAT_ASYNC_DONE;
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
+uint8_t
+cfs_fat_async_pending()
+{
+  if (cfs_fat_async_event == 0) {
+    return 0;
+  }
+
+  return list_length(request_queue);
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Skips all completely transferred elements of the scatter-gather list.
+ * Returns 1 if there is data left to transfer.
+ */
+static uint8_t
+fat_async_data_left(struct cfs_fat_async_req *req)
+{
+  while (req->iov_index < req->iovcnt
+         && req->iov_offset >= req->iov[req->iov_index].len) {
+    req->iov_index++;
+    req->iov_offset = 0;
+  }
+
+  return req->iov_index < req->iovcnt;
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Transfers up to FAT_ASYNC_STEP_SIZE bytes of the request.
+ * Returns 1 if the request needs further steps.
+ */
+static uint8_t
+fat_async_step(struct cfs_fat_async_req *req)
+{
+  struct cfs_fat_iovec *iov;
+  uint16_t len;
+  int n;
+
+  if (!fat_async_data_left(req)) {
+    return 0;
+  }
+
+  iov = &req->iov[req->iov_index];
+  len = iov->len - req->iov_offset;
+  if (len > FAT_ASYNC_STEP_SIZE) {
+    len = FAT_ASYNC_STEP_SIZE;
+  }
+
+  if (req->write) {
+    n = cfs_write(req->fd, &iov->base[req->iov_offset], len);
+  } else {
+    n = cfs_read(req->fd, &iov->base[req->iov_offset], len);
+  }
+
+  if (n > 0) {
+    req->result += n;
+    req->iov_offset += n;
+  }
+
+  /* End of file, full disk or error */
+  if (n < (int) len) {
+    if (n < 0 && req->result == 0) {
+      req->result = -1;
+    }
+    return 0;
+  }
+
+  return fat_async_data_left(req);
+}
+/*----------------------------------------------------------------------------*/
+PROCESS_THREAD(fat_async_process, ev, data)
+{
+  static struct cfs_fat_async_req *req;
+
+  PROCESS_BEGIN();
+
+  /* Bulk disk work gives way to the network and radio processes */
+  process_set_priority(&fat_async_process, PROCESS_PRIO_BACKGROUND);
+
+  while (1) {
+    PROCESS_WAIT_UNTIL(list_head(request_queue) != NULL);
+
+    req = list_head(request_queue);
+    req->state = CFS_FAT_ASYNC_INPROGRESS;
+
+    /* Let other processes run between the steps */
+    while (fat_async_step(req)) {
+      PROCESS_PAUSE();
+    }
+
+    list_remove(request_queue, req);
+    req->state = CFS_FAT_ASYNC_DONE;
+    PRINTF("fat_async: request %p done, result %ld\n", req, (long) req->result);
+    if (req->owner != NULL) {
+      process_post(req->owner, cfs_fat_async_event, req);
+    }
+  }
+
+  PROCESS_END();
+}
+/*----------------------------------------------------------------------------*/
+
+/** @} */
+/** @} */
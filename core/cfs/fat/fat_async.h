@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2013, Institute of Operating Systems and Computer Networks (TU Braunschweig).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \addtogroup cfs
+ * @{
+ *
+ * \defgroup fat_async_driver FAT Driver - Asynchronous I/O
+ *
+ * Queues read and write requests on open FAT files and processes them in
+ * small steps from a Contiki process. Between two steps other processes
+ * (e.g. radio processing) keep running. The caller is notified with
+ * cfs_fat_async_event when its request is done.
+ *
+ * Requests and their buffers are owned by the caller and must stay valid
+ * until the completion event was received. File descriptors with pending
+ * requests must not be accessed with the synchronous cfs functions.
+ *
+ * @{
+ */
+
+/**
+ * \file
+ *		FAT driver asynchronous I/O definitions
+ */
+
+#ifndef FAT_ASYNC_H
+#define FAT_ASYNC_H
+
+#include <stdint.h>
+#include "contiki.h"
+#include "cfs-fat.h"
+
+/** Maximum number of bytes transferred in one step before other processes
+ * get the chance to run. Should be a multiple of the sector size to allow
+ * multi block transfers. */
+#ifdef FAT_ASYNC_CONF_STEP_SIZE
+#define FAT_ASYNC_STEP_SIZE FAT_ASYNC_CONF_STEP_SIZE
+#else
+#define FAT_ASYNC_STEP_SIZE 1024
+#endif
+
+/** One element of a scatter-gather list */
+struct cfs_fat_iovec {
+  uint8_t *base;
+  uint16_t len;
+};
+
+/** \name Request states
+ * @{ */
+#define CFS_FAT_ASYNC_QUEUED     1
+#define CFS_FAT_ASYNC_INPROGRESS 2
+#define CFS_FAT_ASYNC_DONE       3
+/** @} */
+
+/** An asynchronous read or write request, allocated by the caller. */
+struct cfs_fat_async_req {
+  /** Next request in the queue, used internally */
+  struct cfs_fat_async_req *next;
+  /** Process that is notified when the request is done */
+  struct process *owner;
+  /** Scatter-gather list of the data */
+  struct cfs_fat_iovec *iov;
+  uint8_t iovcnt;
+  uint8_t write;
+  /** One of CFS_FAT_ASYNC_{QUEUED,INPROGRESS,DONE} */
+  uint8_t state;
+  int fd;
+  /** Bytes transferred so far, -1 if nothing could be transferred */
+  int32_t result;
+  /** Current position within the scatter-gather list */
+  uint8_t iov_index;
+  uint16_t iov_offset;
+};
+
+/**
+ * Posted to the owner of a request when it is done, the data pointer is
+ * the finished struct cfs_fat_async_req.
+ */
+extern process_event_t cfs_fat_async_event;
+
+/**
+ * Queues a request reading from the current position of fd into the
+ * buffers of iov. The calling process is notified with
+ * cfs_fat_async_event.
+ *
+ * \param req Request storage, owned by the caller until done
+ * \param fd File descriptor opened with CFS_READ
+ * \param iov Scatter-gather list, filled in order
+ * \param iovcnt Number of elements in iov
+ * \return 0 if queued, -1 on invalid parameters
+ */
+int cfs_fat_read_async(struct cfs_fat_async_req *req, int fd, struct cfs_fat_iovec *iov, uint8_t iovcnt);
+
+/**
+ * Queues a request writing the buffers of iov to the current position
+ * of fd. The calling process is notified with cfs_fat_async_event.
+ *
+ * \param req Request storage, owned by the caller until done
+ * \param fd File descriptor opened with CFS_WRITE or CFS_APPEND
+ * \param iov Scatter-gather list, written in order
+ * \param iovcnt Number of elements in iov
+ * \return 0 if queued, -1 on invalid parameters
+ */
+int cfs_fat_write_async(struct cfs_fat_async_req *req, int fd, struct cfs_fat_iovec *iov, uint8_t iovcnt);
+
+/**
+ * Removes a request from the queue that was not started yet.
+ *
+ * \return 0 if the request was removed, -1 if it is in progress or done
+ */
+int cfs_fat_async_cancel(struct cfs_fat_async_req *req);
+
+/**
+ * Returns the number of requests that are not done yet.
+ */
+uint8_t cfs_fat_async_pending();
+
+PROCESS_NAME(fat_async_process);
+
+#endif /* FAT_ASYNC_H */
+
+/** @} */
+/** @} */
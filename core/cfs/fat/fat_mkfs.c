@@ -485,20 +485,15 @@ mkfs_write_fsinfo(uint8_t *buffer, struct diskio_device_info *dev, struct FAT_In
   buffer[486] = 0x41;
   buffer[487] = 0x61;
 
-  // FSI_Free_Count
-  fsi_free_count = (fi->BPB_TotSec - ((fi->BPB_FATSz * fi->BPB_NumFATs) + fi->BPB_RsvdSecCnt)) / fi->BPB_SecPerClus;
+  // FSI_Free_Count (all data clusters except the root directory cluster)
+  fsi_free_count = (fi->BPB_TotSec - ((fi->BPB_FATSz * fi->BPB_NumFATs) + fi->BPB_RsvdSecCnt)) / fi->BPB_SecPerClus - 1;
   buffer[488] = (uint8_t) fsi_free_count;
   buffer[489] = (uint8_t) (fsi_free_count >> 8);
   buffer[490] = (uint8_t) (fsi_free_count >> 16);
   buffer[491] = (uint8_t) (fsi_free_count >> 24);
 
-  // FSI_Nxt_Free
-  fsi_nxt_free = (fi->BPB_RsvdSecCnt + (fi->BPB_NumFATs * fi->BPB_FATSz));
-  if (fsi_nxt_free % fi->BPB_SecPerClus) {
-    fsi_nxt_free = (fsi_nxt_free / fi->BPB_SecPerClus) + 1;
-  } else {
-    fsi_nxt_free = (fsi_nxt_free / fi->BPB_SecPerClus);
-  }
+  // FSI_Nxt_Free (first cluster behind the root directory cluster 2)
+  fsi_nxt_free = 3;
   buffer[492] = (uint8_t) fsi_nxt_free;
   buffer[493] = (uint8_t) (fsi_nxt_free >> 8);
   buffer[494] = (uint8_t) (fsi_nxt_free >> 16);
@@ -47,12 +47,49 @@
 #include "contiki.h"
 #include "lib/memb.h"
 
+/* State of an allocated chunk */
+#define USED 0xFF
+
+#if MEMB_STATS
+static struct memb *pools;
+#endif
+
+/*---------------------------------------------------------------------------*/
+#if MEMB_STATS
+static void
+add_pool(struct memb *m)
+{
+  struct memb *p;
+
+  for(p = pools; p != NULL; p = p->next) {
+    if(p == m) {
+      return;
+    }
+  }
+  m->next = pools;
+  pools = m;
+}
+/*---------------------------------------------------------------------------*/
+struct memb *
+memb_pools(void)
+{
+  return pools;
+}
+#endif /* MEMB_STATS */
 /*---------------------------------------------------------------------------*/
 void
 memb_init(struct memb *m)
 {
   memset(m->count, 0, m->num);
   memset(m->mem, 0, m->size * m->num);
+  m->free = 0;
+  m->fresh = 0;
+#if MEMB_STATS
+  m->used = 0;
+  m->max_used = 0;
+  m->failed = 0;
+  add_pool(m);
+#endif
 }
 /*---------------------------------------------------------------------------*/
 void *
@@ -60,44 +97,82 @@ memb_alloc(struct memb *m)
 {
   int i;
 
-  for(i = 0; i < m->num; ++i) {
-    if(m->count[i] == 0) {
-      /* If this block was unused, we increase the reference count to
-	 indicate that it now is used and return a pointer to the
-	 memory block. */
-      ++(m->count[i]);
-      return (void *)((char *)m->mem + (i * m->size));
+  if(m->num > MEMB_MAX_LINKED) {
+    for(i = 0; i < m->num; ++i) {
+      if(m->count[i] == 0) {
+        break;
+      }
+    }
+  } else if(m->free != 0) {
+    /* Reuse the chunk freed last. */
+    i = m->free - 1;
+    m->free = (unsigned char)m->count[i];
+  } else {
+    /* Take the first chunk that was never allocated. */
+    i = m->fresh;
+    if(i < m->num) {
+      m->fresh++;
+    }
+  }
+
+  if(i >= m->num) {
+    /* No free block was found, so we return NULL to indicate failure to
+       allocate block. */
+#if MEMB_STATS
+    if(m->max_used == 0 && m->failed == 0) {
+      add_pool(m);
     }
+    m->failed++;
+#endif
+    return NULL;
   }
 
-  /* No free block was found, so we return NULL to indicate failure to
-     allocate block. */
-  return NULL;
+  m->count[i] = (char)USED;
+#if MEMB_STATS
+  if(m->max_used == 0 && m->failed == 0) {
+    /* Memory blocks without memb_init() are added here. */
+    add_pool(m);
+  }
+  if(++m->used > m->max_used) {
+    m->max_used = m->used;
+  }
+#endif
+  return (void *)((char *)m->mem + (i * m->size));
 }
 /*---------------------------------------------------------------------------*/
 char
 memb_free(struct memb *m, void *ptr)
 {
+  unsigned int offset;
   int i;
-  char *ptr2;
 
-  /* Walk through the list of blocks and try to find the block to
-     which the pointer "ptr" points to. */
-  ptr2 = (char *)m->mem;
-  for(i = 0; i < m->num; ++i) {
-    
-    if(ptr2 == (char *)ptr) {
-      /* We've found to block to which "ptr" points so we decrease the
-	 reference count and return the new value of it. */
-      if(m->count[i] > 0) {
-	/* Make sure that we don't deallocate free memory. */
-	--(m->count[i]);
-      }
-      return m->count[i];
-    }
-    ptr2 += m->size;
+  if(!memb_inmemb(m, ptr)) {
+    return -1;
+  }
+
+  /* The index of the block to which the pointer "ptr" points. */
+  offset = (char *)ptr - (char *)m->mem;
+  i = offset / m->size;
+  if(offset != i * m->size) {
+    return -1;
+  }
+
+  /* Make sure that we don't deallocate free memory. */
+  if((unsigned char)m->count[i] != USED ||
+     (m->num <= MEMB_MAX_LINKED && i >= m->fresh)) {
+    return 0;
+  }
+
+  if(m->num > MEMB_MAX_LINKED) {
+    m->count[i] = 0;
+  } else {
+    m->count[i] = (char)m->free;
+    m->free = i + 1;
   }
-  return -1;
+#if MEMB_STATS
+  m->used--;
+#endif
+  return 0;
 }
 /*---------------------------------------------------------------------------*/
 int
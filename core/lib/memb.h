@@ -48,6 +48,11 @@
  * memory by the memb_alloc() function, and are deallocated with the
  * memb_free() function.
  *
+ * Freed blocks are kept in a list, so that both functions take
+ * constant time. With MEMB_CONF_STATS, every memory block keeps its
+ * high-water mark and the number of failed allocations, and all memory
+ * blocks are kept in a list that the shell command "memb" prints.
+ *
  * @{
  */
 
@@ -65,6 +70,17 @@
 
 #include "sys/cc.h"
 
+/* Keep statistics of every memory block and a list of the memory
+   blocks */
+#ifdef MEMB_CONF_STATS
+#define MEMB_STATS MEMB_CONF_STATS
+#else
+#define MEMB_STATS 0
+#endif
+
+/* Memory blocks with more chunks are searched linearly */
+#define MEMB_MAX_LINKED 254
+
 /**
  * Declare a memory block.
  *
@@ -86,18 +102,41 @@ MEMB(connections, struct connection, 16);
  * \param num The total number of memory chunks in the block.
  *
  */
+#if MEMB_STATS
+#define MEMB(name, structure, num) \
+        static char CC_CONCAT(name,_memb_count)[num]; \
+        static structure CC_CONCAT(name,_memb_mem)[num]; \
+        static struct memb name = {sizeof(structure), num, \
+                                          CC_CONCAT(name,_memb_count), \
+                                          (void *)CC_CONCAT(name,_memb_mem), \
+                                          0, 0, #name}
+#else
 #define MEMB(name, structure, num) \
         static char CC_CONCAT(name,_memb_count)[num]; \
         static structure CC_CONCAT(name,_memb_mem)[num]; \
         static struct memb name = {sizeof(structure), num, \
                                           CC_CONCAT(name,_memb_count), \
                                           (void *)CC_CONCAT(name,_memb_mem)}
+#endif
 
 struct memb {
   unsigned short size;
   unsigned short num;
+  /* State of each chunk: 0xFF if allocated, otherwise the index + 1 of
+     the next freed chunk or 0 */
   char *count;
   void *mem;
+  /* Index + 1 of the last freed chunk, 0 if none */
+  unsigned char free;
+  /* Chunks from this index on were not allocated since memb_init() */
+  unsigned char fresh;
+#if MEMB_STATS
+  const char *name;
+  struct memb *next;
+  unsigned short used;
+  unsigned short max_used;
+  unsigned short failed;
+#endif
 };
 
 /**
@@ -130,6 +169,14 @@ char  memb_free(struct memb *m, void *ptr);
 
 int memb_inmemb(struct memb *m, void *ptr);
 
+#if MEMB_STATS
+/**
+ * Get the list of memory blocks, continued by the next field. A memory
+ * block is added by memb_init() or its first allocation.
+ */
+struct memb *memb_pools(void);
+#endif
+
 
 /** @} */
 /** @} */
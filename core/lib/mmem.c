@@ -40,13 +40,25 @@
  *         Implementation of the managed memory allocator
  * \author
  *         Adam Dunkels <adam@sics.se>
- * 
+ *
+ * Every block starts with a header holding its size, the size of the
+ * physically preceding block and the handle that owns it. Free blocks
+ * are kept in segregated lists, one per power of two of the block
+ * size, and a bitmap of the non-empty lists. An allocation takes the
+ * first block of the smallest list whose blocks are all large enough
+ * and splits it, a free merges the block with its free neighbours.
+ * Both take constant time and never move other blocks.
+ *
+ * Compaction is deferred: mmem_compact() slides allocated blocks down
+ * over the free space a few at a time and updates their handles. It
+ * runs on its own only when an allocation does not find a large enough
+ * free block although enough memory is free, or in the background if
+ * MMEM_CONF_BACKGROUND_COMPACT is set.
  */
 
-
 #include "mmem.h"
-#include "list.h"
 #include "contiki-conf.h"
+#include <stdint.h>
 #include <string.h>
 
 #ifdef MMEM_CONF_SIZE
@@ -55,10 +67,203 @@
 #define MMEM_SIZE 4096
 #endif
 
-LIST(mmemlist);
+/* Compact in a process when the free memory gets fragmented, instead
+   of only when an allocation fails. */
+#ifdef MMEM_CONF_BACKGROUND_COMPACT
+#define MMEM_BACKGROUND_COMPACT MMEM_CONF_BACKGROUND_COMPACT
+#else
+#define MMEM_BACKGROUND_COMPACT 0
+#endif
+
+/* Number of free blocks from which the background compaction starts. */
+#ifdef MMEM_CONF_COMPACT_THRESHOLD
+#define MMEM_COMPACT_THRESHOLD MMEM_CONF_COMPACT_THRESHOLD
+#else
+#define MMEM_COMPACT_THRESHOLD 4
+#endif
+
+/* Bytes the background compaction moves before it yields. */
+#ifdef MMEM_CONF_COMPACT_BUDGET
+#define MMEM_COMPACT_BUDGET MMEM_CONF_COMPACT_BUDGET
+#else
+#define MMEM_COMPACT_BUDGET 128
+#endif
+
+#if MMEM_SIZE > 65535
+#error "MMEM_SIZE must be smaller than 64 kB"
+#endif
+
+#if MMEM_BACKGROUND_COMPACT
+#include "sys/process.h"
+#endif
+
+struct block {
+  /* Size of the block including this header. */
+  uint16_t size;
+  /* Size of the physically preceding block, 0 for the first block. */
+  uint16_t prev_size;
+  /* Handle of an allocated block, NULL if the block is free. */
+  struct mmem *owner;
+};
+
+struct free_block {
+  struct block b;
+  struct free_block *next;
+  struct free_block *prev;
+};
+
+#define ALIGN         sizeof(void *)
+#define ALIGN_UP(x)   (((x) + ALIGN - 1) & ~(ALIGN - 1))
+#define HEAP_SIZE     (MMEM_SIZE & ~(ALIGN - 1))
+#define HEADER_SIZE   ALIGN_UP(sizeof(struct block))
+#define MIN_BLOCK     ALIGN_UP(sizeof(struct free_block))
+#define BINS          16
+
+#define FIRST_BLOCK   ((struct block *)heap.bytes)
+#define PAYLOAD(b)    ((void *)((uint8_t *)(b) + HEADER_SIZE))
+#define BLOCK_OF(p)   ((struct block *)((uint8_t *)(p) - HEADER_SIZE))
+
+/* Bytes in free blocks, including their headers. */
 unsigned int avail_memory;
-static char memory[MMEM_SIZE];
 
+static union {
+  void *align;
+  uint8_t bytes[HEAP_SIZE];
+} heap;
+
+static struct free_block *bins[BINS];
+static uint16_t bin_map;
+static unsigned int free_blocks;
+static unsigned int allocations;
+static unsigned int max_used;
+static unsigned int failed;
+static unsigned long moved;
+/* The block where mmem_compact() continues. */
+static struct block *cursor;
+
+#if MMEM_BACKGROUND_COMPACT
+PROCESS(mmem_compact_process, "mmem compaction");
+#endif
+
+/*---------------------------------------------------------------------------*/
+static uint8_t
+bin_of(unsigned int size)
+{
+#ifdef __GNUC__
+  return sizeof(unsigned int) * 8 - 1 - __builtin_clz(size);
+#else
+  uint8_t bin;
+
+  for(bin = 0; size > 1; bin++) {
+    size >>= 1;
+  }
+  return bin;
+#endif
+}
+/*---------------------------------------------------------------------------*/
+static struct block *
+next_block(struct block *b)
+{
+  b = (struct block *)((uint8_t *)b + b->size);
+  return (uint8_t *)b < &heap.bytes[HEAP_SIZE] ? b : NULL;
+}
+/*---------------------------------------------------------------------------*/
+static struct block *
+prev_block(struct block *b)
+{
+  return b->prev_size == 0 ? NULL :
+    (struct block *)((uint8_t *)b - b->prev_size);
+}
+/*---------------------------------------------------------------------------*/
+static void
+insert_free(struct block *b)
+{
+  struct free_block *f = (struct free_block *)b;
+  uint8_t bin = bin_of(b->size);
+
+  b->owner = NULL;
+  f->prev = NULL;
+  f->next = bins[bin];
+  if(f->next != NULL) {
+    f->next->prev = f;
+  }
+  bins[bin] = f;
+  bin_map |= 1U << bin;
+  free_blocks++;
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_free(struct block *b)
+{
+  struct free_block *f = (struct free_block *)b;
+  uint8_t bin = bin_of(b->size);
+
+  if(f->prev != NULL) {
+    f->prev->next = f->next;
+  } else {
+    bins[bin] = f->next;
+    if(f->next == NULL) {
+      bin_map &= ~(1U << bin);
+    }
+  }
+  if(f->next != NULL) {
+    f->next->prev = f->prev;
+  }
+  free_blocks--;
+}
+/*---------------------------------------------------------------------------*/
+/* Appends the block b to its preceding block a. */
+static void
+merge(struct block *a, struct block *b)
+{
+  struct block *next;
+
+  a->size += b->size;
+  next = next_block(a);
+  if(next != NULL) {
+    next->prev_size = a->size;
+  }
+  if(cursor == b) {
+    cursor = a;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static struct block *
+find_fit(unsigned int size)
+{
+  uint8_t bin = bin_of(size);
+  unsigned int larger;
+
+  /* The first block of the own list often fits. */
+  if(bins[bin] != NULL && bins[bin]->b.size >= size) {
+    return &bins[bin]->b;
+  }
+
+  /* Every block of a larger list fits. */
+  larger = bin_map & ~((2U << bin) - 1);
+  if(larger == 0) {
+    return NULL;
+  }
+#ifdef __GNUC__
+  bin = __builtin_ctz(larger);
+#else
+  for(bin++; !(larger & (1U << bin)); bin++);
+#endif
+  return &bins[bin]->b;
+}
+/*---------------------------------------------------------------------------*/
+#if MMEM_BACKGROUND_COMPACT
+static void
+compact_poke(void)
+{
+  if(free_blocks >= MMEM_COMPACT_THRESHOLD) {
+    if(!process_is_running(&mmem_compact_process)) {
+      process_start(&mmem_compact_process, NULL);
+    }
+    process_poll(&mmem_compact_process);
+  }
+}
+#endif /* MMEM_BACKGROUND_COMPACT */
 /*---------------------------------------------------------------------------*/
 /**
  * \brief      Allocate a managed memory block
@@ -82,27 +287,60 @@ static char memory[MMEM_SIZE];
 int
 mmem_alloc(struct mmem *m, unsigned int size)
 {
-  /* Check if we have enough memory left for this allocation. */
-  if(avail_memory < size) {
+  struct block *b;
+  struct block *rest;
+  struct block *next;
+  unsigned int need;
+
+  if(size > HEAP_SIZE - HEADER_SIZE) {
+    failed++;
     return 0;
   }
+  need = HEADER_SIZE + ALIGN_UP(size);
+  if(need < MIN_BLOCK) {
+    need = MIN_BLOCK;
+  }
 
-  /* We had enough memory so we add this memory block to the end of
-     the list of allocated memory blocks. */
-  list_add(mmemlist, m);
+  b = find_fit(need);
+  if(b == NULL && avail_memory >= need) {
+    /* Enough memory is free, but not in one piece. Compact from the
+       start only until the free block in front of the cursor is large
+       enough, a complete pass leaves all free memory in one block. */
+    cursor = FIRST_BLOCK;
+    while(mmem_compact(need) &&
+          (cursor->owner != NULL || cursor->size < need));
+    b = find_fit(need);
+  }
+  if(b == NULL) {
+    failed++;
+    return 0;
+  }
+  remove_free(b);
 
-  /* Set up the pointer so that it points to the first available byte
-     in the memory block. */
-  m->ptr = &memory[MMEM_SIZE - avail_memory];
+  /* Return the rest of the block to the free lists. Its successor is
+     allocated, as free neighbours are always merged. */
+  if(b->size - need >= MIN_BLOCK) {
+    rest = (struct block *)((uint8_t *)b + need);
+    rest->size = b->size - need;
+    rest->prev_size = need;
+    next = next_block(rest);
+    if(next != NULL) {
+      next->prev_size = rest->size;
+    }
+    b->size = need;
+    insert_free(rest);
+  }
 
-  /* Remember the size of this memory block. */
+  b->owner = m;
+  m->ptr = PAYLOAD(b);
   m->size = size;
 
-  /* Decrease the amount of available memory. */
-  avail_memory -= size;
+  avail_memory -= b->size;
+  allocations++;
+  if(HEAP_SIZE - avail_memory > max_used) {
+    max_used = HEAP_SIZE - avail_memory;
+  }
 
-  /* Return non-zero to indicate that we were able to allocate
-     memory. */
   return 1;
 }
 /*---------------------------------------------------------------------------*/
@@ -112,31 +350,148 @@ mmem_alloc(struct mmem *m, unsigned int size)
  * \author     Adam Dunkels
  *
  *             This function deallocates a managed memory block that
- *             previously has been allocated with mmem_alloc().
+ *             previously has been allocated with mmem_alloc(). The
+ *             pointer of the handle is set to NULL.
  *
  */
 void
 mmem_free(struct mmem *m)
 {
-  struct mmem *n;
-
-  if(m->next != NULL) {
-    /* Compact the memory after the allocation that is to be removed
-       by moving it downwards. */
-    memmove(m->ptr, m->next->ptr,
-	    &memory[MMEM_SIZE - avail_memory] - (char *)m->next->ptr);
-    
-    /* Update all the memory pointers that points to memory that is
-       after the allocation that is to be removed. */
-    for(n = m->next; n != NULL; n = n->next) {
-      n->ptr = (void *)((char *)n->ptr - m->size);
+  struct block *b;
+  struct block *neighbour;
+
+  if(m->ptr == NULL) {
+    return;
+  }
+  b = BLOCK_OF(m->ptr);
+  m->ptr = NULL;
+
+  avail_memory += b->size;
+  allocations--;
+
+  neighbour = next_block(b);
+  if(neighbour != NULL && neighbour->owner == NULL) {
+    remove_free(neighbour);
+    merge(b, neighbour);
+  }
+  neighbour = prev_block(b);
+  if(neighbour != NULL && neighbour->owner == NULL) {
+    remove_free(neighbour);
+    merge(neighbour, b);
+    b = neighbour;
+  }
+  insert_free(b);
+
+#if MMEM_BACKGROUND_COMPACT
+  compact_poke();
+#endif
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief        Compact the managed memory
+ * \param budget Number of bytes that may be moved
+ * \return       Non-zero if the end of the memory was not reached
+ *
+ *               This function moves allocated blocks down over the
+ *               free blocks before them, starting where the previous
+ *               call stopped, and updates the pointers of their
+ *               handles. It stops when about budget bytes have been
+ *               moved or the end of the memory is reached. A pass over
+ *               the whole memory leaves all free memory in one block,
+ *               unless memory was freed behind the pass in between.
+ *
+ */
+int
+mmem_compact(unsigned int budget)
+{
+  struct block *b;
+  struct block *f;
+  struct block *next;
+  uint16_t free_size;
+  uint16_t prev_size;
+
+  if(cursor == NULL) {
+    cursor = FIRST_BLOCK;
+  }
+
+  while(budget > 0) {
+    f = cursor;
+    b = next_block(f);
+    if(b == NULL) {
+      /* Start over with the next pass. */
+      cursor = FIRST_BLOCK;
+      return 0;
+    }
+    if(f->owner != NULL) {
+      cursor = b;
+      budget -= budget < HEADER_SIZE ? budget : HEADER_SIZE;
+      continue;
+    }
+
+    /* f is free and b allocated: swap them. */
+    remove_free(f);
+    free_size = f->size;
+    prev_size = f->prev_size;
+    memmove(f, b, b->size);
+    b = f;
+    b->prev_size = prev_size;
+    b->owner->ptr = PAYLOAD(b);
+    moved += b->size;
+    budget -= budget < b->size ? budget : b->size;
+
+    f = next_block(b);
+    f->size = free_size;
+    f->prev_size = b->size;
+    next = next_block(f);
+    if(next != NULL) {
+      if(next->owner == NULL) {
+        remove_free(next);
+        merge(f, next);
+      } else {
+        next->prev_size = f->size;
+      }
     }
+    insert_free(f);
+    cursor = f;
   }
 
-  avail_memory += m->size;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief       Get statistics of the managed memory
+ * \param stats Filled with the statistics
+ *
+ *              The time taken is proportional to the number of free
+ *              blocks in the largest size class.
+ *
+ */
+void
+mmem_stats(struct mmem_stats *stats)
+{
+  struct free_block *f;
+  int bin;
+
+  stats->size = HEAP_SIZE;
+  stats->used = HEAP_SIZE - avail_memory;
+  stats->max_used = max_used;
+  stats->allocations = allocations;
+  stats->free_blocks = free_blocks;
+  stats->failed = failed;
+  stats->moved = moved;
+
+  stats->largest_free = 0;
+  for(bin = BINS - 1; bin >= 0 && bins[bin] == NULL; bin--);
+  if(bin >= 0) {
+    for(f = bins[bin]; f != NULL; f = f->next) {
+      if(f->b.size > stats->largest_free) {
+        stats->largest_free = f->b.size;
+      }
+    }
+  }
 
-  /* Remove the memory block from the list. */
-  list_remove(mmemlist, m);
+  stats->fragmentation = avail_memory == 0 ? 0 :
+    100 - (unsigned int)(100UL * stats->largest_free / avail_memory);
 }
 /*---------------------------------------------------------------------------*/
 /**
@@ -151,9 +506,38 @@ mmem_free(struct mmem *m)
 void
 mmem_init(void)
 {
-  list_init(mmemlist);
-  avail_memory = MMEM_SIZE;
+  memset(bins, 0, sizeof(bins));
+  bin_map = 0;
+  free_blocks = 0;
+  allocations = 0;
+  max_used = 0;
+  failed = 0;
+  moved = 0;
+  cursor = FIRST_BLOCK;
+
+  FIRST_BLOCK->size = HEAP_SIZE;
+  FIRST_BLOCK->prev_size = 0;
+  insert_free(FIRST_BLOCK);
+  avail_memory = HEAP_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+#if MMEM_BACKGROUND_COMPACT
+PROCESS_THREAD(mmem_compact_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  process_set_priority(&mmem_compact_process, PROCESS_PRIO_BACKGROUND);
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_POLL);
+    while(mmem_compact(MMEM_COMPACT_BUDGET)) {
+      PROCESS_PAUSE();
+    }
+  }
+
+  PROCESS_END();
 }
+#endif /* MMEM_BACKGROUND_COMPACT */
 /*---------------------------------------------------------------------------*/
 
 /** @} */
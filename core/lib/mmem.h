@@ -38,9 +38,11 @@
  * \defgroup mmem Managed memory allocator
  *
  * The managed memory allocator is a fragmentation-free memory
- * manager. It keeps the allocated memory free from fragmentation by
- * compacting the memory when blocks are freed. A program that uses
- * the managed memory module cannot be sure that allocated memory
+ * manager. Allocating and freeing take constant time, the free memory
+ * is kept in lists per size class. It keeps the allocated memory free
+ * from fragmentation by compacting the memory later, a few blocks at
+ * a time, or when an allocation would fail otherwise. A program that
+ * uses the managed memory module cannot be sure that allocated memory
  * stays in place. Therefore, a level of indirection is used: access
  * to allocated memory must always be done using a special macro.
  *
@@ -75,17 +77,38 @@
 #define MMEM_PTR(m) (struct mmem *)(m)->ptr
 
 struct mmem {
-  struct mmem *next;
+  struct mmem *next;  /* Unused, kept for compatibility */
   unsigned int size;
   void *ptr;
 };
 
+struct mmem_stats {
+  /* Size of the managed memory */
+  unsigned int size;
+  /* Bytes in allocated blocks, including the block headers */
+  unsigned int used;
+  /* Largest value of used since mmem_init() */
+  unsigned int max_used;
+  /* Size of the largest free block, including its header */
+  unsigned int largest_free;
+  /* Percentage of the free memory outside of the largest free block */
+  unsigned int fragmentation;
+  unsigned int allocations;
+  unsigned int free_blocks;
+  /* Number of failed allocations */
+  unsigned int failed;
+  /* Bytes moved by the compaction */
+  unsigned long moved;
+};
+
 /* XXX: tagga minne med "interrupt usage", vilke gr att man r
    speciellt varsam under free(). */
 
 int  mmem_alloc(struct mmem *m, unsigned int size);
 void mmem_free(struct mmem *);
 void mmem_init(void);
+int  mmem_compact(unsigned int budget);
+void mmem_stats(struct mmem_stats *stats);
 
 #endif /* MMEM_H_ */
 
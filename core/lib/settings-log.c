@@ -0,0 +1,848 @@
+/*
+ * Copyright (c) 2013, Institute of Operating Systems and Computer Networks (TU Braunschweig).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * @file   settings-log.c
+ * @brief  Log-structured backend of the settings manager
+ *
+ * Selected with SETTINGS_CONF_LOG. The settings area is split into two
+ * regions. The active region holds a header with a generation number and
+ * a log of records, new values and deletions are appended to the log.
+ * A RAM index maps every live (key, index) pair to its record, so
+ * lookups do not walk the EEPROM. When the active region is full, the
+ * live records are copied to the other region, which then becomes the
+ * active one with the next generation. Cells are only written again
+ * after the whole region was used.
+ *
+ *  | Size     | Name  | Description                               |
+ *  | ----     | ----  | ----------------------------------------- |
+ *  | 1        | state | 0x5A value, 0xA5 deletion, 0xFF end of log |
+ *  | 1        | index | Index among the values of the key        |
+ *  | 2        | key   |                                           |
+ *  | 2        | size  | The size of the value, in bytes           |
+ *  | variable | value |                                           |
+ *
+ * The state byte is written last, and the state byte behind a new
+ * record is set to 0xFF before, so an interrupted write leaves the log
+ * as it was. A region only becomes active when its header is written
+ * after all live records were copied.
+ */
+
+#ifdef SETTINGS_CONF_SKIP_CONVENIENCE_FUNCS
+#undef SETTINGS_CONF_SKIP_CONVENIENCE_FUNCS
+#endif
+
+#define SETTINGS_CONF_SKIP_CONVENIENCE_FUNCS 1
+
+#include "contiki.h"
+#include "settings.h"
+#include "dev/eeprom.h"
+
+#if CONTIKI_CONF_SETTINGS_MANAGER && SETTINGS_CONF_LOG
+
+#if !EEPROM_CONF_SIZE
+#error CONTIKI_CONF_SETTINGS_MANAGER has been set, but EEPROM_CONF_SIZE hasnt!
+#endif
+
+#ifndef EEPROM_END_ADDR
+#define EEPROM_END_ADDR         (EEPROM_CONF_SIZE - 1)
+#endif
+
+/** Size of the store of the list backend, imported on the first start. */
+#define SETTINGS_LEGACY_SIZE	(127)
+
+#ifndef SETTINGS_MAX_SIZE
+/**
+ * The amount EEPROM dedicated to settings, both regions. Defaults to the
+ * area of the list backend, which is too small to import its values, see
+ * SETTINGS_LEGACY_IMPORT_SIZE.
+ */
+#define SETTINGS_MAX_SIZE	SETTINGS_LEGACY_SIZE
+#endif
+
+#ifndef SETTINGS_TOP_ADDR
+/** The top address in EEPROM that settings should use. Inclusive. */
+#define SETTINGS_TOP_ADDR	(settings_iter_t)(EEPROM_END_ADDR)
+#endif
+
+#ifndef SETTINGS_BOTTOM_ADDR
+/** The lowest address in EEPROM that settings should use. Inclusive. */
+#define SETTINGS_BOTTOM_ADDR	(SETTINGS_TOP_ADDR + 1 - SETTINGS_MAX_SIZE)
+#endif
+
+#ifndef SETTINGS_INDEX_SIZE
+/** The maximum number of values in the store. */
+#define SETTINGS_INDEX_SIZE	(16)  /**< Defaults to 16 values */
+#endif
+
+/**
+ * The region size that takes any full store of the list backend: the
+ * region header, the store and two more header bytes for each value.
+ */
+#define SETTINGS_LEGACY_IMPORT_SIZE \
+  (4 + SETTINGS_LEGACY_SIZE + 2 * SETTINGS_INDEX_SIZE)
+
+#ifndef MIN
+#define MIN(a,b) ((a)<(b)?a:b)
+#endif
+
+#define REGION_SIZE		(SETTINGS_MAX_SIZE / 2)
+#define REGION_START(r)		(SETTINGS_BOTTOM_ADDR + (r) * REGION_SIZE)
+#define REGION_END(r)		(REGION_START(r) + REGION_SIZE)
+#define REGION_MAGIC		0x53
+
+#define RECORD_END		0xFF
+#define RECORD_VALUE		0x5A
+#define RECORD_DELETED		0xA5
+
+/* Indices of a key are renumbered by the compaction before they reach
+   this, SETTINGS_LAST_INDEX is never stored. */
+#define MAX_STORED_INDEX	0xFE
+
+typedef struct {
+  uint16_t generation;
+  uint8_t magic;
+  uint8_t check;
+} region_header_t;
+
+typedef struct {
+  uint8_t state;
+  uint8_t index;
+  settings_key_t key;
+  settings_length_t size;
+} record_header_t;
+
+typedef struct {
+  settings_key_t key;
+  uint8_t index;
+  eeprom_addr_t addr;
+} index_entry_t;
+
+/* Sorted by key and index, so the values of a key are adjacent and in
+   the order they were added. */
+static index_entry_t settings_index[SETTINGS_INDEX_SIZE];
+static uint8_t index_count;
+
+static uint8_t initialized;
+/* Set when the values of the list backend did not fit and were kept */
+static uint8_t legacy_blocked;
+static uint8_t region;
+static uint16_t generation;
+static eeprom_addr_t log_end;
+
+/*****************************************************************************/
+// MARK: - RAM Index
+/*****************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/* Position of the first entry that is not smaller than (key, index). */
+static uint8_t
+index_lower_bound(settings_key_t key, uint8_t index)
+{
+  uint8_t lo = 0, hi = index_count, mid;
+
+  while(lo < hi) {
+    mid = (lo + hi) / 2;
+    if(settings_index[mid].key < key
+       || (settings_index[mid].key == key && settings_index[mid].index < index)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Position of the n-th value of the key, -1 if there is none. */
+static int
+index_lookup(settings_key_t key, uint8_t n)
+{
+  int i;
+
+  if(n == SETTINGS_LAST_INDEX) {
+    i = (int)index_lower_bound(key, SETTINGS_LAST_INDEX) - 1;
+  } else {
+    i = index_lower_bound(key, 0) + n;
+  }
+
+  if(i < 0 || i >= index_count || settings_index[i].key != key) {
+    return -1;
+  }
+  return i;
+}
+
+/*---------------------------------------------------------------------------*/
+static uint8_t
+index_update(settings_key_t key, uint8_t index, eeprom_addr_t addr)
+{
+  uint8_t i = index_lower_bound(key, index);
+
+  if(i == index_count || settings_index[i].key != key
+     || settings_index[i].index != index) {
+    if(index_count == SETTINGS_INDEX_SIZE) {
+      return 0;
+    }
+    memmove(&settings_index[i + 1], &settings_index[i],
+            (index_count - i) * sizeof(index_entry_t));
+    index_count++;
+    settings_index[i].key = key;
+    settings_index[i].index = index;
+  }
+  settings_index[i].addr = addr;
+  return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+index_remove(uint8_t i)
+{
+  index_count--;
+  memmove(&settings_index[i], &settings_index[i + 1],
+          (index_count - i) * sizeof(index_entry_t));
+}
+
+/*****************************************************************************/
+// MARK: - Log
+/*****************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+static void
+read_record(eeprom_addr_t addr, record_header_t *header)
+{
+  eeprom_read(addr, (uint8_t *)header, sizeof(*header));
+}
+
+/*---------------------------------------------------------------------------*/
+static uint8_t
+read_region_header(uint8_t r, uint16_t *gen)
+{
+  region_header_t header;
+
+  eeprom_read(REGION_START(r), (uint8_t *)&header, sizeof(header));
+  *gen = header.generation;
+  return header.magic == REGION_MAGIC
+    && header.check == (uint8_t)~(header.generation ^ (header.generation >> 8));
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+write_region_header(uint8_t r, uint16_t gen)
+{
+  region_header_t header;
+
+  header.generation = gen;
+  header.magic = REGION_MAGIC;
+  header.check = ~(gen ^ (gen >> 8));
+  eeprom_write(REGION_START(r), (uint8_t *)&header, sizeof(header));
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+invalidate_region(uint8_t r)
+{
+  region_header_t header;
+
+  memset(&header, 0xFF, sizeof(header));
+  eeprom_write(REGION_START(r), (uint8_t *)&header, sizeof(header));
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+copy_value(eeprom_addr_t to, eeprom_addr_t from, settings_length_t size)
+{
+  uint8_t buf[16];
+  settings_length_t n;
+
+  while(size) {
+    n = MIN(size, sizeof(buf));
+    eeprom_read(from, buf, n);
+    eeprom_write(to, buf, n);
+    from += n;
+    to += n;
+    size -= n;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+/*
+ * Appends a record at the end of the log. The value is taken from RAM or,
+ * if value is NULL, from the EEPROM at from. The caller made sure that
+ * it fits into the region.
+ */
+static eeprom_addr_t
+append_record(uint8_t state, settings_key_t key, uint8_t index,
+              const uint8_t *value, eeprom_addr_t from,
+              settings_length_t size)
+{
+  record_header_t header;
+  eeprom_addr_t addr = log_end;
+  eeprom_addr_t next = addr + sizeof(header) + size;
+
+  /* Mark the end of the log behind the new record first. */
+  if(next + sizeof(header) <= REGION_END(region)) {
+    header.state = RECORD_END;
+    eeprom_write(next, &header.state, 1);
+  }
+
+  if(value) {
+    eeprom_write(addr + sizeof(header), (uint8_t *)value, size);
+  } else {
+    copy_value(addr + sizeof(header), from, size);
+  }
+
+  header.state = state;
+  header.index = index;
+  header.key = key;
+  header.size = size;
+  eeprom_write(addr + 1, (uint8_t *)&header + 1, sizeof(header) - 1);
+  eeprom_write(addr, &header.state, 1);
+
+  log_end = next;
+  return addr;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Makes the given region the active and empty one. */
+static void
+start_region(uint8_t r)
+{
+  invalidate_region(r);
+  region = r;
+  log_end = REGION_START(r) + sizeof(region_header_t);
+  index_count = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+commit_region(void)
+{
+  uint8_t state = RECORD_END;
+
+  if(log_end + sizeof(record_header_t) <= REGION_END(region)) {
+    eeprom_write(log_end, &state, 1);
+  }
+  generation++;
+  write_region_header(region, generation);
+}
+
+/*---------------------------------------------------------------------------*/
+/*
+ * Copies the live records to the other region. The values of each key
+ * are numbered from 0 again. The entry at position replace gets the
+ * given value instead of its stored one.
+ */
+static void
+compact_replace(int replace, const uint8_t *value, settings_length_t size)
+{
+  index_entry_t *entry;
+  record_header_t header;
+  uint8_t count = index_count;
+  uint8_t i, index = 0;
+
+  start_region(region ^ 1);
+  index_count = count;
+
+  for(i = 0; i < count; i++) {
+    entry = &settings_index[i];
+    index = (i > 0 && settings_index[i - 1].key == entry->key) ? index + 1 : 0;
+    entry->index = index;
+    if(i == replace) {
+      entry->addr = append_record(RECORD_VALUE, entry->key, index, value, 0,
+                                  size);
+    } else {
+      read_record(entry->addr, &header);
+      entry->addr = append_record(RECORD_VALUE, entry->key, index, NULL,
+                                  entry->addr + sizeof(header), header.size);
+    }
+  }
+
+  commit_region();
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+compact(void)
+{
+  compact_replace(-1, NULL, 0);
+}
+
+/*---------------------------------------------------------------------------*/
+/* Space of the live records after a compaction, without the one at skip. */
+static eeprom_addr_t
+live_size(int skip)
+{
+  record_header_t header;
+  eeprom_addr_t size = sizeof(region_header_t);
+  uint8_t i;
+
+  for(i = 0; i < index_count; i++) {
+    if(i != skip) {
+      read_record(settings_index[i].addr, &header);
+      size += sizeof(header) + header.size;
+    }
+  }
+  return size;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Makes room for a record with the given value size. */
+static uint8_t
+reserve_space(settings_length_t size)
+{
+  if(log_end + sizeof(record_header_t) + size <= REGION_END(region)) {
+    return 1;
+  }
+  compact();
+  return log_end + sizeof(record_header_t) + size <= REGION_END(region);
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+load_index(void)
+{
+  record_header_t header;
+  eeprom_addr_t addr = REGION_START(region) + sizeof(region_header_t);
+  int i;
+
+  index_count = 0;
+  while(addr + sizeof(header) <= REGION_END(region)) {
+    read_record(addr, &header);
+    if((header.state != RECORD_VALUE && header.state != RECORD_DELETED)
+       || header.size > SETTINGS_MAX_VALUE_SIZE
+       || addr + sizeof(header) + header.size > REGION_END(region)) {
+      break;
+    }
+
+    if(header.state == RECORD_VALUE) {
+      index_update(header.key, header.index, addr);
+    } else {
+      i = index_lower_bound(header.key, header.index);
+      if(i < index_count && settings_index[i].key == header.key
+         && settings_index[i].index == header.index) {
+        index_remove(i);
+      }
+    }
+    addr += sizeof(header) + header.size;
+  }
+  log_end = addr;
+}
+
+/*---------------------------------------------------------------------------*/
+typedef struct {
+#if SETTINGS_CONF_SUPPORT_LARGE_VALUES
+  uint8_t size_extra;
+#endif
+  uint8_t size_low;
+  uint8_t size_check;
+  settings_key_t key;
+} legacy_header_t;
+
+/*
+ * Walks the values of the list backend, stored downwards from the top of
+ * the EEPROM, and appends them to the log if import is set. Returns the
+ * number of values, or -1 if they do not all fit into the first region
+ * and the index.
+ */
+static int
+legacy_scan(uint8_t import)
+{
+  legacy_header_t header;
+  settings_iter_t iter = SETTINGS_TOP_ADDR;
+  settings_length_t len;
+  eeprom_addr_t value_addr;
+  eeprom_addr_t end = REGION_START(0) + sizeof(region_header_t);
+  uint8_t index;
+  int last, count = 0;
+
+  while(iter >= SETTINGS_TOP_ADDR + 1 - SETTINGS_LEGACY_SIZE + sizeof(header)) {
+    eeprom_read(iter - sizeof(header), (uint8_t *)&header, sizeof(header));
+    if((uint8_t)header.size_check != (uint8_t)~header.size_low) {
+      break;
+    }
+
+    len = header.size_low;
+#if SETTINGS_CONF_SUPPORT_LARGE_VALUES
+    if(len & (1 << 7)) {
+      len = ((len & ~(1 << 7)) << 7) | header.size_extra;
+    }
+    value_addr = iter - sizeof(header) - len - (len >= 128);
+#else
+    value_addr = iter - sizeof(header) - len;
+#endif
+    if(value_addr < SETTINGS_TOP_ADDR + 1 - SETTINGS_LEGACY_SIZE) {
+      break;
+    }
+
+    end += sizeof(record_header_t) + len;
+    if(++count > SETTINGS_INDEX_SIZE || end > REGION_END(0)) {
+      return -1;
+    }
+
+    if(import) {
+      last = index_lookup(header.key, SETTINGS_LAST_INDEX);
+      index = last < 0 ? 0 : settings_index[last].index + 1;
+      index_update(header.key, index,
+                   append_record(RECORD_VALUE, header.key, index,
+                                 NULL, value_addr, len));
+    }
+    iter = value_addr;
+  }
+  return count;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Returns 0 if the store is blocked by values of the list backend. */
+static uint8_t
+settings_init(void)
+{
+  uint16_t gen0, gen1;
+  uint8_t valid0, valid1;
+  int count;
+
+  if(initialized) {
+    return !legacy_blocked;
+  }
+  initialized = 1;
+
+  valid0 = read_region_header(0, &gen0);
+  valid1 = read_region_header(1, &gen1);
+
+  if(valid0 || valid1) {
+    if(valid0 && valid1) {
+      region = (int16_t)(gen1 - gen0) > 0;
+    } else {
+      region = valid1;
+    }
+    generation = region ? gen1 : gen0;
+    load_index();
+    return 1;
+  }
+
+  /* First start. The values of the list backend are imported all at
+     once or not at all. */
+  count = legacy_scan(0);
+#if SETTINGS_MAX_SIZE - REGION_SIZE < SETTINGS_LEGACY_SIZE
+  /* The first region overlaps their store. */
+  if(count > 0) {
+    count = -1;
+  }
+#endif
+  if(count < 0) {
+    /* Leave them readable for the list backend until settings_wipe(). */
+    legacy_blocked = 1;
+    return 0;
+  }
+
+  start_region(0);
+  legacy_scan(1);
+  commit_region();
+  return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+static settings_status_t
+delete_entry(int i)
+{
+  index_entry_t entry = settings_index[i];
+
+  index_remove(i);
+  if(log_end + sizeof(record_header_t) <= REGION_END(region)) {
+    append_record(RECORD_DELETED, entry.key, entry.index, NULL, 0, 0);
+  } else {
+    /* The compaction leaves the value out. */
+    compact();
+  }
+  return SETTINGS_STATUS_OK;
+}
+
+/*****************************************************************************/
+// MARK: - Public Travesal Functions
+/*****************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+/* First live record at or after addr. */
+static settings_iter_t
+next_live(eeprom_addr_t addr)
+{
+  record_header_t header;
+  int i;
+
+  while(addr < log_end) {
+    read_record(addr, &header);
+    if(header.state == RECORD_VALUE) {
+      i = index_lower_bound(header.key, header.index);
+      if(i < index_count && settings_index[i].addr == addr) {
+        return addr;
+      }
+    }
+    addr += sizeof(header) + header.size;
+  }
+  return SETTINGS_INVALID_ITER;
+}
+
+/*---------------------------------------------------------------------------*/
+settings_iter_t
+settings_iter_begin()
+{
+  if(!settings_init()) {
+    return SETTINGS_INVALID_ITER;
+  }
+  return next_live(REGION_START(region) + sizeof(region_header_t));
+}
+
+/*---------------------------------------------------------------------------*/
+settings_iter_t
+settings_iter_next(settings_iter_t iter)
+{
+  if(iter) {
+    return next_live(iter + sizeof(record_header_t)
+                     + settings_iter_get_value_length(iter));
+  }
+  return SETTINGS_INVALID_ITER;
+}
+
+/*---------------------------------------------------------------------------*/
+uint8_t
+settings_iter_is_valid(settings_iter_t iter)
+{
+  return settings_init() && iter != SETTINGS_INVALID_ITER
+    && next_live(iter) == iter;
+}
+
+/*---------------------------------------------------------------------------*/
+settings_key_t
+settings_iter_get_key(settings_iter_t iter)
+{
+  record_header_t header;
+
+  read_record(iter, &header);
+  return header.key;
+}
+
+/*---------------------------------------------------------------------------*/
+settings_length_t
+settings_iter_get_value_length(settings_iter_t iter)
+{
+  record_header_t header;
+
+  read_record(iter, &header);
+  return header.size;
+}
+
+/*---------------------------------------------------------------------------*/
+eeprom_addr_t
+settings_iter_get_value_addr(settings_iter_t iter)
+{
+  return iter + sizeof(record_header_t);
+}
+
+/*---------------------------------------------------------------------------*/
+settings_length_t
+settings_iter_get_value_bytes(settings_iter_t iter, void *bytes,
+                              settings_length_t max_length)
+{
+  max_length = MIN(max_length, settings_iter_get_value_length(iter));
+
+  eeprom_read(settings_iter_get_value_addr(iter), bytes, max_length);
+
+  return max_length;
+}
+
+/*---------------------------------------------------------------------------*/
+settings_status_t
+settings_iter_delete(settings_iter_t iter)
+{
+  record_header_t header;
+  int i;
+
+  if(!settings_iter_is_valid(iter)) {
+    return SETTINGS_STATUS_NOT_FOUND;
+  }
+  read_record(iter, &header);
+  i = index_lower_bound(header.key, header.index);
+  return delete_entry(i);
+}
+
+/*****************************************************************************/
+// MARK: - Public Functions
+/*****************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+uint8_t
+settings_check(settings_key_t key, uint8_t index)
+{
+  return settings_init() && index_lookup(key, index) >= 0;
+}
+
+/*---------------------------------------------------------------------------*/
+settings_status_t
+settings_get(settings_key_t key, uint8_t index, uint8_t *value,
+             settings_length_t value_size)
+{
+  int i;
+
+  if(!settings_init()) {
+    return SETTINGS_STATUS_FAILURE;
+  }
+  i = index_lookup(key, index);
+  if(i < 0) {
+    return SETTINGS_STATUS_NOT_FOUND;
+  }
+  settings_iter_get_value_bytes(settings_index[i].addr, value, value_size);
+  return SETTINGS_STATUS_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+settings_status_t
+settings_add(settings_key_t key, const uint8_t *value,
+             settings_length_t value_size)
+{
+  int last;
+  uint8_t index;
+
+  if(!settings_init()) {
+    return SETTINGS_STATUS_FAILURE;
+  }
+
+  if(value_size > SETTINGS_MAX_VALUE_SIZE) {
+    return SETTINGS_STATUS_VALUE_TOO_BIG;
+  }
+  if(index_count == SETTINGS_INDEX_SIZE || !reserve_space(value_size)) {
+    return SETTINGS_STATUS_OUT_OF_SPACE;
+  }
+
+  last = index_lookup(key, SETTINGS_LAST_INDEX);
+  if(last >= 0 && settings_index[last].index == MAX_STORED_INDEX) {
+    /* Renumber the values of the key */
+    compact();
+    if(settings_index[last].index == MAX_STORED_INDEX
+       || !reserve_space(value_size)) {
+      return SETTINGS_STATUS_OUT_OF_SPACE;
+    }
+  }
+  index = last < 0 ? 0 : settings_index[last].index + 1;
+
+  index_update(key, index,
+               append_record(RECORD_VALUE, key, index, value, 0, value_size));
+  return SETTINGS_STATUS_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+settings_status_t
+settings_set(settings_key_t key, const uint8_t *value,
+             settings_length_t value_size)
+{
+  uint8_t buf[16];
+  settings_length_t offset, n;
+  eeprom_addr_t addr;
+  int i;
+
+  if(!settings_init()) {
+    return SETTINGS_STATUS_FAILURE;
+  }
+
+  i = index_lookup(key, 0);
+  if(i < 0) {
+    return settings_add(key, value, value_size);
+  }
+
+  if(value_size > SETTINGS_MAX_VALUE_SIZE) {
+    return SETTINGS_STATUS_VALUE_TOO_BIG;
+  }
+
+  /* Provisioning sets the same values on every start, don't wear the
+     EEPROM for them. */
+  addr = settings_index[i].addr;
+  if(settings_iter_get_value_length(addr) == value_size) {
+    for(offset = 0; offset < value_size; offset += n) {
+      n = MIN(value_size - offset, sizeof(buf));
+      eeprom_read(addr + sizeof(record_header_t) + offset, buf, n);
+      if(memcmp(buf, value + offset, n)) {
+        break;
+      }
+    }
+    if(offset >= value_size) {
+      return SETTINGS_STATUS_OK;
+    }
+  }
+
+  if(log_end + sizeof(record_header_t) + value_size > REGION_END(region)) {
+    /* The compaction drops the old value, only the others count. */
+    if(live_size(i) + sizeof(record_header_t) + value_size <= REGION_SIZE) {
+      compact_replace(i, value, value_size);
+      return SETTINGS_STATUS_OK;
+    }
+    /* Still too full, overwrite a value of the same size in place like
+       the list backend does. */
+    if(settings_iter_get_value_length(addr) == value_size) {
+      eeprom_write(addr + sizeof(record_header_t), (uint8_t *)value,
+                   value_size);
+      return SETTINGS_STATUS_OK;
+    }
+    return SETTINGS_STATUS_OUT_OF_SPACE;
+  }
+
+  /* The new record replaces the old one with the same index. */
+  settings_index[i].addr = append_record(RECORD_VALUE, key,
+                                         settings_index[i].index,
+                                         value, 0, value_size);
+  return SETTINGS_STATUS_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+settings_status_t
+settings_delete(settings_key_t key, uint8_t index)
+{
+  int i;
+
+  if(!settings_init()) {
+    return SETTINGS_STATUS_FAILURE;
+  }
+  i = index_lookup(key, index);
+  if(i < 0) {
+    return SETTINGS_STATUS_NOT_FOUND;
+  }
+  return delete_entry(i);
+}
+
+/*---------------------------------------------------------------------------*/
+void
+settings_wipe(void)
+{
+  /* Also drops values of the list backend that could not be imported. */
+  settings_init();
+  legacy_blocked = 0;
+
+  /* The empty region supersedes the current one. */
+  start_region(region ^ 1);
+  commit_region();
+}
+
+#endif /* CONTIKI_CONF_SETTINGS_MANAGER && SETTINGS_CONF_LOG */
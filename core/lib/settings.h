@@ -80,6 +80,18 @@
  *     of the size byte (or size_low byte).
  *   * The key has a value of 0x0000.
  *
+ *  ## Log Backend ##
+ *
+ *  With SETTINGS_CONF_LOG set, settings-log.c replaces this format by a
+ *  log of records in two alternating EEPROM regions with an index of all
+ *  values in RAM. Lookups do not read the EEPROM except for the value,
+ *  updates are appended instead of rewriting cells, and setting a value
+ *  that is already stored writes nothing. Values stored in the format
+ *  above are imported on the first start if all of them fit into a
+ *  region, see SETTINGS_LEGACY_IMPORT_SIZE. Otherwise they are left in
+ *  place and the settings functions fail with SETTINGS_STATUS_FAILURE
+ *  until settings_wipe() is called.
+ *
  */
 
 #include <stdint.h>
@@ -142,6 +154,10 @@ typedef uint16_t settings_length_t;
 #define SETTINGS_CONF_SUPPORT_LARGE_VALUES  0
 #endif
 
+#ifndef SETTINGS_CONF_LOG
+#define SETTINGS_CONF_LOG  0
+#endif
+
 #if SETTINGS_CONF_SUPPORT_LARGE_VALUES
 #define SETTINGS_MAX_VALUE_SIZE    0x3FFF        /* 16383 bytes */
 #else
@@ -795,6 +795,8 @@ tcpip_uipcall(void)
 PROCESS_THREAD(tcpip_process, ev, data)
 {
   PROCESS_BEGIN();
+
+  process_set_priority(&tcpip_process, PROCESS_PRIO_URGENT);
   
 #if UIP_TCP
  {
@@ -570,6 +570,16 @@ void uip_log(char *msg);
 #define SICSLOWPAN_REASS_MAXAGE 20
 #endif
 
+/**
+ * Number of packets that are reassembled at the same time at the 6lowpan
+ * layer. Each needs a buffer of UIP_BUFSIZE bytes.
+ */
+#ifdef SICSLOWPAN_CONF_REASS_SLOTS
+#define SICSLOWPAN_REASS_SLOTS (SICSLOWPAN_CONF_REASS_SLOTS)
+#else
+#define SICSLOWPAN_REASS_SLOTS 2
+#endif
+
 /**
  * Do we compress the IP header or not (default: no)
  */
@@ -81,13 +81,11 @@ uint8_t p;
 #define PRINTFO(...) PRINTF(__VA_ARGS__)
 #define PRINTPACKETBUF() PRINTF("packetbuf buffer: "); for(p = 0; p < packetbuf_datalen(); p++){PRINTF("%.2X", *(packetbuf_ptr + p));} PRINTF("\n")
 #define PRINTUIPBUF() PRINTF("UIP buffer: "); for(p = 0; p < uip_len; p++){PRINTF("%.2X", uip_buf[p]);}PRINTF("\n")
-#define PRINTSICSLOWPANBUF() PRINTF("SICSLOWPAN buffer: "); for(p = 0; p < sicslowpan_len; p++){PRINTF("%.2X", sicslowpan_buf[p]);}PRINTF("\n")
 #else
 #define PRINTFI(...)
 #define PRINTFO(...)
 #define PRINTPACKETBUF()
 #define PRINTUIPBUF()
-#define PRINTSICSLOWPANBUF()
 #endif /* DEBUG == 1*/
 
 #if UIP_LOGGING
@@ -104,6 +102,16 @@ void uip_log(char *msg);
 #define SICSLOWPAN_MAX_MAC_TRANSMISSIONS 4
 #endif
 
+/* Number of fragments handed to NETSTACK_RDC.send_list() in one burst.
+ * The fragments bypass NETSTACK_MAC, so this is meant for MAC layers
+ * that do not queue packets themselves (nullmac). With 0 every fragment
+ * is sent through NETSTACK_MAC on its own. */
+#ifdef SICSLOWPAN_CONF_FRAG_BURST
+#define SICSLOWPAN_FRAG_BURST SICSLOWPAN_CONF_FRAG_BURST
+#else
+#define SICSLOWPAN_FRAG_BURST 0
+#endif
+
 #ifndef SICSLOWPAN_COMPRESSION
 #ifdef SICSLOWPAN_CONF_COMPRESSION
 #define SICSLOWPAN_COMPRESSION SICSLOWPAN_CONF_COMPRESSION
@@ -219,42 +227,54 @@ static int last_tx_status;
  *  @{
  */
 
-static uint16_t sicslowpan_len;
+/** Datagram tag to be put in the fragments I send. */
+static uint16_t my_tag;
+
+/** Number of 8 byte units of the largest IPv6 packet we can reassemble */
+#define REASS_UNITS ((UIP_BUFSIZE - UIP_LLH_LEN + 7) / 8)
 
 /**
- * The buffer used for the 6lowpan reassembly.
- * This buffer contains only the IPv6 packet (no MAC header, 6lowpan, etc).
- * It has a fix size as we do not use dynamic memory allocation.
+ * A buffer used for the 6lowpan reassembly.
+ * It contains only the IPv6 packet (no MAC header, 6lowpan, etc).
+ * The fragments of a packet are matched to the buffer by sender, tag
+ * and size, and may arrive in any order: the bitmap records which 8 byte
+ * units of the packet have been received.
  */
-static uip_buf_t sicslowpan_aligned_buf;
-#define sicslowpan_buf (sicslowpan_aligned_buf.u8)
-
-/** The total length of the IPv6 packet in the sicslowpan_buf. */
+struct reass_buf {
+  uip_buf_t buf;
+  /** The source address of the fragments being merged */
+  linkaddr_t sender;
+  /** The tag in the fragments being merged */
+  uint16_t tag;
+  /** The total length of the IPv6 packet, 0 if the buffer is free */
+  uint16_t size;
+  /** Length of the IPv6 packet received so far */
+  uint16_t received;
+  /** One bit per received 8 byte unit */
+  uint8_t units[(REASS_UNITS + 7) / 8];
+  /** Reassembly %process %timer. */
+  struct timer timer;
+};
 
 /**
- * length of the ip packet already sent / received.
- * It includes IP and transport headers.
+ * The reassembly buffers.
+ * They have a fix size as we do not use dynamic memory allocation.
  */
-static uint16_t processed_ip_in_len;
-
-/** Datagram tag to be put in the fragments I send. */
-static uint16_t my_tag;
-
-/** When reassembling, the tag in the fragments being merged. */
-static uint16_t reass_tag;
+static struct reass_buf reass_bufs[SICSLOWPAN_REASS_SLOTS];
 
-/** When reassembling, the source address of the fragments being merged */
-linkaddr_t frag_sender;
+struct sicslowpan_reass_stats sicslowpan_reass_stats;
 
-/** Reassembly %process %timer. */
-static struct timer reass_timer;
+/**
+ * The buffer the IPv6 packet is uncompressed to: the reassembly buffer
+ * for fragments, uip_buf for unfragmented packets.
+ */
+static uint8_t *sicslowpan_buf;
 
 /** @} */
 #else /* SICSLOWPAN_CONF_FRAG */
 /** The buffer used for the 6lowpan processing is uip_buf.
     We do not use any additional buffer.*/
 #define sicslowpan_buf uip_buf
-#define sicslowpan_len uip_len
 #endif /* SICSLOWPAN_CONF_FRAG */
 
 static int last_rssi;
@@ -1316,12 +1336,11 @@ packet_sent(void *ptr, int status, int transmissions)
 }
 /*--------------------------------------------------------------------*/
 /**
- * \brief This function is called by the 6lowpan code to send out a
- * packet.
+ * \brief Set the link layer attributes of the packet in packetbuf.
  * \param dest the link layer destination address of the packet
  */
 static void
-send_packet(linkaddr_t *dest)
+set_link_attrs(linkaddr_t *dest)
 {
   /* Set the link layer destination address for the packet as a
    * packetbuf attribute. The MAC layer can access the destination
@@ -1338,6 +1357,17 @@ send_packet(linkaddr_t *dest)
 #if SICSLOWPAN_CONF_ACK_ALL
     packetbuf_set_attr(PACKETBUF_ATTR_RELIABLE, 1);
 #endif
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief This function is called by the 6lowpan code to send out a
+ * packet.
+ * \param dest the link layer destination address of the packet
+ */
+static void
+send_packet(linkaddr_t *dest)
+{
+  set_link_attrs(dest);
 
   /* Provide a callback function to receive the result of
      a packet transmission. */
@@ -1347,6 +1377,170 @@ send_packet(linkaddr_t *dest)
      watchdog know that we are still alive. */
   watchdog_periodic();
 }
+#if SICSLOWPAN_CONF_FRAG && SICSLOWPAN_FRAG_BURST
+/*--------------------------------------------------------------------*/
+/** \name Burst transmission of fragments
+ *  @{
+ */
+/** The fragments handed to the RDC layer in one burst */
+static struct rdc_buf_list frag_burst[SICSLOWPAN_FRAG_BURST];
+/** Number of fragments in the burst, 0 if no burst is being sent */
+static uint8_t frag_burst_len;
+/** Number of fragments of the burst sent so far */
+static uint8_t frag_burst_sent;
+/** The attributes of the fragments, restored after a burst was sent */
+static struct packetbuf_attr frag_attrs[PACKETBUF_NUM_ATTRS];
+static struct packetbuf_addr frag_addrs[PACKETBUF_NUM_ADDRS];
+/*--------------------------------------------------------------------*/
+/**
+ * Callback function for the RDC packet sent callback of a fragment of
+ * the burst. The RDC layer stops the burst at the first fragment that
+ * was not sent, the queuebufs are freed once it is done.
+ */
+static void
+burst_sent(void *ptr, int status, int transmissions)
+{
+  packet_sent(ptr, status, transmissions);
+
+  if(status != MAC_TX_OK || ++frag_burst_sent == frag_burst_len) {
+    while(frag_burst_len > 0) {
+      queuebuf_free(frag_burst[--frag_burst_len].buf);
+    }
+    frag_burst_sent = 0;
+  }
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief Add the fragment in packetbuf to the burst.
+ * \return 0 if the burst is full or no queuebuf is left
+ */
+static int
+add_to_burst(void)
+{
+  struct rdc_buf_list *f;
+
+  if(frag_burst_len == SICSLOWPAN_FRAG_BURST) {
+    return 0;
+  }
+  f = &frag_burst[frag_burst_len];
+  f->buf = queuebuf_new_from_packetbuf();
+  if(f->buf == NULL) {
+    return 0;
+  }
+  f->next = NULL;
+  f->ptr = NULL;
+  if(frag_burst_len > 0) {
+    frag_burst[frag_burst_len - 1].next = f;
+  }
+  frag_burst_len++;
+  return 1;
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief Hand the burst to the RDC layer.
+ * \param last 1 if the burst contains the last fragment of the packet
+ * \return 0 if the remaining fragments cannot be sent
+ */
+static int
+send_burst(uint8_t last)
+{
+  PRINTFO("sicslowpan output: burst of %d fragments\n", frag_burst_len);
+  NETSTACK_RDC.send_list(burst_sent, NULL, frag_burst);
+  watchdog_periodic();
+
+  if(frag_burst_len > 0) {
+    /* The RDC layer sends the burst later (e.g. ContikiMAC phase
+       optimization), we cannot reuse the queuebufs until then. */
+    if(!last) {
+      PRINTFO("burst deferred, dropping subsequent fragments.\n");
+    }
+    return last;
+  }
+  if(last_tx_status != MAC_TX_OK) {
+    PRINTFO("error in fragment tx, dropping subsequent fragments.\n");
+    return 0;
+  }
+
+  /* The RDC layer used packetbuf, prepare it for the next fragments */
+  packetbuf_clear();
+  packetbuf_attr_copyfrom(frag_attrs, frag_addrs);
+  packetbuf_ptr = packetbuf_dataptr();
+  return 1;
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief Send the fragments of the IP packet in uip_buf in bursts.
+ * \param dest the link layer destination address of the packet
+ * \param framer_hdrlen the length of the link layer header
+ * \param tag the datagram tag of the packet
+ * \return 0 if the packet was dropped
+ *
+ * The first fragment is in packetbuf. Every fragment is built in a pbuf
+ * of its own if one is free, so that its queuebuf only references it,
+ * and copied into the queuebuf otherwise. The fragments are handed to
+ * NETSTACK_RDC.send_list(), which may send them in a single burst.
+ * If we run out of queuebufs, the fragments queued so far are sent
+ * before the next ones are built.
+ */
+static uint8_t
+send_fragments(linkaddr_t *dest, int framer_hdrlen, uint16_t tag)
+{
+  uint16_t processed_ip_out_len;
+  uint16_t len;
+
+  if(frag_burst_len > 0) {
+    PRINTFO("sicslowpan output: previous burst not sent yet, dropping packet\n");
+    return 0;
+  }
+
+  set_link_attrs(dest);
+  packetbuf_attr_copyto(frag_attrs, frag_addrs);
+  if(!add_to_burst()) {
+    PRINTFO("could not allocate queuebuf for first fragment, dropping packet\n");
+    return 0;
+  }
+
+  /* set processed_ip_out_len to what we already sent from the IP payload*/
+  processed_ip_out_len = packetbuf_payload_len + uncomp_hdr_len;
+
+  len = (MAC_MAX_PAYLOAD - framer_hdrlen - SICSLOWPAN_FRAGN_HDR_LEN) & 0xfff8;
+  while(processed_ip_out_len < uip_len) {
+    if(uip_len - processed_ip_out_len < len) {
+      /* last fragment */
+      len = uip_len - processed_ip_out_len;
+    }
+    PRINTFO("sicslowpan output: fragment (offset %d, len %d, tag %d)\n",
+            processed_ip_out_len >> 3, len, tag);
+    /* The previous fragment may be shared with its queuebuf */
+    packetbuf_attach_new();
+    packetbuf_attr_copyfrom(frag_attrs, frag_addrs);
+    packetbuf_ptr = packetbuf_dataptr();
+    SET16(PACKETBUF_FRAG_PTR, PACKETBUF_FRAG_DISPATCH_SIZE,
+          ((SICSLOWPAN_DISPATCH_FRAGN << 8) | uip_len));
+    SET16(PACKETBUF_FRAG_PTR, PACKETBUF_FRAG_TAG, tag);
+    PACKETBUF_FRAG_PTR[PACKETBUF_FRAG_OFFSET] = processed_ip_out_len >> 3;
+    memcpy(packetbuf_ptr + SICSLOWPAN_FRAGN_HDR_LEN,
+           (uint8_t *)UIP_IP_BUF + processed_ip_out_len, len);
+    packetbuf_set_datalen(len + SICSLOWPAN_FRAGN_HDR_LEN);
+
+    if(!add_to_burst()) {
+      if(frag_burst_len == 0) {
+        PRINTFO("could not allocate queuebuf, dropping fragment\n");
+        return 0;
+      }
+      /* Send what we have, then build this fragment again */
+      if(!send_burst(0)) {
+        return 0;
+      }
+      continue;
+    }
+    processed_ip_out_len += len;
+  }
+
+  return send_burst(1);
+}
+/** @} */
+#endif /* SICSLOWPAN_CONF_FRAG && SICSLOWPAN_FRAG_BURST */
 /*--------------------------------------------------------------------*/
 /** \brief Take an IP packet and format it to be sent on an 802.15.4
  *  network using 6lowpan.
@@ -1365,15 +1559,18 @@ output(const uip_lladdr_t *localdest)
   /* The MAC address of the destination of the packet */
   linkaddr_t dest;
 
+#if SICSLOWPAN_CONF_FRAG && !SICSLOWPAN_FRAG_BURST
   /* Number of bytes processed. */
   uint16_t processed_ip_out_len;
+#endif /* SICSLOWPAN_CONF_FRAG && !SICSLOWPAN_FRAG_BURST */
 
   /* init */
   uncomp_hdr_len = 0;
   packetbuf_hdr_len = 0;
 
-  /* reset packetbuf buffer */
-  packetbuf_clear();
+  /* reset packetbuf buffer, build the packet in a pbuf if one is free so
+     that the lower layers can queue and send it without copying */
+  packetbuf_attach_new();
   packetbuf_ptr = packetbuf_dataptr();
 
   packetbuf_set_attr(PACKETBUF_ATTR_MAX_MAC_TRANSMISSIONS,
@@ -1446,7 +1643,9 @@ output(const uip_lladdr_t *localdest)
 
   if((int)uip_len - (int)uncomp_hdr_len > (int)MAC_MAX_PAYLOAD - framer_hdrlen - (int)packetbuf_hdr_len) {
 #if SICSLOWPAN_CONF_FRAG
+#if !SICSLOWPAN_FRAG_BURST
     struct queuebuf *q;
+#endif /* !SICSLOWPAN_FRAG_BURST */
     /*
      * The outbound IPv6 packet is too large to fit into a single 15.4
      * packet, so we fragment it into multiple packets and send them.
@@ -1457,6 +1656,13 @@ output(const uip_lladdr_t *localdest)
 
     PRINTFO("Fragmentation sending packet len %d\n", uip_len);
 
+#if !SICSLOWPAN_FRAG_BURST
+    /* The fragments are built one after the other in place, which must
+       not happen in a pbuf that a queuebuf shares */
+    packetbuf_detach();
+    packetbuf_ptr = packetbuf_dataptr();
+#endif /* !SICSLOWPAN_FRAG_BURST */
+
     /* Create 1st Fragment */
     PRINTFO("sicslowpan output: 1rst fragment ");
 
@@ -1482,6 +1688,9 @@ output(const uip_lladdr_t *localdest)
     memcpy(packetbuf_ptr + packetbuf_hdr_len,
            (uint8_t *)UIP_IP_BUF + uncomp_hdr_len, packetbuf_payload_len);
     packetbuf_set_datalen(packetbuf_payload_len + packetbuf_hdr_len);
+#if SICSLOWPAN_FRAG_BURST
+    return send_fragments(&dest, framer_hdrlen, my_tag - 1);
+#else /* SICSLOWPAN_FRAG_BURST */
     q = queuebuf_new_from_packetbuf();
     if(q == NULL) {
       PRINTFO("could not allocate queuebuf for first fragment, dropping packet\n");
@@ -1547,6 +1756,7 @@ output(const uip_lladdr_t *localdest)
         return 0;
       }
     }
+#endif /* SICSLOWPAN_FRAG_BURST */
 #else /* SICSLOWPAN_CONF_FRAG */
     PRINTFO("sicslowpan output: Packet too large to be sent without fragmentation support; dropping packet\n");
     return 0;
@@ -1565,6 +1775,108 @@ output(const uip_lladdr_t *localdest)
   return 1;
 }
 
+#if SICSLOWPAN_CONF_FRAG
+/*--------------------------------------------------------------------*/
+/** \brief Find the reassembly buffer of a fragment.
+ *  \param tag The datagram tag of the fragment
+ *  \param size The datagram size of the fragment
+ *  \return The buffer, NULL if the fragment cannot be reassembled
+ *
+ *  The fragment belongs to the buffer with the same sender, tag and
+ *  size. If there is none, a free buffer is initialized for it.
+ *  Buffers whose reassembly timed out are freed on the way.
+ */
+static struct reass_buf *
+reass_lookup(uint16_t tag, uint16_t size)
+{
+  const linkaddr_t *sender = packetbuf_addr(PACKETBUF_ADDR_SENDER);
+  struct reass_buf *r, *free_buf = NULL, *oldest = NULL;
+
+  for(r = reass_bufs; r < &reass_bufs[SICSLOWPAN_REASS_SLOTS]; r++) {
+    if(r->size != 0 && timer_expired(&r->timer)) {
+      PRINTFI("sicslowpan input: reassembly of tag %d timed out\n", r->tag);
+      r->size = 0;
+      sicslowpan_reass_stats.timeouts++;
+    }
+    if(r->size == 0) {
+      if(free_buf == NULL) {
+        free_buf = r;
+      }
+    } else if(r->tag == tag && r->size == size &&
+              linkaddr_cmp(&r->sender, sender)) {
+      return r;
+    } else if(oldest == NULL ||
+              timer_remaining(&r->timer) < timer_remaining(&oldest->timer)) {
+      oldest = r;
+    }
+  }
+
+  if(free_buf == NULL) {
+    /* All buffers are busy reassembling other packets. We can either
+     * ignore this fragment and hope to receive the rest of the
+     * under-reassembly packets, or we can discard the oldest packet and
+     * start reassembling the new one.
+     *
+     * We discard the oldest packet. This lessens the negative impacts of
+     * too high SICSLOWPAN_REASS_MAXAGE.
+     */
+#define PRIORITIZE_NEW_PACKETS 1
+#if PRIORITIZE_NEW_PACKETS
+    PRINTFI("sicslowpan input: dropping reassembly of tag %d\n", oldest->tag);
+    free_buf = oldest;
+    sicslowpan_reass_stats.evicted++;
+#else /* PRIORITIZE_NEW_PACKETS */
+    PRINTFI("sicslowpan input: no reassembly buffer for tag %d\n", tag);
+    sicslowpan_reass_stats.nobuf++;
+    return NULL;
+#endif /* PRIORITIZE_NEW_PACKETS */
+  }
+
+  free_buf->size = size;
+  free_buf->tag = tag;
+  free_buf->received = 0;
+  memset(free_buf->units, 0, sizeof(free_buf->units));
+  linkaddr_copy(&free_buf->sender, sender);
+  timer_set(&free_buf->timer, SICSLOWPAN_REASS_MAXAGE * CLOCK_SECOND / 16);
+  PRINTFI("sicslowpan input: INIT FRAGMENTATION (len %d, tag %d)\n",
+          size, tag);
+  return free_buf;
+}
+/*--------------------------------------------------------------------*/
+/** \brief Record the part of the IPv6 packet a fragment carries.
+ *  \param r The reassembly buffer
+ *  \param offset Offset of the fragment in the IPv6 packet
+ *  \param len Length of the (uncompressed) fragment
+ *  \return 0 if the fragment is a duplicate or overlaps a fragment
+ *  received before, 1 otherwise
+ */
+static int
+reass_mark(struct reass_buf *r, uint16_t offset, uint16_t len)
+{
+  uint16_t unit, end;
+
+  /* For the last fragment, we are OK if there is extrenous bytes at
+     the end of the packet. */
+  end = offset + len;
+  if(end > r->size) {
+    end = r->size;
+  }
+  if(offset >= end) {
+    return 0;
+  }
+
+  for(unit = offset >> 3; unit < (end + 7) >> 3; unit++) {
+    if(r->units[unit >> 3] & (1 << (unit & 7))) {
+      return 0;
+    }
+  }
+  for(unit = offset >> 3; unit < (end + 7) >> 3; unit++) {
+    r->units[unit >> 3] |= 1 << (unit & 7);
+  }
+  r->received += end - offset;
+  return 1;
+}
+#endif /* SICSLOWPAN_CONF_FRAG */
 /*--------------------------------------------------------------------*/
 /** \brief Process a received 6lowpan packet.
  *  \param r The MAC layer
@@ -1572,11 +1884,13 @@ output(const uip_lladdr_t *localdest)
  *  The 6lowpan packet is put in packetbuf by the MAC. If its a frag1 or
  *  a non-fragmented packet we first uncompress the IP header. The
  *  6lowpan payload and possibly the uncompressed IP header are then
- *  copied in siclowpan_buf. If the IP packet is complete it is copied
- *  to uip_buf and the IP layer is called.
+ *  copied in the reassembly buffer of the fragment, or in uip_buf if the
+ *  packet is not fragmented. If the IP packet is complete the IP layer
+ *  is called.
  *
- * \note We do not check for overlapping sicslowpan fragments
- * (it is a SHALL in the RFC 4944 and should never happen)
+ *  Fragments are accepted in any order. Duplicate and overlapping
+ *  fragments are dropped. The size and offset of a fragment are checked
+ *  before it gets a reassembly buffer.
  */
 static void
 input(void)
@@ -1585,11 +1899,12 @@ input(void)
   uint16_t frag_size = 0;
   /* offset of the fragment in the IP packet */
   uint8_t frag_offset = 0;
-  uint8_t is_fragment = 0;
 #if SICSLOWPAN_CONF_FRAG
+  uint8_t is_fragment = 0;
   /* tag of the fragment */
   uint16_t frag_tag = 0;
-  uint8_t first_fragment = 0, last_fragment = 0;
+  /* reassembly buffer of the fragment */
+  struct reass_buf *reass = NULL;
 #endif /*SICSLOWPAN_CONF_FRAG*/
 
   /* init */
@@ -1603,11 +1918,6 @@ input(void)
      want to query us for it later. */
   last_rssi = (signed short)packetbuf_attr(PACKETBUF_ATTR_RSSI);
 #if SICSLOWPAN_CONF_FRAG
-  /* if reassembly timed out, cancel it */
-  if(timer_expired(&reass_timer)) {
-    sicslowpan_len = 0;
-    processed_ip_in_len = 0;
-  }
   /*
    * Since we don't support the mesh and broadcast header, the first header
    * we look for is the fragmentation header
@@ -1623,8 +1933,6 @@ input(void)
       PRINTFI("size %d, tag %d, offset %d)\n",
              frag_size, frag_tag, frag_offset);
       packetbuf_hdr_len += SICSLOWPAN_FRAG1_HDR_LEN;
-      /*      printf("frag1 %d %d\n", reass_tag, frag_tag);*/
-      first_fragment = 1;
       is_fragment = 1;
       break;
     case SICSLOWPAN_DISPATCH_FRAGN:
@@ -1639,78 +1947,25 @@ input(void)
       PRINTFI("size %d, tag %d, offset %d)\n",
              frag_size, frag_tag, frag_offset);
       packetbuf_hdr_len += SICSLOWPAN_FRAGN_HDR_LEN;
-
-      /* If this is the last fragment, we may shave off any extrenous
-         bytes at the end. We must be liberal in what we accept. */
-      PRINTFI("last_fragment?: processed_ip_in_len %d packetbuf_payload_len %d frag_size %d\n",
-              processed_ip_in_len, packetbuf_datalen() - packetbuf_hdr_len, frag_size);
-
-      if(processed_ip_in_len + packetbuf_datalen() - packetbuf_hdr_len >= frag_size) {
-        last_fragment = 1;
-      }
       is_fragment = 1;
       break;
     default:
       break;
   }
 
-  /* We are currently reassembling a packet, but have just received the first
-   * fragment of another packet. We can either ignore it and hope to receive
-   * the rest of the under-reassembly packet fragments, or we can discard the
-   * previous packet altogether, and start reassembling the new packet.
-   *
-   * We discard the previous packet, and start reassembling the new packet.
-   * This lessens the negative impacts of too high SICSLOWPAN_REASS_MAXAGE.
-   */
-#define PRIORITIZE_NEW_PACKETS 1
-#if PRIORITIZE_NEW_PACKETS
-
-  if(!is_fragment) {
-    /* Prioritize non-fragment packets too. */
-    sicslowpan_len = 0;
-    processed_ip_in_len = 0;
-  } else if(processed_ip_in_len > 0 && first_fragment
-      && !linkaddr_cmp(&frag_sender, packetbuf_addr(PACKETBUF_ADDR_SENDER))) {
-    sicslowpan_len = 0;
-    processed_ip_in_len = 0;
+  if(is_fragment &&
+     (frag_size == 0 || frag_size > UIP_BUFSIZE - UIP_LLH_LEN ||
+      (uint16_t)(frag_offset << 3) >= frag_size)) {
+    PRINTFI("sicslowpan input: Dropping fragment of invalid size %d or offset %d\n",
+            frag_size, frag_offset);
+    sicslowpan_reass_stats.invalid++;
+    return;
   }
-#endif /* PRIORITIZE_NEW_PACKETS */
-
-  if(processed_ip_in_len > 0) {
-    /* reassembly is ongoing */
-    /*    printf("frag %d %d\n", reass_tag, frag_tag);*/
-    if((frag_size > 0 &&
-        (frag_size != sicslowpan_len ||
-         reass_tag  != frag_tag ||
-         !linkaddr_cmp(&frag_sender, packetbuf_addr(PACKETBUF_ADDR_SENDER))))  ||
-       frag_size == 0) {
-      /*
-       * the packet is a fragment that does not belong to the packet
-       * being reassembled or the packet is not a fragment.
-       */
-      PRINTFI("sicslowpan input: Dropping 6lowpan packet that is not a fragment of the packet currently being reassembled\n");
-      return;
-    }
-  } else {
-    /*
-     * reassembly is off
-     * start it if we received a fragment
-     */
-    if((frag_size > 0) && (frag_size <= UIP_BUFSIZE)) {
-      /* We are currently not reassembling a packet, but have received a packet fragment
-       * that is not the first one. */
-      if(is_fragment && !first_fragment) {
-        return;
-      }
 
-      sicslowpan_len = frag_size;
-      reass_tag = frag_tag;
-      timer_set(&reass_timer, SICSLOWPAN_REASS_MAXAGE * CLOCK_SECOND / 16);
-      PRINTFI("sicslowpan input: INIT FRAGMENTATION (len %d, tag %d)\n",
-             sicslowpan_len, reass_tag);
-      linkaddr_copy(&frag_sender, packetbuf_addr(PACKETBUF_ADDR_SENDER));
-    }
-  }
+  /* Uncompress to uip_buf. A fragment is moved to its reassembly buffer
+     only once it is validated, so an invalid fragment neither claims a
+     buffer nor evicts a packet under reassembly. */
+  sicslowpan_buf = uip_buf;
 
   if(packetbuf_hdr_len == SICSLOWPAN_FRAGN_HDR_LEN) {
     /* this is a FRAGN, skip the header compression dispatch section */
@@ -1771,77 +2026,84 @@ input(void)
   {
     int req_size = UIP_LLH_LEN + uncomp_hdr_len + (uint16_t)(frag_offset << 3)
         + packetbuf_payload_len;
-    if(req_size > sizeof(sicslowpan_buf)) {
+    if(req_size > UIP_BUFSIZE) {
       PRINTF(
           "SICSLOWPAN: packet dropped, minimum required SICSLOWPAN_IP_BUF size: %d+%d+%d+%d=%d (current size: %d)\n",
           UIP_LLH_LEN, uncomp_hdr_len, (uint16_t)(frag_offset << 3),
-          packetbuf_payload_len, req_size, sizeof(sicslowpan_buf));
+          packetbuf_payload_len, req_size, UIP_BUFSIZE);
+#if SICSLOWPAN_CONF_FRAG
+      if(is_fragment) {
+        sicslowpan_reass_stats.invalid++;
+      }
+#endif /* SICSLOWPAN_CONF_FRAG */
       return;
     }
   }
 
-  memcpy((uint8_t *)SICSLOWPAN_IP_BUF + uncomp_hdr_len + (uint16_t)(frag_offset << 3), packetbuf_ptr + packetbuf_hdr_len, packetbuf_payload_len);
-  
-  /* update processed_ip_in_len if fragment, sicslowpan_len otherwise */
-
 #if SICSLOWPAN_CONF_FRAG
-  if(frag_size > 0) {
-    /* Add the size of the header only for the first fragment. */
-    if(first_fragment != 0) {
-      processed_ip_in_len += uncomp_hdr_len;
+  if(is_fragment) {
+    if(uncomp_hdr_len + packetbuf_payload_len == 0) {
+      PRINTFI("sicslowpan input: Dropping empty fragment (tag %d)\n", frag_tag);
+      sicslowpan_reass_stats.invalid++;
+      return;
     }
-    /* For the last fragment, we are OK if there is extrenous bytes at
-       the end of the packet. */
-    if(last_fragment != 0) {
-      processed_ip_in_len = frag_size;
-    } else {
-      processed_ip_in_len += packetbuf_payload_len;
+    reass = reass_lookup(frag_tag, frag_size);
+    if(reass == NULL) {
+      return;
     }
-    PRINTF("processed_ip_in_len %d, packetbuf_payload_len %d\n", processed_ip_in_len, packetbuf_payload_len);
-
-  } else {
-#endif /* SICSLOWPAN_CONF_FRAG */
-    sicslowpan_len = packetbuf_payload_len + uncomp_hdr_len;
-#if SICSLOWPAN_CONF_FRAG
+    if(!reass_mark(reass, (uint16_t)(frag_offset << 3),
+                   uncomp_hdr_len + packetbuf_payload_len)) {
+      PRINTFI("sicslowpan input: Dropping duplicate fragment (tag %d, offset %d)\n",
+              frag_tag, frag_offset);
+      sicslowpan_reass_stats.duplicates++;
+      return;
+    }
+    /* Move the uncompressed headers of a first fragment along */
+    sicslowpan_buf = reass->buf.u8;
+    memcpy(SICSLOWPAN_IP_BUF, UIP_IP_BUF, uncomp_hdr_len);
   }
+#endif /* SICSLOWPAN_CONF_FRAG */
 
-  /*
-   * If we have a full IP packet in sicslowpan_buf, deliver it to
-   * the IP stack
-   */
-  PRINTF("sicslowpan_init processed_ip_in_len %d, sicslowpan_len %d\n",
-         processed_ip_in_len, sicslowpan_len);
-  if(processed_ip_in_len == 0 || (processed_ip_in_len == sicslowpan_len)) {
-    PRINTFI("sicslowpan input: IP packet ready (length %d)\n",
-           sicslowpan_len);
-    memcpy((uint8_t *)UIP_IP_BUF, (uint8_t *)SICSLOWPAN_IP_BUF, sicslowpan_len);
-    uip_len = sicslowpan_len;
-    sicslowpan_len = 0;
-    processed_ip_in_len = 0;
+  memcpy((uint8_t *)SICSLOWPAN_IP_BUF + uncomp_hdr_len + (uint16_t)(frag_offset << 3), packetbuf_ptr + packetbuf_hdr_len, packetbuf_payload_len);
+
+#if SICSLOWPAN_CONF_FRAG
+  if(is_fragment) {
+    PRINTF("received %d of %d\n", reass->received, reass->size);
+    if(reass->received < reass->size) {
+      /* Wait for the other fragments */
+      return;
+    }
+    /* We have a full IP packet in the reassembly buffer */
+    PRINTFI("sicslowpan input: IP packet ready (length %d)\n", reass->size);
+    memcpy((uint8_t *)UIP_IP_BUF, (uint8_t *)SICSLOWPAN_IP_BUF, reass->size);
+    uip_len = reass->size;
+    reass->size = 0;
+    sicslowpan_reass_stats.reassembled++;
+  } else
 #endif /* SICSLOWPAN_CONF_FRAG */
+  {
+    uip_len = packetbuf_payload_len + uncomp_hdr_len;
+  }
 
 #if DEBUG
-    {
-      uint16_t ndx;
-      PRINTF("after decompression %u:", SICSLOWPAN_IP_BUF->len[1]);
-      for (ndx = 0; ndx < SICSLOWPAN_IP_BUF->len[1] + 40; ndx++) {
-        uint8_t data = ((uint8_t *) (SICSLOWPAN_IP_BUF))[ndx];
-        PRINTF("%02x", data);
-      }
-      PRINTF("\n");
+  {
+    uint16_t ndx;
+    PRINTF("after decompression %u:", UIP_IP_BUF->len[1]);
+    for (ndx = 0; ndx < UIP_IP_BUF->len[1] + 40; ndx++) {
+      uint8_t data = ((uint8_t *) (UIP_IP_BUF))[ndx];
+      PRINTF("%02x", data);
     }
+    PRINTF("\n");
+  }
 #endif
 
-    /* if callback is set then set attributes and call */
-    if(callback) {
-      set_packet_attrs();
-      callback->input_callback();
-    }
-
-    tcpip_input();
-#if SICSLOWPAN_CONF_FRAG
+  /* if callback is set then set attributes and call */
+  if(callback) {
+    set_packet_attrs();
+    callback->input_callback();
   }
-#endif /* SICSLOWPAN_CONF_FRAG */
+
+  tcpip_input();
 }
 /** @} */
 
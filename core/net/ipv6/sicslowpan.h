@@ -320,6 +320,22 @@ struct sicslowpan_nh_compressor {
 
 int sicslowpan_get_last_rssi(void);
 
+#if SICSLOWPAN_CONF_FRAG
+/**
+ * Counters of the fragment reassembly.
+ */
+struct sicslowpan_reass_stats {
+  uint16_t reassembled; /**< Packets reassembled and passed to the IP layer */
+  uint16_t timeouts;    /**< Packets dropped after SICSLOWPAN_REASS_MAXAGE */
+  uint16_t evicted;     /**< Packets dropped to reassemble a newer one */
+  uint16_t nobuf;       /**< Fragments dropped as all buffers were busy */
+  uint16_t duplicates;  /**< Duplicate or overlapping fragments dropped */
+  uint16_t invalid;     /**< Fragments dropped for an invalid size */
+};
+
+extern struct sicslowpan_reass_stats sicslowpan_reass_stats;
+#endif /* SICSLOWPAN_CONF_FRAG */
+
 extern const struct network_driver sicslowpan_driver;
 
 #endif /* SICSLOWPAN_H_ */
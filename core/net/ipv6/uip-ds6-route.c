@@ -65,6 +65,23 @@ LIST(notificationlist);
 
 static int num_routes = 0;
 
+/* The routes are indexed for uip_ds6_route_lookup(): host routes (/128)
+   are hashed on their interface identifier, all other routes are kept
+   on the prefix list, longest prefix first. Both link their routes
+   through the index_next field. */
+static uip_ds6_route_t *hostroutes[UIP_DS6_ROUTE_HASH_SIZE];
+static uip_ds6_route_t *prefixroutes;
+
+/* The result of the last lookup. Packets tend to come in flows, so the
+   next lookup is often for the same address. */
+static uip_ds6_route_t *last_route;
+static uip_ipaddr_t last_route_addr;
+
+/* Counts the lookups, the route with the oldest last_used value is the
+   least recently used one. 32 bits, so that the ages stay unambiguous
+   over the lifetime of a node. */
+static uint32_t lookup_count;
+
 #undef DEBUG
 #define DEBUG DEBUG_NONE
 #include "net/ip/uip-debug.h"
@@ -136,11 +153,87 @@ uip_ds6_notification_rm(struct uip_ds6_notification *n)
 }
 #endif
 /*---------------------------------------------------------------------------*/
+static uint8_t
+route_hash(const uip_ipaddr_t *addr)
+{
+  uint8_t i;
+  uint8_t hash = 0;
+
+  for(i = 8; i < sizeof(uip_ipaddr_t); i++) {
+    hash = ((hash << 1) | (hash >> 7)) ^ addr->u8[i];
+  }
+  return hash & (UIP_DS6_ROUTE_HASH_SIZE - 1);
+}
+/*---------------------------------------------------------------------------*/
+static uip_ds6_route_t **
+index_chain(uip_ds6_route_t *route)
+{
+  if(route->length == 128) {
+    return &hostroutes[route_hash(&route->ipaddr)];
+  }
+  return &prefixroutes;
+}
+/*---------------------------------------------------------------------------*/
+static void
+index_add(uip_ds6_route_t *route)
+{
+  uip_ds6_route_t **r;
+
+  /* The prefix list is sorted by decreasing prefix length, so the first
+     match is the longest. Host routes are all of the same length. */
+  for(r = index_chain(route);
+      *r != NULL && (*r)->length > route->length;
+      r = &(*r)->index_next);
+  route->index_next = *r;
+  *r = route;
+
+  /* The new route may be a better match for the last lookup */
+  last_route = NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+index_rm(uip_ds6_route_t *route)
+{
+  uip_ds6_route_t **r;
+
+  for(r = index_chain(route);
+      *r != NULL && *r != route;
+      r = &(*r)->index_next);
+  if(*r != NULL) {
+    *r = route->index_next;
+  }
+
+  if(last_route == route) {
+    last_route = NULL;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static uip_ds6_route_t *
+index_lookup(uip_ipaddr_t *addr)
+{
+  uip_ds6_route_t *r;
+
+  for(r = hostroutes[route_hash(addr)]; r != NULL; r = r->index_next) {
+    if(uip_ipaddr_cmp(addr, &r->ipaddr)) {
+      return r;
+    }
+  }
+  for(r = prefixroutes; r != NULL; r = r->index_next) {
+    if(uip_ipaddr_prefixcmp(addr, &r->ipaddr, r->length)) {
+      return r;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
 void
 uip_ds6_route_init(void)
 {
   memb_init(&routememb);
   list_init(routelist);
+  memset(hostroutes, 0, sizeof(hostroutes));
+  prefixroutes = NULL;
+  last_route = NULL;
   nbr_table_register(nbr_routes,
                      (nbr_table_callback *)rm_routelist_callback);
 
@@ -152,11 +245,11 @@ uip_ds6_route_init(void)
 #endif
 }
 /*---------------------------------------------------------------------------*/
-static uip_lladdr_t *
+static const uip_lladdr_t *
 uip_ds6_route_nexthop_lladdr(uip_ds6_route_t *route)
 {
   if(route != NULL) {
-    return (uip_lladdr_t *)nbr_table_get_lladdr(nbr_routes,
+    return (const uip_lladdr_t *)nbr_table_get_lladdr(nbr_routes,
                                                 route->neighbor_routes);
   } else {
     return NULL;
@@ -198,24 +291,19 @@ uip_ds6_route_num_routes(void)
 uip_ds6_route_t *
 uip_ds6_route_lookup(uip_ipaddr_t *addr)
 {
-  uip_ds6_route_t *r;
   uip_ds6_route_t *found_route;
-  uint8_t longestmatch;
 
   PRINTF("uip-ds6-route: Looking up route for ");
   PRINT6ADDR(addr);
   PRINTF("\n");
 
-
-  found_route = NULL;
-  longestmatch = 0;
-  for(r = uip_ds6_route_head();
-      r != NULL;
-      r = uip_ds6_route_next(r)) {
-    if(r->length >= longestmatch &&
-       uip_ipaddr_prefixcmp(addr, &r->ipaddr, r->length)) {
-      longestmatch = r->length;
-      found_route = r;
+  if(last_route != NULL && uip_ipaddr_cmp(addr, &last_route_addr)) {
+    found_route = last_route;
+  } else {
+    found_route = index_lookup(addr);
+    if(found_route != NULL) {
+      last_route = found_route;
+      uip_ipaddr_copy(&last_route_addr, addr);
     }
   }
 
@@ -225,19 +313,14 @@ uip_ds6_route_lookup(uip_ipaddr_t *addr)
     PRINTF(" via ");
     PRINT6ADDR(uip_ds6_route_nexthop(found_route));
     PRINTF("\n");
+
+    /* Remember when we looked the route up, the least recently used
+       route is the first to be dropped when the table is full. */
+    found_route->last_used = ++lookup_count;
   } else {
     PRINTF("uip-ds6-route: No route found\n");
   }
 
-  if(found_route != NULL) {
-    /* If we found a route, we put it at the end of the routeslist
-       list. The list is ordered by how recently we looked them up:
-       the least recently used route will be at the start of the
-       list. */
-    list_remove(routelist, found_route);
-    list_add(routelist, found_route);
-  }
-
   return found_route;
 }
 /*---------------------------------------------------------------------------*/
@@ -279,10 +362,19 @@ uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
 
     if(uip_ds6_route_num_routes() == UIP_DS6_ROUTE_NB) {
       /* Removing the oldest route entry from the route table. The
-         least recently used route is the first route on the list. */
+         least recently used route is the one that was looked up the
+         most lookups ago. */
       uip_ds6_route_t *oldest;
 
       oldest = uip_ds6_route_head();
+      for(r = uip_ds6_route_next(oldest);
+          r != NULL;
+          r = uip_ds6_route_next(r)) {
+        if(lookup_count - r->last_used >
+           lookup_count - oldest->last_used) {
+          oldest = r;
+        }
+      }
       PRINTF("uip_ds6_route_add: dropping route to ");
       PRINT6ADDR(&oldest->ipaddr);
       PRINTF("\n");
@@ -350,6 +442,8 @@ uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
 
   uip_ipaddr_copy(&(r->ipaddr), ipaddr);
   r->length = length;
+  r->last_used = lookup_count;
+  index_add(r);
 
 #ifdef UIP_DS6_ROUTE_STATE_TYPE
   memset(&r->state, 0, sizeof(UIP_DS6_ROUTE_STATE_TYPE));
@@ -388,6 +482,7 @@ uip_ds6_route_rm(uip_ds6_route_t *route)
 
     /* Remove the neighbor from the route list */
     list_remove(routelist, route);
+    index_rm(route);
 
     /* Find the corresponding neighbor_route and remove it. */
     for(neighbor_route = list_head(route->neighbor_routes->route_list);
@@ -80,6 +80,20 @@ void uip_ds6_notification_rm(struct uip_ds6_notification *n);
 #define UIP_DS6_ROUTE_NB UIP_CONF_MAX_ROUTES
 #endif /* UIP_CONF_MAX_ROUTES */
 
+/* Number of hash buckets for the host (/128) routes, a power of two
+   up to 256 */
+#ifdef UIP_CONF_DS6_ROUTE_HASH_SIZE
+#define UIP_DS6_ROUTE_HASH_SIZE UIP_CONF_DS6_ROUTE_HASH_SIZE
+#elif UIP_DS6_ROUTE_NB > 128
+#define UIP_DS6_ROUTE_HASH_SIZE 128
+#elif UIP_DS6_ROUTE_NB > 32
+#define UIP_DS6_ROUTE_HASH_SIZE 32
+#elif UIP_DS6_ROUTE_NB > 8
+#define UIP_DS6_ROUTE_HASH_SIZE 8
+#else
+#define UIP_DS6_ROUTE_HASH_SIZE 2
+#endif
+
 /** \brief define some additional RPL related route state and
  *  neighbor callback for RPL - if not a DS6_ROUTE_STATE is already set */
 #ifndef UIP_DS6_ROUTE_STATE_TYPE
@@ -108,10 +122,15 @@ typedef struct uip_ds6_route {
      belong to the neighbor table entry that this routing table entry
      uses. */
   struct uip_ds6_route_neighbor_routes *neighbor_routes;
+  /* Next route in the same hash bucket or on the prefix list of the
+     route index. */
+  struct uip_ds6_route *index_next;
   uip_ipaddr_t ipaddr;
 #ifdef UIP_DS6_ROUTE_STATE_TYPE
   UIP_DS6_ROUTE_STATE_TYPE state;
 #endif
+  /* Lookup count when the route was last used, for the LRU eviction */
+  uint32_t last_used;
   uint8_t length;
 } uip_ds6_route_t;
 
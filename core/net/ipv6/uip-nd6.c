@@ -189,11 +189,13 @@ ns_input(void)
 			  (uip_lladdr_t *)&nd6_opt_llao[UIP_ND6_OPT_DATA_OFFSET],
 			  0, NBR_STALE);
         } else {
-          uip_lladdr_t *lladdr = (uip_lladdr_t *)uip_ds6_nbr_get_ll(nbr);
+          const uip_lladdr_t *lladdr = uip_ds6_nbr_get_ll(nbr);
           if(memcmp(&nd6_opt_llao[UIP_ND6_OPT_DATA_OFFSET],
 		    lladdr, UIP_LLADDR_LEN) != 0) {
-            memcpy(lladdr, &nd6_opt_llao[UIP_ND6_OPT_DATA_OFFSET],
-		   UIP_LLADDR_LEN);
+            if(nbr_table_update_lladdr(ds6_neighbors, nbr,
+                 (const linkaddr_t *)&nd6_opt_llao[UIP_ND6_OPT_DATA_OFFSET]) == 0) {
+              goto discard;
+            }
             nbr->state = NBR_STALE;
           } else {
             if(nbr->state == NBR_INCOMPLETE) {
@@ -473,9 +475,9 @@ na_input(void)
     PRINTF("NA received is bad\n");
     goto discard;
   } else {
-    uip_lladdr_t *lladdr;
+    const uip_lladdr_t *lladdr;
     nbr = uip_ds6_nbr_lookup(&UIP_ND6_NA_BUF->tgtipaddr);
-    lladdr = (uip_lladdr_t *)uip_ds6_nbr_get_ll(nbr);
+    lladdr = uip_ds6_nbr_get_ll(nbr);
     if(nbr == NULL) {
       goto discard;
     }
@@ -488,8 +490,10 @@ na_input(void)
       if(nd6_opt_llao == NULL) {
         goto discard;
       }
-      memcpy(lladdr, &nd6_opt_llao[UIP_ND6_OPT_DATA_OFFSET],
-	     UIP_LLADDR_LEN);
+      if(nbr_table_update_lladdr(ds6_neighbors, nbr,
+           (const linkaddr_t *)&nd6_opt_llao[UIP_ND6_OPT_DATA_OFFSET]) == 0) {
+        goto discard;
+      }
       if(is_solicited) {
         nbr->state = NBR_REACHABLE;
         nbr->nscount = 0;
@@ -510,9 +514,10 @@ na_input(void)
       } else {
         if(is_override || (!is_override && nd6_opt_llao != 0 && !is_llchange)
            || nd6_opt_llao == 0) {
-          if(nd6_opt_llao != 0) {
-            memcpy(lladdr, &nd6_opt_llao[UIP_ND6_OPT_DATA_OFFSET],
-		   UIP_LLADDR_LEN);
+          if(nd6_opt_llao != 0 &&
+             nbr_table_update_lladdr(ds6_neighbors, nbr,
+               (const linkaddr_t *)&nd6_opt_llao[UIP_ND6_OPT_DATA_OFFSET]) == 0) {
+            goto discard;
           }
           if(is_solicited) {
             nbr->state = NBR_REACHABLE;
@@ -835,15 +840,16 @@ ra_input(void)
                               (uip_lladdr_t *)&nd6_opt_llao[UIP_ND6_OPT_DATA_OFFSET],
 			      1, NBR_STALE);
       } else {
-        uip_lladdr_t *lladdr = uip_ds6_nbr_get_ll(nbr);
+        const uip_lladdr_t *lladdr = uip_ds6_nbr_get_ll(nbr);
         if(nbr->state == NBR_INCOMPLETE) {
           nbr->state = NBR_STALE;
         }
         if(memcmp(&nd6_opt_llao[UIP_ND6_OPT_DATA_OFFSET],
 		  lladdr, UIP_LLADDR_LEN) != 0) {
-          memcpy(lladdr, &nd6_opt_llao[UIP_ND6_OPT_DATA_OFFSET],
-		 UIP_LLADDR_LEN);
-          nbr->state = NBR_STALE;
+          if(nbr_table_update_lladdr(ds6_neighbors, nbr,
+               (const linkaddr_t *)&nd6_opt_llao[UIP_ND6_OPT_DATA_OFFSET])) {
+            nbr->state = NBR_STALE;
+          }
         }
         nbr->isrouter = 1;
       }
@@ -632,6 +632,8 @@ send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
   packetbuf_compact();
 
 #ifdef NETSTACK_ENCRYPT
+  /* Encrypt a copy, a queuebuf may share the packet */
+  packetbuf_detach();
   NETSTACK_ENCRYPT();
 #endif /* NETSTACK_ENCRYPT */
 
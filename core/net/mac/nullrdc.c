@@ -127,6 +127,8 @@ send_one_packet(mac_callback_t sent, void *ptr)
   } else {
 
 #ifdef NETSTACK_ENCRYPT
+    /* Encrypt a copy, a queuebuf may share the packet */
+    packetbuf_detach();
     NETSTACK_ENCRYPT();
 #endif /* NETSTACK_ENCRYPT */
 
@@ -62,6 +62,21 @@ static unsigned num_tables;
 MEMB(neighbor_addr_mem, nbr_table_key_t, NBR_TABLE_MAX_NEIGHBORS);
 LIST(nbr_table_keys);
 
+#if NBR_TABLE_HASH_SIZE <= NBR_TABLE_MAX_NEIGHBORS
+#error NBR_TABLE_HASH_SIZE must be larger than NBR_TABLE_MAX_NEIGHBORS
+#endif
+
+/* Open addressing hash index over the link-layer addresses of the keys.
+ * A slot holds the neighbor index plus one, 0 marks a free slot. Collisions
+ * are resolved by linear probing, removals shift the rest of the run back
+ * so no deleted markers are needed */
+#if NBR_TABLE_MAX_NEIGHBORS < 255
+typedef uint8_t nbr_table_slot_t;
+#else
+typedef uint16_t nbr_table_slot_t;
+#endif
+static nbr_table_slot_t lladdr_index[NBR_TABLE_HASH_SIZE];
+
 /*---------------------------------------------------------------------------*/
 /* Get a key from a neighbor index */
 static nbr_table_key_t *
@@ -105,22 +120,84 @@ key_from_item(nbr_table_t *table, const nbr_table_item_t *item)
   return key_from_index(index_from_item(table, item));
 }
 /*---------------------------------------------------------------------------*/
+/* Get the hash index slot of a link-layer address */
+static uint16_t
+lladdr_hash(const linkaddr_t *lladdr)
+{
+  uint16_t hash = 0;
+  uint8_t i;
+
+  for(i = 0; i < LINKADDR_SIZE; i++) {
+    hash = ((hash << 3) | (hash >> 13)) ^ lladdr->u8[i];
+  }
+  hash ^= hash >> 8;
+  return hash & (NBR_TABLE_HASH_SIZE - 1);
+}
+/*---------------------------------------------------------------------------*/
+/* Add a key to the hash index */
+static void
+index_add(nbr_table_key_t *key)
+{
+  uint16_t slot = lladdr_hash(&key->lladdr);
+
+  while(lladdr_index[slot] != 0) {
+    slot = (slot + 1) & (NBR_TABLE_HASH_SIZE - 1);
+  }
+  lladdr_index[slot] = index_from_key(key) + 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Remove a key from the hash index */
+static void
+index_remove(nbr_table_key_t *key)
+{
+  nbr_table_slot_t entry = index_from_key(key) + 1;
+  uint16_t slot = lladdr_hash(&key->lladdr);
+  uint16_t next;
+  uint16_t home;
+
+  while(lladdr_index[slot] != entry) {
+    if(lladdr_index[slot] == 0) {
+      return;
+    }
+    slot = (slot + 1) & (NBR_TABLE_HASH_SIZE - 1);
+  }
+
+  /* Move back the following entries of the run that would no longer be
+   * reachable from their home slot */
+  next = slot;
+  for(;;) {
+    next = (next + 1) & (NBR_TABLE_HASH_SIZE - 1);
+    if(lladdr_index[next] == 0) {
+      break;
+    }
+    home = lladdr_hash(&key_from_index(lladdr_index[next] - 1)->lladdr);
+    if(((next - home) & (NBR_TABLE_HASH_SIZE - 1)) >=
+       ((next - slot) & (NBR_TABLE_HASH_SIZE - 1))) {
+      lladdr_index[slot] = lladdr_index[next];
+      slot = next;
+    }
+  }
+  lladdr_index[slot] = 0;
+}
+/*---------------------------------------------------------------------------*/
 /* Get the index of a neighbor from its link-layer address */
 static int
 index_from_lladdr(const linkaddr_t *lladdr)
 {
+  uint16_t slot;
   nbr_table_key_t *key;
   /* Allow lladdr-free insertion, useful e.g. for IPv6 ND.
    * Only one such entry is possible at a time, indexed by linkaddr_null. */
   if(lladdr == NULL) {
     lladdr = &linkaddr_null;
   }
-  key = list_head(nbr_table_keys);
-  while(key != NULL) {
-    if(lladdr && linkaddr_cmp(lladdr, &key->lladdr)) {
-      return index_from_key(key);
+  slot = lladdr_hash(lladdr);
+  while(lladdr_index[slot] != 0) {
+    key = key_from_index(lladdr_index[slot] - 1);
+    if(linkaddr_cmp(lladdr, &key->lladdr)) {
+      return lladdr_index[slot] - 1;
     }
-    key = list_item_next(key);
+    slot = (slot + 1) & (NBR_TABLE_HASH_SIZE - 1);
   }
   return -1;
 }
@@ -156,6 +233,29 @@ nbr_set_bit(uint8_t *bitmap, nbr_table_t *table, nbr_table_item_t *item, int val
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+/* Remove a neighbor from all tables, the list and the index. The key is
+ * left allocated */
+static void
+nbr_table_unlink(nbr_table_key_t *key)
+{
+  int i;
+  for(i = 0; i<MAX_NUM_TABLES; i++) {
+    if(all_tables[i] != NULL && all_tables[i]->callback != NULL) {
+      /* Call table callback for each table that uses this item */
+      nbr_table_item_t *removed_item = item_from_key(all_tables[i], key);
+      if(nbr_get_bit(used_map, all_tables[i], removed_item) == 1) {
+        all_tables[i]->callback(removed_item);
+      }
+    }
+  }
+  /* Empty used and locked maps */
+  used_map[index_from_key(key)] = 0;
+  locked_map[index_from_key(key)] = 0;
+  /* Remove neighbor from list and index */
+  list_remove(nbr_table_keys, key);
+  index_remove(key);
+}
+/*---------------------------------------------------------------------------*/
 static nbr_table_key_t *
 nbr_table_allocate(void)
 {
@@ -204,20 +304,7 @@ nbr_table_allocate(void)
       return NULL;
     } else {
       /* Reuse least used item */
-      int i;
-      for(i = 0; i<MAX_NUM_TABLES; i++) {
-        if(all_tables[i] != NULL && all_tables[i]->callback != NULL) {
-          /* Call table callback for each table that uses this item */
-          nbr_table_item_t *removed_item = item_from_key(all_tables[i], least_used_key);
-          if(nbr_get_bit(used_map, all_tables[i], removed_item) == 1) {
-            all_tables[i]->callback(removed_item);
-          }
-        }
-      }
-      /* Empty used map */
-      used_map[index_from_key(least_used_key)] = 0;
-      /* Remove neighbor from list */
-      list_remove(nbr_table_keys, least_used_key);
+      nbr_table_unlink(least_used_key);
       /* Return associated key */
       return least_used_key;
     }
@@ -298,6 +385,9 @@ nbr_table_add_lladdr(nbr_table_t *table, const linkaddr_t *lladdr)
 
     /* Set link-layer address */
     linkaddr_copy(&key->lladdr, lladdr);
+
+    /* Make the neighbor findable by its link-layer address */
+    index_add(key);
   }
 
   /* Get item in the current table */
@@ -342,9 +432,40 @@ nbr_table_unlock(nbr_table_t *table, void *item)
 }
 /*---------------------------------------------------------------------------*/
 /* Get link-layer address of an item */
-linkaddr_t *
+const linkaddr_t *
 nbr_table_get_lladdr(nbr_table_t *table, const void *item)
 {
   nbr_table_key_t *key = key_from_item(table, item);
   return key != NULL ? &key->lladdr : NULL;
 }
+/*---------------------------------------------------------------------------*/
+/* Change the link-layer address of an item and move it in the index */
+int
+nbr_table_update_lladdr(nbr_table_t *table, const void *item,
+                        const linkaddr_t *lladdr)
+{
+  nbr_table_key_t *key = key_from_item(table, item);
+  int index;
+
+  if(key == NULL || lladdr == NULL) {
+    return 0;
+  }
+
+  index = index_from_lladdr(lladdr);
+  if(index == index_from_key(key)) {
+    return 1;
+  }
+  if(index != -1) {
+    /* Another neighbor has the address, it is replaced unless locked */
+    if(locked_map[index]) {
+      return 0;
+    }
+    nbr_table_unlink(key_from_index(index));
+    memb_free(&neighbor_addr_mem, key_from_index(index));
+  }
+
+  index_remove(key);
+  linkaddr_copy(&key->lladdr, lladdr);
+  index_add(key);
+  return 1;
+}
@@ -46,6 +46,26 @@
 #define NBR_TABLE_MAX_NEIGHBORS 8
 #endif /* NBR_TABLE_CONF_MAX_NEIGHBORS */
 
+/* Number of slots of the link-layer address hash index, a power of two
+ * larger than the table. Defaults to at least twice the table size */
+#ifdef NBR_TABLE_CONF_HASH_SIZE
+#define NBR_TABLE_HASH_SIZE NBR_TABLE_CONF_HASH_SIZE
+#elif NBR_TABLE_MAX_NEIGHBORS > 256
+#define NBR_TABLE_HASH_SIZE 1024
+#elif NBR_TABLE_MAX_NEIGHBORS > 128
+#define NBR_TABLE_HASH_SIZE 512
+#elif NBR_TABLE_MAX_NEIGHBORS > 64
+#define NBR_TABLE_HASH_SIZE 256
+#elif NBR_TABLE_MAX_NEIGHBORS > 32
+#define NBR_TABLE_HASH_SIZE 128
+#elif NBR_TABLE_MAX_NEIGHBORS > 16
+#define NBR_TABLE_HASH_SIZE 64
+#elif NBR_TABLE_MAX_NEIGHBORS > 8
+#define NBR_TABLE_HASH_SIZE 32
+#else
+#define NBR_TABLE_HASH_SIZE 16
+#endif /* NBR_TABLE_CONF_HASH_SIZE */
+
 /* An item in a neighbor table */
 typedef void nbr_table_item_t;
 
@@ -97,7 +117,13 @@ int nbr_table_unlock(nbr_table_t *table, nbr_table_item_t *item);
 
 /** \name Neighbor tables: address manipulation */
 /** @{ */
-linkaddr_t *nbr_table_get_lladdr(nbr_table_t *table, const nbr_table_item_t *item);
+const linkaddr_t *nbr_table_get_lladdr(nbr_table_t *table, const nbr_table_item_t *item);
+/* Sets the link-layer address of an item, e.g. one added without address.
+ * The address must not be written through nbr_table_get_lladdr(), the
+ * neighbor would no longer be found by it. A different unlocked neighbor
+ * with the same address is removed from all tables. Returns 0 if that
+ * neighbor is locked, 1 otherwise */
+int nbr_table_update_lladdr(nbr_table_t *table, const nbr_table_item_t *item, const linkaddr_t *lladdr);
 /** @} */
 
 #endif /* NBR_TABLE_H_ */
@@ -46,6 +46,7 @@
 
 #include "contiki-net.h"
 #include "net/packetbuf.h"
+#include "net/pbuf.h"
 #include "net/rime/rime.h"
 
 struct packetbuf_attr packetbuf_attrs[PACKETBUF_NUM_ATTRS];
@@ -64,6 +65,11 @@ static uint8_t *packetbuf = (uint8_t *)packetbuf_aligned;
 
 static uint8_t *packetbufptr;
 
+#if PBUF_NUM
+/* The pbuf that backs the packetbuf instead of the static buffer */
+static struct pbuf *attached;
+#endif /* PBUF_NUM */
+
 #define DEBUG 0
 #if DEBUG
 #include <stdio.h>
@@ -76,6 +82,14 @@ static uint8_t *packetbufptr;
 void
 packetbuf_clear(void)
 {
+#if PBUF_NUM
+  if(attached != NULL) {
+    pbuf_free(attached);
+    attached = NULL;
+    packetbuf = (uint8_t *)packetbuf_aligned;
+  }
+#endif /* PBUF_NUM */
+
   buflen = bufptr = 0;
   hdrptr = PACKETBUF_HDR_SIZE;
 
@@ -110,6 +124,11 @@ packetbuf_compact(void)
     memcpy(&packetbuf[PACKETBUF_HDR_SIZE], packetbuf_reference_ptr(),
 	   packetbuf_datalen());
   } else if(bufptr > 0) {
+#if PBUF_NUM
+    if(attached != NULL && pbuf_is_shared(attached)) {
+      packetbuf_detach();
+    }
+#endif /* PBUF_NUM */
     len = packetbuf_datalen() + PACKETBUF_HDR_SIZE;
     for(i = PACKETBUF_HDR_SIZE; i < len; i++) {
       packetbuf[i] = packetbuf[bufptr + i];
@@ -235,6 +254,95 @@ packetbuf_reference_ptr(void)
   return packetbufptr;
 }
 /*---------------------------------------------------------------------------*/
+int
+packetbuf_attach(struct pbuf *p)
+{
+#if PBUF_NUM
+  if(p->offset + p->len > PBUF_SIZE) {
+    return 0;
+  }
+  /* Take the reference first, p may be the pbuf attached so far */
+  pbuf_ref(p);
+  packetbuf_clear();
+  attached = p;
+  packetbuf = pbuf_mem(p);
+  packetbufptr = &packetbuf[PACKETBUF_HDR_SIZE];
+
+  /* Data in front of the packetbuf data area becomes the header */
+  if(p->offset < PACKETBUF_HDR_SIZE) {
+    hdrptr = p->offset;
+    buflen = p->offset + p->len > PACKETBUF_HDR_SIZE ?
+      p->offset + p->len - PACKETBUF_HDR_SIZE : 0;
+  } else {
+    bufptr = p->offset - PACKETBUF_HDR_SIZE;
+    buflen = p->len;
+  }
+  return 1;
+#else /* PBUF_NUM */
+  return 0;
+#endif /* PBUF_NUM */
+}
+/*---------------------------------------------------------------------------*/
+int
+packetbuf_attach_new(void)
+{
+#if PBUF_NUM
+  struct pbuf *p;
+
+  packetbuf_clear();
+  p = pbuf_alloc(PACKETBUF_HDR_SIZE);
+  if(p == NULL) {
+    return 0;
+  }
+  packetbuf_attach(p);
+  pbuf_free(p);
+  return 1;
+#else /* PBUF_NUM */
+  packetbuf_clear();
+  return 0;
+#endif /* PBUF_NUM */
+}
+/*---------------------------------------------------------------------------*/
+struct pbuf *
+packetbuf_pbuf(void)
+{
+#if PBUF_NUM
+  if(attached == NULL) {
+    return NULL;
+  }
+  if(packetbuf_hdrlen() == 0) {
+    attached->offset = PACKETBUF_HDR_SIZE + bufptr;
+    attached->len = buflen;
+  } else if(bufptr == 0) {
+    attached->offset = hdrptr;
+    attached->len = packetbuf_totlen();
+  } else {
+    /* Header and data are not contiguous */
+    return NULL;
+  }
+  return attached;
+#else /* PBUF_NUM */
+  return NULL;
+#endif /* PBUF_NUM */
+}
+/*---------------------------------------------------------------------------*/
+void
+packetbuf_detach(void)
+{
+#if PBUF_NUM
+  if(attached != NULL) {
+    /* Copy everything behind the header, the data may have been written
+       before its length was set */
+    memcpy((uint8_t *)packetbuf_aligned + hdrptr, packetbuf + hdrptr,
+           PACKETBUF_HDR_SIZE + PACKETBUF_SIZE - hdrptr);
+    pbuf_free(attached);
+    attached = NULL;
+    packetbuf = (uint8_t *)packetbuf_aligned;
+    packetbufptr = &packetbuf[PACKETBUF_HDR_SIZE];
+  }
+#endif /* PBUF_NUM */
+}
+/*---------------------------------------------------------------------------*/
 uint16_t
 packetbuf_datalen(void)
 {
@@ -234,6 +234,66 @@ void *packetbuf_reference_ptr(void);
  */
 void packetbuf_compact(void);
 
+struct pbuf;
+
+/**
+ * \brief      Back the packetbuf by a pbuf
+ * \param p    The pbuf
+ * \retval     Non-zero if the packetbuf uses p, zero otherwise
+ *
+ *             This function clears the packetbuf and makes it use the
+ *             storage of the pbuf instead of its static buffer, without
+ *             copying. The data of the pbuf becomes the packetbuf
+ *             data, the part of it that lies in front of the packetbuf
+ *             data area becomes the header. The packetbuf holds a
+ *             reference to the pbuf until it is cleared.
+ *
+ *             Zero is returned if the data of p does not fit into the
+ *             packetbuf or if pbufs are disabled with
+ *             PBUF_CONF_NUM.
+ *
+ */
+int packetbuf_attach(struct pbuf *p);
+
+/**
+ * \brief      Clear the packetbuf and back it by a new pbuf
+ * \retval     Non-zero if a pbuf is used, zero if the static buffer is used
+ *
+ *             Like packetbuf_clear(), but the packet is built in a new
+ *             pbuf if one is free. Lower layers can then queue and
+ *             send it by reference instead of copying it.
+ *
+ */
+int packetbuf_attach_new(void);
+
+/**
+ * \brief      Get the pbuf that backs the packetbuf
+ * \retval     The pbuf, or NULL
+ *
+ *             This function returns the pbuf that backs the packetbuf,
+ *             with its offset and length set to the header and data
+ *             of the packetbuf. NULL is returned if the packetbuf uses
+ *             its static buffer or if its header and data are not
+ *             consecutive.
+ *
+ *             The data of a pbuf that has other holders must not be
+ *             changed, see packetbuf_detach().
+ *
+ */
+struct pbuf *packetbuf_pbuf(void);
+
+/**
+ * \brief      Move the packetbuf back to its static buffer
+ *
+ *             This function copies the contents of the packetbuf
+ *             from the pbuf that backs it to the static buffer and
+ *             releases the pbuf. It must be called before
+ *             the contents of the packetbuf are modified in place when
+ *             they may be shared, e.g. by a queuebuf.
+ *
+ */
+void packetbuf_detach(void);
+
 /**
  * \brief      Copy from external data into the packetbuf
  * \param from A pointer to the data from which to copy
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2013, Institute of Operating Systems and Computer Networks (TU Braunschweig).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Reference counted packet buffers
+ */
+
+#include "contiki.h"
+#include "lib/memb.h"
+#include "net/pbuf.h"
+
+#if PBUF_NUM
+
+MEMB(pbuf_memb, struct pbuf, PBUF_NUM);
+
+/*---------------------------------------------------------------------------*/
+void
+pbuf_init(void)
+{
+  memb_init(&pbuf_memb);
+}
+/*---------------------------------------------------------------------------*/
+struct pbuf *
+pbuf_alloc(uint16_t headroom)
+{
+  struct pbuf *p;
+
+  if(headroom > PBUF_SIZE) {
+    return NULL;
+  }
+  p = memb_alloc(&pbuf_memb);
+  if(p != NULL) {
+    p->offset = headroom;
+    p->len = 0;
+    p->ref = 1;
+  }
+  return p;
+}
+/*---------------------------------------------------------------------------*/
+void
+pbuf_ref(struct pbuf *p)
+{
+  p->ref++;
+}
+/*---------------------------------------------------------------------------*/
+void
+pbuf_free(struct pbuf *p)
+{
+  if(--p->ref == 0) {
+    memb_free(&pbuf_memb, p);
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+pbuf_hdralloc(struct pbuf *p, uint16_t size)
+{
+  if(p->offset < size) {
+    return 0;
+  }
+  p->offset -= size;
+  p->len += size;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+pbuf_hdrreduce(struct pbuf *p, uint16_t size)
+{
+  if(p->len < size) {
+    return 0;
+  }
+  p->offset += size;
+  p->len -= size;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+#endif /* PBUF_NUM */
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2013, Institute of Operating Systems and Computer Networks (TU Braunschweig).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Reference counted packet buffers
+ *
+ *         A pbuf holds one frame together with the headroom for the
+ *         headers of the lower layers. Several holders can share a pbuf,
+ *         so a frame built once can be queued and sent without being
+ *         copied on every layer. The packetbuf can be backed by a pbuf,
+ *         see packetbuf_attach(); queuebufs created from such a packetbuf
+ *         and radio drivers then hold references to it.
+ *
+ *         The offset and length describe the data for the current user of
+ *         a pbuf. Users that share a pbuf, like the queuebufs, keep their
+ *         own copy of them. The data of a shared pbuf must not be changed.
+ */
+
+#ifndef PBUF_H_
+#define PBUF_H_
+
+#include "contiki-conf.h"
+#include "net/packetbuf.h"
+
+/* Number of pbufs, 0 disables them and the packetbuf always uses its
+ * static buffer */
+#ifdef PBUF_CONF_NUM
+#define PBUF_NUM PBUF_CONF_NUM
+#else
+#define PBUF_NUM 0
+#endif
+
+/* A pbuf has room for the packetbuf header area and data */
+#define PBUF_SIZE (PACKETBUF_HDR_SIZE + PACKETBUF_SIZE)
+
+struct pbuf {
+  /* Start of the data, the headroom is in front of it */
+  uint16_t offset;
+  /* Length of the data in this pbuf */
+  uint16_t len;
+  /* Number of holders */
+  uint8_t ref;
+  /* Storage, 16-bit aligned like the packetbuf */
+  uint16_t mem[PBUF_SIZE / 2 + 1];
+};
+
+void pbuf_init(void);
+
+/* Allocate a pbuf with room for headroom bytes of headers in front of
+ * the data and a reference count of 1. Returns NULL if none is free */
+struct pbuf *pbuf_alloc(uint16_t headroom);
+
+/* Add a holder to p */
+void pbuf_ref(struct pbuf *p);
+
+/* Drop a holder of p, a pbuf without holders is freed */
+void pbuf_free(struct pbuf *p);
+
+/* 1 if p has more than one holder */
+#define pbuf_is_shared(p) ((p)->ref > 1)
+
+/* Start of the storage of p */
+#define pbuf_mem(p) ((uint8_t *)(p)->mem)
+
+/* Start of the data of p */
+#define pbuf_dataptr(p) (pbuf_mem(p) + (p)->offset)
+
+/* Extend the data of p by size bytes of headroom, returns 0 if there is
+ * not enough headroom left */
+int pbuf_hdralloc(struct pbuf *p, uint16_t size);
+
+/* Remove size bytes from the front of the data of p, returns 0 if the
+ * data is shorter */
+int pbuf_hdrreduce(struct pbuf *p, uint16_t size);
+
+#endif /* PBUF_H_ */
@@ -43,6 +43,7 @@
  */
 
 #include "contiki-net.h"
+#include "net/pbuf.h"
 #if WITH_SWAP
 #include "cfs/cfs.h"
 #endif
@@ -94,6 +95,20 @@ MEMB(bufmem, struct queuebuf, QUEUEBUF_NUM);
 MEMB(refbufmem, struct queuebuf_ref, QUEUEBUF_REF_NUM);
 MEMB(buframmem, struct queuebuf_data, QUEUEBUFRAM_NUM);
 
+#if PBUF_NUM
+/* A queuebuf that holds a reference to the pbuf backing the packetbuf
+   instead of a copy of the packet */
+struct queuebuf_pbuf {
+  struct pbuf *p;
+  uint16_t offset;
+  uint16_t len;
+  struct packetbuf_attr attrs[PACKETBUF_NUM_ATTRS];
+  struct packetbuf_addr addrs[PACKETBUF_NUM_ADDRS];
+};
+
+MEMB(pbufmem, struct queuebuf_pbuf, QUEUEBUF_NUM);
+#endif /* PBUF_NUM */
+
 #if WITH_SWAP
 
 /* Swapping allows to store up to QUEUEBUF_NUM - QUEUEBUFRAM_NUM
@@ -288,6 +303,15 @@ queuebuf_load_to_ram(struct queuebuf *b)
   return b->ram_ptr;
 }
 #endif /* WITH_SWAP */
+#if PBUF_NUM
+/*---------------------------------------------------------------------------*/
+/* Get the pbuf queuebuf, NULL if the queuebuf holds a copy */
+static struct queuebuf_pbuf *
+queuebuf_pbuf(struct queuebuf *b)
+{
+  return memb_inmemb(&pbufmem, b) ? (struct queuebuf_pbuf *)b : NULL;
+}
+#endif /* PBUF_NUM */
 /*---------------------------------------------------------------------------*/
 void
 queuebuf_init(void)
@@ -302,6 +326,10 @@ queuebuf_init(void)
   memb_init(&buframmem);
   memb_init(&bufmem);
   memb_init(&refbufmem);
+#if PBUF_NUM
+  memb_init(&pbufmem);
+  pbuf_init();
+#endif /* PBUF_NUM */
 #if QUEUEBUF_STATS
   queuebuf_max_len = QUEUEBUF_NUM;
 #endif /* QUEUEBUF_STATS */
@@ -317,6 +345,25 @@ queuebuf_new_from_packetbuf(void)
 {
   struct queuebuf *buf;
   struct queuebuf_ref *rbuf;
+#if PBUF_NUM
+  struct queuebuf_pbuf *pbuf;
+  struct pbuf *p;
+
+  /* Share the pbuf that backs the packetbuf */
+  p = packetbuf_pbuf();
+  if(p != NULL) {
+    pbuf = memb_alloc(&pbufmem);
+    if(pbuf != NULL) {
+      pbuf_ref(p);
+      pbuf->p = p;
+      pbuf->offset = p->offset;
+      pbuf->len = p->len;
+      packetbuf_attr_copyto(pbuf->attrs, pbuf->addrs);
+      return (struct queuebuf *)pbuf;
+    }
+    /* Fall back to a copy */
+  }
+#endif /* PBUF_NUM */
 
   if(packetbuf_is_reference()) {
     rbuf = memb_alloc(&refbufmem);
@@ -395,7 +442,15 @@ queuebuf_new_from_packetbuf(void)
 void
 queuebuf_update_attr_from_packetbuf(struct queuebuf *buf)
 {
-  struct queuebuf_data *buframptr = queuebuf_load_to_ram(buf);
+  struct queuebuf_data *buframptr;
+#if PBUF_NUM
+  struct queuebuf_pbuf *pbuf = queuebuf_pbuf(buf);
+  if(pbuf != NULL) {
+    packetbuf_attr_copyto(pbuf->attrs, pbuf->addrs);
+    return;
+  }
+#endif /* PBUF_NUM */
+  buframptr = queuebuf_load_to_ram(buf);
   packetbuf_attr_copyto(buframptr->attrs, buframptr->addrs);
 #if WITH_SWAP
   if(buf->location == IN_CFS) {
@@ -430,6 +485,11 @@ queuebuf_free(struct queuebuf *buf)
 #if QUEUEBUF_STATS
     --queuebuf_ref_len;
 #endif /* QUEUEBUF_STATS */
+#if PBUF_NUM
+  } else if(memb_inmemb(&pbufmem, buf)) {
+    pbuf_free(((struct queuebuf_pbuf *)buf)->p);
+    memb_free(&pbufmem, buf);
+#endif /* PBUF_NUM */
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -447,6 +507,21 @@ queuebuf_to_packetbuf(struct queuebuf *b)
     packetbuf_copyfrom(r->ref, r->len);
     packetbuf_hdralloc(r->hdrlen);
     memcpy(packetbuf_hdrptr(), r->hdr, r->hdrlen);
+#if PBUF_NUM
+  } else if(memb_inmemb(&pbufmem, b)) {
+    struct queuebuf_pbuf *pbuf = (struct queuebuf_pbuf *)b;
+    if(pbuf->offset < PACKETBUF_HDR_SIZE) {
+      /* The frame was queued with its header, which the packetbuf would
+         map to its header area again. Restore the whole frame as data,
+         like the other queuebufs do. */
+      packetbuf_copyfrom(pbuf_mem(pbuf->p) + pbuf->offset, pbuf->len);
+    } else {
+      pbuf->p->offset = pbuf->offset;
+      pbuf->p->len = pbuf->len;
+      packetbuf_attach(pbuf->p);
+    }
+    packetbuf_attr_copyfrom(pbuf->attrs, pbuf->addrs);
+#endif /* PBUF_NUM */
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -461,6 +536,11 @@ queuebuf_dataptr(struct queuebuf *b)
   } else if(memb_inmemb(&refbufmem, b)) {
     r = (struct queuebuf_ref *)b;
     return r->ref;
+#if PBUF_NUM
+  } else if(memb_inmemb(&pbufmem, b)) {
+    struct queuebuf_pbuf *pbuf = (struct queuebuf_pbuf *)b;
+    return pbuf_mem(pbuf->p) + pbuf->offset;
+#endif /* PBUF_NUM */
   }
   return NULL;
 }
@@ -468,21 +548,42 @@ queuebuf_dataptr(struct queuebuf *b)
 int
 queuebuf_datalen(struct queuebuf *b)
 {
-  struct queuebuf_data *buframptr = queuebuf_load_to_ram(b);
+  struct queuebuf_data *buframptr;
+#if PBUF_NUM
+  struct queuebuf_pbuf *pbuf = queuebuf_pbuf(b);
+  if(pbuf != NULL) {
+    return pbuf->len;
+  }
+#endif /* PBUF_NUM */
+  buframptr = queuebuf_load_to_ram(b);
   return buframptr->len;
 }
 /*---------------------------------------------------------------------------*/
 linkaddr_t *
 queuebuf_addr(struct queuebuf *b, uint8_t type)
 {
-  struct queuebuf_data *buframptr = queuebuf_load_to_ram(b);
+  struct queuebuf_data *buframptr;
+#if PBUF_NUM
+  struct queuebuf_pbuf *pbuf = queuebuf_pbuf(b);
+  if(pbuf != NULL) {
+    return &pbuf->addrs[type - PACKETBUF_ADDR_FIRST].addr;
+  }
+#endif /* PBUF_NUM */
+  buframptr = queuebuf_load_to_ram(b);
   return &buframptr->addrs[type - PACKETBUF_ADDR_FIRST].addr;
 }
 /*---------------------------------------------------------------------------*/
 packetbuf_attr_t
 queuebuf_attr(struct queuebuf *b, uint8_t type)
 {
-  struct queuebuf_data *buframptr = queuebuf_load_to_ram(b);
+  struct queuebuf_data *buframptr;
+#if PBUF_NUM
+  struct queuebuf_pbuf *pbuf = queuebuf_pbuf(b);
+  if(pbuf != NULL) {
+    return pbuf->attrs[type].val;
+  }
+#endif /* PBUF_NUM */
+  buframptr = queuebuf_load_to_ram(b);
   return buframptr->attrs[type].val;
 }
 /*---------------------------------------------------------------------------*/
@@ -117,8 +117,8 @@ rpl_get_parent_link_metric(const uip_lladdr_t *addr)
 uip_ipaddr_t *
 rpl_get_parent_ipaddr(rpl_parent_t *p)
 {
-  linkaddr_t *lladdr = nbr_table_get_lladdr(rpl_parents, p);
-  return uip_ds6_nbr_ipaddr_from_lladdr((uip_lladdr_t *)lladdr);
+  const linkaddr_t *lladdr = nbr_table_get_lladdr(rpl_parents, p);
+  return uip_ds6_nbr_ipaddr_from_lladdr((const uip_lladdr_t *)lladdr);
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -12,6 +12,11 @@
  * to the event timer is made by a pointer to the declared event
  * timer.
  *
+ * The pending event timers are kept sorted by their expiration time.
+ * Setting or stopping a timer walks the list up to its position, while
+ * the next expiration time and the expired timers are found at the
+ * front of the list.
+ *
  * \sa \ref timer "Simple timer library"
  * \sa \ref clock "Clock library" (used by the timer library)
  *
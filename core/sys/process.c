@@ -44,6 +44,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "sys/process.h"
 #include "sys/arg.h"
@@ -63,16 +64,42 @@ struct event_data {
   process_event_t ev;
   process_data_t data;
   struct process *p;
+  /* Next entry in the same queue or in the free list */
+  process_num_events_t next;
+#if PROCESS_CONF_LATENCY_STATS
+  rtimer_clock_t posted;
+#endif
 };
 
-static process_num_events_t nevents, fevent;
+/*
+ * The entries of events[] form one FIFO queue per priority and a list
+ * of free entries.
+ */
+#define NO_EVENT PROCESS_CONF_NUMEVENTS
+
+#define QUEUE_URGENT     0
+#define QUEUE_NORMAL     1
+#define QUEUE_BACKGROUND 2
+
+#define QUEUE(prio) ((prio) == PROCESS_PRIO_URGENT ? QUEUE_URGENT : \
+                     (prio) == PROCESS_PRIO_NORMAL ? QUEUE_NORMAL : \
+                     QUEUE_BACKGROUND)
+
+static process_num_events_t nevents, free_event;
+static process_num_events_t queue_head[PROCESS_PRIOS];
+static process_num_events_t queue_tail[PROCESS_PRIOS];
+static process_num_events_t queued[PROCESS_PRIOS];
 static struct event_data events[PROCESS_CONF_NUMEVENTS];
 
 #if PROCESS_CONF_STATS
 process_num_events_t process_maxevents;
+process_num_events_t process_maxevents_prio[PROCESS_PRIOS];
 #endif
 
 static volatile unsigned char poll_requested;
+/* Set while the poll of a background process waits for the urgent and
+   normal queues to drain. */
+static unsigned char background_poll;
 
 #define PROCESS_STATE_NONE        0
 #define PROCESS_STATE_RUNNING     1
@@ -205,13 +232,30 @@ process_exit(struct process *p)
 }
 /*---------------------------------------------------------------------------*/
 void
+process_set_priority(struct process *p, unsigned char priority)
+{
+  p->priority = priority;
+}
+/*---------------------------------------------------------------------------*/
+void
 process_init(void)
 {
+  process_num_events_t i;
+
   lastevent = PROCESS_EVENT_MAX;
 
-  nevents = fevent = 0;
+  nevents = 0;
+  for(i = 0; i < PROCESS_PRIOS; i++) {
+    queue_head[i] = queue_tail[i] = NO_EVENT;
+    queued[i] = 0;
+  }
+  for(i = 0; i < PROCESS_CONF_NUMEVENTS; i++) {
+    events[i].next = i + 1;
+  }
+  free_event = 0;
 #if PROCESS_CONF_STATS
   process_maxevents = 0;
+  memset(process_maxevents_prio, 0, sizeof(process_maxevents_prio));
 #endif /* PROCESS_CONF_STATS */
 
   process_current = process_list = NULL;
@@ -222,14 +266,19 @@ process_init(void)
  */
 /*---------------------------------------------------------------------------*/
 static void
-do_poll(void)
+poll_processes(unsigned char urgent)
 {
   struct process *p;
 
-  poll_requested = 0;
-  /* Call the processes that needs to be polled. */
   for(p = process_list; p != NULL; p = p->next) {
-    if(p->needspoll) {
+    if(p->needspoll && (p->priority == PROCESS_PRIO_URGENT) == urgent) {
+      if(p->priority == PROCESS_PRIO_BACKGROUND &&
+         queued[QUEUE_URGENT] + queued[QUEUE_NORMAL] > 0) {
+        /* Background processes wait until no other events are
+           queued. */
+        background_poll = 1;
+        continue;
+      }
       p->state = PROCESS_STATE_RUNNING;
       p->needspoll = 0;
       call_process(p, PROCESS_EVENT_POLL, NULL);
@@ -237,6 +286,31 @@ do_poll(void)
   }
 }
 /*---------------------------------------------------------------------------*/
+static void
+do_poll(void)
+{
+  poll_requested = 0;
+  background_poll = 0;
+  /* Call the processes that needs to be polled, the urgent ones
+     first. */
+  poll_processes(1);
+  poll_processes(0);
+}
+/*---------------------------------------------------------------------------*/
+#if PROCESS_CONF_LATENCY_STATS
+static void
+count_latency(struct process *p, rtimer_clock_t posted)
+{
+  rtimer_clock_t latency = RTIMER_NOW() - posted;
+
+  p->events++;
+  p->latency += latency;
+  if(latency > p->max_latency) {
+    p->max_latency = latency;
+  }
+}
+#endif /* PROCESS_CONF_LATENCY_STATS */
+/*---------------------------------------------------------------------------*/
 /*
  * Process the next event in the event queue and deliver it to
  * listening processes.
@@ -249,6 +323,11 @@ do_event(void)
   static process_data_t data;
   static struct process *receiver;
   static struct process *p;
+  static process_num_events_t e;
+  static unsigned char queue;
+#if PROCESS_CONF_LATENCY_STATS
+  static rtimer_clock_t posted;
+#endif
   
   /*
    * If there are any events in the queue, take the first one and walk
@@ -259,16 +338,28 @@ do_event(void)
    */
 
   if(nevents > 0) {
-    
-    /* There are events that we should deliver. */
-    ev = events[fevent].ev;
-    
-    data = events[fevent].data;
-    receiver = events[fevent].p;
-
-    /* Since we have seen the new event, we move pointer upwards
+
+    /* There are events that we should deliver, take the first one of
+       the most urgent queue. */
+    for(queue = QUEUE_URGENT; queue_head[queue] == NO_EVENT; queue++);
+    e = queue_head[queue];
+
+    ev = events[e].ev;
+    data = events[e].data;
+    receiver = events[e].p;
+#if PROCESS_CONF_LATENCY_STATS
+    posted = events[e].posted;
+#endif
+
+    /* Since we have seen the new event, we move it to the free list
        and decrese the number of events. */
-    fevent = (fevent + 1) % PROCESS_CONF_NUMEVENTS;
+    queue_head[queue] = events[e].next;
+    if(queue_head[queue] == NO_EVENT) {
+      queue_tail[queue] = NO_EVENT;
+    }
+    events[e].next = free_event;
+    free_event = e;
+    --queued[queue];
     --nevents;
 
     /* If this is a broadcast event, we deliver it to all events, in
@@ -281,6 +372,9 @@ do_event(void)
 	if(poll_requested) {
 	  do_poll();
 	}
+#if PROCESS_CONF_LATENCY_STATS
+	count_latency(p, posted);
+#endif
 	call_process(p, ev, data);
       }
     } else {
@@ -292,6 +386,9 @@ do_event(void)
 	receiver->state = PROCESS_STATE_RUNNING;
       }
 
+#if PROCESS_CONF_LATENCY_STATS
+      count_latency(receiver, posted);
+#endif
       /* Make sure that the process actually is running. */
       call_process(receiver, ev, data);
     }
@@ -301,27 +398,30 @@ do_event(void)
 int
 process_run(void)
 {
-  /* Process poll events. */
-  if(poll_requested) {
+  /* Process poll events. Deferred background polls are only retried
+     when no other events are queued. */
+  if(poll_requested ||
+     (background_poll && queued[QUEUE_URGENT] + queued[QUEUE_NORMAL] == 0)) {
     do_poll();
   }
 
   /* Process one event from the queue */
   do_event();
 
-  return nevents + poll_requested;
+  return nevents + poll_requested + background_poll;
 }
 /*---------------------------------------------------------------------------*/
 int
 process_nevents(void)
 {
-  return nevents + poll_requested;
+  return nevents + poll_requested + background_poll;
 }
 /*---------------------------------------------------------------------------*/
 int
 process_post(struct process *p, process_event_t ev, process_data_t data)
 {
   static process_num_events_t snum;
+  static unsigned char queue;
 
   if(PROCESS_CURRENT() == NULL) {
     PRINTF("process_post: NULL process posts event %d to process '%s', nevents %d\n",
@@ -332,7 +432,12 @@ process_post(struct process *p, process_event_t ev, process_data_t data)
 	   p == PROCESS_BROADCAST? "<broadcast>": PROCESS_NAME_STRING(p), nevents);
   }
   
-  if(nevents == PROCESS_CONF_NUMEVENTS) {
+  queue = p == PROCESS_BROADCAST ? QUEUE_NORMAL : QUEUE(p->priority);
+
+  /* The last entries are kept for urgent events. */
+  if(nevents == PROCESS_CONF_NUMEVENTS ||
+     (queue != QUEUE_URGENT &&
+      nevents >= PROCESS_CONF_NUMEVENTS - PROCESS_CONF_URGENT_RESERVE)) {
 #if DEBUG
     if(p == PROCESS_BROADCAST) {
       printf("soft panic: event queue is full when broadcast event %d was posted from %s\n", ev, PROCESS_NAME_STRING(process_current));
@@ -343,16 +448,33 @@ process_post(struct process *p, process_event_t ev, process_data_t data)
     return PROCESS_ERR_FULL;
   }
   
-  snum = (process_num_events_t)(fevent + nevents) % PROCESS_CONF_NUMEVENTS;
+  snum = free_event;
+  free_event = events[snum].next;
   events[snum].ev = ev;
   events[snum].data = data;
   events[snum].p = p;
+  events[snum].next = NO_EVENT;
+#if PROCESS_CONF_LATENCY_STATS
+  events[snum].posted = RTIMER_NOW();
+#endif
+
+  /* Append the event to the queue of its priority. */
+  if(queue_tail[queue] == NO_EVENT) {
+    queue_head[queue] = snum;
+  } else {
+    events[queue_tail[queue]].next = snum;
+  }
+  queue_tail[queue] = snum;
+  ++queued[queue];
   ++nevents;
 
 #if PROCESS_CONF_STATS
   if(nevents > process_maxevents) {
     process_maxevents = nevents;
   }
+  if(queued[queue] > process_maxevents_prio[queue]) {
+    process_maxevents_prio[queue] = queued[queue];
+  }
 #endif /* PROCESS_CONF_STATS */
   
   return PROCESS_ERR_OK;
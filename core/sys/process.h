@@ -88,6 +88,22 @@ typedef unsigned char process_num_events_t;
 #define PROCESS_CONF_NUMEVENTS 32
 #endif /* PROCESS_CONF_NUMEVENTS */
 
+/* Event queue entries that only events to urgent processes may use */
+#ifndef PROCESS_CONF_URGENT_RESERVE
+#define PROCESS_CONF_URGENT_RESERVE 2
+#endif /* PROCESS_CONF_URGENT_RESERVE */
+
+/* Measure the time from posting an event until its delivery for every
+   process, in rtimer ticks */
+#ifndef PROCESS_CONF_LATENCY_STATS
+#define PROCESS_CONF_LATENCY_STATS 0
+#endif /* PROCESS_CONF_LATENCY_STATS */
+
+#if PROCESS_CONF_LATENCY_STATS
+#include "sys/clock.h"
+#include "sys/rtimer.h"
+#endif
+
 #define PROCESS_EVENT_NONE            0x80
 #define PROCESS_EVENT_INIT            0x81
 #define PROCESS_EVENT_POLL            0x82
@@ -103,6 +119,22 @@ typedef unsigned char process_num_events_t;
 #define PROCESS_BROADCAST NULL
 #define PROCESS_ZOMBIE ((struct process *)0x1)
 
+/**
+ * \name Process priorities
+ *
+ * Events and polls of urgent processes are delivered before those of
+ * normal processes, which in turn go before background processes.
+ * Events to the same process keep their order, broadcast events are
+ * normal. Processes are normal unless process_set_priority() is
+ * called.
+ * @{
+ */
+#define PROCESS_PRIO_NORMAL           0
+#define PROCESS_PRIO_URGENT           1
+#define PROCESS_PRIO_BACKGROUND       2
+#define PROCESS_PRIOS                 3
+/* @} */
+
 /**
  * \name Process protothread functions
  * @{
@@ -323,6 +355,13 @@ struct process {
   PT_THREAD((* thread)(struct pt *, process_event_t, process_data_t));
   struct pt pt;
   unsigned char state, needspoll;
+  unsigned char priority;
+#if PROCESS_CONF_LATENCY_STATS
+  /* Delivered events and their total and longest delay */
+  unsigned short events;
+  unsigned long latency;
+  rtimer_clock_t max_latency;
+#endif
 };
 
 /**
@@ -377,6 +416,18 @@ CCIF int process_post(struct process *p, process_event_t ev, void* data);
 CCIF void process_post_synch(struct process *p,
 			     process_event_t ev, void* data);
 
+/**
+ * Set the priority of a process.
+ *
+ * \param p The process.
+ *
+ * \param priority PROCESS_PRIO_URGENT, PROCESS_PRIO_NORMAL or
+ * PROCESS_PRIO_BACKGROUND.
+ *
+ * Events already queued for the process keep their priority.
+ */
+CCIF void process_set_priority(struct process *p, unsigned char priority);
+
 /**
  * \brief      Cause a process to exit
  * \param p    The process that is to be exited
@@ -519,6 +570,15 @@ CCIF int process_is_running(struct process *p);
  */
 int process_nevents(void);
 
+#if PROCESS_CONF_STATS
+/**
+ * The largest number of events that were queued at the same time, in
+ * total and for each priority.
+ */
+extern process_num_events_t process_maxevents;
+extern process_num_events_t process_maxevents_prio[PROCESS_PRIOS];
+#endif
+
 /** @} */
 
 CCIF extern struct process *process_list;
@@ -0,0 +1,487 @@
+/*
+ * Copyright (c) 2013, Institute of Operating Systems and Computer Networks (TU Braunschweig).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ * Streaming export of the profiler tables over SLIP or UDP
+ */
+
+#include <string.h>
+
+#include "contiki.h"
+#include "lib/ringbuf.h"
+#include "sys/profiling/profiling-export.h"
+#if PROFILING_EXPORT_PROF
+#include "sys/profiling/profiling.h"
+#endif
+#if PROFILING_EXPORT_SPROF
+#include "sys/profiling/sprofiling.h"
+#endif
+#include "profiling_arch.h"
+
+#if PROFILING_EXPORT_UDP
+#include "net/ip/simple-udp.h"
+#else
+#include "dev/slip.h"
+#endif
+
+/* Shift that turns the recorded addresses into byte addresses */
+#ifndef ARCHADDR_SHIFT
+#define ARCHADDR_SHIFT 0
+#endif
+
+/* Large enough for every record with 8 byte pointers */
+#define RECORD_SIZE 64
+
+/* Frame header: magic, sequence number and first record offset */
+#define FRAME_HEADER 5
+#define NO_RECORD_START 0xFF
+
+/* Stages of the export of one profile */
+#define STAGE_IDLE 0
+#define STAGE_BEGIN 1
+#define STAGE_SITES 2
+
+PROCESS(profiling_export_process, "Profile export");
+
+static void export_fill(void) __attribute__ ((no_instrument_function));
+static void export_send(void) __attribute__ ((no_instrument_function));
+static uint8_t export_next_record(void) __attribute__ ((no_instrument_function));
+static void export_freeze(void) __attribute__ ((no_instrument_function));
+static void export_thaw(void) __attribute__ ((no_instrument_function));
+
+static struct ringbuf ring;
+static uint8_t ring_data[PROFILING_EXPORT_BUFSIZE];
+
+/* Profiles still to export, the one being exported and its state */
+static uint8_t pending;
+static uint8_t current;
+/* Profilers stopped for the export, restarted after their table */
+static uint8_t resume;
+static uint8_t stage;
+static uint16_t cursor;
+static char name[PROFILING_EXPORT_NAME_LEN + 1];
+
+/* Encoded record that did not fit into the ring buffer yet */
+static uint8_t record[RECORD_SIZE];
+static uint8_t record_len;
+
+/* Where the records start in the bytes taken from the ring buffer */
+static uint8_t payload_left;
+static uint8_t expect_length;
+
+static uint8_t frame[FRAME_HEADER + PROFILING_EXPORT_FRAME_SIZE];
+static uint16_t seq;
+
+#if PROFILING_EXPORT_SPROF && SPROFILE_PROCESS
+static uint8_t process_sent;
+#endif
+
+#if PROFILING_EXPORT_UDP
+static struct simple_udp_connection connection;
+static uip_ipaddr_t destination;
+#endif
+
+static void put8(uint8_t value) __attribute__ ((no_instrument_function));
+static void put8(uint8_t value)
+{
+	record[record_len++] = value;
+}
+
+static void put_value(uintptr_t value, uint8_t size) __attribute__ ((no_instrument_function));
+static void put_value(uintptr_t value, uint8_t size)
+{
+	while (size--) {
+		put8(value & 0xFF);
+		value >>= 8;
+	}
+}
+
+static void put_name(const char *str) __attribute__ ((no_instrument_function));
+static void put_name(const char *str)
+{
+	uint8_t len = strlen(str);
+
+	if (len > PROFILING_EXPORT_NAME_LEN)
+		len = PROFILING_EXPORT_NAME_LEN;
+	memcpy(&record[record_len], str, len);
+	record_len += len;
+}
+
+static void begin_record(uint8_t type) __attribute__ ((no_instrument_function));
+static void begin_record(uint8_t type)
+{
+	record_len = 0;
+	put8(type);
+	/* Payload length, set by end_record() */
+	put8(0);
+}
+
+static void end_record(void) __attribute__ ((no_instrument_function));
+static void end_record(void)
+{
+	record[1] = record_len - 2;
+}
+
+#if PROFILING_EXPORT_SPROF && SPROFILE_PROCESS
+/* Returns 1 if the process of site i did not occur in an earlier site */
+static uint8_t first_process(struct sprofile_t *sprof, uint16_t i) __attribute__ ((no_instrument_function));
+static uint8_t first_process(struct sprofile_t *sprof, uint16_t i)
+{
+	uint16_t j;
+
+	if (sprof->sites[i].process == NULL)
+		return 0;
+
+	for (j=0; j<i; j++) {
+		if (sprof->sites[j].calls != 0 && sprof->sites[j].process == sprof->sites[i].process)
+			return 0;
+	}
+	return 1;
+}
+#endif
+
+#if PROFILING_EXPORT_PROF
+static uint8_t prof_record(void) __attribute__ ((no_instrument_function));
+static uint8_t prof_record(void)
+{
+	struct profile_t *prof = profiling_get();
+	struct profile_site_t *site;
+
+	if (stage == STAGE_BEGIN) {
+		begin_record(PROFILING_EXPORT_PROF_BEGIN);
+		put8(sizeof(void *));
+		put8(ARCHADDR_SHIFT);
+		put_value(prof->num_sites, 2);
+		put_value(prof->max_sites, 2);
+		put_value(prof->time_run, 4);
+		put_value(CLOCK_SECOND*256l, 4);
+		put_name(name);
+		end_record();
+		stage = STAGE_SITES;
+		return 1;
+	}
+
+	for (; cursor < prof->max_sites; cursor++) {
+		site = &prof->sites[cursor];
+		if (site->addr == NULL)
+			continue;
+
+		begin_record(PROFILING_EXPORT_PROF_SITE);
+		put_value((uintptr_t)site->from, sizeof(void *));
+		put_value((uintptr_t)site->addr, sizeof(void *));
+		put_value(site->calls, 4);
+		put_value(site->time_accum, 4);
+		put_value(site->time_min, 2);
+		put_value(site->time_max, 2);
+		put_value(site->time_self, 4);
+		end_record();
+		cursor++;
+		return 1;
+	}
+
+	return 0;
+}
+#endif /* PROFILING_EXPORT_PROF */
+
+#if PROFILING_EXPORT_SPROF
+static uint8_t sprof_record(void) __attribute__ ((no_instrument_function));
+static uint8_t sprof_record(void)
+{
+	struct sprofile_t *sprof = sprofiling_get();
+	struct sprofile_site_t *site;
+	uint8_t i;
+
+	if (stage == STAGE_BEGIN) {
+		begin_record(PROFILING_EXPORT_SPROF_BEGIN);
+		put8(sizeof(void *));
+		put8(ARCHADDR_SHIFT);
+		put8(SPROFILE_FRAMES);
+		put_value(sprof->num_sites, 2);
+		put_value(sprof->max_sites, 2);
+		put_value(sprof->num_samples, 4);
+		put_value(sprof->dropped, 4);
+		put_name(name);
+		end_record();
+		stage = STAGE_SITES;
+		return 1;
+	}
+
+	for (; cursor < sprof->max_sites; cursor++) {
+		site = &sprof->sites[cursor];
+		if (site->calls == 0)
+			continue;
+
+#if SPROFILE_PROCESS
+		/* Name each process once before its first site */
+		if (!process_sent && first_process(sprof, cursor)) {
+			begin_record(PROFILING_EXPORT_PROCESS);
+			put_value((uintptr_t)site->process, sizeof(void *));
+			put_name(PROCESS_NAME_STRING(site->process));
+			end_record();
+			process_sent = 1;
+			return 1;
+		}
+		process_sent = 0;
+#endif
+
+		begin_record(PROFILING_EXPORT_SPROF_SITE);
+		put_value(site->calls, 2);
+#if SPROFILE_PROCESS
+		put_value((uintptr_t)site->process, sizeof(void *));
+#else
+		put_value(0, sizeof(void *));
+#endif
+		for (i=0; i<SPROFILE_FRAMES; i++)
+			put_value((uintptr_t)site->addr[i], sizeof(void *));
+		end_record();
+		cursor++;
+		return 1;
+	}
+
+	return 0;
+}
+#endif /* PROFILING_EXPORT_SPROF */
+
+/* Stops the profiler whose table is exported. The export yields after
+ * every frame, the sites and the totals in the begin record would not
+ * match if the profiler kept recording in between */
+static void export_freeze(void)
+{
+#if PROFILING_EXPORT_PROF
+	if (current == PROFILING_EXPORT_WITH_PROF && (profiling_get()->status & PROFILING_STARTED)) {
+		profiling_stop();
+		resume |= current;
+	}
+#endif
+#if PROFILING_EXPORT_SPROF
+	if (current == PROFILING_EXPORT_WITH_SPROF && (sprofiling_get()->status & SPROFILING_STARTED)) {
+		sprofiling_stop();
+		resume |= current;
+	}
+#endif
+}
+
+/* Restarts the profiler once all of its sites are encoded */
+static void export_thaw(void)
+{
+	if (!(resume & current))
+		return;
+	resume &= ~current;
+
+#if PROFILING_EXPORT_PROF
+	if (current == PROFILING_EXPORT_WITH_PROF)
+		profiling_start();
+#endif
+#if PROFILING_EXPORT_SPROF
+	if (current == PROFILING_EXPORT_WITH_SPROF)
+		sprofiling_start();
+#endif
+}
+
+/* Encodes the next record, returns 0 if there is nothing left to export */
+static uint8_t export_next_record(void)
+{
+	if (stage == STAGE_IDLE) {
+		if (pending & PROFILING_EXPORT_WITH_PROF)
+			current = PROFILING_EXPORT_WITH_PROF;
+		else if (pending & PROFILING_EXPORT_WITH_SPROF)
+			current = PROFILING_EXPORT_WITH_SPROF;
+		else
+			return 0;
+
+		pending &= ~current;
+		stage = STAGE_BEGIN;
+		cursor = 0;
+		export_freeze();
+	}
+
+#if PROFILING_EXPORT_PROF
+	if (current == PROFILING_EXPORT_WITH_PROF && prof_record())
+		return 1;
+#endif
+#if PROFILING_EXPORT_SPROF
+	if (current == PROFILING_EXPORT_WITH_SPROF && sprof_record())
+		return 1;
+#endif
+
+	/* All sites are sent */
+	begin_record(PROFILING_EXPORT_END);
+	put8(current);
+	end_record();
+	export_thaw();
+	stage = STAGE_IDLE;
+	return 1;
+}
+
+/* Moves whole records into the ring buffer until it is full */
+static void export_fill(void)
+{
+	uint8_t i;
+
+	while (1) {
+		if (record_len == 0 && !export_next_record())
+			return;
+
+		if (ringbuf_size(&ring) - 1 - ringbuf_elements(&ring) < record_len)
+			return;
+
+		for (i=0; i<record_len; i++)
+			ringbuf_put(&ring, record[i]);
+		record_len = 0;
+	}
+}
+
+/* Sends one frame from the ring buffer */
+static void export_send(void)
+{
+	uint8_t len = FRAME_HEADER;
+	int c;
+
+	frame[0] = 'P';
+	frame[1] = 'X';
+	frame[2] = seq & 0xFF;
+	frame[3] = seq >> 8;
+	frame[4] = NO_RECORD_START;
+
+	while (len < sizeof(frame) && (c = ringbuf_get(&ring)) != -1) {
+		if (expect_length) {
+			payload_left = c;
+			expect_length = 0;
+		} else if (payload_left == 0) {
+			/* A type, so a new record starts here */
+			if (frame[4] == NO_RECORD_START)
+				frame[4] = len - FRAME_HEADER;
+			expect_length = 1;
+		} else {
+			payload_left--;
+		}
+		frame[len++] = c;
+	}
+
+	if (len == FRAME_HEADER)
+		return;
+
+	seq++;
+#if PROFILING_EXPORT_UDP
+	simple_udp_sendto(&connection, frame, len, &destination);
+#else
+	slip_write(frame, len);
+#endif
+}
+
+void profiling_export_init(void)
+{
+	ringbuf_init(&ring, ring_data, sizeof(ring_data));
+	pending = 0;
+	resume = 0;
+	stage = STAGE_IDLE;
+	record_len = 0;
+	payload_left = 0;
+	expect_length = 0;
+#if PROFILING_EXPORT_UDP
+	uip_create_linklocal_allnodes_mcast(&destination);
+#endif
+
+	process_start(&profiling_export_process, NULL);
+}
+
+uint8_t profiling_export_start(const char *export_name, uint8_t which)
+{
+	if (profiling_export_busy())
+		return 0;
+
+	strncpy(name, export_name, PROFILING_EXPORT_NAME_LEN);
+	name[PROFILING_EXPORT_NAME_LEN] = '\0';
+
+#if !PROFILING_EXPORT_PROF
+	which &= ~PROFILING_EXPORT_WITH_PROF;
+#endif
+#if !PROFILING_EXPORT_SPROF
+	which &= ~PROFILING_EXPORT_WITH_SPROF;
+#endif
+	pending = which;
+
+	process_poll(&profiling_export_process);
+	return 1;
+}
+
+uint8_t profiling_export_busy(void)
+{
+	return pending || stage != STAGE_IDLE || record_len || ringbuf_elements(&ring);
+}
+
+#if PROFILING_EXPORT_UDP
+void profiling_export_set_destination(const uip_ipaddr_t *addr)
+{
+	uip_ipaddr_copy(&destination, addr);
+}
+#endif
+
+PROCESS_THREAD(profiling_export_process, ev, data)
+{
+#if PROFILING_EXPORT_INTERVAL
+	static struct etimer timer;
+#endif
+
+	PROCESS_BEGIN();
+
+	process_set_priority(&profiling_export_process, PROCESS_PRIO_BACKGROUND);
+
+#if PROFILING_EXPORT_UDP
+	simple_udp_register(&connection, PROFILING_EXPORT_UDP_PORT, NULL, PROFILING_EXPORT_UDP_PORT, NULL);
+#endif
+#if PROFILING_EXPORT_INTERVAL
+	etimer_set(&timer, PROFILING_EXPORT_INTERVAL * CLOCK_SECOND);
+#endif
+
+	while (1) {
+		PROCESS_YIELD();
+
+#if PROFILING_EXPORT_INTERVAL
+		if (ev == PROCESS_EVENT_TIMER && data == &timer) {
+			etimer_reset(&timer);
+			profiling_export_start("periodic", PROFILING_EXPORT_WITH_PROF | PROFILING_EXPORT_WITH_SPROF);
+		}
+#endif
+
+		if (!profiling_export_busy())
+			continue;
+
+		export_fill();
+		export_send();
+
+		/* Continue behind all queued events instead of polling, so the
+		 * export only runs when nothing else has to be done */
+		if (profiling_export_busy() &&
+				process_post(PROCESS_CURRENT(), PROCESS_EVENT_CONTINUE, NULL) != PROCESS_ERR_OK)
+			process_poll(PROCESS_CURRENT());
+	}
+
+	PROCESS_END();
+}
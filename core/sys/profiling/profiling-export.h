@@ -0,0 +1,107 @@
+#ifndef __PROFILING_EXPORT_H__
+#define __PROFILING_EXPORT_H__
+
+#include <stdint.h>
+
+#include "contiki.h"
+
+/*
+ * Streams the profiler tables as binary records instead of printing them.
+ * Records are encoded a few at a time into a ring buffer and sent in small
+ * frames over SLIP or UDP by a process that yields after every frame, so
+ * the node keeps running while a large table is exported. A running
+ * profiler is stopped until its last site is encoded and then restarted,
+ * so every export is a consistent snapshot. Nothing is recorded meanwhile.
+ * tools/profiling/profile-collect.py turns the stream back into reports
+ * for profile-neat.py.
+ *
+ * Frame: 'P' 'X', sequence number (16 bit), offset of the first record
+ * that starts in this frame (0xFF if none), record bytes. Records may
+ * continue in the next frame.
+ *
+ * Record: type, payload length, payload. All values are little endian,
+ * addresses have the size of a pointer.
+ */
+
+/* Export the instrumenting profiler */
+#ifdef PROFILING_EXPORT_CONF_PROF
+#define PROFILING_EXPORT_PROF PROFILING_EXPORT_CONF_PROF
+#else
+#define PROFILING_EXPORT_PROF 1
+#endif
+
+/* Export the sampling profiler, needs the arch sampling code */
+#ifdef PROFILING_EXPORT_CONF_SPROF
+#define PROFILING_EXPORT_SPROF PROFILING_EXPORT_CONF_SPROF
+#else
+#define PROFILING_EXPORT_SPROF 0
+#endif
+
+/* Send the frames as UDP datagrams instead of SLIP frames */
+#ifdef PROFILING_EXPORT_CONF_UDP
+#define PROFILING_EXPORT_UDP PROFILING_EXPORT_CONF_UDP
+#else
+#define PROFILING_EXPORT_UDP 0
+#endif
+
+#ifdef PROFILING_EXPORT_CONF_UDP_PORT
+#define PROFILING_EXPORT_UDP_PORT PROFILING_EXPORT_CONF_UDP_PORT
+#else
+#define PROFILING_EXPORT_UDP_PORT 5689
+#endif
+
+/* Size of the ring buffer, a power of two up to 128 */
+#ifdef PROFILING_EXPORT_CONF_BUFSIZE
+#define PROFILING_EXPORT_BUFSIZE PROFILING_EXPORT_CONF_BUFSIZE
+#else
+#define PROFILING_EXPORT_BUFSIZE 128
+#endif
+
+/* Record bytes per frame */
+#ifdef PROFILING_EXPORT_CONF_FRAME_SIZE
+#define PROFILING_EXPORT_FRAME_SIZE PROFILING_EXPORT_CONF_FRAME_SIZE
+#else
+#define PROFILING_EXPORT_FRAME_SIZE 64
+#endif
+
+/* Export all profiles every that many seconds, 0 only on request. Keeps
+ * the data of a run even if the node crashes before the end */
+#ifdef PROFILING_EXPORT_CONF_INTERVAL
+#define PROFILING_EXPORT_INTERVAL PROFILING_EXPORT_CONF_INTERVAL
+#else
+#define PROFILING_EXPORT_INTERVAL 0
+#endif
+
+/* Which profiles to export */
+#define PROFILING_EXPORT_WITH_PROF 1
+#define PROFILING_EXPORT_WITH_SPROF 2
+
+/* Record types */
+#define PROFILING_EXPORT_PROF_BEGIN 1
+#define PROFILING_EXPORT_PROF_SITE 2
+#define PROFILING_EXPORT_SPROF_BEGIN 3
+#define PROFILING_EXPORT_SPROF_SITE 4
+#define PROFILING_EXPORT_PROCESS 5
+#define PROFILING_EXPORT_END 6
+
+/* Longest name sent in a record */
+#define PROFILING_EXPORT_NAME_LEN 24
+
+/* Start the export process */
+void profiling_export_init(void) __attribute__ ((no_instrument_function));
+/* Queue an export of the selected profiles under the given name, returns
+ * 0 if an export is still running */
+uint8_t profiling_export_start(const char *name, uint8_t which) __attribute__ ((no_instrument_function));
+/* 1 while an export is running */
+uint8_t profiling_export_busy(void) __attribute__ ((no_instrument_function));
+
+#if PROFILING_EXPORT_UDP
+#include "net/ip/uip.h"
+
+/* Send to this address instead of the link local all nodes address */
+void profiling_export_set_destination(const uip_ipaddr_t *addr) __attribute__ ((no_instrument_function));
+#endif
+
+PROCESS_NAME(profiling_export_process);
+
+#endif /* __PROFILING_EXPORT_H__ */
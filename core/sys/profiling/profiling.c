@@ -54,6 +54,13 @@
 #define PROFILE_STACKSIZE 0
 #endif /* PROFILES_CONF_STACKSIZE */
 
+/* Use a mask instead of a division if the table size is a power of two */
+#if (MAX_PROFILES & (MAX_PROFILES - 1)) == 0
+#define SITE_INDEX(hash) ((hash) & (MAX_PROFILES - 1))
+#else
+#define SITE_INDEX(hash) ((hash) % MAX_PROFILES)
+#endif
+
 static struct profile_t profile;
 static struct profile_site_t site[MAX_PROFILES];
 static int fine_count;
@@ -86,6 +93,21 @@ static inline void profiling_internal(uint8_t internal)
 		profile.status &= ~PROFILING_INTERNAL;
 }
 
+/* Current time in 1/256 clock ticks */
+static inline unsigned long profiling_now(void)  __attribute__ ((no_instrument_function));
+static inline unsigned long profiling_now(void)
+{
+	clock_time_t now;
+	unsigned short now_fine;
+
+	do {
+		now_fine = clock_fine();
+		now = clock_time();
+	} while (now_fine != clock_fine());
+
+	return ((unsigned long)now<<8) + now_fine*256/fine_count;
+}
+
 void profiling_report(const char *name, uint8_t pretty)
 {
         int i;
@@ -97,13 +119,16 @@ void profiling_report(const char *name, uint8_t pretty)
 	}
 
 	if (pretty)
-		printf("PROF: \"%s\" %u sites %u max sites %lu ticks spent %lu ticks/s\nfrom:to:calls:time\n", name, profile.num_sites, profile.max_sites, profile.time_run, CLOCK_SECOND*256l);
+		printf("PROF: \"%s\" %u sites %u max sites %lu ticks spent %lu ticks/s\nfrom:to:calls:time:min:max:self\n", name, profile.num_sites, profile.max_sites, profile.time_run, CLOCK_SECOND*256l);
 	else
 		printf("PROF:%s:%u:%u:%lu:%lu\n", name, profile.num_sites, profile.max_sites, profile.time_run, CLOCK_SECOND*256l);
 
-	for(i=0; i<profile.num_sites;i++) {
-		printf("%p:%p:%lu:%lu:%u:%u\n", ARCHADDR2ADDR(profile.sites[i].from), ARCHADDR2ADDR(profile.sites[i].addr),
-				profile.sites[i].calls, profile.sites[i].time_accum, profile.sites[i].time_min, profile.sites[i].time_max);
+	for(i=0; i<profile.max_sites;i++) {
+		if (profile.sites[i].addr == NULL)
+			continue;
+		printf("%p:%p:%lu:%lu:%u:%u:%lu\n", ARCHADDR2ADDR(profile.sites[i].from), ARCHADDR2ADDR(profile.sites[i].addr),
+				profile.sites[i].calls, profile.sites[i].time_accum, profile.sites[i].time_min, profile.sites[i].time_max,
+				profile.sites[i].time_self);
 	}
 	printf("\n");
 }
@@ -117,6 +142,7 @@ void profiling_init(void)
 {
 	fine_count = clock_fine_max() + 1;
 
+	memset(site, 0, sizeof(site));
 	profile.sites = site;
 	profile.max_sites = MAX_PROFILES;
 	profile.num_sites = 0;
@@ -127,19 +153,10 @@ void profiling_init(void)
 
 void profiling_start(void)
 {
-	clock_time_t now;
-	unsigned short now_fine;
-
 	if (profile.status & PROFILING_STARTED)
 		return;
 
-	do {
-		now_fine = clock_fine();
-		now = clock_time();
-	} while (now_fine != clock_fine());
-
-
-	profile.time_start = ((unsigned long)now<<8) + now_fine*256/fine_count;
+	profile.time_start = profiling_now();
 	profile.status |= PROFILING_STARTED;
 
 	/* Reset the callstack */
@@ -149,19 +166,11 @@ void profiling_start(void)
 void profiling_stop(void)
 {
 	unsigned long temp;
-	clock_time_t now;
-	unsigned short now_fine;
 
-	if (!profile.status & PROFILING_STARTED)
+	if (!(profile.status & PROFILING_STARTED))
 		return;
 
-	do {
-		now_fine = clock_fine();
-		now = clock_time();
-	} while (now_fine != clock_fine());
-
-
-	temp = ((unsigned long)now<<8) + now_fine*256/fine_count;
+	temp = profiling_now();
 
 	profile.time_run += (temp - profile.time_start);
 	profile.status &= ~PROFILING_STARTED;
@@ -170,65 +179,52 @@ void profiling_stop(void)
 /* Don't instrument the instrumentation functions */
 void __cyg_profile_func_enter(void *, void *) __attribute__ ((no_instrument_function));
 void __cyg_profile_func_exit(void *, void *) __attribute__ ((no_instrument_function));
-static inline struct profile_site_t *find_or_add_site(void *func, void *caller, uint8_t findonly)  __attribute__ ((no_instrument_function));
+static inline uint16_t site_hash(void *func, void *caller)  __attribute__ ((no_instrument_function));
+static inline struct profile_site_t *find_or_add_site(void *func, void *caller)  __attribute__ ((no_instrument_function));
 
-static inline struct profile_site_t *find_or_add_site(void *func, void *caller, uint8_t findonly)
+static inline uint16_t site_hash(void *func, void *caller)
 {
-	struct profile_site_t *site = NULL;
-	int16_t lower, upper;
-	uint16_t newindex = 0, i;
-
-	lower = 0;
-	upper = profile.num_sites-1;
-
-	while (lower <= upper) {
-		newindex = ((upper - lower)>>1) + lower;
-		site = &profile.sites[newindex];
-		if (func > site->addr) {
-			lower = newindex + 1;
-		} else if (func < site->addr) {
-			upper = newindex - 1;
-		} else {
-			if (caller > site->from) {
-				lower = newindex + 1;
-			} else if (caller < site->from) {
-				upper = newindex - 1;
-			} else {
-				return site;
-			}
-		}
-	}
+	uint16_t hash = (uint16_t)(uintptr_t)func * 31 ^ (uint16_t)(uintptr_t)caller;
 
-	/* We only want to get an entry if it existed */
-	if (findonly)
-		return NULL;
+	return hash ^ (hash >> 7);
+}
 
-	/* Table is full - nothing we can do */
-	if (profile.num_sites == profile.max_sites)
-		return NULL;
+/* Open addressing with linear probing, sites are never removed */
+static inline struct profile_site_t *find_or_add_site(void *func, void *caller)
+{
+	struct profile_site_t *site;
+	uint16_t index, probes;
+
+	index = SITE_INDEX(site_hash(func, caller));
+
+	for (probes = 0; probes < profile.max_sites; probes++) {
+		site = &profile.sites[index];
+		if (site->addr == func && site->from == caller)
+			return site;
+
+		if (site->addr == NULL) {
+			profile.num_sites++;
+			site->from = caller;
+			site->addr = func;
+			site->calls = 0;
+			site->time_max = 0;
+			site->time_min = 0xFFFF;
+			site->time_accum = 0;
+			site->time_self = 0;
+			return site;
+		}
 
-	newindex = lower;
-	/* Site not found, need to insert it */
-	for (i = profile.num_sites; i>newindex; i--) {
-		memcpy(&profile.sites[i], &profile.sites[i-1], sizeof(struct profile_site_t));
+		if (++index == profile.max_sites)
+			index = 0;
 	}
-	profile.num_sites++;
-	site = &profile.sites[newindex];
-	site->from = caller;
-	site->addr = func;
-	site->calls = 0;
-	site->time_max = 0;
-	site->time_min = 0xFFFF;
-	site->time_accum = 0;
-
-	return site;
+
+	/* Table is full and the site is not in it - nothing we can do */
+	return NULL;
 }
 
 void __cyg_profile_func_enter(void *func, void *caller)
 {
       struct profile_site_t *site;
-      clock_time_t now;
-      unsigned short now_fine;
 
       if (!(profile.status&PROFILING_STARTED) || (profile.status&PROFILING_INTERNAL))
 	      return;
@@ -238,19 +234,16 @@ void __cyg_profile_func_enter(void *func, void *caller)
       if (stacklevel >= PROFILE_STACKSIZE)
 	      goto out;
 
-      site = find_or_add_site(func, caller, 0);
+      site = find_or_add_site(func, caller);
       if (!site)
 	      goto out;
 
       /* Update the call stack */
-      do {
-	      now_fine = clock_fine();
-	      now = clock_time();
-      } while (now_fine != clock_fine());
-
-      callstack[stacklevel].time_start = ((unsigned long)now<<8) + now_fine*256/fine_count;
       callstack[stacklevel].func = func;
       callstack[stacklevel].caller = caller;
+      callstack[stacklevel].site = site;
+      callstack[stacklevel].time_children = 0;
+      callstack[stacklevel].time_start = profiling_now();
 
       stacklevel++;
 
@@ -261,38 +254,36 @@ out:
 void __cyg_profile_func_exit(void *func, void *caller)
 {
 	unsigned long temp;
+	struct profile_callstack_t *frame;
 	struct profile_site_t *site;
-	clock_time_t now;
-	unsigned short now_fine;
 
       if (!(profile.status&PROFILING_STARTED) || (profile.status&PROFILING_INTERNAL))
 	      return;
 
       profiling_internal(1);
 
-      do {
-	      now_fine = clock_fine();
-	      now = clock_time();
-      } while (now_fine != clock_fine());
-
-      temp = ((unsigned long)now<<8) + now_fine*256/fine_count;
+      temp = profiling_now();
 
       /* See if this call was recorded on the call stack */
-      if (stacklevel > 0 && callstack[stacklevel-1].func == func &&
-		      callstack[stacklevel-1].caller == caller) {
-	      temp = temp - callstack[stacklevel-1].time_start;
-	      stacklevel--;
-      } else {
+      if (stacklevel <= 0)
 	      goto out;
-      }
 
-      site = find_or_add_site(func, caller, 1);
-      if (!site)
+      frame = &callstack[stacklevel-1];
+      if (frame->func != func || frame->caller != caller)
 	      goto out;
 
+      temp = temp - frame->time_start;
+      stacklevel--;
+
+      /* The caller spent this time in a callee */
+      if (stacklevel > 0)
+	      callstack[stacklevel-1].time_children += temp;
+
       /* Update calls and time */
+      site = frame->site;
       site->calls++;
       site->time_accum += temp;
+      site->time_self += temp - frame->time_children;
 
       /* Min max calculation */
       if (temp > site->time_max) {
@@ -303,12 +294,6 @@ void __cyg_profile_func_exit(void *func, void *caller)
       if (temp < site->time_min)
 	      site->time_min = temp;
 
-      profiling_internal(0);
-      return;
-
 out:
-      /* We didn't find the entry, abort */
       profiling_internal(0);
 }
-
-
@@ -6,10 +6,16 @@
 #define PROFILING_STARTED 1
 #define PROFILING_INTERNAL 2
 
+struct profile_site_t;
+
 struct profile_callstack_t {
 	void *func;
 	void *caller;
 	unsigned long time_start;
+	/* Time spent in instrumented callees */
+	unsigned long time_children;
+	/* Site of this call, saves the lookup on exit */
+	struct profile_site_t *site;
 };
 
 /* The structure that holds the callsites */
@@ -20,8 +26,11 @@ struct profile_site_t {
 	uint16_t time_min;
 	uint16_t time_max;
 	unsigned long time_accum;
+	/* Time without the instrumented callees */
+	unsigned long time_self;
 };
 
+/* sites is a hash table of max_sites entries, unused ones have addr NULL */
 struct profile_t {
 	int status;
 	uint16_t max_sites;
@@ -39,6 +39,7 @@
 
 #include "contiki.h"
 #include "sys/profiling/sprofiling.h"
+#include "profiling_arch.h"
 
 #ifdef SPROFILES_CONF_MAX
 #define MAX_PROFILES SPROFILES_CONF_MAX
@@ -46,12 +47,46 @@
 #define MAX_PROFILES 1
 #endif /* MAX_CONF_PROFILES */
 
+/* Use a mask instead of a division if the table size is a power of two */
+#if (MAX_PROFILES & (MAX_PROFILES - 1)) == 0
+#define SITE_INDEX(hash) ((hash) & (MAX_PROFILES - 1))
+#else
+#define SITE_INDEX(hash) ((hash) % MAX_PROFILES)
+#endif
+
+/* Shift that turns the recorded addresses into byte addresses */
+#ifndef ARCHADDR_SHIFT
+#define ARCHADDR_SHIFT 0
+#endif
+
+#define SPROFILE_DUMP_VERSION 1
+/* Bytes per line of the hex encoded dump */
+#define SPROFILE_DUMP_LINE 32
+
 static struct sprofile_t stat_profile;
 static struct sprofile_site_t stat_site[MAX_PROFILES];
+static uint8_t dump_column;
+
+static struct process *site_process(struct sprofile_site_t *site)
+{
+#if SPROFILE_PROCESS
+	return site->process;
+#else
+	return NULL;
+#endif
+}
+
+/* Samples taken outside of a process have no process to name */
+static const char *site_name(struct sprofile_site_t *site)
+{
+	struct process *p = site_process(site);
+
+	return p ? PROCESS_NAME_STRING(p) : "none";
+}
 
 void sprofiling_report(const char* name, uint8_t pretty)
 {
-	int i;
+	int i, j;
 
 	/* The parser would be confused if the name contains colons or newlines, so disallow */
 	if (!name || strchr(name, ':') || strchr(name, '\r') || strchr(name, '\n')) {
@@ -60,13 +95,120 @@ void sprofiling_report(const char* name, uint8_t pretty)
 	}
 
 	if (pretty)
-		printf("\nSPROF: \"%s\" %u sites %u max_sites %lu samples\npc:calls\n", name, stat_profile.num_sites, stat_profile.max_sites, stat_profile.num_samples);
+		printf("\nSPROF: \"%s\" %u sites %u max_sites %lu samples %lu dropped %u frames\npc:calls:callers:process\n", name, stat_profile.num_sites, stat_profile.max_sites, stat_profile.num_samples, stat_profile.dropped, SPROFILE_FRAMES);
 	else
-		printf("\nSPROF:%s:%u:%u:%lu\n", name, stat_profile.num_sites, stat_profile.max_sites, stat_profile.num_samples);
+		printf("\nSPROF:%s:%u:%u:%lu:%lu:%u\n", name, stat_profile.num_sites, stat_profile.max_sites, stat_profile.num_samples, stat_profile.dropped, SPROFILE_FRAMES);
+
+	for(i=0; i<stat_profile.max_sites;i++) {
+		if (stat_profile.sites[i].calls == 0)
+			continue;
+		printf("%p:%u", ARCHADDR2ADDR(stat_profile.sites[i].addr[0]), stat_profile.sites[i].calls);
+		for (j=1; j<SPROFILE_FRAMES; j++)
+			printf(":%p", ARCHADDR2ADDR(stat_profile.sites[i].addr[j]));
+#if SPROFILE_PROCESS
+		printf(":%s", site_name(&stat_profile.sites[i]));
+#endif
+		printf("\n");
+	}
+}
+
+static void dump_byte(uint8_t byte)
+{
+	printf("%02x", byte);
+	if (++dump_column == SPROFILE_DUMP_LINE) {
+		printf("\n");
+		dump_column = 0;
+	}
+}
+
+static void dump_value(uintptr_t value, uint8_t size)
+{
+	/* Little endian regardless of the architecture */
+	while (size--) {
+		dump_byte(value & 0xFF);
+		value >>= 8;
+	}
+}
+
+/* Returns 1 if the process of site i did not occur in an earlier site */
+static uint8_t first_process(int i)
+{
+	int j;
+	struct process *p = site_process(&stat_profile.sites[i]);
+
+	if (p == NULL)
+		return 0;
 
-	for(i=0; i<stat_profile.num_sites;i++) {
-		printf("%p:%u\n", stat_profile.sites[i].addr, stat_profile.sites[i].calls);
+	for (j=0; j<i; j++) {
+		if (stat_profile.sites[j].calls != 0 && site_process(&stat_profile.sites[j]) == p)
+			return 0;
 	}
+	return 1;
+}
+
+/*
+ * Format (little endian):
+ * "SPRB", version, frames, address size, address shift,
+ * sites (16 bit), samples (32 bit), dropped (32 bit), processes (8 bit),
+ * processes x {process, name length (8 bit), name},
+ * sites x {calls (16 bit), process, frames x address}
+ */
+void sprofiling_dump(const char* name)
+{
+	int i, j;
+	uint8_t num_processes = 0, len;
+	const char *pname;
+
+	if (!name || strchr(name, ':') || strchr(name, '\r') || strchr(name, '\n')) {
+		printf("The profile report name is invalid\n");
+		name = "invalid";
+	}
+
+	for (i=0; i<stat_profile.max_sites; i++) {
+		if (stat_profile.sites[i].calls != 0 && first_process(i) && num_processes < 0xFF)
+			num_processes++;
+	}
+
+	printf("\nSPROFBIN:%s\n", name);
+	dump_column = 0;
+
+	dump_byte('S');
+	dump_byte('P');
+	dump_byte('R');
+	dump_byte('B');
+	dump_byte(SPROFILE_DUMP_VERSION);
+	dump_byte(SPROFILE_FRAMES);
+	dump_byte(sizeof(void *));
+	dump_byte(ARCHADDR_SHIFT);
+	dump_value(stat_profile.num_sites, 2);
+	dump_value(stat_profile.num_samples, 4);
+	dump_value(stat_profile.dropped, 4);
+	dump_value(num_processes, 1);
+
+	for (i=0; i<stat_profile.max_sites && num_processes > 0; i++) {
+		if (stat_profile.sites[i].calls == 0 || !first_process(i))
+			continue;
+		pname = site_name(&stat_profile.sites[i]);
+		len = strlen(pname) > 0xFF ? 0xFF : strlen(pname);
+		dump_value((uintptr_t)site_process(&stat_profile.sites[i]), sizeof(void *));
+		dump_byte(len);
+		for (j=0; j<len; j++)
+			dump_byte(pname[j]);
+		num_processes--;
+	}
+
+	for (i=0; i<stat_profile.max_sites; i++) {
+		if (stat_profile.sites[i].calls == 0)
+			continue;
+		dump_value(stat_profile.sites[i].calls, 2);
+		dump_value((uintptr_t)site_process(&stat_profile.sites[i]), sizeof(void *));
+		for (j=0; j<SPROFILE_FRAMES; j++)
+			dump_value((uintptr_t)stat_profile.sites[i].addr[j], sizeof(void *));
+	}
+
+	if (dump_column)
+		printf("\n");
+	printf("\n");
 }
 
 struct sprofile_t *sprofiling_get()
@@ -74,39 +216,98 @@ struct sprofile_t *sprofiling_get()
 	return &stat_profile;
 }
 
-inline void sprofiling_add_sample(void *pc)
+static inline uint16_t site_hash(void **trace)
+{
+	uint16_t hash = 0;
+	uint8_t i;
+
+	for (i=0; i<SPROFILE_FRAMES; i++)
+		hash = hash * 31 + (uint16_t)(uintptr_t)trace[i];
+#if SPROFILE_PROCESS
+	hash ^= (uint16_t)(uintptr_t)PROCESS_CURRENT() * 7;
+#endif
+
+	return hash ^ (hash >> 7);
+}
+
+static inline uint8_t site_match(struct sprofile_site_t *site, void **trace)
+{
+#if SPROFILE_PROCESS
+	if (site->process != PROCESS_CURRENT())
+		return 0;
+#endif
+	return memcmp(site->addr, trace, sizeof(site->addr)) == 0;
+}
+
+/* Called from the sampling interrupt - open addressing with linear probing */
+void sprofiling_add_trace(void **trace, uint8_t depth)
+{
+	void *frames[SPROFILE_FRAMES];
+	struct sprofile_site_t *site;
+	uint16_t index, probes;
+
+	if (depth > SPROFILE_FRAMES)
+		depth = SPROFILE_FRAMES;
+	memcpy(frames, trace, depth * sizeof(void *));
+	memset(&frames[depth], 0, (SPROFILE_FRAMES - depth) * sizeof(void *));
+
+	index = SITE_INDEX(site_hash(frames));
+
+	for (probes = 0; probes < stat_profile.max_sites; probes++) {
+		site = &stat_profile.sites[index];
+		if (site->calls == 0) {
+			memcpy(site->addr, frames, sizeof(site->addr));
+#if SPROFILE_PROCESS
+			site->process = PROCESS_CURRENT();
+#endif
+			site->calls = 1;
+			stat_profile.num_sites++;
+			stat_profile.num_samples++;
+			return;
+		}
+
+		if (site_match(site, frames)) {
+			if (site->calls == 0xFFFF)
+				break;
+			site->calls++;
+			stat_profile.num_samples++;
+			return;
+		}
+
+		if (++index == stat_profile.max_sites)
+			index = 0;
+	}
+
+	/* Table is full or the counter saturated */
+	stat_profile.dropped++;
+}
+
+void sprofiling_add_sample(void *pc)
 {
-        uint8_t i;
-        for (i=0;i<stat_profile.num_sites;i++) {
-                if (stat_profile.sites[i].addr == pc)
-                        break;
-        }
-        if (i<stat_profile.max_sites) {
-                if (i==stat_profile.num_sites) {
-                        stat_profile.sites[i].addr = pc;
-                        stat_profile.sites[i].calls = 1;
-                        stat_profile.num_sites++;
-                } else {
-                        stat_profile.sites[i].calls++;
-                }
-		stat_profile.num_samples++;
-        }
+	sprofiling_add_trace(&pc, 1);
 }
 
 void sprofiling_init(void)
 {
+	memset(stat_site, 0, sizeof(stat_site));
 	stat_profile.sites = stat_site;
 	stat_profile.max_sites = MAX_PROFILES;
+	stat_profile.status = 0;
+	stat_profile.num_sites = 0;
+	stat_profile.num_samples = 0;
+	stat_profile.dropped = 0;
 
 	sprofiling_arch_init();
 }
 
 inline void sprofiling_start(void)
 {
+	stat_profile.status |= SPROFILING_STARTED;
 	sprofiling_arch_start();
 }
 
 inline void sprofiling_stop(void)
 {
 	sprofiling_arch_stop();
+	stat_profile.status &= ~SPROFILING_STARTED;
 }
@@ -3,16 +3,42 @@
 
 #include <stdint.h>
 
-/* The structure that holds the callsites */
+/* Number of return addresses recorded per sample (1-4), 1 only records the pc */
+#ifdef SPROFILES_CONF_FRAMES
+#define SPROFILE_FRAMES SPROFILES_CONF_FRAMES
+#else
+#define SPROFILE_FRAMES 1
+#endif /* SPROFILES_CONF_FRAMES */
+
+/* Record the process that was running when the sample was taken */
+#ifdef SPROFILES_CONF_PROCESS
+#define SPROFILE_PROCESS SPROFILES_CONF_PROCESS
+#else
+#define SPROFILE_PROCESS 1
+#endif /* SPROFILES_CONF_PROCESS */
+
+#define SPROFILING_STARTED 1
+
+struct process;
+
+/* The structure that holds the callsites, addr[0] is the sampled pc and
+ * addr[1..] are its callers or NULL if they could not be found */
 struct sprofile_site_t {
-	void *addr;
+	void *addr[SPROFILE_FRAMES];
+#if SPROFILE_PROCESS
+	struct process *process;
+#endif
 	uint16_t calls;
 };
 
+/* sites is a hash table of max_sites entries, unused ones have calls 0 */
 struct sprofile_t {
+	uint8_t status;
 	uint16_t max_sites;
 	uint16_t num_sites;
 	uint32_t num_samples;
+	/* Samples lost because the table was full or a counter saturated */
+	uint32_t dropped;
 	struct sprofile_site_t *sites;
 };
 
@@ -22,8 +48,12 @@ void sprofiling_init(void);
 void sprofiling_start(void);
 void sprofiling_stop(void);
 void sprofiling_report(const char* name, uint8_t pretty);
+/* Print the profile in the compact binary format, hex encoded */
+void sprofiling_dump(const char* name);
 struct sprofile_t *sprofiling_get(void);
-inline void sprofiling_add_sample(void *pc);
+void sprofiling_add_sample(void *pc);
+/* Add a sample with up to SPROFILE_FRAMES return addresses, pc first */
+void sprofiling_add_trace(void **trace, uint8_t depth);
 
 /* Arch functions */
 void sprofiling_arch_init(void);
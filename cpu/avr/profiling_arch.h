@@ -3,5 +3,7 @@
 #include <stdint.h>
 
 #define ARCHADDR2ADDR(x) (void *)((unsigned int)x<<1)
+/* Code addresses are word addresses */
+#define ARCHADDR_SHIFT 1
 
 #endif /* __PROFILING_ARCH_H__ */
@@ -64,6 +64,7 @@
 #include "rf230bb.h"
 
 #include "net/packetbuf.h"
+#include "net/pbuf.h"
 #include "net/rime/rimestats.h"
 #include "net/netstack.h"
 
@@ -143,6 +144,15 @@ uint8_t ack_pending,ack_seqnum;
 #warning RF230 Untested Configuration!
 #endif
 
+/* Send frames straight from the pbuf that backs the packetbuf instead of
+ * copying them to the transmit buffer first. Only possible when the
+ * driver appends nothing to the frame */
+#if PBUF_NUM && !RF230_CONF_CHECKSUM && AUX_LEN == CHECKSUM_LEN && !defined(RF230BB_HOOK_TX_PACKET)
+#define RF230_PBUF_TX 1
+#else
+#define RF230_PBUF_TX 0
+#endif
+
 struct timestamp {
   uint16_t time;
   uint8_t authority_level;
@@ -913,6 +923,11 @@ void rf230_warm_reset(void) {
 }
 /*---------------------------------------------------------------------------*/
 static uint8_t buffer[RF230_MAX_TX_FRAME_LENGTH+AUX_LEN];
+/* The prepared frame, in the transmit buffer or in tx_pbuf */
+static uint8_t *tx_frame = buffer;
+#if RF230_PBUF_TX
+static struct pbuf *tx_pbuf;
+#endif /* RF230_PBUF_TX */
 
 static int
 rf230_transmit(unsigned short payload_len)
@@ -1000,7 +1015,7 @@ rf230_transmit(unsigned short payload_len)
    * (for the synchronization header) before the transceiver sends the PHR. */
   hal_set_slptr_high();
   hal_set_slptr_low();
-  hal_frame_write(buffer, total_len);
+  hal_frame_write(tx_frame, total_len);
 
   HAL_LEAVE_CRITICAL_REGION();
   PRINTF("rf230_transmit: %d\n", (int)total_len);
@@ -1012,7 +1027,7 @@ rf230_transmit(unsigned short payload_len)
   {
     uint8_t i;
     PRINTF("0000");       //Start a new wireshark packet
-    for (i=0;i<total_len;i++) PRINTF(" %02x",buffer[i]);
+    for (i=0;i<total_len;i++) PRINTF(" %02x",tx_frame[i]);
     PRINTF("\n");
   }
 #endif
@@ -1081,7 +1096,7 @@ rf230_transmit(unsigned short payload_len)
       RIMESTATS_ADD(ackrx);		//ack was requested and received
 #if RF230_INSERTACK
   /* Not PAN broadcast to FFFF, and ACK was requested and received */
-  if (!((buffer[5]==0xff) && (buffer[6]==0xff)) && (buffer[0]&(1<<6)))
+  if (!((tx_frame[5]==0xff) && (tx_frame[6]==0xff)) && (tx_frame[0]&(1<<6)))
     ack_pending=1;
 #endif
 
@@ -1129,6 +1144,15 @@ rf230_prepare(const void *payload, unsigned short payload_len)
 
   RIMESTATS_ADD(tx);
 
+#if RF230_PBUF_TX
+  /* Release the pbuf of the previous frame */
+  if(tx_pbuf != NULL) {
+    pbuf_free(tx_pbuf);
+    tx_pbuf = NULL;
+  }
+#endif /* RF230_PBUF_TX */
+  tx_frame = buffer;
+
 #if RF230_CONF_CHECKSUM
   checksum = crc16_data(payload, payload_len, 0);
 #endif
@@ -1143,6 +1167,19 @@ rf230_prepare(const void *payload, unsigned short payload_len)
     ret = -1;
     goto bail;
   }
+
+#if RF230_PBUF_TX
+  /* The frame is the packetbuf backed by a pbuf, send it from there and
+   * hold the pbuf until the next frame is prepared */
+  tx_pbuf = packetbuf_pbuf();
+  if(tx_pbuf != NULL && payload == pbuf_dataptr(tx_pbuf)) {
+    pbuf_ref(tx_pbuf);
+    tx_frame = (uint8_t *)payload;
+    goto bail;
+  }
+  tx_pbuf = NULL;
+#endif /* RF230_PBUF_TX */
+
   pbuf=&buffer[0];
   memcpy(pbuf,payload,payload_len);
   pbuf+=payload_len;
@@ -1360,6 +1397,9 @@ PROCESS_THREAD(rf230_process, ev, data)
   PROCESS_BEGIN();
   RF230PROCESSFLAG(99);
 
+  /* Received frames are handed to the MAC layer before other events */
+  process_set_priority(&rf230_process, PROCESS_PRIO_URGENT);
+
   while(1) {
     PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL);
     RF230PROCESSFLAG(42);
@@ -3,8 +3,89 @@
 
 #include "contiki.h"
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 
-#include "sys/sprofiling.h"
+#include "sys/profiling/sprofiling.h"
+
+/* Number of stack bytes searched for return addresses */
+#ifdef SPROFILES_CONF_STACK_SCAN
+#define SPROFILE_STACK_SCAN SPROFILES_CONF_STACK_SCAN
+#else
+#define SPROFILE_STACK_SCAN 64
+#endif
+
+#if SPROFILE_FRAMES > 1 && defined(__AVR_3_BYTE_PC__)
+#error "Caller capture is only supported with a 16 bit program counter."
+#endif
+
+#if SPROFILE_FRAMES > 1
+#if FLASHEND > 0xFFFF
+#define read_code_word(word) pgm_read_word_far((uint32_t)(word) << 1)
+#else
+#define read_code_word(word) pgm_read_word((uint16_t)(word) << 1)
+#endif
+
+/*
+ * Returns 1 if the instruction before the word address ret is a call,
+ * which makes ret a plausible return address.
+ */
+static inline uint8_t sprofiling_is_return_address(uint16_t ret) __attribute__ ((always_inline));
+static inline uint8_t sprofiling_is_return_address(uint16_t ret)
+{
+	uint16_t op;
+
+	if (ret < 2 || ret > (FLASHEND >> 1))
+		return 0;
+
+	/* rcall, icall and eicall are one word */
+	op = read_code_word(ret - 1);
+	if ((op & 0xF000) == 0xD000 || op == 0x9509 || op == 0x9519)
+		return 1;
+
+	/* call is two words */
+	op = read_code_word(ret - 2);
+	return (op & 0xFE0E) == 0x940E;
+}
+
+/*
+ * There are no frame pointers, so the stack is searched for the pc pushed
+ * by the interrupt and above it for values that follow a call instruction.
+ * Saved registers or local variables can still be taken for a caller, so
+ * treat the callers as a hint.
+ */
+static inline uint8_t sprofiling_capture(void **trace, void *pc) __attribute__ ((always_inline));
+static inline uint8_t sprofiling_capture(void **trace, void *pc)
+{
+	uint8_t *sp, *end;
+	uint16_t value;
+	uint8_t depth = 1;
+
+	trace[0] = pc;
+
+	sp = (uint8_t *)SP + 1;
+	end = sp + SPROFILE_STACK_SCAN;
+	if (end > (uint8_t *)RAMEND)
+		end = (uint8_t *)RAMEND;
+
+	/* The return address is stored high byte first, accept both byte
+	 * orders for the pc as gcc versions differ */
+	for (; sp < end; sp++) {
+		value = ((uint16_t)sp[0] << 8) | sp[1];
+		if (value == (uint16_t)pc || value == (((uint16_t)pc << 8) | ((uint16_t)pc >> 8)))
+			break;
+	}
+
+	for (sp += 2; sp < end && depth < SPROFILE_FRAMES; sp++) {
+		value = ((uint16_t)sp[0] << 8) | sp[1];
+		if (sprofiling_is_return_address(value)) {
+			trace[depth++] = (void *)value;
+			sp++;
+		}
+	}
+
+	return depth;
+}
+#endif /* SPROFILE_FRAMES > 1 */
 
 
 /* For the INGA platform */
@@ -16,6 +97,9 @@ ISR(TIMER2_COMPB_vect)
 	uint8_t i;
 	void *pc;
 	uint8_t tccr;
+#if SPROFILE_FRAMES > 1
+	void *trace[SPROFILE_FRAMES];
+#endif
 
 	/* Move the interrupt around to avoid aliasing effects*/
 	OCR2B = (OCR2B + 29)%(32768/8/CLOCK_CONF_SECOND);
@@ -30,7 +114,11 @@ ISR(TIMER2_COMPB_vect)
 
 	/* The AVR stores the word offset - not the address itself
 	 * in the PC - beware when editing */
+#if SPROFILE_FRAMES > 1
+	sprofiling_add_trace(trace, sprofiling_capture(trace, pc));
+#else
 	sprofiling_add_sample(pc);
+#endif
 }
 
 inline void sprofiling_arch_start(void)
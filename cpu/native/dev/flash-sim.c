@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2013, Institute of Operating Systems and Computer Networks (TU Braunschweig).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      Simulated AT45DB dataflash for the native platform
+ */
+
+#include "dev/flash-sim.h"
+#include "dev/storage-sim.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/** Time for sending a command in us */
+#ifdef FLASH_SIM_CONF_CMD_US
+#define FLASH_SIM_CMD_US FLASH_SIM_CONF_CMD_US
+#else
+#define FLASH_SIM_CMD_US 10
+#endif
+
+/** Time for transferring 16 bytes over SPI in us (8 MHz SPI clock) */
+#ifdef FLASH_SIM_CONF_16_BYTES_US
+#define FLASH_SIM_16_BYTES_US FLASH_SIM_CONF_16_BYTES_US
+#else
+#define FLASH_SIM_16_BYTES_US 16
+#endif
+
+/** Busy time of a page program with built-in erase in us */
+#ifdef FLASH_SIM_CONF_PROGRAM_US
+#define FLASH_SIM_PROGRAM_US FLASH_SIM_CONF_PROGRAM_US
+#else
+#define FLASH_SIM_PROGRAM_US 17000
+#endif
+
+/** Busy time of a page erase in us */
+#ifdef FLASH_SIM_CONF_PAGE_ERASE_US
+#define FLASH_SIM_PAGE_ERASE_US FLASH_SIM_CONF_PAGE_ERASE_US
+#else
+#define FLASH_SIM_PAGE_ERASE_US 13000
+#endif
+
+/** Busy time of a block erase in us */
+#ifdef FLASH_SIM_CONF_BLOCK_ERASE_US
+#define FLASH_SIM_BLOCK_ERASE_US FLASH_SIM_CONF_BLOCK_ERASE_US
+#else
+#define FLASH_SIM_BLOCK_ERASE_US 30000
+#endif
+
+#define TRANSFER_US(bytes) (((uint32_t) (bytes) * FLASH_SIM_16_BYTES_US) / 16)
+
+static int fd = -1;
+
+/* End of the busy phase of the last program or erase */
+static storage_sim_time_t busy_until = 0;
+
+static struct flash_sim_stats stats;
+/*---------------------------------------------------------------------------*/
+static void
+elapse(uint32_t us)
+{
+  storage_sim_elapse(us);
+  stats.time_us += us;
+}
+/*---------------------------------------------------------------------------*/
+static void
+wait_ready(void)
+{
+  storage_sim_time_t waited = storage_sim_wait_until(busy_until);
+
+  stats.busy_us += waited;
+  stats.time_us += waited;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+in_range(uint16_t page, uint16_t offset, uint16_t bytes)
+{
+  if(fd < 0 && flash_sim_init() != 0) {
+    return 0;
+  }
+
+  return page < FLASH_SIM_PAGES && (uint32_t) offset + bytes <= FLASH_SIM_PAGE_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+static void
+fill(off_t start, uint32_t bytes)
+{
+  uint8_t zero[FLASH_SIM_PAGE_SIZE];
+
+  memset(zero, 0, sizeof(zero));
+  while(bytes > 0) {
+    uint32_t len = bytes < sizeof(zero) ? bytes : sizeof(zero);
+    if(pwrite(fd, zero, len, start) != len) {
+      perror("flash_sim: pwrite() failed");
+      return;
+    }
+    start += len;
+    bytes -= len;
+  }
+}
+/*---------------------------------------------------------------------------*/
+int8_t
+flash_sim_init(void)
+{
+  uint64_t size;
+
+  if(fd >= 0) {
+    return 0;
+  }
+
+  fd = storage_sim_open_image("CONTIKI_FLASH", (uint64_t) FLASH_SIM_PAGES * FLASH_SIM_PAGE_SIZE, &size);
+  if(fd < 0) {
+    return -1;
+  }
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+flash_sim_read_page(uint16_t page, uint16_t offset, uint8_t *buffer, uint16_t bytes)
+{
+  if(!in_range(page, offset, bytes)) {
+    return;
+  }
+
+  wait_ready();
+  elapse(FLASH_SIM_CMD_US + TRANSFER_US(bytes));
+  if(pread(fd, buffer, bytes, (off_t) page * FLASH_SIM_PAGE_SIZE + offset) != bytes) {
+    perror("flash_sim: pread() failed");
+  }
+  stats.page_reads++;
+}
+/*---------------------------------------------------------------------------*/
+void
+flash_sim_write_page(uint16_t page, uint16_t offset, uint8_t *buffer, uint16_t bytes)
+{
+  if(!in_range(page, offset, bytes)) {
+    return;
+  }
+
+  /* Filling the SRAM buffer overlaps with a running program operation */
+  elapse(FLASH_SIM_CMD_US + TRANSFER_US(bytes));
+  wait_ready();
+  elapse(FLASH_SIM_CMD_US);
+  if(pwrite(fd, buffer, bytes, (off_t) page * FLASH_SIM_PAGE_SIZE + offset) != bytes) {
+    perror("flash_sim: pwrite() failed");
+  }
+  busy_until = storage_sim_now() + FLASH_SIM_PROGRAM_US;
+  stats.page_writes++;
+}
+/*---------------------------------------------------------------------------*/
+void
+flash_sim_erase_page(uint16_t page)
+{
+  if(!in_range(page, 0, 0)) {
+    return;
+  }
+
+  wait_ready();
+  elapse(FLASH_SIM_CMD_US);
+  fill((off_t) page * FLASH_SIM_PAGE_SIZE, FLASH_SIM_PAGE_SIZE);
+  busy_until = storage_sim_now() + FLASH_SIM_PAGE_ERASE_US;
+  stats.erases++;
+}
+/*---------------------------------------------------------------------------*/
+void
+flash_sim_erase_block(uint16_t block)
+{
+  if(!in_range(block * FLASH_SIM_BLOCK_PAGES, 0, 0)) {
+    return;
+  }
+
+  wait_ready();
+  elapse(FLASH_SIM_CMD_US);
+  fill((off_t) block * FLASH_SIM_BLOCK_PAGES * FLASH_SIM_PAGE_SIZE,
+       FLASH_SIM_BLOCK_PAGES * FLASH_SIM_PAGE_SIZE);
+  busy_until = storage_sim_now() + FLASH_SIM_BLOCK_ERASE_US;
+  stats.erases++;
+}
+/*---------------------------------------------------------------------------*/
+int
+flash_sim_pread(void *buf, int size, unsigned long offset)
+{
+  uint8_t *p = buf;
+  int done = 0;
+
+  while(done < size) {
+    uint16_t page = (offset + done) / FLASH_SIM_DATA_SIZE;
+    uint16_t page_offset = (offset + done) % FLASH_SIM_DATA_SIZE;
+    uint16_t len = FLASH_SIM_DATA_SIZE - page_offset;
+
+    if(len > size - done) {
+      len = size - done;
+    }
+    flash_sim_read_page(page, page_offset, p + done, len);
+    done += len;
+  }
+  return size;
+}
+/*---------------------------------------------------------------------------*/
+int
+flash_sim_pwrite(const void *buf, int size, unsigned long offset)
+{
+  const uint8_t *p = buf;
+  uint8_t page_buffer[FLASH_SIM_DATA_SIZE];
+  int done = 0;
+
+  /* A page is always programmed as a whole, so partial writes have to read
+   * the remaining content first, as the INGA Coffee driver does */
+  while(done < size) {
+    uint16_t page = (offset + done) / FLASH_SIM_DATA_SIZE;
+    uint16_t page_offset = (offset + done) % FLASH_SIM_DATA_SIZE;
+    uint16_t len = FLASH_SIM_DATA_SIZE - page_offset;
+
+    if(len > size - done) {
+      len = size - done;
+    }
+    if(len < FLASH_SIM_DATA_SIZE) {
+      flash_sim_read_page(page, 0, page_buffer, FLASH_SIM_DATA_SIZE);
+    }
+    memcpy(&page_buffer[page_offset], p + done, len);
+    flash_sim_write_page(page, 0, page_buffer, FLASH_SIM_DATA_SIZE);
+    done += len;
+  }
+  return size;
+}
+/*---------------------------------------------------------------------------*/
+int
+flash_sim_erase(long nbytes, unsigned long offset)
+{
+  unsigned long page = offset / FLASH_SIM_DATA_SIZE;
+  unsigned long end = (offset + nbytes + FLASH_SIM_DATA_SIZE - 1) / FLASH_SIM_DATA_SIZE;
+
+  /* Use block erases where possible */
+  while(page < end) {
+    if(page % FLASH_SIM_BLOCK_PAGES == 0 && page + FLASH_SIM_BLOCK_PAGES <= end) {
+      flash_sim_erase_block(page / FLASH_SIM_BLOCK_PAGES);
+      page += FLASH_SIM_BLOCK_PAGES;
+    } else {
+      flash_sim_erase_page(page);
+      page++;
+    }
+  }
+  return nbytes;
+}
+/*---------------------------------------------------------------------------*/
+const struct flash_sim_stats *
+flash_sim_get_stats(void)
+{
+  return &stats;
+}
+/*---------------------------------------------------------------------------*/
+void
+flash_sim_reset_stats(void)
+{
+  memset(&stats, 0, sizeof(stats));
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2013, Institute of Operating Systems and Computer Networks (TU Braunschweig).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \addtogroup native_storage_sim
+ * @{
+ */
+
+/**
+ * \file
+ *      Simulated AT45DB dataflash for the native platform
+ *
+ * Offers the page interface of the INGA AT45DB driver on top of an image
+ * file (environment variable CONTIKI_FLASH, a temporary file otherwise).
+ * As seen through the INGA driver, erased memory reads as zero.
+ *
+ * Writing a page fills the SRAM buffer of the chip and programs the page
+ * with built-in erase. The chip is busy while programming or erasing and
+ * every following command has to wait for it. All timing parameters can be
+ * changed with FLASH_SIM_CONF_* defines.
+ */
+
+#ifndef FLASH_SIM_H
+#define FLASH_SIM_H
+
+#include <stdint.h>
+
+/** Number of pages of the flash */
+#define FLASH_SIM_PAGES       4096
+/** Size of a page including the extra bytes */
+#define FLASH_SIM_PAGE_SIZE   528
+/** Bytes per page used by flash_sim_pread() and flash_sim_pwrite() */
+#define FLASH_SIM_DATA_SIZE   512
+/** Pages per erase block */
+#define FLASH_SIM_BLOCK_PAGES 8
+
+/** Statistics of the simulated flash */
+struct flash_sim_stats {
+  uint32_t page_reads;
+  uint32_t page_writes;
+  /** Page and block erase commands */
+  uint32_t erases;
+  /** Time spent waiting for the chip to finish programming in us */
+  uint64_t busy_us;
+  /** Total time of all operations in us */
+  uint64_t time_us;
+};
+
+/**
+ * \brief Opens the image file
+ * \retval 0 Flash is available
+ * \retval -1 Image could not be opened
+ */
+int8_t flash_sim_init(void);
+
+/** \brief Reads bytes of a page directly from the main memory */
+void flash_sim_read_page(uint16_t page, uint16_t offset, uint8_t *buffer, uint16_t bytes);
+
+/** \brief Writes bytes to a page, programming the page with built-in erase */
+void flash_sim_write_page(uint16_t page, uint16_t offset, uint8_t *buffer, uint16_t bytes);
+
+/** \brief Erases one page */
+void flash_sim_erase_page(uint16_t page);
+
+/** \brief Erases one block of FLASH_SIM_BLOCK_PAGES pages */
+void flash_sim_erase_block(uint16_t block);
+
+/**
+ * \name Linear access
+ *
+ * Access the data bytes of all pages as one linear memory, with the same
+ * semantics as the xmem interface.
+ * @{
+ */
+int flash_sim_pread(void *buf, int size, unsigned long offset);
+int flash_sim_pwrite(const void *buf, int size, unsigned long offset);
+int flash_sim_erase(long nbytes, unsigned long offset);
+/** @} */
+
+/** \brief Returns the statistics since the last reset */
+const struct flash_sim_stats *flash_sim_get_stats(void);
+
+/** \brief Resets the statistics */
+void flash_sim_reset_stats(void);
+
+#endif /* FLASH_SIM_H */
+
+/** @} */
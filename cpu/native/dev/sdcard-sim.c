@@ -0,0 +1,338 @@
+/*
+ * Copyright (c) 2013, Institute of Operating Systems and Computer Networks (TU Braunschweig).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      Simulated SD card for the native platform
+ */
+
+#include "dev/sdcard-sim.h"
+#include "dev/storage-sim.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DEBUG 0
+#if DEBUG
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#define BLOCK_SIZE 512
+
+/** Minimum size of a new image in blocks (64 MiB) */
+#ifdef SDCARD_SIM_CONF_BLOCKS
+#define SDCARD_SIM_BLOCKS SDCARD_SIM_CONF_BLOCKS
+#else
+#define SDCARD_SIM_BLOCKS 131072UL
+#endif
+
+/** Time for sending a command and receiving the response in us */
+#ifdef SDCARD_SIM_CONF_CMD_US
+#define SDCARD_SIM_CMD_US SDCARD_SIM_CONF_CMD_US
+#else
+#define SDCARD_SIM_CMD_US 40
+#endif
+
+/** Time until the card starts sending a read block in us */
+#ifdef SDCARD_SIM_CONF_ACCESS_US
+#define SDCARD_SIM_ACCESS_US SDCARD_SIM_CONF_ACCESS_US
+#else
+#define SDCARD_SIM_ACCESS_US 250
+#endif
+
+/** Time for transferring one block over SPI in us (4 MHz SPI clock) */
+#ifdef SDCARD_SIM_CONF_TRANSFER_US
+#define SDCARD_SIM_TRANSFER_US SDCARD_SIM_CONF_TRANSFER_US
+#else
+#define SDCARD_SIM_TRANSFER_US 1030
+#endif
+
+/** Busy time for programming one block in us */
+#ifdef SDCARD_SIM_CONF_PROGRAM_US
+#define SDCARD_SIM_PROGRAM_US SDCARD_SIM_CONF_PROGRAM_US
+#else
+#define SDCARD_SIM_PROGRAM_US 250
+#endif
+
+/** Size of an erase unit in blocks */
+#ifdef SDCARD_SIM_CONF_ERASE_UNIT_BLOCKS
+#define SDCARD_SIM_ERASE_UNIT_BLOCKS SDCARD_SIM_CONF_ERASE_UNIT_BLOCKS
+#else
+#define SDCARD_SIM_ERASE_UNIT_BLOCKS 128
+#endif
+
+/** Additional busy time for erasing or copying an erase unit in us */
+#ifdef SDCARD_SIM_CONF_ERASE_US
+#define SDCARD_SIM_ERASE_US SDCARD_SIM_CONF_ERASE_US
+#else
+#define SDCARD_SIM_ERASE_US 4000
+#endif
+
+#define MODE_IDLE    0
+#define MODE_READING 1
+#define MODE_WRITING 2
+
+static int fd = -1;
+static uint32_t num_blocks = 0;
+
+/* State of a running multi block transfer */
+static uint8_t mode = MODE_IDLE;
+static uint32_t next_block = 0;
+
+/* End of the busy phase of the last write */
+static storage_sim_time_t busy_until = 0;
+
+/* Erase unit that is currently written sequentially */
+static uint32_t open_unit = 0xFFFFFFFF;
+static uint32_t open_next = 0;
+
+static struct sdcard_sim_stats stats;
+/*---------------------------------------------------------------------------*/
+static void
+elapse(uint32_t us)
+{
+  storage_sim_elapse(us);
+  stats.time_us += us;
+}
+/*---------------------------------------------------------------------------*/
+static void
+wait_ready(void)
+{
+  storage_sim_time_t waited = storage_sim_wait_until(busy_until);
+
+  stats.busy_us += waited;
+  stats.time_us += waited;
+}
+/*---------------------------------------------------------------------------*/
+/* Every command has to wait until the card finished programming */
+static void
+command(void)
+{
+  wait_ready();
+  elapse(SDCARD_SIM_CMD_US);
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+read_block(uint32_t addr, uint8_t *buffer)
+{
+  if(addr >= num_blocks) {
+    return 1;
+  }
+
+  elapse(SDCARD_SIM_ACCESS_US + SDCARD_SIM_TRANSFER_US);
+  if(pread(fd, buffer, BLOCK_SIZE, (off_t) addr * BLOCK_SIZE) != BLOCK_SIZE) {
+    perror("sdcard_sim: pread() failed");
+    return 1;
+  }
+
+  stats.blocks_read++;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+write_block(uint32_t addr, uint8_t *buffer)
+{
+  uint32_t busy = SDCARD_SIM_PROGRAM_US;
+  uint32_t unit = addr / SDCARD_SIM_ERASE_UNIT_BLOCKS;
+
+  if(addr >= num_blocks) {
+    return 1;
+  }
+
+  /* The transfer overlaps with programming the previous block of a
+   * multi block write, programming this block has to wait for it */
+  elapse(SDCARD_SIM_TRANSFER_US);
+  wait_ready();
+  if(pwrite(fd, buffer, BLOCK_SIZE, (off_t) addr * BLOCK_SIZE) != BLOCK_SIZE) {
+    perror("sdcard_sim: pwrite() failed");
+    return 1;
+  }
+
+  /* Leaving the sequential stream of the open unit requires an erase */
+  if(unit != open_unit || addr < open_next) {
+    PRINTF("sdcard_sim: erase unit %lu for block %lu\n", (unsigned long) unit, (unsigned long) addr);
+    busy += SDCARD_SIM_ERASE_US;
+    open_unit = unit;
+    stats.erases++;
+  }
+  open_next = addr + 1;
+
+  busy_until = storage_sim_now() + busy;
+  stats.blocks_written++;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+sdcard_sim_init(void)
+{
+  uint64_t size;
+
+  if(fd >= 0) {
+    return 0;
+  }
+
+  fd = storage_sim_open_image("CONTIKI_SDCARD", SDCARD_SIM_BLOCKS * BLOCK_SIZE, &size);
+  if(fd < 0) {
+    return 1;
+  }
+
+  num_blocks = size / BLOCK_SIZE;
+  mode = MODE_IDLE;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+sdcard_sim_get_block_size(void)
+{
+  return BLOCK_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+sdcard_sim_get_block_num(void)
+{
+  return num_blocks;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+sdcard_sim_read_block(uint32_t addr, uint8_t *buffer)
+{
+  if(fd < 0 || mode != MODE_IDLE) {
+    return 1;
+  }
+
+  command();
+  stats.read_cmds++;
+  return read_block(addr, buffer);
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+sdcard_sim_read_multi_block_start(uint32_t addr)
+{
+  if(fd < 0 || mode != MODE_IDLE || addr >= num_blocks) {
+    return 1;
+  }
+
+  command();
+  stats.read_cmds++;
+  mode = MODE_READING;
+  next_block = addr;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+sdcard_sim_read_multi_block_next(uint8_t *buffer)
+{
+  if(mode != MODE_READING) {
+    return 1;
+  }
+
+  return read_block(next_block++, buffer);
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+sdcard_sim_read_multi_block_stop(void)
+{
+  if(mode != MODE_READING) {
+    return 1;
+  }
+
+  /* Stop transmission command */
+  elapse(SDCARD_SIM_CMD_US);
+  mode = MODE_IDLE;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+sdcard_sim_write_block(uint32_t addr, uint8_t *buffer)
+{
+  if(fd < 0 || mode != MODE_IDLE) {
+    return 1;
+  }
+
+  command();
+  stats.write_cmds++;
+  return write_block(addr, buffer);
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+sdcard_sim_write_multi_block_start(uint32_t addr, uint32_t num_blocks_hint)
+{
+  if(fd < 0 || mode != MODE_IDLE || addr >= num_blocks) {
+    return 1;
+  }
+
+  /* Pre-erase count (ACMD23) and write command */
+  if(num_blocks_hint != 0) {
+    command();
+  }
+  command();
+  stats.write_cmds++;
+  mode = MODE_WRITING;
+  next_block = addr;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+sdcard_sim_write_multi_block_next(uint8_t *buffer)
+{
+  if(mode != MODE_WRITING) {
+    return 1;
+  }
+
+  return write_block(next_block++, buffer);
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+sdcard_sim_write_multi_block_stop(void)
+{
+  if(mode != MODE_WRITING) {
+    return 1;
+  }
+
+  /* Stop tran token, the card stays busy with the last block */
+  elapse(SDCARD_SIM_CMD_US);
+  mode = MODE_IDLE;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+const struct sdcard_sim_stats *
+sdcard_sim_get_stats(void)
+{
+  return &stats;
+}
+/*---------------------------------------------------------------------------*/
+void
+sdcard_sim_reset_stats(void)
+{
+  memset(&stats, 0, sizeof(stats));
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2013, Institute of Operating Systems and Computer Networks (TU Braunschweig).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \addtogroup native_storage_sim
+ * @{
+ */
+
+/**
+ * \file
+ *      Simulated SD card for the native platform
+ *
+ * Offers the block interface of the INGA SD card driver on top of an image
+ * file (environment variable CONTIKI_SDCARD, a temporary file otherwise).
+ * Each operation is charged with a model of the SPI mode SD card timing:
+ *
+ * - every command costs a fixed overhead
+ * - every block read costs the card access time plus the transfer
+ * - every block written costs the transfer plus a busy phase for programming
+ * - writes outside the sequential stream of the currently open erase unit
+ *   additionally cost an erase, as the card has to copy or erase the unit
+ *
+ * Thus multi block transfers and sequential writes are cheaper than single
+ * block or random writes, just like on real cards. All parameters can be
+ * changed with SDCARD_SIM_CONF_* defines.
+ */
+
+#ifndef SDCARD_SIM_H
+#define SDCARD_SIM_H
+
+#include <stdint.h>
+
+/** Statistics of the simulated SD card */
+struct sdcard_sim_stats {
+  /** Single and multi block read commands */
+  uint32_t read_cmds;
+  /** Single and multi block write commands */
+  uint32_t write_cmds;
+  uint32_t blocks_read;
+  uint32_t blocks_written;
+  /** Erase units that were erased or copied */
+  uint32_t erases;
+  /** Time spent waiting for the card to finish programming in us */
+  uint64_t busy_us;
+  /** Total time of all operations in us */
+  uint64_t time_us;
+};
+
+/**
+ * \brief Opens the image file
+ * \retval 0 Card is available
+ * \retval 1 Image could not be opened
+ */
+uint8_t sdcard_sim_init(void);
+
+/** \brief Returns the block size in bytes, always 512 */
+uint16_t sdcard_sim_get_block_size(void);
+
+/** \brief Returns the number of blocks of the image */
+uint32_t sdcard_sim_get_block_num(void);
+
+/**
+ * \brief Reads one block
+ * \retval 0 Success
+ * \retval 1 Address out of range or I/O error
+ */
+uint8_t sdcard_sim_read_block(uint32_t addr, uint8_t *buffer);
+
+/**
+ * \brief Starts reading consecutive blocks
+ * \retval 0 Success
+ * \retval 1 Address out of range or a transfer is already running
+ */
+uint8_t sdcard_sim_read_multi_block_start(uint32_t addr);
+
+/** \brief Reads the next block of a multi block read */
+uint8_t sdcard_sim_read_multi_block_next(uint8_t *buffer);
+
+/** \brief Stops a multi block read */
+uint8_t sdcard_sim_read_multi_block_stop(void);
+
+/**
+ * \brief Writes one block
+ * \retval 0 Success
+ * \retval 1 Address out of range or I/O error
+ */
+uint8_t sdcard_sim_write_block(uint32_t addr, uint8_t *buffer);
+
+/**
+ * \brief Starts writing consecutive blocks
+ * \param addr First block
+ * \param num_blocks Number of blocks that will be written, 0 if unknown
+ */
+uint8_t sdcard_sim_write_multi_block_start(uint32_t addr, uint32_t num_blocks);
+
+/** \brief Writes the next block of a multi block write */
+uint8_t sdcard_sim_write_multi_block_next(uint8_t *buffer);
+
+/** \brief Stops a multi block write */
+uint8_t sdcard_sim_write_multi_block_stop(void);
+
+/** \brief Returns the statistics since the last reset */
+const struct sdcard_sim_stats *sdcard_sim_get_stats(void);
+
+/** \brief Resets the statistics */
+void sdcard_sim_reset_stats(void);
+
+#endif /* SDCARD_SIM_H */
+
+/** @} */
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2013, Institute of Operating Systems and Computer Networks (TU Braunschweig).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      Common parts of the simulated storage devices of the native platform
+ */
+
+#include "dev/storage-sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+/* Sleeping is only worth it for at least this many microseconds */
+#define REALTIME_MIN_SLEEP_US 1000
+
+static uint8_t initialized = 0;
+static uint8_t realtime = 0;
+/* Simulated clock */
+static storage_sim_time_t sim_time = 0;
+/* Realtime mode: start of the host clock and time not slept yet */
+static storage_sim_time_t host_start = 0;
+static storage_sim_time_t sleep_debt = 0;
+/*---------------------------------------------------------------------------*/
+static storage_sim_time_t
+host_time(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (storage_sim_time_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+/*---------------------------------------------------------------------------*/
+static void
+init(void)
+{
+  initialized = 1;
+  if(getenv("CONTIKI_STORAGE_REALTIME") != NULL) {
+    realtime = 1;
+    host_start = host_time();
+  }
+}
+/*---------------------------------------------------------------------------*/
+storage_sim_time_t
+storage_sim_now(void)
+{
+  if(!initialized) {
+    init();
+  }
+
+  if(realtime) {
+    return host_time() - host_start + sleep_debt;
+  }
+  return sim_time;
+}
+/*---------------------------------------------------------------------------*/
+void
+storage_sim_elapse(uint32_t us)
+{
+  if(!initialized) {
+    init();
+  }
+
+  if(!realtime) {
+    sim_time += us;
+    return;
+  }
+
+  /* Collect short delays to keep the sleeping overhead low */
+  sleep_debt += us;
+  if(sleep_debt >= REALTIME_MIN_SLEEP_US) {
+    storage_sim_time_t start = host_time();
+    storage_sim_time_t slept;
+
+    usleep(sleep_debt);
+    slept = host_time() - start;
+    sleep_debt = slept < sleep_debt ? sleep_debt - slept : 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+storage_sim_time_t
+storage_sim_wait_until(storage_sim_time_t t)
+{
+  storage_sim_time_t now = storage_sim_now();
+
+  if(t <= now) {
+    return 0;
+  }
+  storage_sim_elapse(t - now);
+  return t - now;
+}
+/*---------------------------------------------------------------------------*/
+int
+storage_sim_open_image(const char *env, uint64_t size, uint64_t *image_size)
+{
+  char *filename = getenv(env);
+  struct stat st;
+  int fd;
+
+  if(filename != NULL) {
+    fd = open(filename, O_RDWR | O_CREAT, 0644);
+    if(fd < 0) {
+      perror("Unable to open image file");
+      return -1;
+    }
+    fprintf(stderr, "storage_sim: Using \"%s\".\n", filename);
+  } else {
+    FILE *f = tmpfile();
+    if(f == NULL) {
+      perror("Unable to create temporary image file");
+      return -1;
+    }
+    fd = dup(fileno(f));
+    fclose(f);
+  }
+
+  if(fstat(fd, &st) != 0) {
+    perror("fstat() failed");
+    close(fd);
+    return -1;
+  }
+
+  /* Unwritten parts of the image read as zero, just like erased memory */
+  if((uint64_t) st.st_size < size) {
+    if(ftruncate(fd, size) != 0) {
+      perror("ftruncate() failed");
+      close(fd);
+      return -1;
+    }
+    st.st_size = size;
+  }
+
+  *image_size = st.st_size;
+  return fd;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2013, Institute of Operating Systems and Computer Networks (TU Braunschweig).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \defgroup native_storage_sim Simulated storage devices
+ *
+ * Image file backed SD card and flash for running the storage stack
+ * (diskio, FAT, Coffee) on the native platform.
+ *
+ * @{
+ */
+
+/**
+ * \file
+ *      Common parts of the simulated storage devices of the native platform
+ *
+ * The simulated SD card and flash are backed by image files and account
+ * the time the real device would need for each operation. By default the
+ * time is only accounted on a simulated clock. If the environment variable
+ * CONTIKI_STORAGE_REALTIME is set, the simulated devices also block for
+ * the accounted time, so timers and throughput measurements behave like
+ * on the node.
+ */
+
+#ifndef STORAGE_SIM_H
+#define STORAGE_SIM_H
+
+#include <stdint.h>
+
+/** Time in microseconds */
+typedef uint64_t storage_sim_time_t;
+
+/**
+ * \brief Returns the current time of the simulated storage clock
+ */
+storage_sim_time_t storage_sim_now(void);
+
+/**
+ * \brief Lets the given time pass, e.g. for a command or a transfer
+ */
+void storage_sim_elapse(uint32_t us);
+
+/**
+ * \brief Waits until the given point in time, e.g. the end of a busy phase
+ * \return The time that was waited
+ */
+storage_sim_time_t storage_sim_wait_until(storage_sim_time_t t);
+
+/**
+ * \brief Opens the image file of a simulated device
+ *
+ * The file is taken from the environment variable env. If it is not set, a
+ * temporary file is used. Images smaller than size are extended with zeros.
+ *
+ * \param env Name of the environment variable holding the file name
+ * \param size Minimum size of the image in bytes
+ * \param image_size Set to the size of the image in bytes
+ * \return File descriptor, -1 on error
+ */
+int storage_sim_open_image(const char *env, uint64_t size, uint64_t *image_size);
+
+#endif /* STORAGE_SIM_H */
+
+/** @} */
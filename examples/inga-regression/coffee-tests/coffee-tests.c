@@ -38,7 +38,7 @@
 #include "../test.h"
 
 #include <stdio.h> /* For printf() */
-#include "cfs/cfs-coffee.h"
+#include "cfs-coffee.h"
 
 TEST_SUITE("coffee-tests");
 
@@ -54,8 +54,8 @@ struct diskio_device_info *info = 0;
 
 void fail() {
   TEST_FAIL("");
-  watchdog_stop();
-  while(1) ;
+  suite.errors++;
+  TESTS_HALT();
 }
 /*---------------------------------------------------------------------------*/
 PROCESS_THREAD(coffee_test_process, ev, data)
@@ -64,7 +64,7 @@ PROCESS_THREAD(coffee_test_process, ev, data)
   static int cnt = 0;
   uint8_t buffer[FILE_SIZE];
   clock_time_t now;
-  unsigned short now_fine;
+  clock_time_t now_fine;
   static uint32_t time_start, time_stop;
 
   printf("###########################################################\n");
@@ -192,8 +192,7 @@ PROCESS_THREAD(coffee_test_process, ev, data)
 
       TEST_REPORT("data written", FILE_SIZE*cnt*CLOCK_SECOND, time_stop-time_start, "bytes/s");
       TEST_PASS();
-      watchdog_stop();
-      while(1);
+      TESTS_HALT();
     }
   }
 
@@ -4,7 +4,7 @@
 #include "leds.h"
 
 #include "fat/diskio.h"           //tested
-#include "fat/fat_coop.h"           //tested
+#include "fat/fat_async.h"           //tested
 #include "dev/watchdog.h"
 #include "clock.h"
 
@@ -13,7 +13,14 @@
 #define FILE_SIZE 128
 #define LOOPS 1024
 
-TEST_SUITE("fat-coop-test");
+#ifdef CONTIKI_TARGET_NATIVE
+// the simulated SD card has no partition table
+#define FAT_TEST_DEVICE DISKIO_DEVICE_TYPE_SD_CARD
+#else
+#define FAT_TEST_DEVICE (DISKIO_DEVICE_TYPE_SD_CARD | DISKIO_DEVICE_TYPE_PARTITION)
+#endif
+
+TEST_SUITE("fat-async-test");
 
 /*---------------------------------------------------------------------------*/
 PROCESS(hello_world_process, "Hello world process");
@@ -23,18 +30,17 @@ void
 fail()
 {
   printf("FAIL\n");
-  watchdog_stop();
-  while (1);
+  suite.errors++;
+  TESTS_HALT();
 }
 /*---------------------------------------------------------------------------*/
 static struct etimer timer;
 int cnt = 0;
 int fd;
-process_event_t coop_event;
 char b_file[8];
 uint8_t buffer[256];
-uint8_t token = 0;
-Event_OperationFinished * event;
+struct cfs_fat_iovec iov[2];
+struct cfs_fat_async_req req;
 /*---------------------------------------------------------------------------*/
 PROCESS_THREAD(hello_world_process, ev, data)
 {
@@ -54,7 +60,7 @@ PROCESS_THREAD(hello_world_process, ev, data)
 
   info = diskio_devices();
   for (i = 0; i < DISKIO_MAX_DEVICES; i++) {
-    if ((info + i)->type == (DISKIO_DEVICE_TYPE_SD_CARD | DISKIO_DEVICE_TYPE_PARTITION)) {
+    if ((info + i)->type == FAT_TEST_DEVICE) {
       info += i;
       initialized = 1;
       break; 
@@ -95,22 +101,8 @@ PROCESS_THREAD(hello_world_process, ev, data)
     printf("Opening file...\n");
 
     // Open the file descriptor
-    fd = ccfs_open(b_file, CFS_WRITE, &token);
-    // In case something goes wrong, we cannot save this file
-    if (fd != 0) {
-      printf("############# STORAGE: ccfs_open for write failed\n");
-      fail();
-    }
-
-    // Wait until the file is open
-    coop_event = get_coop_event_id();
-    PROCESS_WAIT_UNTIL(ev == coop_event && ((Event_OperationFinished *) data)->token == token);
-    event = (Event_OperationFinished *) data;
-
-    printf("File opened...\n");
-
-    // In case something goes wrong, we cannot save this file
-    if (event->ret_value == -1) {
+    fd = cfs_open(b_file, CFS_WRITE);
+    if (fd < 0) {
       printf("############# STORAGE: open for write failed\n");
       fail();
     }
@@ -122,8 +114,12 @@ PROCESS_THREAD(hello_world_process, ev, data)
 
     printf("Writing file...\n");
 
-    // Write to file
-    n = ccfs_write(fd, buffer, FILE_SIZE, &token);
+    // Write to file, the buffer is split to test scatter-gather
+    iov[0].base = buffer;
+    iov[0].len = FILE_SIZE / 4;
+    iov[1].base = &buffer[FILE_SIZE / 4];
+    iov[1].len = FILE_SIZE - FILE_SIZE / 4;
+    n = cfs_fat_write_async(&req, fd, iov, 2);
 
     if (n != 0) {
       printf("############# STORAGE: Write failed\n");
@@ -131,77 +127,48 @@ PROCESS_THREAD(hello_world_process, ev, data)
     }
 
     // Wait until write is finished
-    PROCESS_WAIT_UNTIL(ev == coop_event && ((Event_OperationFinished *) data)->token == token);
-    event = (Event_OperationFinished *) data;
+    PROCESS_WAIT_EVENT_UNTIL(ev == cfs_fat_async_event && data == &req);
 
     printf("File written...\n");
 
-    if (event->ret_value != FILE_SIZE) {
-      printf("############# STORAGE: Write failed and returned %d\n", event->ret_value);
+    if (req.result != FILE_SIZE) {
+      printf("############# STORAGE: Write failed and returned %ld\n", req.result);
       fail();
     }
 
-    // Close the file
-    n = ccfs_close(fd, &token);
-    if (n != 0) {
-      printf("############# STORAGE: Close failed\n");
-
-    }
-
-    // Wait until close is finished
-    PROCESS_WAIT_UNTIL(ev == coop_event && ((Event_OperationFinished *) data)->token == token);
-    event = (Event_OperationFinished *) data;
+    cfs_close(fd);
 
     printf("\n\t%s written\n", b_file);
 
     // Open the file for reading
-    fd = ccfs_open(b_file, CFS_READ, &token);
-    // In case something goes wrong, we cannot save this file
-    if (fd != 0) {
+    fd = cfs_open(b_file, CFS_READ);
+    if (fd < 0) {
       printf("############# STORAGE: open for read failed\n");
       fail();
     }
 
-    // Wait until finished
-    PROCESS_WAIT_UNTIL(ev == coop_event && ((Event_OperationFinished *) data)->token == token);
-    event = (Event_OperationFinished *) data;
-
-    // In case something goes wrong, we cannot save this file
-    if (event->ret_value == -1) {
-      printf("############# STORAGE: open for read failed\n");
-      cfs_fat_print_file_info(fd);
-      fail();
-    }
-
     memset(buffer, 0, FILE_SIZE);
 
-    // And now read the bundle back from flash
-    n = ccfs_read(fd, buffer, FILE_SIZE, &token);
+    // And now read the file back, again split into two buffers
+    iov[0].len = FILE_SIZE / 2;
+    iov[1].base = &buffer[FILE_SIZE / 2];
+    iov[1].len = FILE_SIZE - FILE_SIZE / 2;
+    n = cfs_fat_read_async(&req, fd, iov, 2);
 
     if (n != 0) {
-      printf("############# STORAGE: ccfs_read error\n");
+      printf("############# STORAGE: cfs_fat_read_async error\n");
       fail();
     }
 
     // Wait until read is finished
-    PROCESS_WAIT_UNTIL(ev == coop_event && ((Event_OperationFinished *) data)->token == token);
-    event = (Event_OperationFinished *) data;
+    PROCESS_WAIT_EVENT_UNTIL(ev == cfs_fat_async_event && data == &req);
 
-    if (event->ret_value != FILE_SIZE) {
-      printf("############# STORAGE: read failed and returned %d\n", event->ret_value);
+    if (req.result != FILE_SIZE) {
+      printf("############# STORAGE: read failed and returned %ld\n", req.result);
       fail();
     }
 
-    // Close file
-    n = ccfs_close(fd, &token);
-    if (n != 0) {
-      printf("############# STORAGE: Close failed\n");
-
-    }
-
-    // Wait
-    PROCESS_WAIT_UNTIL(ev == coop_event && ((Event_OperationFinished *) data)->token == token);
-    event = (Event_OperationFinished *) data;
+    cfs_close(fd);
 
     // Verify contents
     for (i = 0; i < FILE_SIZE; i++) {
@@ -211,18 +178,6 @@ PROCESS_THREAD(hello_world_process, ev, data)
       }
     }
 
-    //		n = ccfs_remove(b_file, &token);
-    //
-    //		if( n != 0 ) {
-    //			printf("############# STORAGE: unable to remove %s\n", b_file);
-    //			fail();
-    //		}
-    //
-    //		PROCESS_WAIT_UNTIL(ev == coop_event && ((Event_OperationFinished *) data)->token == token);
-    //		event = (Event_OperationFinished *) data;
-    //
-    //		printf("\t%s deleted\n", b_file);
-
     printf("\n");
 
     cnt++;
@@ -231,9 +186,7 @@ PROCESS_THREAD(hello_world_process, ev, data)
   cfs_fat_umount_device();
 
   TESTS_DONE();
-
-  watchdog_stop();
-  while (1);
+  TESTS_HALT();
 
   PROCESS_END();
 }
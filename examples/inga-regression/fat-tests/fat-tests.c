@@ -1,10 +1,13 @@
 #include "contiki.h"
 #include <stdlib.h>
 #include <stdio.h> /* For printf() */
+#include <string.h>
 #include "dev/watchdog.h"
 #include "clock.h"
 #include "../test.h"
+#ifndef CONTIKI_TARGET_NATIVE
 #include <util/delay.h>
+#endif
 
 #include "fat/diskio.h"           //tested
 #include "fat/cfs-fat.h"           //tested
@@ -17,7 +20,10 @@
 uint32_t file_sizes[FAT_TEST_CONF_NUM_FILES] = {127, 128, 511, 512, 1023, 1024, 4095, 4096, 12345, 16383, 16384, 32767, 32768U, 65535UL, 65536UL};
 uint8_t file_inits[FAT_TEST_CONF_NUM_FILES] = {5, 12, 80, 3, 76, 13, 123, 42, 23, 200, 255, 7, 99, 12, 77, 31};
 
-#ifdef FAT_TEST_SD
+#if defined FAT_TEST_SD && defined CONTIKI_TARGET_NATIVE
+// the simulated SD card has no partition table
+#define FAT_TEST_DEVICE DISKIO_DEVICE_TYPE_SD_CARD
+#elif defined FAT_TEST_SD
 #define FAT_TEST_DEVICE (DISKIO_DEVICE_TYPE_SD_CARD | DISKIO_DEVICE_TYPE_PARTITION)
 #elif defined FAT_TEST_EXTFLASH
 #define FAT_TEST_DEVICE DISKIO_DEVICE_TYPE_GENERIC_FLASH  
@@ -49,7 +55,7 @@ test_device_init()
 {
   int initialized = 0, i;
 
-#ifdef FAT_TEST_SD
+#if defined FAT_TEST_SD && defined SDCARD_POWER_ON
   // power on sd card only if tested to not block flash
   SDCARD_POWER_ON();
 #endif
@@ -167,6 +173,60 @@ test_cfs_remove()
   printf("\n");
 }
 /*---------------------------------------------------------------------------*/
+/* Fills the root directory and lists it. On FAT16 the root directory is
+ * a fixed region in front of the data region which can not grow, on FAT32
+ * it is an ordinary cluster chain and more than two sectors are filled. */
+void
+test_cfs_root_dir()
+{
+  struct FAT_Info fat;
+  struct cfs_dir dir;
+  struct cfs_dirent dirent;
+  int idx, files, found = 0;
+  char fnamebuf[13];
+
+  cfs_fat_get_fat_info(&fat);
+  if (fat.type == FAT16) {
+    files = fat.BPB_RootEntCnt;
+  } else {
+    files = 2 * fat.BPB_BytesPerSec / 32 + 1;
+  }
+  TEST_REPORT("Root directory files", files, 1, "files");
+
+  for (idx = 0; idx < files; idx++) {
+    sprintf(fnamebuf, "root%03d.dat", idx);
+    write_test_bytes(fnamebuf, 127, idx);
+  }
+
+  TEST_CODE();
+
+  if (fat.type == FAT16) {
+    TEST_EQUALS(cfs_open("rootfull.dat", CFS_WRITE), -1);
+  }
+
+  TEST_EQUALS(cfs_opendir(&dir, "/"), 0);
+  memset(&dirent, 0, sizeof (dirent));
+  while (cfs_readdir(&dir, &dirent) == 0) {
+    if (strncmp(dirent.name, "ROOT", 4) == 0) {
+      TEST_EQUALS(dirent.size, 127);
+      found++;
+    }
+    memset(&dirent, 0, sizeof (dirent));
+  }
+  cfs_closedir(&dir);
+  TEST_EQUALS(found, files);
+
+  TEST_POST();
+
+  // the last file is in the last sector that was filled
+  read_test_bytes(fnamebuf, 127, files - 1);
+  for (idx = 0; idx < files; idx++) {
+    sprintf(fnamebuf, "root%03d.dat", idx);
+    TEST_EQUALS(cfs_remove(fnamebuf), 0);
+  }
+  printf("\n");
+}
+/*---------------------------------------------------------------------------*/
 void
 test_cfs_write_many_files()
 {
@@ -364,12 +424,14 @@ PROCESS_THREAD(test_process, ev, data)
   RUN_TEST("cfs_seek", test_cfs_seek);
   RUN_TEST("cfs_read_files", test_cfs_read_files);
   RUN_TEST("test_cfs_remove", test_cfs_remove);
+  RUN_TEST("test_cfs_root_dir", test_cfs_root_dir);
   RUN_TEST("cfs_write_many_files", test_cfs_write_many_files);
   RUN_TEST("test_cfs_seek_many", test_cfs_seek_many);
   RUN_TEST("test_cfs_read_many_files", test_cfs_read_many_files);
   RUN_TEST("test_cfs_remove_many", test_cfs_remove_many);
   
   TESTS_DONE();
+  TESTS_HALT();
 
   PROCESS_END();
 }
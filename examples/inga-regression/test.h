@@ -8,7 +8,10 @@
 #ifndef TEST_H
 #define	TEST_H
 
+#include <stdint.h>
 #include <sys/test.h>
+#include <stdlib.h>
+#include "dev/watchdog.h"
 
 void test_eq(uint32_t a, uint32_t b, char* test);
 void test_neq(uint32_t a, uint32_t b, char* test);
@@ -90,6 +93,16 @@ extern struct test_suite suite;
     TEST_PASS();  \
   }
 
+/** Stops after the tests. Native builds exit with the result instead, so
+ * the suites can run on the simulated storage devices of cpu/native. */
+#ifdef CONTIKI_TARGET_NATIVE
+#define TESTS_HALT() exit(suite.errors != 0)
+#else
+#define TESTS_HALT() \
+  watchdog_stop(); \
+  while (1)
+#endif
+
 /** Runs test if previous finished without failure. */
 #define RUN_TEST(name, test) \
   if (suite.errors != 0) return 1; \
@@ -0,0 +1,466 @@
+/*
+ * Copyright (c) 2013, Institute of Operating Systems and Computer Networks (TU Braunschweig).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      Benchmark of the managed memory allocator
+ *
+ * Replays allocation traces modelled after the users of mmem against
+ * the current allocator and a copy of the previous one, which compacted
+ * the memory on every free:
+ *
+ *  - queuebuf: packets of 30 to 127 bytes freed in FIFO order
+ *  - coap:     transactions with a 24 byte state and a 64, 128 or 256
+ *              byte block, completed in random order
+ *  - antelope: result sets of 4 to 16 tuples freed after the set is
+ *              complete, next to a long lived relation buffer
+ *  - random:   8 to 200 bytes, freed in random order
+ *
+ * Each run prints one JSON object per line:
+ *
+ *   {"bench":"queuebuf","alloc":"mmem","ops":...,"failed":...,
+ *    "errors":...,"ns_op":...,"max_ns":...,"moved":...,"max_moved":...,
+ *    "max_used":...,"fragmentation":...}
+ *
+ * Only the calls of the allocator are timed, ns_op is their mean and
+ * max_ns their maximum duration. moved is the number of bytes moved by
+ * compaction, max_moved the most bytes moved by a single call.
+ * mmem_idle additionally calls mmem_compact() every MMEM_BENCH_IDLE
+ * operations, like an application that compacts while it is idle.
+ * Every block is filled with a pattern that is checked when it is
+ * freed, errors counts the mismatches.
+ *
+ * The first line is {"bench":"start","size":...,"ops":...,"clock_ns":...}
+ * with the mean time of reading the clock twice in clock_ns, which is
+ * included in ns_op and max_ns. The last line is {"bench":"done"}. The
+ * benchmark is meant for the native platform, other platforms only
+ * have the resolution of the system clock:
+ *
+ *   make TARGET=native mmem-bench && ./mmem-bench.native
+ */
+
+#include "contiki.h"
+#include "lib/mmem.h"
+#include "dev/watchdog.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef CONTIKI_TARGET_NATIVE
+#include <stdlib.h>
+#include <time.h>
+#endif
+
+#ifdef MMEM_CONF_SIZE
+#define MMEM_BENCH_SIZE MMEM_CONF_SIZE
+#else
+#define MMEM_BENCH_SIZE 4096
+#endif
+
+/** Operations per trace and allocator */
+#ifdef MMEM_BENCH_CONF_OPS
+#define MMEM_BENCH_OPS MMEM_BENCH_CONF_OPS
+#else
+#define MMEM_BENCH_OPS 200000UL
+#endif
+
+/** Operations between two idle compactions of mmem_idle */
+#ifdef MMEM_BENCH_CONF_IDLE
+#define MMEM_BENCH_IDLE MMEM_BENCH_CONF_IDLE
+#else
+#define MMEM_BENCH_IDLE 32
+#endif
+
+/** Bytes moved by one idle compaction */
+#ifdef MMEM_BENCH_CONF_IDLE_BUDGET
+#define MMEM_BENCH_IDLE_BUDGET MMEM_BENCH_CONF_IDLE_BUDGET
+#else
+#define MMEM_BENCH_IDLE_BUDGET 128
+#endif
+
+#define SLOTS 32
+
+struct allocator {
+  const char *name;
+  void (*init)(void);
+  int (*alloc)(struct mmem *m, unsigned int size);
+  void (*free)(struct mmem *m);
+  uint8_t idle;
+};
+
+struct trace {
+  const char *name;
+  void (*step)(void);
+};
+
+static const struct allocator *allocator;
+static struct mmem slots[SLOTS];
+static uint8_t pattern[SLOTS];
+/* Slots the trace considers allocated, even if the allocation failed */
+static uint8_t live[SLOTS];
+static uint32_t rng;
+
+static unsigned long ops;
+static unsigned int failed;
+static unsigned int errors;
+static unsigned long moved;
+static unsigned int max_moved;
+static unsigned int max_used;
+static unsigned long time_ns;
+static unsigned long max_ns;
+static unsigned long call_start;
+
+PROCESS(mmem_bench_process, "mmem benchmark");
+AUTOSTART_PROCESSES(&mmem_bench_process);
+/*---------------------------------------------------------------------------*/
+/* The previous allocator, which compacts the memory on every free */
+static struct mmem *legacy_list;
+static unsigned int legacy_avail;
+static char legacy_memory[MMEM_BENCH_SIZE];
+/*---------------------------------------------------------------------------*/
+static void
+legacy_init(void)
+{
+  legacy_list = NULL;
+  legacy_avail = MMEM_BENCH_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+static int
+legacy_alloc(struct mmem *m, unsigned int size)
+{
+  struct mmem **last;
+
+  if(legacy_avail < size) {
+    return 0;
+  }
+  for(last = &legacy_list; *last != NULL; last = &(*last)->next);
+  *last = m;
+  m->next = NULL;
+  m->ptr = &legacy_memory[MMEM_BENCH_SIZE - legacy_avail];
+  m->size = size;
+  legacy_avail -= size;
+  if(MMEM_BENCH_SIZE - legacy_avail > max_used) {
+    max_used = MMEM_BENCH_SIZE - legacy_avail;
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+legacy_free(struct mmem *m)
+{
+  struct mmem **prev;
+  struct mmem *n;
+  unsigned int len;
+
+  if(m->next != NULL) {
+    len = &legacy_memory[MMEM_BENCH_SIZE - legacy_avail] - (char *)m->next->ptr;
+    memmove(m->ptr, m->next->ptr, len);
+    moved += len;
+    if(len > max_moved) {
+      max_moved = len;
+    }
+    for(n = m->next; n != NULL; n = n->next) {
+      n->ptr = (void *)((char *)n->ptr - m->size);
+    }
+  }
+  legacy_avail += m->size;
+  for(prev = &legacy_list; *prev != m; prev = &(*prev)->next);
+  *prev = m->next;
+}
+/*---------------------------------------------------------------------------*/
+static const struct allocator allocators[] = {
+  { "legacy", legacy_init, legacy_alloc, legacy_free, 0 },
+  { "mmem", mmem_init, mmem_alloc, mmem_free, 0 },
+  { "mmem_idle", mmem_init, mmem_alloc, mmem_free, 1 },
+};
+/*---------------------------------------------------------------------------*/
+static uint16_t
+rand_range(uint16_t range)
+{
+  rng = rng * 1103515245UL + 12345;
+  return (uint16_t)(rng >> 16) % range;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+now_ns(void)
+{
+#ifdef CONTIKI_TARGET_NATIVE
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+#else
+  return clock_time() * (1000000000UL / CLOCK_SECOND);
+#endif
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+clock_overhead(void)
+{
+  unsigned long sum = 0;
+  unsigned int i;
+
+  for(i = 0; i < 1000; i++) {
+    call_start = now_ns();
+    sum += now_ns() - call_start;
+  }
+  return sum / 1000;
+}
+/*---------------------------------------------------------------------------*/
+static void
+begin_call(void)
+{
+  call_start = now_ns();
+}
+/*---------------------------------------------------------------------------*/
+static void
+end_call(void)
+{
+  struct mmem_stats stats;
+  unsigned long t = now_ns() - call_start;
+
+  time_ns += t;
+  if(t > max_ns) {
+    max_ns = t;
+  }
+  if(allocator->alloc == mmem_alloc) {
+    /* Includes the compaction of an allocation that did not find a
+       large enough free block */
+    mmem_stats(&stats);
+    if(stats.moved - moved > max_moved) {
+      max_moved = stats.moved - moved;
+    }
+    moved = stats.moved;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+do_alloc(uint8_t slot, unsigned int size)
+{
+  live[slot] = 1;
+  ops++;
+  begin_call();
+  if(!allocator->alloc(&slots[slot], size)) {
+    end_call();
+    slots[slot].ptr = NULL;
+    failed++;
+    return;
+  }
+  end_call();
+  pattern[slot] = (uint8_t)(ops * 7 + slot);
+  memset(MMEM_PTR(&slots[slot]), pattern[slot], size);
+}
+/*---------------------------------------------------------------------------*/
+static void
+do_free(uint8_t slot)
+{
+  uint8_t *p;
+  unsigned int i;
+
+  live[slot] = 0;
+  ops++;
+  if(slots[slot].ptr == NULL) {
+    return;
+  }
+  p = (uint8_t *)MMEM_PTR(&slots[slot]);
+  for(i = 0; i < slots[slot].size; i++) {
+    if(p[i] != pattern[slot]) {
+      errors++;
+      break;
+    }
+  }
+  begin_call();
+  allocator->free(&slots[slot]);
+  end_call();
+  slots[slot].ptr = NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+queuebuf_step(void)
+{
+  static uint8_t head, count;
+
+  if(ops == 0) {
+    head = count = 0;
+  }
+  if(count == 0 || (count < 16 && rand_range(2))) {
+    do_alloc((head + count) % 16, 30 + rand_range(98));
+    count++;
+  } else {
+    do_free(head);
+    head = (head + 1) % 16;
+    count--;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+coap_step(void)
+{
+  static const unsigned int blocks[] = { 64, 128, 256 };
+  uint8_t t = rand_range(SLOTS / 2) * 2;
+
+  if(!live[t]) {
+    do_alloc(t, 24);
+    do_alloc(t + 1, blocks[rand_range(3)]);
+  } else {
+    do_free(t + 1);
+    do_free(t);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+antelope_step(void)
+{
+  static uint8_t tuples, next, tuple_size, freeing;
+
+  if(ops == 0) {
+    tuples = 0;
+  }
+  /* Slot 0 is the relation buffer, reallocated now and then */
+  if(rand_range(64) == 0) {
+    if(live[0]) {
+      do_free(0);
+    } else {
+      do_alloc(0, 128);
+    }
+    return;
+  }
+  if(tuples == 0) {
+    tuples = 4 + rand_range(13);
+    tuple_size = 16 + rand_range(33);
+    next = 0;
+    freeing = 0;
+  }
+  if(!freeing) {
+    do_alloc(1 + next, tuple_size);
+    freeing = ++next == tuples;
+  } else {
+    do_free(1 + tuples - next);
+    if(--next == 0) {
+      tuples = 0;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+random_step(void)
+{
+  uint8_t slot = rand_range(SLOTS);
+
+  if(live[slot]) {
+    do_free(slot);
+  } else {
+    do_alloc(slot, 8 + rand_range(193));
+  }
+}
+/*---------------------------------------------------------------------------*/
+static const struct trace traces[] = {
+  { "queuebuf", queuebuf_step },
+  { "coap", coap_step },
+  { "antelope", antelope_step },
+  { "random", random_step },
+};
+/*---------------------------------------------------------------------------*/
+static void
+run(const struct trace *trace)
+{
+  struct mmem_stats stats;
+  unsigned int fragmentation;
+  uint8_t i;
+
+  memset(slots, 0, sizeof(slots));
+  memset(live, 0, sizeof(live));
+  rng = 1;
+  ops = 0;
+  failed = errors = 0;
+  moved = max_moved = max_used = 0;
+  time_ns = max_ns = 0;
+  fragmentation = 0;
+
+  allocator->init();
+  while(ops < MMEM_BENCH_OPS) {
+    trace->step();
+
+    if(allocator->idle && ops % MMEM_BENCH_IDLE == 0) {
+      begin_call();
+      mmem_compact(MMEM_BENCH_IDLE_BUDGET);
+      end_call();
+    }
+    if((ops & 0x3FF) == 0) {
+      watchdog_periodic();
+    }
+  }
+
+  if(allocator->alloc == mmem_alloc) {
+    mmem_stats(&stats);
+    max_used = stats.max_used;
+    fragmentation = stats.fragmentation;
+  }
+
+  /* Free in a fixed order to check the remaining patterns */
+  for(i = 0; i < SLOTS; i++) {
+    if(live[i]) {
+      do_free(i);
+    }
+  }
+
+  printf("{\"bench\":\"%s\",\"alloc\":\"%s\",\"ops\":%lu,\"failed\":%u,"
+         "\"errors\":%u,\"ns_op\":%lu,\"max_ns\":%lu,\"moved\":%lu,"
+         "\"max_moved\":%u,\"max_used\":%u,\"fragmentation\":%u}\n",
+         trace->name, allocator->name, ops, failed, errors,
+         ops ? time_ns / ops : 0, max_ns, moved, max_moved, max_used,
+         fragmentation);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(mmem_bench_process, ev, data)
+{
+  static uint8_t t, a;
+
+  PROCESS_BEGIN();
+
+  printf("{\"bench\":\"start\",\"size\":%u,\"ops\":%lu,"
+         "\"clock_ns\":%lu}\n",
+         MMEM_BENCH_SIZE, (unsigned long)MMEM_BENCH_OPS, clock_overhead());
+
+  for(t = 0; t < sizeof(traces) / sizeof(traces[0]); t++) {
+    for(a = 0; a < sizeof(allocators) / sizeof(allocators[0]); a++) {
+      allocator = &allocators[a];
+      run(&traces[t]);
+      PROCESS_PAUSE();
+    }
+  }
+
+  printf("{\"bench\":\"done\"}\n");
+
+#ifdef CONTIKI_TARGET_NATIVE
+  exit(0);
+#endif
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
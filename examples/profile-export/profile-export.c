@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2013, Institute of Operating Systems and Computer Networks (TU Braunschweig).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Streams the profiles of a small LED workload with the profile
+ *         export process instead of printing reports
+ *
+ *         Collect them on the host with
+ *         tools/profiling/profile-collect.py serial --port /dev/ttyUSB0
+ */
+
+#include "contiki.h"
+#include "dev/leds.h"
+#include "sys/profiling/profiling.h"
+#include "sys/profiling/sprofiling.h"
+#include "sys/profiling/profiling-export.h"
+
+#include <stdio.h> /* For printf() */
+
+/* Seconds between two exports */
+#define EXPORT_INTERVAL 30
+
+/*---------------------------------------------------------------------------*/
+PROCESS(blink_process, "Blink");
+PROCESS(busy_process, "Busy");
+PROCESS(profiler_process, "Profiler");
+AUTOSTART_PROCESSES(&blink_process, &busy_process, &profiler_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(blink_process, ev, data)
+{
+  static struct etimer timer;
+
+  PROCESS_BEGIN();
+
+  while(1) {
+    leds_toggle(LEDS_YELLOW);
+    etimer_set(&timer, CLOCK_SECOND / 8);
+    PROCESS_WAIT_UNTIL(etimer_expired(&timer));
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(busy_process, ev, data)
+{
+  static struct etimer timer;
+  uint16_t i;
+
+  PROCESS_BEGIN();
+
+  while(1) {
+    leds_on(LEDS_GREEN);
+    for(i = 0; i < 2000; i++) {
+      asm volatile("nop");
+    }
+    leds_off(LEDS_GREEN);
+    etimer_set(&timer, CLOCK_SECOND / 10);
+    PROCESS_WAIT_UNTIL(etimer_expired(&timer));
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(profiler_process, ev, data)
+{
+  static struct etimer timer;
+  static uint8_t run;
+  static char name[8];
+
+  PROCESS_BEGIN();
+
+  profiling_init();
+  sprofiling_init();
+  profiling_export_init();
+
+  profiling_start();
+  sprofiling_start();
+
+  while(1) {
+    etimer_set(&timer, CLOCK_SECOND * EXPORT_INTERVAL);
+    PROCESS_WAIT_UNTIL(etimer_expired(&timer));
+
+    /* The profilers keep running, the export stops each one while its
+     * table is sent and restarts it afterwards */
+    sprintf(name, "run%u", run++);
+    if(!profiling_export_start(name, PROFILING_EXPORT_WITH_PROF | PROFILING_EXPORT_WITH_SPROF)) {
+      printf("Export of %s skipped, the last one is still running\n", name);
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
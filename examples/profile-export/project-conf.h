@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012, Institute of Operating Systems and Computer Networks (TU Brunswick).
+ * Copyright (c) 2013, Institute of Operating Systems and Computer Networks (TU Braunschweig).
  * All rights reserved.
  *
  * Redistribution and use in source and binary forms, with or without
@@ -26,35 +26,21 @@
  * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
  * SUCH DAMAGE.
  *
- * Author: Wolf-Bastian Poettner <poettner@ibr.cs.tu-bs.de>
+ * This file is part of the Contiki operating system.
  */
 
- /**
- * \addtogroup Drivers
- * @{
- *
- * \defgroup fat_coop_driver FAT Driver - Cooperative Additions - Platform specific
- *
- * <p></p>
- * @{
- *
- */
+#ifndef __PROJECT_CONF_H__
+#define __PROJECT_CONF_H__
 
-/**
- * \file
- *		FAT driver Coop Additions definitions - Platform specific
- * \author
- *      Wolf-Bastian Poettner <poettner@ibr.cs.tu-bs.de>
- */
+/* Sites of the instrumenting profiler and its call stack depth */
+#define PROFILES_CONF_MAX 32
+#define PROFILES_CONF_STACKSIZE 16
 
-#ifndef FAT_COOP_ARCH_H
-#define FAT_COOP_ARCH_H
+/* Sampling profiler with the pc and one caller per sample */
+#define SPROFILES_CONF_MAX 64
+#define SPROFILES_CONF_FRAMES 2
 
-void coop_finished_op();
-void coop_mt_init( void *data );
-void coop_mt_stop();
-void coop_switch_sp();
-void perform_next_step( QueueEntry *entry );
-int calc_free_stack();
+/* Export both profiles over SLIP on the debug port */
+#define PROFILING_EXPORT_CONF_SPROF 1
 
-#endif /* FAT_COOP_ARCH_H */
+#endif /* __PROJECT_CONF_H__ */
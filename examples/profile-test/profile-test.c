@@ -40,8 +40,8 @@
 
 #include "contiki.h"
 #include "dev/leds.h"
-#include "sys/profiling.h"
-#include "sys/sprofiling.h"
+#include "sys/profiling/profiling.h"
+#include "sys/profiling/sprofiling.h"
 #include "sys/test.h"
 
 #include <stdio.h> /* For printf() */
@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2013, Institute of Operating Systems and Computer Networks (TU Braunschweig).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      Benchmark of the IPv6 route lookup
+ *
+ * Fills the routing table with host routes (/128) of nodes below a
+ * storing mode RPL root and two prefix routes, then measures
+ * uip_ds6_route_lookup() for a growing table. Every result is one JSON
+ * object per line:
+ *
+ *   {"bench":"route","routes":64,"lookup_ns":...,"lookups_per_s":...,
+ *    "flow_ns":...,"prefix_ns":...,"miss_ns":...,"add_ns":...}
+ *
+ *  - lookup_ns: lookup of a random host route
+ *  - flow_ns:   repeated lookup of the same host route, as for the
+ *               packets of one flow
+ *  - prefix_ns: lookup of an address covered by a prefix route only
+ *  - miss_ns:   lookup of an address without a route
+ *  - add_ns:    uip_ds6_route_add() replacing an existing host route
+ *
+ * The last line is {"bench":"done"}. The benchmark is meant for the
+ * native platform, other platforms only have the resolution of the
+ * system clock:
+ *
+ *   make TARGET=native && ./route-bench.native
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "contiki.h"
+#include "dev/watchdog.h"
+#include "net/ip/uip.h"
+#include "net/ipv6/uip-ds6.h"
+
+/** Measured lookups of each kind per table size */
+#ifdef ROUTE_BENCH_CONF_ROUNDS
+#define ROUTE_BENCH_ROUNDS ROUTE_BENCH_CONF_ROUNDS
+#else
+#define ROUTE_BENCH_ROUNDS 20000
+#endif
+
+/** Next hops the routes are spread over */
+#define NEXTHOPS 4
+
+/** Prefix routes in the table */
+#define PREFIXES 2
+
+static uip_ipaddr_t nexthops[NEXTHOPS];
+static uint32_t rng;
+
+PROCESS(route_bench_process, "Route benchmark");
+AUTOSTART_PROCESSES(&route_bench_process);
+/*---------------------------------------------------------------------------*/
+static unsigned long
+now_ns(void)
+{
+#ifdef CONTIKI_TARGET_NATIVE
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+#else
+  return clock_time() * (1000000000UL / CLOCK_SECOND);
+#endif
+}
+/*---------------------------------------------------------------------------*/
+static unsigned int
+rand_range(unsigned int range)
+{
+  rng = rng * 1103515245UL + 12345;
+  return (rng >> 16) % range;
+}
+/*---------------------------------------------------------------------------*/
+/* The address of node n, with an interface identifier as derived from
+   the link layer address of a Tmote Sky */
+static void
+host_addr(uip_ipaddr_t *addr, unsigned int n)
+{
+  uip_ip6addr(addr, 0xaaaa, 0, 0, 0, 0x0212, 0x7400 | (n >> 8),
+              (n << 8) | (n & 0xff), (n << 8) | (n & 0xff));
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_nexthops(void)
+{
+  uip_lladdr_t lladdr;
+  unsigned int i;
+
+  for(i = 0; i < NEXTHOPS; i++) {
+    memset(&lladdr, 0, sizeof(lladdr));
+    lladdr.addr[sizeof(lladdr) - 1] = i + 1;
+    uip_ip6addr(&nexthops[i], 0xfe80, 0, 0, 0, 0, 0, 0, i + 1);
+    uip_ds6_nbr_add(&nexthops[i], &lladdr, 1, NBR_REACHABLE);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+fill_table(unsigned int hosts)
+{
+  uip_ipaddr_t addr;
+  unsigned int i;
+
+  for(i = 0; i < hosts; i++) {
+    host_addr(&addr, i);
+    uip_ds6_route_add(&addr, 128, &nexthops[i % NEXTHOPS]);
+  }
+  /* Added last, adding a route removes the longest match of its
+     address */
+  uip_ip6addr(&addr, 0xbbbb, 0, 0, 0, 0, 0, 0, 0);
+  uip_ds6_route_add(&addr, 64, &nexthops[0]);
+  uip_ip6addr(&addr, 0xaaaa, 0, 0, 1, 0, 0, 0, 0);
+  uip_ds6_route_add(&addr, 64, &nexthops[1]);
+}
+/*---------------------------------------------------------------------------*/
+static void
+empty_table(void)
+{
+  while(uip_ds6_route_head() != NULL) {
+    uip_ds6_route_rm(uip_ds6_route_head());
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(route_bench_process, ev, data)
+{
+  static unsigned int routes;
+  static unsigned long lookup, flow, prefix, miss, add;
+  static uip_ipaddr_t addrs[64];
+  unsigned long start;
+  unsigned int hosts, round, i;
+
+  PROCESS_BEGIN();
+
+  printf("{\"bench\":\"start\",\"rounds\":%u}\n", ROUTE_BENCH_ROUNDS);
+
+  rng = 1;
+  add_nexthops();
+  for(routes = 16; routes <= UIP_DS6_ROUTE_NB; routes *= 2) {
+    hosts = routes - PREFIXES;
+    fill_table(hosts);
+    if(uip_ds6_route_num_routes() != routes) {
+      printf("{\"bench\":\"error\",\"routes\":%u,\"added\":%u}\n",
+             routes, uip_ds6_route_num_routes());
+      break;
+    }
+    lookup = flow = prefix = miss = add = 0;
+
+    /* Lookups of random hosts, in blocks to keep the clock overhead
+       out of the measurement */
+    for(round = 0; round < ROUTE_BENCH_ROUNDS; round += 64) {
+      for(i = 0; i < 64; i++) {
+        host_addr(&addrs[i], rand_range(hosts));
+      }
+      start = now_ns();
+      for(i = 0; i < 64; i++) {
+        uip_ds6_route_lookup(&addrs[i]);
+      }
+      lookup += now_ns() - start;
+    }
+
+    host_addr(&addrs[0], rand_range(hosts));
+    start = now_ns();
+    for(round = 0; round < ROUTE_BENCH_ROUNDS; round++) {
+      uip_ds6_route_lookup(&addrs[0]);
+    }
+    flow = now_ns() - start;
+
+    uip_ip6addr(&addrs[0], 0xbbbb, 0, 0, 0, 0, 0, 0, 1);
+    uip_ip6addr(&addrs[1], 0xcccc, 0, 0, 0, 0, 0, 0, 1);
+    start = now_ns();
+    for(round = 0; round < ROUTE_BENCH_ROUNDS / 2; round++) {
+      uip_ds6_route_lookup(&addrs[0]);
+      uip_ds6_route_lookup(&addrs[round & 1]);
+    }
+    prefix = now_ns() - start;
+    start = now_ns();
+    for(round = 0; round < ROUTE_BENCH_ROUNDS; round++) {
+      uip_ds6_route_lookup(&addrs[1]);
+    }
+    miss = now_ns() - start;
+
+    for(round = 0; round < ROUTE_BENCH_ROUNDS / 16; round++) {
+      i = rand_range(hosts);
+      host_addr(&addrs[0], i);
+      start = now_ns();
+      uip_ds6_route_add(&addrs[0], 128, &nexthops[(i + 1) % NEXTHOPS]);
+      add += now_ns() - start;
+    }
+
+    printf("{\"bench\":\"route\",\"routes\":%u,\"lookup_ns\":%lu,"
+           "\"lookups_per_s\":%lu,\"flow_ns\":%lu,\"prefix_ns\":%lu,"
+           "\"miss_ns\":%lu,\"add_ns\":%lu}\n",
+           routes, lookup / ROUTE_BENCH_ROUNDS,
+           lookup > 0 ? (unsigned long)(1000000000.0 * ROUTE_BENCH_ROUNDS / lookup) : 0,
+           flow / ROUTE_BENCH_ROUNDS, prefix / ROUTE_BENCH_ROUNDS,
+           miss / ROUTE_BENCH_ROUNDS, add / (ROUTE_BENCH_ROUNDS / 16));
+
+    empty_table();
+    watchdog_periodic();
+    PROCESS_PAUSE();
+  }
+
+  printf("{\"bench\":\"done\"}\n");
+
+#ifdef CONTIKI_TARGET_NATIVE
+  exit(0);
+#endif
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,540 @@
+/*
+ * Copyright (c) 2013, Institute of Operating Systems and Computer Networks (TU Braunschweig).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      Storage benchmark for the FAT driver, Coffee and raw diskio
+ *
+ * Measures sequential write and read with multi-sector and single sector
+ * calls, append, random read, open/close churn and directory listing. Every benchmark prints one JSON object per line:
+ *
+ *   {"bench":"fat_seq_write","ops":128,"bytes":65536,"errors":0,
+ *    "time_us":...,"ops_s":...,"bytes_s":...,"hist":[...],
+ *    "cpu":...,"lpm":...,"tx":...,"rx":...}
+ *
+ * hist[i] counts the operations that took less than (32 << i) us, the
+ * last bucket all longer operations. The energest values are given in
+ * rtimer ticks and only if energest is enabled. The last line is
+ * {"bench":"done"}.
+ *
+ * On the native platform the time is taken from the simulated storage
+ * clock, so the results do not depend on the speed of the build host.
+ */
+
+#include "contiki.h"
+#include "cfs/cfs.h"
+#include "dev/watchdog.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef STORAGE_BENCH_FAT
+#include "fat/diskio.h"
+#include "fat/cfs-fat.h"
+#endif
+#ifdef STORAGE_BENCH_COFFEE
+#include "cfs-coffee.h"
+#endif
+#ifdef CONTIKI_TARGET_NATIVE
+#include "dev/storage-sim.h"
+#include <stdlib.h>
+#endif
+
+/** Size of the file written sequentially */
+#ifdef STORAGE_BENCH_CONF_FILE_SIZE
+#define STORAGE_BENCH_FILE_SIZE STORAGE_BENCH_CONF_FILE_SIZE
+#else
+#define STORAGE_BENCH_FILE_SIZE 65536UL
+#endif
+
+/** Size of one write or read call of the sequential benchmarks. Spans
+ * several sectors, so the FAT driver reads and writes multiple blocks at
+ * once. The *_sector benchmarks use single sectors. */
+#ifdef STORAGE_BENCH_CONF_CHUNK_SIZE
+#define STORAGE_BENCH_CHUNK_SIZE STORAGE_BENCH_CONF_CHUNK_SIZE
+#else
+#define STORAGE_BENCH_CHUNK_SIZE 2048
+#endif
+
+#define SECTOR_SIZE 512
+
+/** Size of one record of the append and random read benchmarks */
+#ifdef STORAGE_BENCH_CONF_RECORD_SIZE
+#define STORAGE_BENCH_RECORD_SIZE STORAGE_BENCH_CONF_RECORD_SIZE
+#else
+#define STORAGE_BENCH_RECORD_SIZE 64
+#endif
+
+/** Number of operations of the append, random and churn benchmarks */
+#ifdef STORAGE_BENCH_CONF_OPS
+#define STORAGE_BENCH_OPS STORAGE_BENCH_CONF_OPS
+#else
+#define STORAGE_BENCH_OPS 100
+#endif
+
+/** Number of files in the directory listing benchmark */
+#ifdef STORAGE_BENCH_CONF_DIR_FILES
+#define STORAGE_BENCH_DIR_FILES STORAGE_BENCH_CONF_DIR_FILES
+#else
+#define STORAGE_BENCH_DIR_FILES 8
+#endif
+
+/** Number of blocks of the raw diskio benchmarks */
+#ifdef STORAGE_BENCH_CONF_RAW_BLOCKS
+#define STORAGE_BENCH_RAW_BLOCKS STORAGE_BENCH_CONF_RAW_BLOCKS
+#else
+#define STORAGE_BENCH_RAW_BLOCKS 128
+#endif
+
+#define HIST_BUCKETS 16
+
+#if defined STORAGE_BENCH_FAT
+#define FS_NAME "fat"
+#elif defined STORAGE_BENCH_COFFEE
+#define FS_NAME "coffee"
+#else
+#error Neither STORAGE_BENCH_FAT nor STORAGE_BENCH_COFFEE set, build with CFS=fat or CFS=coffee
+#endif
+
+typedef uint64_t bench_time_t;
+
+struct bench {
+  const char *name;
+  uint32_t ops;
+  uint32_t bytes;
+  uint16_t errors;
+  bench_time_t time_us;
+  uint16_t hist[HIST_BUCKETS];
+#if ENERGEST_CONF_ON
+  unsigned long energest[4];
+#endif
+};
+
+static uint8_t buffer[STORAGE_BENCH_CHUNK_SIZE];
+static struct bench bench;
+static bench_time_t op_start;
+/* Simple linear congruential generator, reproducible on every platform */
+static uint32_t random_state;
+
+#ifdef STORAGE_BENCH_FAT
+static struct diskio_device_info *device;
+#endif
+
+PROCESS(storage_bench_process, "Storage benchmark");
+AUTOSTART_PROCESSES(&storage_bench_process);
+/*---------------------------------------------------------------------------*/
+static bench_time_t
+now_us(void)
+{
+#ifdef CONTIKI_TARGET_NATIVE
+  return storage_sim_now();
+#else
+  static rtimer_clock_t last;
+  static bench_time_t ticks;
+
+  /* Extend the rtimer, which may only have 16 bits */
+  rtimer_clock_t t = RTIMER_NOW();
+  ticks += (rtimer_clock_t) (t - last);
+  last = t;
+  return ticks * 1000000 / RTIMER_SECOND;
+#endif
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+bench_random(void)
+{
+  random_state = random_state * 1103515245UL + 12345;
+  return random_state >> 8;
+}
+/*---------------------------------------------------------------------------*/
+#if ENERGEST_CONF_ON
+static void
+energest_snapshot(unsigned long *values)
+{
+  energest_flush();
+  values[0] = energest_type_time(ENERGEST_TYPE_CPU);
+  values[1] = energest_type_time(ENERGEST_TYPE_LPM);
+  values[2] = energest_type_time(ENERGEST_TYPE_TRANSMIT);
+  values[3] = energest_type_time(ENERGEST_TYPE_LISTEN);
+}
+#endif
+/*---------------------------------------------------------------------------*/
+static void
+bench_begin(const char *name)
+{
+  memset(&bench, 0, sizeof(bench));
+  bench.name = name;
+  random_state = 1;
+#if ENERGEST_CONF_ON
+  energest_snapshot(bench.energest);
+#endif
+}
+/*---------------------------------------------------------------------------*/
+static void
+op_begin(void)
+{
+  watchdog_periodic();
+  op_start = now_us();
+}
+/*---------------------------------------------------------------------------*/
+/* Ends an operation, ok is 0 if the operation failed */
+static void
+op_end(uint16_t bytes, uint8_t ok)
+{
+  bench_time_t t = now_us() - op_start;
+  uint8_t bucket = 0;
+
+  while(bucket < HIST_BUCKETS - 1 && t >= (32UL << bucket)) {
+    bucket++;
+  }
+
+  bench.hist[bucket]++;
+  bench.time_us += t;
+  bench.ops++;
+  if(ok) {
+    bench.bytes += bytes;
+  } else {
+    bench.errors++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+bench_end(void)
+{
+  uint8_t i;
+  unsigned long ops_s = 0, bytes_s = 0;
+
+  if(bench.time_us > 0) {
+    ops_s = bench.ops * 1000000ULL / bench.time_us;
+    bytes_s = bench.bytes * 1000000ULL / bench.time_us;
+  }
+
+  printf("{\"bench\":\"%s_%s\",\"ops\":%lu,\"bytes\":%lu,\"errors\":%u,"
+         "\"time_us\":%lu,\"ops_s\":%lu,\"bytes_s\":%lu,\"hist\":[",
+         FS_NAME, bench.name, (unsigned long) bench.ops,
+         (unsigned long) bench.bytes, bench.errors,
+         (unsigned long) bench.time_us,
+         ops_s, bytes_s);
+  for(i = 0; i < HIST_BUCKETS; i++) {
+    printf(i == 0 ? "%u" : ",%u", bench.hist[i]);
+  }
+  printf("]");
+
+#if ENERGEST_CONF_ON
+  {
+    unsigned long values[4];
+
+    energest_snapshot(values);
+    printf(",\"cpu\":%lu,\"lpm\":%lu,\"tx\":%lu,\"rx\":%lu",
+           values[0] - bench.energest[0], values[1] - bench.energest[1],
+           values[2] - bench.energest[2], values[3] - bench.energest[3]);
+  }
+#endif
+
+  printf("}\n");
+}
+/*---------------------------------------------------------------------------*/
+static void
+fill_buffer(uint32_t offset, uint16_t len)
+{
+  uint16_t i;
+
+  for(i = 0; i < len; i++) {
+    buffer[i] = (uint8_t) (offset + i);
+  }
+}
+/*---------------------------------------------------------------------------*/
+#ifdef STORAGE_BENCH_FAT
+static uint8_t
+raw_init(void)
+{
+  uint8_t i;
+
+#ifdef SDCARD_POWER_ON
+  SDCARD_POWER_ON();
+#endif
+
+  if(diskio_detect_devices() != DISKIO_SUCCESS) {
+    return 1;
+  }
+
+  /* Prefer the first partition of the SD card, the whole card otherwise */
+  device = NULL;
+  for(i = 0; i < DISKIO_MAX_DEVICES; i++) {
+    struct diskio_device_info *dev = &diskio_devices()[i];
+    if(dev->type == (DISKIO_DEVICE_TYPE_SD_CARD | DISKIO_DEVICE_TYPE_PARTITION)) {
+      device = dev;
+      break;
+    }
+    if(dev->type == DISKIO_DEVICE_TYPE_SD_CARD && device == NULL) {
+      device = dev;
+    }
+  }
+
+  if(device == NULL) {
+    return 1;
+  }
+
+  diskio_set_default_device(device);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+bench_raw(void)
+{
+  uint32_t block;
+
+  bench_begin("raw_seq_write");
+  op_begin();
+  if(diskio_write_blocks_start(device, 0, STORAGE_BENCH_RAW_BLOCKS) != DISKIO_SUCCESS) {
+    op_end(0, 0);
+  } else {
+    op_end(0, 1);
+    for(block = 0; block < STORAGE_BENCH_RAW_BLOCKS; block++) {
+      fill_buffer(block, SECTOR_SIZE);
+      op_begin();
+      op_end(SECTOR_SIZE, diskio_write_blocks_next(device, buffer) == DISKIO_SUCCESS);
+    }
+    op_begin();
+    op_end(0, diskio_write_blocks_done(device) == DISKIO_SUCCESS);
+  }
+  bench_end();
+
+  bench_begin("raw_seq_read");
+  for(block = 0; block < STORAGE_BENCH_RAW_BLOCKS; block++) {
+    op_begin();
+    op_end(SECTOR_SIZE, diskio_read_block(device, block, buffer) == DISKIO_SUCCESS);
+  }
+  bench_end();
+
+  bench_begin("raw_multi_read");
+  for(block = 0; block + STORAGE_BENCH_CHUNK_SIZE / SECTOR_SIZE <= STORAGE_BENCH_RAW_BLOCKS;
+      block += STORAGE_BENCH_CHUNK_SIZE / SECTOR_SIZE) {
+    op_begin();
+    op_end(STORAGE_BENCH_CHUNK_SIZE,
+           diskio_read_blocks(device, block, STORAGE_BENCH_CHUNK_SIZE / SECTOR_SIZE, buffer) == DISKIO_SUCCESS);
+  }
+  bench_end();
+
+  bench_begin("raw_rand_read");
+  for(block = 0; block < STORAGE_BENCH_OPS; block++) {
+    op_begin();
+    op_end(SECTOR_SIZE, diskio_read_block(device, bench_random() % STORAGE_BENCH_RAW_BLOCKS, buffer) == DISKIO_SUCCESS);
+  }
+  bench_end();
+
+  bench_begin("raw_rand_write");
+  for(block = 0; block < STORAGE_BENCH_OPS; block++) {
+    op_begin();
+    op_end(SECTOR_SIZE, diskio_write_block(device, bench_random() % STORAGE_BENCH_RAW_BLOCKS, buffer) == DISKIO_SUCCESS);
+  }
+  bench_end();
+}
+#endif /* STORAGE_BENCH_FAT */
+/*---------------------------------------------------------------------------*/
+static uint8_t
+fs_init(void)
+{
+#ifdef STORAGE_BENCH_FAT
+  if(cfs_fat_mkfs(device) != 0) {
+    return 1;
+  }
+  return cfs_fat_mount_device(device) != 0;
+#else
+  return cfs_coffee_format() != 0;
+#endif
+}
+/*---------------------------------------------------------------------------*/
+static void
+fs_sync(void)
+{
+#ifdef STORAGE_BENCH_FAT
+  cfs_fat_flush();
+#endif
+}
+/*---------------------------------------------------------------------------*/
+/* Drops the cached sectors, so the next operation reads the device */
+static void
+fs_drop_caches(void)
+{
+#ifdef STORAGE_BENCH_FAT
+  cfs_fat_umount_device();
+  cfs_fat_mount_device(device);
+#endif
+}
+/*---------------------------------------------------------------------------*/
+/* Writes and reads back a file in calls of chunk bytes */
+static void
+bench_seq(const char *file, const char *write_name, const char *read_name,
+          uint16_t chunk)
+{
+  uint32_t offset;
+  int fd;
+
+#ifdef STORAGE_BENCH_COFFEE
+  cfs_coffee_reserve(file, STORAGE_BENCH_FILE_SIZE);
+#endif
+  bench_begin(write_name);
+  fd = cfs_open(file, CFS_WRITE);
+  for(offset = 0; fd >= 0 && offset < STORAGE_BENCH_FILE_SIZE; offset += chunk) {
+    fill_buffer(offset, chunk);
+    op_begin();
+    op_end(chunk, cfs_write(fd, buffer, chunk) == chunk);
+  }
+  op_begin();
+  cfs_close(fd);
+  fs_sync();
+  op_end(0, fd >= 0);
+  bench_end();
+
+  bench_begin(read_name);
+  fd = cfs_open(file, CFS_READ);
+  for(offset = 0; fd >= 0 && offset < STORAGE_BENCH_FILE_SIZE; offset += chunk) {
+    op_begin();
+    op_end(chunk, cfs_read(fd, buffer, chunk) == chunk
+           && buffer[1] == (uint8_t) (offset + 1));
+  }
+  cfs_close(fd);
+  bench_end();
+}
+/*---------------------------------------------------------------------------*/
+static void
+bench_fs(void)
+{
+  uint32_t offset;
+  uint16_t i;
+  int fd;
+  char name[12];
+
+  bench_seq("seq.dat", "seq_write", "seq_read", STORAGE_BENCH_CHUNK_SIZE);
+  bench_seq("sector.dat", "seq_write_sector", "seq_read_sector", SECTOR_SIZE);
+
+  /* Random read of records */
+  bench_begin("rand_read");
+  fd = cfs_open("seq.dat", CFS_READ);
+  for(i = 0; fd >= 0 && i < STORAGE_BENCH_OPS; i++) {
+    offset = (bench_random() % (STORAGE_BENCH_FILE_SIZE / STORAGE_BENCH_RECORD_SIZE)) * STORAGE_BENCH_RECORD_SIZE;
+    op_begin();
+    op_end(STORAGE_BENCH_RECORD_SIZE, cfs_seek(fd, offset, CFS_SEEK_SET) == offset
+           && cfs_read(fd, buffer, STORAGE_BENCH_RECORD_SIZE) == STORAGE_BENCH_RECORD_SIZE);
+  }
+  cfs_close(fd);
+  bench_end();
+
+  /* Append records, opening and closing the file for each one like a logger */
+  bench_begin("append");
+  for(i = 0; i < STORAGE_BENCH_OPS; i++) {
+    fill_buffer(i, STORAGE_BENCH_RECORD_SIZE);
+    op_begin();
+    fd = cfs_open("append.log", CFS_WRITE | CFS_APPEND);
+    op_end(STORAGE_BENCH_RECORD_SIZE, fd >= 0 && cfs_write(fd, buffer, STORAGE_BENCH_RECORD_SIZE) == STORAGE_BENCH_RECORD_SIZE);
+    cfs_close(fd);
+  }
+  op_begin();
+  fs_sync();
+  op_end(0, 1);
+  bench_end();
+
+  /* Create, write, close and remove small files */
+  bench_begin("churn");
+  for(i = 0; i < STORAGE_BENCH_OPS; i++) {
+    sprintf(name, "churn%u.tmp", i % 4);
+    op_begin();
+    fd = cfs_open(name, CFS_WRITE);
+    op_end(STORAGE_BENCH_RECORD_SIZE, fd >= 0 && cfs_write(fd, buffer, STORAGE_BENCH_RECORD_SIZE) == STORAGE_BENCH_RECORD_SIZE);
+    cfs_close(fd);
+    op_begin();
+    op_end(0, cfs_remove(name) == 0);
+  }
+  op_begin();
+  fs_sync();
+  op_end(0, 1);
+  bench_end();
+
+  /* List the directory */
+  for(i = 0; i < STORAGE_BENCH_DIR_FILES; i++) {
+    sprintf(name, "dir%u.dat", i);
+    fd = cfs_open(name, CFS_WRITE);
+    cfs_write(fd, buffer, STORAGE_BENCH_RECORD_SIZE);
+    cfs_close(fd);
+  }
+  fs_sync();
+  bench_begin("dir_list");
+  for(i = 0; i < STORAGE_BENCH_OPS / 10; i++) {
+    struct cfs_dir dir;
+    struct cfs_dirent dirent;
+    uint8_t entries = 0;
+    uint8_t ok;
+
+    /* A listing from the cache does not touch the device at all */
+    fs_drop_caches();
+    op_begin();
+    ok = cfs_opendir(&dir, "/") == 0;
+    if(ok) {
+      while(entries < 64 && cfs_readdir(&dir, &dirent) == 0) {
+        entries++;
+      }
+      cfs_closedir(&dir);
+    }
+    op_end(0, ok);
+  }
+  bench_end();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(storage_bench_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  printf("{\"bench\":\"start\",\"fs\":\"%s\",\"file_size\":%lu,\"chunk_size\":%u,"
+         "\"record_size\":%u,\"ops\":%u,\"rtimer_second\":%lu}\n",
+         FS_NAME, (unsigned long) STORAGE_BENCH_FILE_SIZE, STORAGE_BENCH_CHUNK_SIZE,
+         STORAGE_BENCH_RECORD_SIZE, STORAGE_BENCH_OPS, (unsigned long) RTIMER_SECOND);
+
+#ifdef STORAGE_BENCH_FAT
+  if(raw_init() != 0) {
+    printf("{\"bench\":\"error\",\"reason\":\"no device\"}\n");
+    PROCESS_EXIT();
+  }
+  bench_raw();
+#endif
+
+  if(fs_init() != 0) {
+    printf("{\"bench\":\"error\",\"reason\":\"format failed\"}\n");
+    PROCESS_EXIT();
+  }
+  bench_fs();
+
+  printf("{\"bench\":\"done\"}\n");
+
+#ifdef CONTIKI_TARGET_NATIVE
+  exit(0);
+#endif
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
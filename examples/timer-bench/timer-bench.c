@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2013, Institute of Operating Systems and Computer Networks (TU Braunschweig).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      Benchmark of the event timer queue
+ *
+ * Measures the cost of the event timer operations for a growing number
+ * of pending timers. Every result is one JSON object per line:
+ *
+ *   {"bench":"etimer","timers":64,"set_ns":...,"stop_ns":...,
+ *    "poll_ns":...,"expire_ns":...,"next_ns":...}
+ *
+ *  - set_ns:    etimer_set() of a pending timer with a random interval
+ *  - stop_ns:   etimer_stop() of a pending timer
+ *  - poll_ns:   a run of the etimer process when no timer has expired,
+ *               which happens on every clock tick on some platforms
+ *  - expire_ns: a run of the etimer process per expired timer
+ *  - next_ns:   etimer_next_expiration_time()
+ *
+ * The last line is {"bench":"done"}. The benchmark is meant for the
+ * native platform, other platforms only have the resolution of the
+ * system clock:
+ *
+ *   make TARGET=native && ./timer-bench.native
+ */
+
+#include "contiki.h"
+#include "dev/watchdog.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/** Measured operations of each kind per number of timers */
+#ifdef TIMER_BENCH_CONF_ROUNDS
+#define TIMER_BENCH_ROUNDS TIMER_BENCH_CONF_ROUNDS
+#else
+#define TIMER_BENCH_ROUNDS 4000
+#endif
+
+/** Largest number of pending timers */
+#ifdef TIMER_BENCH_CONF_MAX_TIMERS
+#define TIMER_BENCH_MAX_TIMERS TIMER_BENCH_CONF_MAX_TIMERS
+#else
+#define TIMER_BENCH_MAX_TIMERS 512
+#endif
+
+/** Timers that expire together in the expire benchmark */
+#define EXPIRE_BATCH 8
+
+static struct etimer timers[TIMER_BENCH_MAX_TIMERS];
+static uint32_t rng;
+
+PROCESS(timer_bench_process, "Timer benchmark");
+AUTOSTART_PROCESSES(&timer_bench_process);
+/*---------------------------------------------------------------------------*/
+static unsigned long
+now_ns(void)
+{
+#ifdef CONTIKI_TARGET_NATIVE
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+#else
+  return clock_time() * (1000000000UL / CLOCK_SECOND);
+#endif
+}
+/*---------------------------------------------------------------------------*/
+static unsigned int
+rand_range(unsigned int range)
+{
+  rng = rng * 1103515245UL + 12345;
+  return (rng >> 16) % range;
+}
+/*---------------------------------------------------------------------------*/
+/* A random interval between 10 and 1000 seconds, so that no timer
+   expires during the benchmark */
+static clock_time_t
+interval(void)
+{
+  return CLOCK_SECOND * 10 + rand_range(CLOCK_SECOND * 990);
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_etimer_process(void)
+{
+  process_post_synch(&etimer_process, PROCESS_EVENT_POLL, NULL);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(timer_bench_process, ev, data)
+{
+  static unsigned int count;
+  static unsigned int round;
+  static unsigned long set, stop, poll, expire, next;
+  unsigned long start;
+  unsigned int i, t;
+
+  PROCESS_BEGIN();
+
+  printf("{\"bench\":\"start\",\"rounds\":%u}\n", TIMER_BENCH_ROUNDS);
+
+  rng = 1;
+  for(count = 1; count <= TIMER_BENCH_MAX_TIMERS; count *= 2) {
+    for(i = 0; i < count; i++) {
+      etimer_set(&timers[i], interval());
+    }
+    set = stop = poll = expire = next = 0;
+
+    for(round = 0; round < TIMER_BENCH_ROUNDS; round++) {
+      t = rand_range(count);
+      start = now_ns();
+      etimer_set(&timers[t], interval());
+      set += now_ns() - start;
+
+      t = rand_range(count);
+      start = now_ns();
+      etimer_stop(&timers[t]);
+      stop += now_ns() - start;
+      etimer_set(&timers[t], interval());
+
+      start = now_ns();
+      run_etimer_process();
+      poll += now_ns() - start;
+
+      start = now_ns();
+      etimer_next_expiration_time();
+      next += now_ns() - start;
+
+      if(count >= EXPIRE_BATCH && round % 16 == 0) {
+        for(i = 0; i < EXPIRE_BATCH; i++) {
+          etimer_set(&timers[rand_range(count)], 0);
+        }
+        start = now_ns();
+        run_etimer_process();
+        expire += now_ns() - start;
+        for(i = 0; i < count; i++) {
+          if(etimer_expired(&timers[i])) {
+            etimer_set(&timers[i], interval());
+          }
+        }
+        /* Receive the timer events */
+        PROCESS_PAUSE();
+      }
+      if(round % 256 == 0) {
+        watchdog_periodic();
+      }
+    }
+
+    printf("{\"bench\":\"etimer\",\"timers\":%u,\"set_ns\":%lu,"
+           "\"stop_ns\":%lu,\"poll_ns\":%lu,\"expire_ns\":%lu,"
+           "\"next_ns\":%lu}\n",
+           count, set / TIMER_BENCH_ROUNDS, stop / TIMER_BENCH_ROUNDS,
+           poll / TIMER_BENCH_ROUNDS,
+           count >= EXPIRE_BATCH ?
+           expire / ((TIMER_BENCH_ROUNDS + 15) / 16 * EXPIRE_BATCH) : 0,
+           next / TIMER_BENCH_ROUNDS);
+
+    for(i = 0; i < count; i++) {
+      etimer_stop(&timers[i]);
+    }
+  }
+
+  printf("{\"bench\":\"done\"}\n");
+
+#ifdef CONTIKI_TARGET_NATIVE
+  exit(0);
+#endif
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -343,22 +343,13 @@ external_flash_write_page(coffee_page_t page, CFS_CONF_OFFSET_TYPE offset, uint8
     return;
   }
 
-  unsigned char buffer[COFFEE_PAGE_SIZE];
-
-  // Now read the current content of that page
-  at45db_read_page_bypassed(page, 0, buffer, COFFEE_PAGE_SIZE);
-
-  watchdog_periodic();
-
-  // Copy over the new content
-  memcpy(buffer + offset, buf, size);
-
-  // And write the page again
-  at45db_write_page(page, 0, buffer, COFFEE_PAGE_SIZE);
+  // Merge the new content into the page in the flash buffer, the page is
+  // programmed while the next page is written
+  at45db_write(page, offset, buf, size);
 
   watchdog_periodic();
 
-  PRINTF("Page %u programmed with %u bytes (%u new)\n", page, COFFEE_PAGE_SIZE, size);
+  PRINTF("Page %u written with %u new bytes\n", page, size);
 }
 /*----------------------------------------------------------------------------*/
 void
@@ -414,7 +405,7 @@ external_flash_read_page(coffee_page_t page, CFS_CONF_OFFSET_TYPE offset, uint8_
     return;
   }
 
-  at45db_read_page_bypassed(page, offset, buf, size);
+  at45db_read(page, offset, buf, size);
   watchdog_periodic();
 
 #if DEBUG > 1
@@ -490,6 +481,12 @@ external_flash_erase(coffee_page_t page)
   at45db_erase_page(page);
   watchdog_periodic();
 }
+/*----------------------------------------------------------------------------*/
+void
+external_flash_flush(void)
+{
+  at45db_flush();
+}
 
 /*
 void external_flash_erase(coffee_page_t sector) {
@@ -188,6 +188,11 @@ void avr_flash_write(CFS_CONF_OFFSET_TYPE addr, uint8_t *buf, CFS_CONF_OFFSET_TY
 #define COFFEE_DYN_SIZE           (COFFEE_PAGE_SIZE*1)
 #define COFFEE_MICRO_LOGS         0
 #define COFFEE_LOG_SIZE           128
+/* Avoid header scans over the 4096 pages, costs 64 + 1024 bytes RAM */
+#define COFFEE_NAME_INDEX_SIZE    16
+#define COFFEE_SECTOR_SUMMARY     1
+/* Reclaim obsolete pages in the background before the space runs out */
+#define COFFEE_BACKGROUND_GC      1
 
 /* coffee_page_t is used for page and sector numbering
  * uint8_t can handle 511 pages.
@@ -207,6 +212,10 @@ void avr_flash_write(CFS_CONF_OFFSET_TYPE addr, uint8_t *buf, CFS_CONF_OFFSET_TY
 #define COFFEE_ERASE(sector) \
 		external_flash_erase((coffee_page_t) sector)
 
+/* Program the page that is still in the flash buffer when a file is closed */
+#define COFFEE_FLUSH() \
+		external_flash_flush()
+
 void external_flash_write_page(coffee_page_t page, CFS_CONF_OFFSET_TYPE offset, uint8_t * buf, CFS_CONF_OFFSET_TYPE size);
 
 void external_flash_write(CFS_CONF_OFFSET_TYPE addr, uint8_t *buf, CFS_CONF_OFFSET_TYPE size);
@@ -215,6 +224,8 @@ void external_flash_read(CFS_CONF_OFFSET_TYPE addr, uint8_t *buf, CFS_CONF_OFFSE
 
 void external_flash_erase(coffee_page_t sector);
 
+void external_flash_flush(void);
+
 
 #elif defined COFFEE_INGA_SDCARD /* COFFEE_INGA_EXTERNAL */
 /* Byte page size, starting address on page boundary, and size of the file system */
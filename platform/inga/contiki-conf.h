@@ -53,6 +53,17 @@
  * like the avrdude erase count and bootloader signaling. */
 #define EEPROM_CONF_SIZE   ((E2END + 1) - 4)
 
+/* Keep the settings in a log with a RAM index, see core/lib/settings-log.c */
+#define SETTINGS_CONF_LOG  1
+
+/* Two regions of SETTINGS_LEGACY_IMPORT_SIZE (163 bytes with 16 values),
+ * so the 127 bytes of settings stored by the list backend are imported
+ * on the first start. The settings take the top 326 bytes of the EEPROM,
+ * 0xEB6 to 0xFFB, which is 199 bytes more than before. Applications that
+ * keep own data in the EEPROM must stay below, as coffee does with
+ * COFFEE_DEVICE 1 or 2 (0x000 to 0xBFF). */
+#define SETTINGS_MAX_SIZE  326
+
 /* @todo: Just a temporary solution... */
 #define CFS_CONF_OFFSET_SIZE  uint32_t
 
@@ -126,6 +137,12 @@
 /* 54 bytes per queue ref buffer */
 #define QUEUEBUF_CONF_REF_NUM     2
 
+/* 184 bytes per pbuf. Frames are built in pbufs and queued and sent
+ * by the rf230 driver without being copied, one per fragment of a burst */
+#ifndef PBUF_CONF_NUM
+#define PBUF_CONF_NUM             4
+#endif /* PBUF_CONF_NUM */
+
 /* -- Default network stack */
 
 #ifndef NETSTACK_CONF_MAC
@@ -168,6 +185,11 @@
 /* Request 802.15.4 ACK on all packets sent (else autoretry).
  * This is primarily for testing. */
 #define SICSLOWPAN_CONF_ACK_ALL   0
+/* Hand the fragments of a packet to the RDC layer in one burst. They
+ * bypass the MAC layer, set to 0 when using csma_driver. */
+#ifndef SICSLOWPAN_CONF_FRAG_BURST
+#define SICSLOWPAN_CONF_FRAG_BURST 4
+#endif
 /* 10 bytes per stateful address context - see sicslowpan.c */
 /* Default is 1 context with prefix aaaa::/64 */
 /* These must agree with all the other nodes or there will be a failure to communicate! */
@@ -64,6 +64,73 @@
 static bufmgr_t buffer_mgr;
 static uint8_t initialized = 0;
 
+/*
+ * Waits until the pending operation is finished. Nothing is polled if no
+ * operation was started since the device was ready the last time.
+ */
+static void
+wait_ready(void) {
+  if (buffer_mgr.pending) {
+    at45db_busy_wait();
+  }
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Waits until the buffer may be accessed again. The buffer that is not
+ * used by a pending program or transfer can be read and written right away.
+ */
+static void
+buffer_ready(uint8_t b) {
+  if (buffer_mgr.pending
+          && (buffer_mgr.busy_buffer == b || buffer_mgr.busy_buffer == 0xFF)) {
+    wait_ready();
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void
+start_operation(uint8_t b) {
+  buffer_mgr.pending = 1;
+  buffer_mgr.busy_buffer = b;
+}
+/*----------------------------------------------------------------------------*/
+/* Erases the page of the buffer and programs it in the background */
+static void
+program_buffer(uint8_t b) {
+  uint16_t addr = buffer_mgr.page[b];
+  wait_ready();
+  uint8_t cmd[4] = {buffer_mgr.buf_to_page_addr[b],
+    (uint8_t) (addr >> 6), (uint8_t) (addr << 2), 0x00};
+  at45db_write_cmd(&cmd[0]);
+  mspi_chip_release(AT45DB_CS);
+  buffer_mgr.dirty &= ~(1 << b);
+  start_operation(b);
+}
+/*----------------------------------------------------------------------------*/
+/* Forgets a page, unwritten data is dropped */
+static void
+drop_page(uint16_t addr) {
+  uint8_t b;
+  for (b = 0; b < 2; b++) {
+    if (addr == AT45DB_NO_PAGE || buffer_mgr.page[b] == addr) {
+      buffer_mgr.page[b] = AT45DB_NO_PAGE;
+      buffer_mgr.dirty &= ~(1 << b);
+    }
+  }
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * The functions that use the buffers directly know nothing about the
+ * cached pages. Program them and leave the active buffer free.
+ */
+static void
+release_buffers(void) {
+  at45db_flush();
+  drop_page(AT45DB_NO_PAGE);
+  if (buffer_mgr.pending && buffer_mgr.busy_buffer < 2) {
+    buffer_mgr.active_buffer = buffer_mgr.busy_buffer ^ 1;
+  }
+}
+/*----------------------------------------------------------------------------*/
 int8_t
 at45db_init(void) {
   uint8_t i = 0, id = 0;
@@ -75,6 +142,14 @@ at45db_init(void) {
   buffer_mgr.buf_to_page_addr[1] = AT45DB_BUF_2_TO_PAGE;
   buffer_mgr.page_program[0] = AT45DB_PAGE_PROGRAM_1;
   buffer_mgr.page_program[1] = AT45DB_PAGE_PROGRAM_2;
+  buffer_mgr.page_to_buf_addr[0] = AT45DB_PAGE_TO_BUF_1;
+  buffer_mgr.page_to_buf_addr[1] = AT45DB_PAGE_TO_BUF;
+  buffer_mgr.read_buffer_addr[0] = AT45DB_READ_BUFFER_1;
+  buffer_mgr.read_buffer_addr[1] = AT45DB_READ_BUFFER;
+  buffer_mgr.page[0] = AT45DB_NO_PAGE;
+  buffer_mgr.page[1] = AT45DB_NO_PAGE;
+  buffer_mgr.dirty = 0;
+  buffer_mgr.pending = 0;
 
   mspi_chip_release(AT45DB_CS);
   /*init mspi in mode3, at chip select pin 3 and max baud rate*/
@@ -100,48 +175,55 @@ at45db_init(void) {
 void
 at45db_erase_chip(void) {
   if (!initialized) return;
+  drop_page(AT45DB_NO_PAGE);
+  wait_ready();
   /*chip erase command consists of 4 byte*/
   uint8_t cmd[4] = {0xC7, 0x94, 0x80, 0x9A};
   at45db_write_cmd(&cmd[0]);
   mspi_chip_release(AT45DB_CS);
   /*wait until AT45DB161 is ready again*/
-  mspi_chip_select(AT45DB_CS);
-  at45db_busy_wait();
-  mspi_chip_release(AT45DB_CS);
+  start_operation(0xFF);
+  wait_ready();
 }
 /*----------------------------------------------------------------------------*/
 void
 at45db_erase_block(uint16_t addr) {
+  uint16_t i;
   if (!initialized) return;
+  /*a block consists of 8 pages*/
+  for (i = addr << 3; i < (addr + 1) << 3; i++) {
+    drop_page(i);
+  }
+  wait_ready();
   /*block erase command consists of 4 byte*/
   uint8_t cmd[4] = {AT45DB_BLOCK_ERASE, (uint8_t) (addr >> 3),
     (uint8_t) (addr << 5), 0x00};
   at45db_write_cmd(&cmd[0]);
   mspi_chip_release(AT45DB_CS);
-  /*wait until AT45DB161 is ready again*/
-  mspi_chip_select(AT45DB_CS);
-  at45db_busy_wait();
-  mspi_chip_release(AT45DB_CS);
+  /*the next command waits until AT45DB161 is ready again*/
+  start_operation(0xFF);
 }
 /*----------------------------------------------------------------------------*/
 void
 at45db_erase_page(uint16_t addr) {
   if (!initialized) return;
+  drop_page(addr);
+  wait_ready();
   /*block erase command consists of 4 byte*/
   uint8_t cmd[4] = {AT45DB_PAGE_ERASE, (uint8_t) (addr >> 6),
     (uint8_t) (addr << 2), 0x00};
   at45db_write_cmd(&cmd[0]);
   mspi_chip_release(AT45DB_CS);
-  /*wait until AT45DB161 is ready again*/
-  mspi_chip_select(AT45DB_CS);
-  at45db_busy_wait();
-  mspi_chip_release(AT45DB_CS);
+  /*the next command waits until AT45DB161 is ready again*/
+  start_operation(0xFF);
 }
 /*----------------------------------------------------------------------------*/
 void
 at45db_write_buffer(uint16_t addr, uint8_t *buffer, uint16_t bytes) {
   uint16_t i;
   if (!initialized) return;
+  release_buffers();
+  buffer_ready(buffer_mgr.active_buffer);
   /*block erase command consists of 4 byte*/
   uint8_t cmd[4] = {buffer_mgr.buffer_addr[buffer_mgr.active_buffer], 0x00,
     (uint8_t) (addr >> 8), (uint8_t) (addr)};
@@ -159,12 +241,13 @@ void
 at45db_buffer_to_page(uint16_t addr) {
   if (!initialized) return;
   /*wait until AT45DB161 is ready again*/
-  at45db_busy_wait();
+  wait_ready();
   /*write active buffer to page command consists of 4 byte*/
   uint8_t cmd[4] = {buffer_mgr.buf_to_page_addr[buffer_mgr.active_buffer],
     (uint8_t) (addr >> 6), (uint8_t) (addr << 2), 0x00};
   at45db_write_cmd(&cmd[0]);
   mspi_chip_release(AT45DB_CS);
+  start_operation(buffer_mgr.active_buffer);
   /* switch active buffer to allow the other one to be written,
    * while these buffer is copied to the Flash EEPROM page*/
   buffer_mgr.active_buffer ^= 1;
@@ -174,6 +257,8 @@ void
 at45db_write_page(uint16_t p_addr, uint16_t b_addr, uint8_t *buffer, uint16_t bytes) {
   uint16_t i;
   if (!initialized) return;
+  release_buffers();
+  wait_ready();
   /*block erase command consists of 4 byte*/
   uint8_t cmd[4] = {buffer_mgr.page_program[buffer_mgr.active_buffer],
     (uint8_t) (p_addr >> 6),
@@ -186,6 +271,7 @@ at45db_write_page(uint16_t p_addr, uint16_t b_addr, uint8_t *buffer, uint16_t by
   }
 
   mspi_chip_release(AT45DB_CS);
+  start_operation(buffer_mgr.active_buffer);
 
   /* switch active buffer to allow the other one to be written,
    * while these buffer is copied to the Flash EEPROM page*/
@@ -197,7 +283,7 @@ at45db_read_page_buffered(uint16_t p_addr, uint16_t b_addr,
         uint8_t *buffer, uint16_t bytes) {
   if (!initialized) return;
   /* wait until AT45DB161 is ready again */
-  at45db_busy_wait();
+  wait_ready();
   at45db_page_to_buf(p_addr);
   at45db_read_buffer(b_addr, buffer, bytes);
 }
@@ -207,8 +293,14 @@ at45db_read_page_bypassed(uint16_t p_addr, uint16_t b_addr,
         uint8_t *buffer, uint16_t bytes) {
   uint16_t i;
   if (!initialized) return;
+  /* a page that was written to a buffer must be programmed first */
+  for (i = 0; i < 2; i++) {
+    if (buffer_mgr.page[i] == p_addr && (buffer_mgr.dirty & (1 << i))) {
+      program_buffer(i);
+    }
+  }
   /* wait until AT45DB161 is ready again */
-  at45db_busy_wait();
+  wait_ready();
   /* read bytes directly from page command consists of 4 cmd bytes and
    * 4 don't care */
   uint8_t cmd[4] = {AT45DB_PAGE_READ,
@@ -231,6 +323,8 @@ void
 at45db_page_to_buf(uint16_t addr) {
 
   if (!initialized) return;
+  release_buffers();
+  wait_ready();
   /* write active buffer to page command consists of 4 byte */
   uint8_t cmd[4] = {AT45DB_PAGE_TO_BUF,
     (uint8_t) (addr >> 6),
@@ -241,7 +335,8 @@ at45db_page_to_buf(uint16_t addr) {
   /* switch active buffer to allow the other one to be written,
    * while these buffer is copied to the Flash EEPROM page*/
   //buffer_mgr.active_buffer ^= 1;
-  at45db_busy_wait();
+  start_operation(1);
+  wait_ready();
 
 }
 /*----------------------------------------------------------------------------*/
@@ -251,7 +346,83 @@ at45db_read_buffer(uint16_t b_addr, uint8_t *buffer, uint16_t bytes) {
   if (!initialized) return;
   uint8_t cmd[4] = {AT45DB_READ_BUFFER, 0x00, (uint8_t) (b_addr >> 8),
     (uint8_t) (b_addr)};
-  at45db_busy_wait();
+  buffer_ready(1);
+  at45db_write_cmd(&cmd[0]);
+  mspi_transceive(0x00);
+
+  for (i = 0; i < bytes; i++) {
+    *buffer++ = ~mspi_transceive(0x00);
+  }
+  mspi_chip_release(AT45DB_CS);
+}
+/*----------------------------------------------------------------------------*/
+void
+at45db_write(uint16_t p_addr, uint16_t b_addr, uint8_t *buffer, uint16_t bytes) {
+  uint16_t i;
+  uint8_t b;
+  if (!initialized || bytes == 0) return;
+
+  for (b = 0; b < 2 && buffer_mgr.page[b] != p_addr; b++);
+
+  if (b == 2) {
+    /* take the buffer that was not written last */
+    b = buffer_mgr.active_buffer ^ 1;
+    if (buffer_mgr.dirty & (1 << b)) {
+      program_buffer(b);
+    }
+    if (bytes < AT45DB_PAGE_SIZE) {
+      /* the rest of the page has to be kept */
+      wait_ready();
+      uint8_t cmd[4] = {buffer_mgr.page_to_buf_addr[b],
+        (uint8_t) (p_addr >> 6), (uint8_t) (p_addr << 2), 0x00};
+      at45db_write_cmd(&cmd[0]);
+      mspi_chip_release(AT45DB_CS);
+      start_operation(b);
+    }
+    buffer_mgr.page[b] = p_addr;
+  }
+
+  if (b != buffer_mgr.active_buffer) {
+    /* program the previous page while this one is filled */
+    if (buffer_mgr.dirty & (1 << buffer_mgr.active_buffer)) {
+      program_buffer(buffer_mgr.active_buffer);
+    }
+    buffer_mgr.active_buffer = b;
+  }
+
+  buffer_ready(b);
+  uint8_t cmd[4] = {buffer_mgr.buffer_addr[b], 0x00,
+    (uint8_t) (b_addr >> 8), (uint8_t) (b_addr)};
+  at45db_write_cmd(&cmd[0]);
+
+  for (i = 0; i < bytes; i++) {
+    mspi_transceive(~(*buffer++));
+  }
+
+  mspi_chip_release(AT45DB_CS);
+  buffer_mgr.dirty |= 1 << b;
+
+#if !AT45DB_WRITE_BACK
+  program_buffer(b);
+#endif
+}
+/*----------------------------------------------------------------------------*/
+void
+at45db_read(uint16_t p_addr, uint16_t b_addr, uint8_t *buffer, uint16_t bytes) {
+  uint16_t i;
+  uint8_t b;
+  if (!initialized) return;
+
+  for (b = 0; b < 2 && buffer_mgr.page[b] != p_addr; b++);
+
+  if (b == 2) {
+    at45db_read_page_bypassed(p_addr, b_addr, buffer, bytes);
+    return;
+  }
+
+  buffer_ready(b);
+  uint8_t cmd[4] = {buffer_mgr.read_buffer_addr[b], 0x00,
+    (uint8_t) (b_addr >> 8), (uint8_t) (b_addr)};
   at45db_write_cmd(&cmd[0]);
   mspi_transceive(0x00);
 
@@ -262,6 +433,17 @@ at45db_read_buffer(uint16_t b_addr, uint8_t *buffer, uint16_t bytes) {
 }
 /*----------------------------------------------------------------------------*/
 void
+at45db_flush(void) {
+  uint8_t b;
+  if (!initialized) return;
+  for (b = 0; b < 2; b++) {
+    if (buffer_mgr.dirty & (1 << b)) {
+      program_buffer(b);
+    }
+  }
+}
+/*----------------------------------------------------------------------------*/
+void
 at45db_write_cmd(uint8_t *cmd) {
   uint8_t i;
   if (!initialized) return;
@@ -271,18 +453,36 @@ at45db_write_cmd(uint8_t *cmd) {
   }
 }
 /*----------------------------------------------------------------------------*/
+uint8_t
+at45db_busy(void) {
+  uint8_t status;
+  if (!initialized || !buffer_mgr.pending) return 0;
+  mspi_chip_select(AT45DB_CS);
+  mspi_transceive(AT45DB_STATUS_REG);
+  status = mspi_transceive(MSPI_DUMMY_BYTE);
+  mspi_chip_release(AT45DB_CS);
+  if (status & 0x80) {
+    buffer_mgr.pending = 0;
+    return 0;
+  }
+  return 1;
+}
+/*----------------------------------------------------------------------------*/
 void
 at45db_busy_wait(void) {
   uint16_t i = 0;
   if (!initialized) return;
   mspi_chip_select(AT45DB_CS);
   mspi_transceive(AT45DB_STATUS_REG);
+  /* the status register is sent repeatedly while the chip is selected */
   while ((mspi_transceive(MSPI_DUMMY_BYTE) >> 7) != 0x01) {
-    _delay_ms(1);
-    if (i++ > 500) {
+    _delay_us(20);
+    if (i++ > 25000) {
       PRINTF("at45db.c: at45db_busy_wait timeout\n");
+      mspi_chip_release(AT45DB_CS);
       return;
     }
   }
   mspi_chip_release(AT45DB_CS);
+  buffer_mgr.pending = 0;
 }
@@ -60,6 +60,15 @@
  * only a command is necessary and the AT45DBxx1 will copy the buffer into
  * the flash section. To avoid latency, it is possible (and implemented)
  * to switch between the page buffers.
+ *
+ * \note
+ * at45db_write() and at45db_read() use the two buffers as a cache of two
+ * pages. Writes are merged into the buffer that holds the page, so only
+ * the new bytes are transferred, and the page is programmed right after
+ * each write. Programming runs in the background while the other buffer
+ * is filled, the driver only polls the status register when the device
+ * has to be idle. With AT45DB_CONF_WRITE_BACK the page is only programmed
+ * when the next page is written or at45db_flush() is called.
  * @{
  *
  */
@@ -67,6 +76,7 @@
 #ifndef FLASHAT45DB_H_
 #define FLASHAT45DB_H_
 
+#include "contiki-conf.h"
 #include "../dev/mspi.h"
 #include <stdio.h>
 #include <util/delay.h>
@@ -78,6 +88,30 @@
  */
 #define AT45DB_CS 					1
 
+/*!
+ * Page size in bytes (528 byte pages, e.g. AT45DB161)
+ */
+#define AT45DB_PAGE_SIZE			528
+
+/*!
+ * Keep the written page in its buffer until another page is written or
+ * at45db_flush() is called. This saves programming cycles for small
+ * writes to the same page, but the buffer is lost on a reset, so the
+ * last page written may never reach the Flash EEPROM. By default every
+ * at45db_write() programs the page immediately, still without waiting
+ * for the programming.
+ */
+#ifdef AT45DB_CONF_WRITE_BACK
+#define AT45DB_WRITE_BACK AT45DB_CONF_WRITE_BACK
+#else
+#define AT45DB_WRITE_BACK 0
+#endif
+
+/*!
+ * No page in this buffer
+ */
+#define AT45DB_NO_PAGE				0xFFFF
+
 /*!
  * Status Register Address. Bit 7 signalizes if the device is
  * busy.
@@ -131,12 +165,20 @@
  *
  */
 #define AT45DB_PAGE_TO_BUF			0x55 //use buffer 2
+/*!
+ * Transfer page to buffer 1 Opcode
+ */
+#define AT45DB_PAGE_TO_BUF_1		0x53
 /*!
  * Read buffer 2 opcode
  * \note Only Buffer 2 is used to readout a page, because the read
  * respectively transfer latency is only about 200us
  */
 #define AT45DB_READ_BUFFER  		0xD6
+/*!
+ * Read buffer 1 opcode
+ */
+#define AT45DB_READ_BUFFER_1		0xD4
 
 
 /*!
@@ -167,6 +209,36 @@ typedef struct{
  * Main Memory Page Program (Erase Page + Reprogram directly in one operation)
  */
 	volatile uint8_t page_program[2];
+
+/*!
+ * The specific "page to buffer" and "read buffer" opcodes
+ * for buffer 1 and buffer 2
+ */
+	volatile uint8_t page_to_buf_addr[2];
+	volatile uint8_t read_buffer_addr[2];
+
+/*!
+ * The page held by buffer 1 and buffer 2 or AT45DB_NO_PAGE
+ */
+	volatile uint16_t page[2];
+
+/*!
+ * Bit 0 and 1 are set if buffer 1 and 2 hold data that is not
+ * programmed yet
+ */
+	volatile uint8_t dirty;
+
+/*!
+ * Set when an operation was started that keeps the device busy,
+ * cleared when the status register reported ready
+ */
+	volatile uint8_t pending;
+
+/*!
+ * The buffer that is used by the pending operation
+ * (0xFF for erase operations)
+ */
+	volatile uint8_t busy_buffer;
 }bufmgr_t;
 
 /**
@@ -272,6 +344,41 @@ void at45db_read_page_buffered(uint16_t p_addr, uint16_t b_addr, uint8_t *buffer
  */
 void at45db_read_page_bypassed(uint16_t p_addr, uint16_t b_addr, uint8_t *buffer, uint16_t bytes);
 
+/**
+ * \brief Writes bytes into a page and keeps the rest of the page. The
+ * bytes are merged into the buffer that holds the page, if no buffer
+ * holds it the page is transferred into the buffer not used last. The
+ * previous page is programmed while the new bytes are transferred.
+ *
+ * \param p_addr page address e.g. AT45DB161 (0 - 4095)
+ * \param b_addr byte address within the page e.g. AT45DB161 (0 - 527)
+ * \param *buffer Pointer to local byte buffer
+ * \param bytes Number of bytes which have to be written
+ *
+ * \note With AT45DB_WRITE_BACK the bytes only reach the Flash EEPROM
+ * page when another page is written or at45db_flush() is called.
+ */
+void at45db_write(uint16_t p_addr, uint16_t b_addr, uint8_t *buffer, uint16_t bytes);
+
+/**
+ * \brief Reads bytes from a page. Pages held by a buffer are read from
+ * the buffer, this does not wait for the programming of the other
+ * buffer.
+ *
+ * \param p_addr page address e.g. AT45DB161 (0 - 4095)
+ * \param b_addr byte address within the page e.g. AT45DB161 (0 - 527)
+ * \param *buffer Pointer to local byte buffer
+ * \param bytes Number of bytes which have to be read
+ */
+void at45db_read(uint16_t p_addr, uint16_t b_addr, uint8_t *buffer, uint16_t bytes);
+
+/**
+ * \brief Starts programming the buffer written by at45db_write(), if
+ * its page was not programmed yet. Returns without waiting for the
+ * programming.
+ */
+void at45db_flush(void);
+
 /**
  * \brief Copies the given page into the buffer 2.
  * \note Only Buffer 2 is used to readout a page, because the read
@@ -309,6 +416,14 @@ void at45db_write_cmd(uint8_t *cmd);
  */
 void at45db_busy_wait(void);
 
+/**
+ * \brief Reads the status register once without waiting.
+ *
+ * \retval 1 the device is erasing, programming or transferring a page
+ * \retval 0 the device is ready
+ */
+uint8_t at45db_busy(void);
+
 /** @} */
 /** @} */
 
@@ -78,6 +78,8 @@
 #define SDCARD_CMD9   9
 /** CMD10 -- SEND_CID */
 #define SDCARD_CMD10  10
+/** CMD12 -- STOP_TRANSMISSION */
+#define SDCARD_CMD12  12
 /** CMD13 -- SEND_STATUS */
 #define SDCARD_CMD13  13
 
@@ -195,6 +197,7 @@ static uint8_t sdcard_sdsc_card = 1;
 static uint8_t sdcard_crc_enable = 0;
 
 static void get_csd_info(uint8_t *csd);
+static uint8_t sdcard_receive_data_block(uint8_t *buffer);
 /**
  * Waits for the busy signal to become high.
  * \retval 0 successfull
@@ -749,14 +752,99 @@ sdcard_read_block(uint32_t addr, uint8_t *buffer)
   /* send CMD17 with address information. */ 
   if ((i = sdcard_write_cmd(SDCARD_CMD17, &addr, NULL)) != 0x00) {
     PRINTD("\nsdcard_read_block(): CMD17 failure! (%u)", i);
+    mspi_chip_release(MICRO_SD_CS);
+    return SDCARD_CMD_ERROR;
+  }
+
+  ret = sdcard_receive_data_block(buffer);
+
+  /* release chip select and disable sdcard spi */
+  mspi_chip_release(MICRO_SD_CS);
+
+  return ret;
+}
+/*----------------------------------------------------------------------------*/
+uint8_t
+sdcard_read_multi_block_start(uint32_t addr)
+{
+  uint8_t ret;
+
+  /* calculate the start address: byte_addr = block_addr * 512.
+   * this is only needed if the card is a SDSC card and uses
+   * byte addressing (Block size of 512 is set in sdcard_init()).
+   * SDHC and SDXC card use block-addressing with a fixed block size
+   * of 512 Bytes.
+   */
+  if (sdcard_sdsc_card) {
+    addr = addr << 9;
+  }
+
+  mspi_chip_select(MICRO_SD_CS);
+
+  if (sdcard_busy_wait() == SDCARD_BUSY_TIMEOUT) {
+    mspi_chip_release(MICRO_SD_CS);
+    return SDCARD_BUSY_TIMEOUT;
+  }
+
+  /* send CMD18 with address information. */
+  if ((ret = sdcard_write_cmd(SDCARD_CMD18, &addr, NULL)) != 0x00) {
+    PRINTD("\nsdcard_read_multi_block_start(): CMD18 failure! (%u)", ret);
+    mspi_chip_release(MICRO_SD_CS);
     return SDCARD_CMD_ERROR;
   }
 
+  /* chip select stays asserted until sdcard_read_multi_block_stop() */
+  return SDCARD_SUCCESS;
+}
+/*----------------------------------------------------------------------------*/
+uint8_t
+sdcard_read_multi_block_next(uint8_t *buffer)
+{
+  mspi_chip_select(MICRO_SD_CS);
+
+  return sdcard_receive_data_block(buffer);
+}
+/*----------------------------------------------------------------------------*/
+uint8_t
+sdcard_read_multi_block_stop()
+{
+  uint8_t ret;
+
+  mspi_chip_select(MICRO_SD_CS);
+
+  /* CMD12 terminates the data stream, card responds with R1b */
+  if ((ret = sdcard_write_cmd(SDCARD_CMD12, NULL, NULL)) & 0xFE) {
+    PRINTD("\nsdcard_read_multi_block_stop(): CMD12 failure! (%u)", ret);
+    mspi_chip_release(MICRO_SD_CS);
+    return SDCARD_CMD_ERROR;
+  }
+
+  if (sdcard_busy_wait() == SDCARD_BUSY_TIMEOUT) {
+    mspi_chip_release(MICRO_SD_CS);
+    return SDCARD_BUSY_TIMEOUT;
+  }
+
+  /* release chip select and disable sdcard spi */
+  mspi_chip_release(MICRO_SD_CS);
+
+  return SDCARD_SUCCESS;
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Receives one data block (start token, 512 bytes data, CRC) after a
+ * read command. Chip select must already be asserted.
+ */
+static uint8_t
+sdcard_receive_data_block(uint8_t *buffer)
+{
+  uint16_t i;
+  uint8_t ret;
+
   /* wait for the 0xFE start byte */
   i = 0;
   while ((ret = mspi_transceive(MSPI_DUMMY_BYTE)) == SD_DATA_HIGH) {
-    if (i >= 200) {
-      PRINTD("\nsdcard_read_block(): No Start Byte recieved, last was %d", ret);
+    if (++i >= 200) {
+      PRINTD("\nsdcard_receive_data_block(): No Start Byte recieved, last was %d", ret);
       return SDCARD_DATA_TIMEOUT;
     }
   }
@@ -777,9 +865,6 @@ sdcard_read_block(uint32_t addr, uint8_t *buffer)
   mspi_transceive(MSPI_DUMMY_BYTE);
   mspi_transceive(MSPI_DUMMY_BYTE);
 
-  /* release chip select and disable sdcard spi */
-  mspi_chip_release(MICRO_SD_CS);
-
   return SDCARD_SUCCESS;
 }
 /*----------------------------------------------------------------------------*/
@@ -1053,6 +1138,11 @@ sdcard_write_cmd(uint8_t cmd, uint32_t *arg, uint8_t *resp)
     mspi_transceive(*(cmd_seq + i));
   }
 
+  /* The byte following CMD12 is a stuff byte from the aborted data stream */
+  if (cmd == SDCARD_CMD12) {
+    mspi_transceive(MSPI_DUMMY_BYTE);
+  }
+
   /* wait for the answer of the sd card */
   i = 0;
   do {
@@ -47,11 +47,12 @@
  * This driver provides the following main features:
  *
  * - single block read
+ * - multi block read
  * - single block write
  * - multi block write
  *
- * Note that multiple bock write is faster than single block write
- * but only writes sequential block numbers
+ * Note that multiple bock read/write is faster than single block read/write
+ * but only reads/writes sequential block numbers
  *
  * \note CRC functionality is not fully implemented thus it sould not be used yet.
  *
@@ -187,6 +188,39 @@ uint8_t sdcard_erase_blocks(uint32_t startaddr, uint32_t endaddr);
  */
 uint8_t sdcard_read_block(uint32_t addr, uint8_t *buffer);
 
+/**
+ * \brief Prepares to read multiple blocks sequentially.
+ *
+ * The card streams consecutive blocks until sdcard_read_multi_block_stop()
+ * is called. This saves the command overhead of sdcard_read_block() for
+ * each block.
+ *
+ * \param addr Address of first block
+ * \retval SDCARD_SUCCESS Starting multi block read was successful
+ * \retval SDCARD_CMD_ERROR CMD18 failure
+ * \retval SDCARD_BUSY_TIMEOUT
+ */
+uint8_t sdcard_read_multi_block_start(uint32_t addr);
+
+/**
+ * \brief Reads next of multiple sequential blocks.
+ *
+ * \param *buffer Pointer to a block buffer (needs to be as long as sdcard_get_block_size()).
+ * \retval SDCARD_SUCCESS Successfully read block
+ * \retval SDCARD_DATA_TIMEOUT
+ * \retval SDCARD_DATA_ERROR
+ */
+uint8_t sdcard_read_multi_block_next(uint8_t *buffer);
+
+/**
+ * \brief Stops multiple block read.
+ *
+ * \retval SDCARD_SUCCESS successfull
+ * \retval SDCARD_CMD_ERROR CMD12 failure
+ * \retval SDCARD_BUSY_TIMEOUT
+ */
+uint8_t sdcard_read_multi_block_stop();
+
 /**
  * \brief This function will write one block (512, 1024, 2048 or 4096Byte) of the SD-Card.
  *
@@ -45,6 +45,12 @@
 
 #define SD_READ_BLOCK(block_start_address, buffer) \
         sdcard_read_block( block_start_address, buffer )
+#define SD_READ_BLOCKS_START(blocks_start_address) \
+        sdcard_read_multi_block_start(blocks_start_address)
+#define SD_READ_BLOCKS_NEXT(buffer) \
+        sdcard_read_multi_block_next(buffer)
+#define SD_READ_BLOCKS_DONE() \
+        sdcard_read_multi_block_stop()
 #define SD_WRITE_BLOCK(block_start_address, buffer) \
         sdcard_write_block( block_start_address, buffer )
 #define SD_INIT() \
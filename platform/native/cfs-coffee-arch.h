@@ -56,7 +56,29 @@
 #define COFFEE_LOG_TABLE_LIMIT		256
 #define COFFEE_MICRO_LOGS		0
 #define COFFEE_IO_SEMANTICS		1
+#define COFFEE_NAME_INDEX_SIZE		16
+#define COFFEE_SECTOR_SUMMARY		1
+#define COFFEE_BACKGROUND_GC		1
 
+/* Use the simulated dataflash with its timing model instead of xmem */
+#ifdef COFFEE_CONF_FLASH_SIM
+#define COFFEE_FLASH_SIM COFFEE_CONF_FLASH_SIM
+#else
+#define COFFEE_FLASH_SIM 0
+#endif
+
+#if COFFEE_FLASH_SIM
+#include "dev/flash-sim.h"
+
+#define COFFEE_WRITE(buf, size, offset)				\
+		flash_sim_pwrite((char *)(buf), (size), COFFEE_START + (offset))
+
+#define COFFEE_READ(buf, size, offset)				\
+  		flash_sim_pread((char *)(buf), (size), COFFEE_START + (offset))
+
+#define COFFEE_ERASE(sector)					\
+  		flash_sim_erase(COFFEE_SECTOR_SIZE, COFFEE_START + (sector) * COFFEE_SECTOR_SIZE)
+#else /* COFFEE_FLASH_SIM */
 #define COFFEE_WRITE(buf, size, offset)				\
 		xmem_pwrite((char *)(buf), (size), COFFEE_START + (offset))
 
@@ -65,6 +87,7 @@
 
 #define COFFEE_ERASE(sector)					\
   		xmem_erase(COFFEE_SECTOR_SIZE, COFFEE_START + (sector) * COFFEE_SECTOR_SIZE)
+#endif /* COFFEE_FLASH_SIM */
 
 #define READ_HEADER(hdr, page)						\
   COFFEE_READ((hdr), sizeof (*hdr), (page) * COFFEE_PAGE_SIZE)
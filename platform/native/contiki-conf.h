@@ -68,7 +68,9 @@ typedef unsigned short uip_stats_t;
 #define UIP_CONF_UDP             1
 #define UIP_CONF_MAX_CONNECTIONS 40
 #define UIP_CONF_MAX_LISTENPORTS 40
+#ifndef UIP_CONF_BUFFER_SIZE
 #define UIP_CONF_BUFFER_SIZE     420
+#endif /* UIP_CONF_BUFFER_SIZE */
 #define UIP_CONF_BYTE_ORDER      UIP_LITTLE_ENDIAN
 #define UIP_CONF_TCP       1
 #define UIP_CONF_TCP_SPLIT       0
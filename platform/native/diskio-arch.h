@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2013, Institute of Operating Systems and Computer Networks (TU Braunschweig).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      Diskio driver definitions - Platform Specific
+ *
+ * Maps the diskio devices to the simulated SD card and flash.
+ */
+
+#ifndef DISKIO_ARCH_H
+#define DISKIO_ARCH_H
+
+#include "dev/sdcard-sim.h"
+#include "dev/flash-sim.h"
+#include "dev/storage-sim.h"
+
+#define SD_READ_BLOCK(block_start_address, buffer) \
+        sdcard_sim_read_block( block_start_address, buffer )
+#define SD_READ_BLOCKS_START(blocks_start_address) \
+        sdcard_sim_read_multi_block_start(blocks_start_address)
+#define SD_READ_BLOCKS_NEXT(buffer) \
+        sdcard_sim_read_multi_block_next(buffer)
+#define SD_READ_BLOCKS_DONE() \
+        sdcard_sim_read_multi_block_stop()
+#define SD_WRITE_BLOCK(block_start_address, buffer) \
+        sdcard_sim_write_block( block_start_address, buffer )
+#define SD_INIT() \
+        sdcard_sim_init()
+#define SD_GET_BLOCK_NUM() \
+        sdcard_sim_get_block_num()
+#define SD_GET_BLOCK_SIZE() \
+        sdcard_sim_get_block_size()
+#define SD_WRITE_BLOCKS_START(blocks_start_address, num_blocks) \
+        sdcard_sim_write_multi_block_start(blocks_start_address, num_blocks)
+#define SD_WRITE_BLOCKS_NEXT(buffer) \
+        sdcard_sim_write_multi_block_next(buffer)
+#define SD_WRITE_BLOCKS_DONE() \
+        sdcard_sim_write_multi_block_stop()
+
+
+#define FLASH_READ_BLOCK(block_start_address, offset, buffer, length) \
+        flash_sim_read_page( block_start_address, offset, buffer, length)
+#define FLASH_WRITE_BLOCK(block_start_address, offset, buffer, length) \
+        flash_sim_write_page( block_start_address, offset, buffer, length)
+#define FLASH_INIT() \
+        flash_sim_init()
+
+#define FLASH_ARCH_NUM_SECTORS  FLASH_SIM_PAGES
+
+/* Retry delay of diskio, passes on the simulated storage clock */
+#define _delay_ms(ms) \
+        storage_sim_elapse((ms) * 1000UL)
+
+#endif /* DISKIO_ARCH_H */
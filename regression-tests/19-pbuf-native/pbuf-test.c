@@ -0,0 +1,560 @@
+/*
+ * Copyright (c) 2013, Institute of Operating Systems and Computer Networks (TU Braunschweig).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Host test of the pbuf backed packetbuf and queuebufs
+ *
+ *         Sends IPv6 packets of many sizes through sicslowpan into a test
+ *         MAC and RDC layer, feeds the captured frames back in and compares
+ *         the reassembled packets. The fragments of two senders are fed
+ *         back in other orders, interleaved, duplicated and invalid, and
+ *         the reassembly counters are checked. Queued frames are restored
+ *         with and without a link-layer header, and no pbuf may be left
+ *         allocated.
+ *         The Makefile builds it with several pbuf and fragment burst
+ *         settings under AddressSanitizer.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "contiki.h"
+#include "net/packetbuf.h"
+#include "net/queuebuf.h"
+#include "net/pbuf.h"
+#include "net/ip/uip.h"
+#include "net/ipv6/sicslowpan.h"
+#include "net/netstack.h"
+
+#define UIP_IP_BUF ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+
+#define MAX_FRAMES 40
+#define MAX_FRAME_SIZE 128
+/* Header that the test RDC layer adds like a framer */
+#define TEST_HDR_SIZE 3
+
+static int errors;
+
+#define CHECK(cond) do { \
+    if(!(cond)) { \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      errors++; \
+    } \
+  } while(0)
+
+/*---------------------------------------------------------------------------*/
+/* The parts of the IP stack sicslowpan needs */
+uip_buf_t uip_aligned_buf;
+uint16_t uip_len;
+uip_lladdr_t uip_lladdr;
+
+static uint8_t (*ip_output)(const uip_lladdr_t *);
+static int delivered;
+static uint8_t received[UIP_BUFSIZE];
+static int received_len;
+
+static clock_time_t now;
+
+clock_time_t clock_time(void) { return now; }
+void watchdog_periodic(void) {}
+void uip_ds6_link_neighbor_callback(int status, int numtx) {}
+void uip_ds6_set_addr_iid(uip_ipaddr_t *ipaddr, uip_lladdr_t *lladdr) {}
+
+void
+tcpip_set_outputfunc(uint8_t (*f)(const uip_lladdr_t *))
+{
+  ip_output = f;
+}
+
+void
+tcpip_input(void)
+{
+  delivered++;
+  memcpy(received, uip_buf, uip_len);
+  received_len = uip_len;
+}
+/*---------------------------------------------------------------------------*/
+/* Test MAC and RDC layers that capture the frames */
+static uint8_t frames[MAX_FRAMES][MAX_FRAME_SIZE];
+static int frame_len[MAX_FRAMES];
+static int num_frames;
+/* Frame whose transmission fails, -1 for none */
+static int fail_frame = -1;
+
+void
+mac_call_sent_callback(mac_callback_t sent, void *ptr, int status, int num_tx)
+{
+  if(sent != NULL) {
+    sent(ptr, status, num_tx);
+  }
+}
+
+static int
+capture(void)
+{
+  CHECK(num_frames < MAX_FRAMES && packetbuf_datalen() <= MAX_FRAME_SIZE);
+  memcpy(frames[num_frames], packetbuf_dataptr(), packetbuf_datalen());
+  frame_len[num_frames] = packetbuf_datalen();
+  return num_frames++ == fail_frame ? MAC_TX_ERR : MAC_TX_OK;
+}
+
+static void
+test_mac_send(mac_callback_t sent, void *ptr)
+{
+  mac_call_sent_callback(sent, ptr, capture(), 1);
+}
+
+static void
+test_rdc_send_list(mac_callback_t sent, void *ptr, struct rdc_buf_list *list)
+{
+  int ret;
+
+  while(list != NULL) {
+    struct rdc_buf_list *next = list->next;
+    queuebuf_to_packetbuf(list->buf);
+    CHECK(packetbuf_hdrlen() == 0);
+    /* Write a header like a framer would, in front of the fragment that
+       is still held by the queuebuf. Only the fragment is captured */
+    CHECK(packetbuf_hdralloc(TEST_HDR_SIZE));
+    memset(packetbuf_hdrptr(), 0x55, TEST_HDR_SIZE);
+    ret = capture();
+    mac_call_sent_callback(sent, ptr, ret, 1);
+    if(ret != MAC_TX_OK) {
+      return;
+    }
+    list = next;
+  }
+}
+
+static int
+test_framer_length(void)
+{
+  return 21;
+}
+
+const struct mac_driver test_mac = { "test", NULL, test_mac_send };
+const struct rdc_driver test_rdc = { "test", NULL, NULL, test_rdc_send_list };
+const struct framer test_framer = { test_framer_length };
+/*---------------------------------------------------------------------------*/
+static void
+make_packet(int size)
+{
+  int i;
+
+  memset(uip_buf, 0, UIP_LLH_LEN + UIP_IPH_LEN);
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->len[0] = (size - UIP_IPH_LEN) >> 8;
+  UIP_IP_BUF->len[1] = (size - UIP_IPH_LEN) & 0xff;
+  UIP_IP_BUF->proto = UIP_PROTO_ICMP6;
+  UIP_IP_BUF->ttl = 64;
+  for(i = UIP_IPH_LEN; i < size; i++) {
+    ((uint8_t *)UIP_IP_BUF)[i] = i * 13 + size;
+  }
+  uip_len = size;
+}
+/*---------------------------------------------------------------------------*/
+/* Feeds the captured frames back in, returns 1 if they are reassembled
+   into the packet in uip_buf */
+static int
+loopback(int size)
+{
+  static uint8_t sent[UIP_BUFSIZE];
+  linkaddr_t sender = {{ 1 }};
+  int i;
+
+  memcpy(sent, UIP_IP_BUF, size);
+  delivered = 0;
+  for(i = 0; i < num_frames; i++) {
+    packetbuf_clear();
+    memcpy(packetbuf_dataptr(), frames[i], frame_len[i]);
+    packetbuf_set_datalen(frame_len[i]);
+    packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &sender);
+    sicslowpan_driver.input();
+  }
+  return delivered == 1 && received_len == size &&
+    memcmp(received, sent, size) == 0;
+}
+/*---------------------------------------------------------------------------*/
+/* The fragments of a packet, captured to be fed back in any order */
+struct fragments {
+  uint8_t packet[UIP_BUFSIZE];
+  int size;
+  uint8_t frames[MAX_FRAMES][MAX_FRAME_SIZE];
+  int len[MAX_FRAMES];
+  int num;
+};
+
+static struct fragments pkt_a, pkt_b;
+
+static void
+capture_fragments(struct fragments *f, int size)
+{
+  uip_lladdr_t dest = {{ 2 }};
+
+  make_packet(size);
+  memcpy(f->packet, UIP_IP_BUF, size);
+  f->size = size;
+  num_frames = 0;
+  CHECK(ip_output(&dest) == 1);
+  memcpy(f->frames, frames, sizeof(f->frames));
+  memcpy(f->len, frame_len, sizeof(f->len));
+  f->num = num_frames;
+}
+/*---------------------------------------------------------------------------*/
+static void
+feed_frame(const uint8_t *frame, int len, int from)
+{
+  linkaddr_t sender = {{ from }};
+
+  packetbuf_clear();
+  memcpy(packetbuf_dataptr(), frame, len);
+  packetbuf_set_datalen(len);
+  packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &sender);
+  sicslowpan_driver.input();
+}
+/*---------------------------------------------------------------------------*/
+/* Feeds fragment i of f from a sender. A packet completed by it must be
+   the packet of f */
+static void
+feed(const struct fragments *f, int i, int from)
+{
+  int before = delivered;
+
+  feed_frame(f->frames[i], f->len[i], from);
+  if(delivered != before) {
+    CHECK(received_len == f->size && memcmp(received, f->packet, f->size) == 0);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+reass_reset(void)
+{
+  memset(&sicslowpan_reass_stats, 0, sizeof(sicslowpan_reass_stats));
+  delivered = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_reass_order(void)
+{
+  int i;
+
+  /* Last fragment first */
+  reass_reset();
+  for(i = pkt_a.num - 1; i >= 0; i--) {
+    feed(&pkt_a, i, 1);
+  }
+  CHECK(delivered == 1);
+
+  /* Odd fragments before even ones */
+  for(i = 1; i < pkt_b.num; i += 2) {
+    feed(&pkt_b, i, 1);
+  }
+  for(i = 0; i < pkt_b.num; i += 2) {
+    feed(&pkt_b, i, 1);
+  }
+  CHECK(delivered == 2);
+  CHECK(sicslowpan_reass_stats.reassembled == 2);
+  CHECK(sicslowpan_reass_stats.duplicates == 0);
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_reass_interleave(void)
+{
+  int i;
+
+  /* Two senders use the same tag, one in order and one backwards */
+  reass_reset();
+  for(i = 0; i < pkt_a.num; i++) {
+    feed(&pkt_a, i, 1);
+    feed(&pkt_a, pkt_a.num - 1 - i, 2);
+  }
+  CHECK(delivered == 2);
+
+  /* Two packets of one sender */
+  for(i = 0; i < pkt_a.num || i < pkt_b.num; i++) {
+    if(i < pkt_b.num) {
+      feed(&pkt_b, pkt_b.num - 1 - i, 3);
+    }
+    if(i < pkt_a.num) {
+      feed(&pkt_a, i, 3);
+    }
+  }
+  CHECK(delivered == 4);
+  CHECK(sicslowpan_reass_stats.reassembled == 4);
+  CHECK(sicslowpan_reass_stats.evicted == 0);
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_reass_duplicates(void)
+{
+  uint8_t frame[MAX_FRAME_SIZE];
+  int i;
+
+  /* Every fragment but the last one twice */
+  reass_reset();
+  for(i = 0; i < pkt_a.num; i++) {
+    feed(&pkt_a, i, 1);
+    if(i < pkt_a.num - 1) {
+      feed(&pkt_a, i, 1);
+    }
+  }
+  CHECK(delivered == 1);
+  CHECK(sicslowpan_reass_stats.duplicates == pkt_a.num - 1);
+
+  /* The third fragment moved to overlap the second one */
+  reass_reset();
+  memcpy(frame, pkt_b.frames[2], pkt_b.len[2]);
+  frame[4] = pkt_b.frames[1][4] + 1;
+  feed(&pkt_b, 0, 1);
+  feed(&pkt_b, 1, 1);
+  feed_frame(frame, pkt_b.len[2], 1);
+  CHECK(sicslowpan_reass_stats.duplicates == 1);
+  for(i = 2; i < pkt_b.num; i++) {
+    feed(&pkt_b, i, 1);
+  }
+  CHECK(delivered == 1);
+  CHECK(sicslowpan_reass_stats.reassembled == 1);
+}
+/*---------------------------------------------------------------------------*/
+/* One packet more than there are reassembly buffers, the oldest one is
+   dropped */
+static void
+test_reass_evict(void)
+{
+  int i, from;
+
+  reass_reset();
+  for(from = 1; from <= SICSLOWPAN_REASS_SLOTS + 1; from++) {
+    feed(&pkt_a, 0, from);
+    now++;
+  }
+  CHECK(sicslowpan_reass_stats.evicted == 1);
+  for(from = 2; from <= SICSLOWPAN_REASS_SLOTS + 1; from++) {
+    for(i = 1; i < pkt_a.num; i++) {
+      feed(&pkt_a, i, from);
+    }
+  }
+  CHECK(delivered == SICSLOWPAN_REASS_SLOTS);
+  CHECK(sicslowpan_reass_stats.reassembled == SICSLOWPAN_REASS_SLOTS);
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_reass_timeout(void)
+{
+  int i;
+
+  /* The rest of the packet comes too late */
+  reass_reset();
+  feed(&pkt_a, 0, 1);
+  now += SICSLOWPAN_REASS_MAXAGE * CLOCK_SECOND / 16 + 1;
+  for(i = 1; i < pkt_a.num; i++) {
+    feed(&pkt_a, i, 1);
+  }
+  CHECK(sicslowpan_reass_stats.timeouts == 1);
+  CHECK(delivered == 0);
+
+  /* So does the first fragment of the packet started by the rest */
+  now += SICSLOWPAN_REASS_MAXAGE * CLOCK_SECOND / 16 + 1;
+  for(i = 0; i < pkt_b.num; i++) {
+    feed(&pkt_b, i, 1);
+  }
+  CHECK(sicslowpan_reass_stats.timeouts == 2);
+  CHECK(delivered == 1);
+}
+/*---------------------------------------------------------------------------*/
+/* Fragments with an invalid size or offset neither get nor take a
+   reassembly buffer */
+static void
+test_reass_invalid(void)
+{
+  uint8_t frame[MAX_FRAME_SIZE];
+  int i, from;
+
+  reass_reset();
+  for(from = 1; from <= SICSLOWPAN_REASS_SLOTS; from++) {
+    feed(&pkt_a, pkt_a.num - 1, from);
+  }
+
+  /* Offset past the size */
+  memcpy(frame, pkt_a.frames[1], pkt_a.len[1]);
+  frame[4] = 0xff;
+  feed_frame(frame, pkt_a.len[1], from);
+  /* No size */
+  memcpy(frame, pkt_a.frames[1], pkt_a.len[1]);
+  frame[0] = 0xe0;
+  frame[1] = 0;
+  feed_frame(frame, pkt_a.len[1], from);
+  /* Larger than uip_buf, as a first and as a subsequent fragment */
+  memcpy(frame, pkt_a.frames[0], pkt_a.len[0]);
+  frame[0] = 0xc7;
+  frame[1] = 0xff;
+  feed_frame(frame, pkt_a.len[0], from);
+  memcpy(frame, pkt_a.frames[1], pkt_a.len[1]);
+  frame[0] = 0xe7;
+  frame[1] = 0xff;
+  feed_frame(frame, pkt_a.len[1], from);
+  /* No payload */
+  feed_frame(pkt_a.frames[1], 5, from);
+  CHECK(sicslowpan_reass_stats.invalid == 5);
+
+  /* A truncated first fragment and one without IPHC are dropped before */
+  feed_frame(pkt_a.frames[0], 4, from);
+  memcpy(frame, pkt_a.frames[0], pkt_a.len[0]);
+  frame[4] = 0;
+  feed_frame(frame, pkt_a.len[0], from);
+
+  CHECK(sicslowpan_reass_stats.evicted == 0);
+  for(from = 1; from <= SICSLOWPAN_REASS_SLOTS; from++) {
+    for(i = 0; i < pkt_a.num - 1; i++) {
+      feed(&pkt_a, i, from);
+    }
+  }
+  CHECK(delivered == SICSLOWPAN_REASS_SLOTS);
+  CHECK(sicslowpan_reass_stats.reassembled == SICSLOWPAN_REASS_SLOTS);
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_sizes(void)
+{
+  uip_lladdr_t dest = {{ 2 }};
+  int size;
+
+  for(size = 60; size <= UIP_BUFSIZE - UIP_LLH_LEN; size += 37) {
+    make_packet(size);
+    num_frames = 0;
+    CHECK(ip_output(&dest) == 1);
+    CHECK(loopback(size));
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_lost_fragment(void)
+{
+  uip_lladdr_t dest = {{ 2 }};
+
+  /* The fragments behind a lost one are dropped */
+  make_packet(400);
+  num_frames = 0;
+  fail_frame = 2;
+  CHECK(ip_output(&dest) == 0);
+  CHECK(num_frames == 3);
+  fail_frame = -1;
+
+  /* The next packet goes through again */
+  make_packet(400);
+  num_frames = 0;
+  CHECK(ip_output(&dest) == 1);
+  CHECK(loopback(400));
+}
+/*---------------------------------------------------------------------------*/
+/* A queued frame comes back as data, with or without a header */
+static void
+test_queuebuf(int hdrlen)
+{
+  struct queuebuf *q;
+  uint8_t frame[100];
+  int i;
+
+  packetbuf_attach_new();
+  for(i = 0; i < 80; i++) {
+    ((uint8_t *)packetbuf_dataptr())[i] = i;
+  }
+  packetbuf_set_datalen(80);
+  if(hdrlen > 0) {
+    CHECK(packetbuf_hdralloc(hdrlen));
+    memset(packetbuf_hdrptr(), 0xAA, hdrlen);
+  }
+  CHECK(packetbuf_copyto(frame) == hdrlen + 80);
+
+  q = queuebuf_new_from_packetbuf();
+  CHECK(q != NULL);
+  packetbuf_clear();
+  if(q == NULL) {
+    return;
+  }
+
+  queuebuf_to_packetbuf(q);
+  CHECK(packetbuf_hdrlen() == 0);
+  CHECK(packetbuf_datalen() == hdrlen + 80);
+  CHECK(memcmp(packetbuf_dataptr(), frame, hdrlen + 80) == 0);
+#if PBUF_NUM
+  /* Without a header the frame is restored by reference */
+  CHECK(hdrlen > 0 || packetbuf_pbuf() != NULL);
+#endif /* PBUF_NUM */
+
+  queuebuf_free(q);
+  packetbuf_clear();
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_no_leak(void)
+{
+#if PBUF_NUM
+  struct pbuf *p[PBUF_NUM + 1];
+  int n = 0;
+
+  packetbuf_clear();
+  while(n <= PBUF_NUM && (p[n] = pbuf_alloc(0)) != NULL) {
+    n++;
+  }
+  CHECK(n == PBUF_NUM);
+  while(n > 0) {
+    pbuf_free(p[--n]);
+  }
+#endif /* PBUF_NUM */
+}
+/*---------------------------------------------------------------------------*/
+int
+main(void)
+{
+  queuebuf_init();
+  packetbuf_clear();
+  sicslowpan_driver.init();
+
+  test_sizes();
+  test_lost_fragment();
+  capture_fragments(&pkt_a, 300);
+  capture_fragments(&pkt_b, 350);
+  CHECK(pkt_a.num >= 3 && pkt_b.num >= 3);
+  test_reass_order();
+  test_reass_interleave();
+  test_reass_duplicates();
+  test_reass_evict();
+  test_reass_timeout();
+  test_reass_invalid();
+  test_queuebuf(0);
+  test_queuebuf(5);
+  test_no_leak();
+
+  printf("pbuf-test with %d pbufs: %s\n", PBUF_NUM, errors ? "FAIL" : "OK");
+  return errors != 0;
+}
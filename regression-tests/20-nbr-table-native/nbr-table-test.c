@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2013, Institute of Operating Systems and Computer Networks (TU Braunschweig).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Host test of the neighbor table and its link-layer address index
+ *
+ *         Adds neighbors without a link-layer address and fills it in later
+ *         like IPv6 ND does, looks them up by the new address and lets the
+ *         table evict them. An address taken over from another neighbor
+ *         removes that neighbor unless it is locked. The Makefile builds it
+ *         with several table sizes under AddressSanitizer.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "contiki.h"
+#include "net/nbr-table.h"
+
+/* Rounds of ND like insertions, each one evicts a neighbor once the
+ * table is full */
+#define ROUNDS (20 * NBR_TABLE_MAX_NEIGHBORS)
+
+static int errors;
+
+#define CHECK(cond) do { \
+    if(!(cond)) { \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      errors++; \
+    } \
+  } while(0)
+
+struct test_nbr {
+  int value;
+};
+
+NBR_TABLE(struct test_nbr, nbrs);
+
+static int removed;
+/*---------------------------------------------------------------------------*/
+static void
+removed_callback(nbr_table_item_t *item)
+{
+  removed++;
+}
+/*---------------------------------------------------------------------------*/
+static void
+make_lladdr(linkaddr_t *lladdr, int n)
+{
+  memset(lladdr, 0, sizeof(linkaddr_t));
+  lladdr->u8[0] = 0x02;
+  lladdr->u8[LINKADDR_SIZE - 2] = n >> 8;
+  lladdr->u8[LINKADDR_SIZE - 1] = n & 0xff;
+}
+/*---------------------------------------------------------------------------*/
+/* A neighbor added without address is found by its address once it is
+ * filled in, and no longer as the neighbor without address */
+static void
+test_fill_in(void)
+{
+  struct test_nbr *item;
+  linkaddr_t lladdr;
+
+  make_lladdr(&lladdr, 1);
+  item = nbr_table_add_lladdr(nbrs, NULL);
+  CHECK(item != NULL);
+  CHECK(nbr_table_get_from_lladdr(nbrs, NULL) == item);
+  CHECK(nbr_table_get_from_lladdr(nbrs, &lladdr) == NULL);
+
+  CHECK(nbr_table_update_lladdr(nbrs, item, &lladdr) == 1);
+  CHECK(nbr_table_get_from_lladdr(nbrs, &lladdr) == item);
+  CHECK(nbr_table_get_from_lladdr(nbrs, NULL) == NULL);
+  CHECK(linkaddr_cmp(nbr_table_get_lladdr(nbrs, item), &lladdr));
+
+  /* Setting the same address again changes nothing */
+  CHECK(nbr_table_update_lladdr(nbrs, item, &lladdr) == 1);
+  CHECK(nbr_table_get_from_lladdr(nbrs, &lladdr) == item);
+  nbr_table_remove(nbrs, item);
+}
+/*---------------------------------------------------------------------------*/
+/* Many more neighbors than the table holds come and go the ND way. Each
+ * evicted neighbor must leave the index, otherwise it fills up */
+static void
+test_evict(void)
+{
+  struct test_nbr *item;
+  linkaddr_t lladdr;
+  int i, count;
+
+  removed = 0;
+  for(i = 1; i <= ROUNDS; i++) {
+    item = nbr_table_add_lladdr(nbrs, NULL);
+    CHECK(item != NULL);
+    if(item == NULL) {
+      return;
+    }
+    item->value = i;
+    make_lladdr(&lladdr, i);
+    CHECK(nbr_table_update_lladdr(nbrs, item, &lladdr) == 1);
+    CHECK(nbr_table_get_from_lladdr(nbrs, &lladdr) == item);
+  }
+  CHECK(removed == ROUNDS - NBR_TABLE_MAX_NEIGHBORS);
+
+  /* The newest neighbors are left, each one found by its address */
+  count = 0;
+  for(item = nbr_table_head(nbrs); item != NULL;
+      item = nbr_table_next(nbrs, item)) {
+    CHECK(item->value > ROUNDS - NBR_TABLE_MAX_NEIGHBORS);
+    make_lladdr(&lladdr, item->value);
+    CHECK(nbr_table_get_from_lladdr(nbrs, &lladdr) == item);
+    count++;
+  }
+  CHECK(count == NBR_TABLE_MAX_NEIGHBORS);
+
+  for(i = 1; i <= ROUNDS - NBR_TABLE_MAX_NEIGHBORS; i++) {
+    make_lladdr(&lladdr, i);
+    CHECK(nbr_table_get_from_lladdr(nbrs, &lladdr) == NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Taking over the address of another neighbor removes that neighbor,
+ * unless it is locked */
+static void
+test_duplicate(void)
+{
+  struct test_nbr *old, *item;
+  linkaddr_t lladdr;
+
+  make_lladdr(&lladdr, ROUNDS + 1);
+  old = nbr_table_add_lladdr(nbrs, &lladdr);
+  CHECK(old != NULL);
+  nbr_table_lock(nbrs, old);
+  item = nbr_table_add_lladdr(nbrs, NULL);
+  CHECK(item != NULL && item != old);
+
+  CHECK(nbr_table_update_lladdr(nbrs, item, &lladdr) == 0);
+  CHECK(nbr_table_get_from_lladdr(nbrs, &lladdr) == old);
+  CHECK(nbr_table_get_from_lladdr(nbrs, NULL) == item);
+
+  nbr_table_unlock(nbrs, old);
+  removed = 0;
+  CHECK(nbr_table_update_lladdr(nbrs, item, &lladdr) == 1);
+  CHECK(removed == 1);
+  CHECK(nbr_table_get_from_lladdr(nbrs, &lladdr) == item);
+  CHECK(nbr_table_get_from_lladdr(nbrs, NULL) == NULL);
+}
+/*---------------------------------------------------------------------------*/
+int
+main(void)
+{
+  nbr_table_register(nbrs, removed_callback);
+
+  test_fill_in();
+  test_evict();
+  test_duplicate();
+
+  printf("nbr-table-test with %d neighbors: %s\n", NBR_TABLE_MAX_NEIGHBORS,
+         errors ? "FAIL" : "OK");
+  return errors != 0;
+}
@@ -0,0 +1,239 @@
+#!/usr/bin/env python
+#
+# Collects the profiles streamed by core/sys/profiling/profiling-export.c
+# over SLIP (serial port or a captured file) or UDP and writes every
+# exported profile as a log that profile-neat.py understands.
+#
+# Examples:
+#   profile-collect.py serial --port /dev/ttyUSB0
+#   profile-collect.py udp --port 5689 -o run-%n-%i.log
+#   profile-collect.py file capture.slip --neat app.inga -- -p avr -g %n.svg
+
+from __future__ import print_function
+
+import argparse
+import binascii
+import os
+import socket
+import struct
+import subprocess
+import sys
+
+NEAT = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'profile-neat.py')
+
+SLIP_END = 0xC0
+SLIP_ESC = 0xDB
+SLIP_ESC_END = 0xDC
+SLIP_ESC_ESC = 0xDD
+
+FRAME_HEADER = 5
+NO_RECORD_START = 0xFF
+
+PROF_BEGIN = 1
+PROF_SITE = 2
+SPROF_BEGIN = 3
+SPROF_SITE = 4
+PROCESS = 5
+END = 6
+
+ADDR_FORMAT = {2: 'H', 4: 'I', 8: 'Q'}
+
+
+def slip_frames(chunks):
+	"""Splits a byte stream into SLIP frames."""
+	frame = bytearray()
+	escaped = False
+	for chunk in chunks:
+		for c in bytearray(chunk):
+			if c == SLIP_END:
+				if frame:
+					yield bytes(frame)
+				frame = bytearray()
+			elif escaped:
+				frame.append({SLIP_ESC_END: SLIP_END, SLIP_ESC_ESC: SLIP_ESC}.get(c, c))
+				escaped = False
+			elif c == SLIP_ESC:
+				escaped = True
+			else:
+				frame.append(c)
+
+
+class Collector(object):
+	"""Reassembles the record stream from the frames and the profiles from the records."""
+
+	def __init__(self, output, neat):
+		self.output = output
+		self.neat = neat
+		self.seq = None
+		self.stream = bytearray()
+		self.profile = None
+		self.count = 0
+		self.lost = 0
+
+	def frame(self, data):
+		data = bytearray(data)
+		if len(data) < FRAME_HEADER or data[0:2] != bytearray(b'PX'):
+			# Console output between the frames
+			return
+		seq = data[2] | (data[3] << 8)
+		first = data[4]
+		payload = data[FRAME_HEADER:]
+
+		if self.seq is not None and seq != (self.seq + 1) & 0xFFFF:
+			self.lost += (seq - self.seq - 1) & 0xFFFF
+			print('lost %i frames' % ((seq - self.seq - 1) & 0xFFFF), file=sys.stderr)
+			# Resynchronize at the first record of this frame
+			self.stream = bytearray()
+			if self.profile:
+				self.profile['complete'] = False
+			if first == NO_RECORD_START:
+				self.seq = None
+				return
+			payload = payload[first:]
+		elif self.seq is None:
+			if first == NO_RECORD_START:
+				return
+			payload = payload[first:]
+		self.seq = seq
+
+		self.stream += payload
+		while len(self.stream) >= 2 and len(self.stream) >= 2 + self.stream[1]:
+			length = self.stream[1]
+			self.record(self.stream[0], bytes(self.stream[2:2 + length]))
+			self.stream = self.stream[2 + length:]
+
+	def record(self, rtype, payload):
+		if rtype == PROF_BEGIN:
+			addr_size, shift, num_sites, max_sites, time_run, ticks = struct.unpack_from('<BBHHII', payload)
+			self.profile = {'type': 'prof', 'addr_size': addr_size, 'shift': shift,
+					'max_sites': max_sites, 'time_run': time_run, 'ticks': ticks,
+					'name': payload[14:].decode('ascii', 'replace'), 'sites': [], 'complete': True}
+		elif rtype == SPROF_BEGIN:
+			addr_size, shift, frames, num_sites, max_sites, samples, dropped = struct.unpack_from('<BBBHHII', payload)
+			self.profile = {'type': 'sprof', 'addr_size': addr_size, 'shift': shift, 'frames': frames,
+					'max_sites': max_sites, 'samples': samples, 'dropped': dropped,
+					'name': payload[15:].decode('ascii', 'replace'), 'sites': [], 'processes': {},
+					'complete': True}
+		elif self.profile is None:
+			# Started listening in the middle of a profile
+			return
+		elif rtype == PROF_SITE:
+			fmt = ADDR_FORMAT[self.profile['addr_size']]
+			self.profile['sites'].append(struct.unpack_from('<%s%sIIHHI' % (fmt, fmt), payload))
+		elif rtype == SPROF_SITE:
+			fmt = ADDR_FORMAT[self.profile['addr_size']]
+			self.profile['sites'].append(struct.unpack_from('<H%s%i%s' % (fmt, self.profile['frames'], fmt), payload))
+		elif rtype == PROCESS:
+			size = self.profile['addr_size']
+			process = struct.unpack_from('<%s' % ADDR_FORMAT[size], payload)[0]
+			self.profile['processes'][process] = payload[size:]
+		elif rtype == END:
+			self.finish(self.profile)
+			self.profile = None
+
+	def finish(self, profile):
+		filename = self.output.replace('%n', profile['name']).replace('%i', str(self.count))
+		self.count += 1
+		if not profile['complete']:
+			print('profile "%s" is incomplete' % profile['name'], file=sys.stderr)
+
+		with open(filename, 'w') as log:
+			if profile['type'] == 'prof':
+				write_prof(log, profile)
+			else:
+				write_sprof(log, profile)
+		print('wrote %s profile "%s" with %i sites to %s' % (profile['type'], profile['name'], len(profile['sites']), filename))
+
+		if self.neat:
+			subprocess.call([sys.executable, NEAT] + [a.replace('%n', profile['name']) for a in self.neat[1]] + [self.neat[0], filename])
+
+
+def write_prof(log, profile):
+	"""Writes the report of profiling_report()."""
+	shift = profile['shift']
+	log.write('PROF:%s:%i:%i:%i:%i\n' % (profile['name'], len(profile['sites']), profile['max_sites'],
+			profile['time_run'], profile['ticks']))
+	for site in profile['sites']:
+		log.write('0x%x:0x%x:%i:%i:%i:%i:%i\n' % ((site[0] << shift, site[1] << shift) + site[2:]))
+	log.write('\n')
+
+
+def write_sprof(log, profile):
+	"""Writes the binary dump of sprofiling_dump()."""
+	size = profile['addr_size']
+	fmt = ADDR_FORMAT[size]
+	data = struct.pack('<4sBBBBHIIB', b'SPRB', 1, profile['frames'], size, profile['shift'],
+			len(profile['sites']), profile['samples'], profile['dropped'], len(profile['processes']))
+	for process, name in profile['processes'].items():
+		data += struct.pack('<%sB' % fmt, process, len(name)) + name
+	for site in profile['sites']:
+		data += struct.pack('<H%s%i%s' % (fmt, profile['frames'], fmt), *site)
+
+	log.write('SPROFBIN:%s\n' % profile['name'])
+	for i in range(0, len(data), 32):
+		log.write(binascii.hexlify(data[i:i + 32]).decode('ascii') + '\n')
+	log.write('\n')
+
+
+def read_serial(args):
+	import serial
+	port = serial.Serial(args.port, args.baud, timeout=1)
+	while True:
+		yield port.read(256)
+
+
+def read_file(args):
+	with open(args.capture, 'rb') as capture:
+		while True:
+			chunk = capture.read(4096)
+			if not chunk:
+				return
+			yield chunk
+
+
+def main():
+	parser = argparse.ArgumentParser(description='Collect streamed profiles')
+	parser.add_argument('-o', '--output', default='profile-%n-%i.log',
+			help='log file pattern, %%n is replaced by the profile name and %%i by a counter')
+	parser.add_argument('--neat', metavar='BIN',
+			help='run profile-neat.py with this binary on every profile, arguments after -- are passed on')
+	sub = parser.add_subparsers(dest='mode')
+	serial_parser = sub.add_parser('serial', help='read SLIP frames from a serial port')
+	serial_parser.add_argument('--port', default='/dev/ttyUSB0')
+	serial_parser.add_argument('--baud', type=int, default=38400)
+	udp_parser = sub.add_parser('udp', help='receive UDP datagrams')
+	udp_parser.add_argument('--port', type=int, default=5689)
+	file_parser = sub.add_parser('file', help='read captured SLIP frames from a file')
+	file_parser.add_argument('capture')
+
+	argv = sys.argv[1:]
+	neat_args = []
+	if '--' in argv:
+		neat_args = argv[argv.index('--') + 1:]
+		argv = argv[:argv.index('--')]
+	args = parser.parse_args(argv)
+
+	collector = Collector(args.output, (args.neat, neat_args) if args.neat else None)
+
+	try:
+		if args.mode == 'udp':
+			sock = socket.socket(socket.AF_INET6, socket.SOCK_DGRAM)
+			sock.bind(('::', args.port))
+			while True:
+				collector.frame(sock.recv(2048))
+		elif args.mode == 'serial':
+			for frame in slip_frames(read_serial(args)):
+				collector.frame(frame)
+		else:
+			for frame in slip_frames(read_file(args)):
+				collector.frame(frame)
+	except KeyboardInterrupt:
+		pass
+
+	if collector.lost:
+		print('%i frames lost' % collector.lost, file=sys.stderr)
+	return 0
+
+
+if __name__ == '__main__':
+	sys.exit(main())
@@ -2,6 +2,8 @@
 
 import os
 import argparse
+import binascii
+import struct
 import subprocess
 import pydot
 
@@ -69,6 +71,8 @@ graph.add_argument("--highlight-functions",
 graph.add_argument("--highlight-color", dest="highlight_color", default="#00FF00",
 		help="Highlight color")
 
+parser.add_argument("-f", "--folded", dest="folded",
+		help="write the stacks of a binary statistical profile in the folded format of flamegraph.pl. The pattern %%n will be replaced by the name of the profiling result")
 parser.add_argument("-s", "--sort", dest="sort", default="count",
 		help="sort according to criteria (from|to|count|time)")
 parser.add_argument("-r", "--reverse", action="store_false", dest="reverse",
@@ -393,8 +397,12 @@ def handle_prof(logfile, header):
 		calls.append(call)
 
 		# Keep track of how much time we're actually spending in here
-		from_el['time_spent'] -= call['time']
-		to_el['time_spent'] += call['time']
+		if len(elements) > 6:
+			# Self time measured on the target, callees already excluded
+			to_el['time_spent'] += int(elements[6])
+		else:
+			from_el['time_spent'] -= call['time']
+			to_el['time_spent'] += call['time']
 		to_el['invocations'] += call['count']
 
 
@@ -439,6 +447,9 @@ def handle_sprof(logfile, header):
 		if len(sites) == opts['num_sites']:
 			break
 
+	print_sprof(sites)
+
+def print_sprof(sites):
 	if options.individual:
 		sites = sorted(sites, key=lambda site: site['count'], reverse=options.reverse)
 		for site in sites:
@@ -461,6 +472,63 @@ def handle_sprof(logfile, header):
 		for site in filtered_sites:
 			print "(%s) %s:%s %i times"%(site['file'], site['name'], site['line'], site['count'])
 
+def handle_sprofbin(logfile, header):
+	print "Statistical profiling for %s"%(options.bin)
+	global opts
+	opts = {'name': header.strip().split(':', 1)[1]}
+
+	# The binary dump is hex encoded and ends with an empty line
+	data = ''
+	for line in logfile:
+		line = line.strip()
+		if not line:
+			break
+		data += binascii.unhexlify(line)
+
+	magic, version, frames, addr_size, addr_shift, num_sites, num_samples, dropped, num_processes = struct.unpack_from('<4sBBBBHIIB', data)
+	if magic != 'SPRB' or version != 1:
+		print "Unknown binary profile format"
+		return
+	offset = struct.calcsize('<4sBBBBHIIB')
+	addr_fmt = {2: 'H', 4: 'I', 8: 'Q'}[addr_size]
+
+	processes = {0: 'none'}
+	for i in range(num_processes):
+		process, length = struct.unpack_from('<%sB'%(addr_fmt), data, offset)
+		offset += addr_size + 1
+		processes[process] = data[offset:offset + length]
+		offset += length
+
+	sites = []
+	stacks = {}
+	per_process = {}
+	for i in range(num_sites):
+		calls, process = struct.unpack_from('<H%s'%(addr_fmt), data, offset)
+		offset += 2 + addr_size
+		trace = struct.unpack_from('<%i%s'%(frames, addr_fmt), data, offset)
+		offset += frames * addr_size
+		pname = processes.get(process, '0x%x'%(process))
+
+		symbols = [lookup_symbol(trace[0] << addr_shift)] + [lookup_symbol(addr << addr_shift) for addr in trace[1:] if addr != 0]
+		sites.append({'addr': symbols[0], 'count': calls})
+		per_process[pname] = per_process.get(pname, 0) + calls
+
+		# Outermost caller first, starting with the process
+		stack = ';'.join([pname] + [symbol['name'] for symbol in reversed(symbols)])
+		stacks[stack] = stacks.get(stack, 0) + calls
+
+	print "%i samples, %i dropped, %i frames"%(num_samples, dropped, frames)
+	for pname in sorted(per_process, key=lambda p: per_process[p], reverse=options.reverse):
+		print "%s %i samples"%(pname, per_process[pname])
+
+	if options.folded:
+		foldedfile = open(options.folded.replace("%n", opts['name']), 'w')
+		for stack in sorted(stacks):
+			foldedfile.write("%s %i\n"%(stack, stacks[stack]))
+		foldedfile.close()
+
+	print_sprof(sites)
+
 
 # Read the header
 header = options.log.readline()
@@ -468,6 +536,9 @@ while (header):
 	if (header.startswith("PROF")):
 		handle_prof(options.log, header)
 		break
+	elif (header.startswith("SPROFBIN")):
+		handle_sprofbin(options.log, header)
+		break
 	elif (header.startswith("SPROF")):
 		handle_sprof(options.log, header)
 		break
@@ -0,0 +1,182 @@
+#!/usr/bin/env python
+#
+# Runs examples/storage-bench on the native simulator or reads its results
+# from an INGA node and stores them as JSON lines, one object per benchmark,
+# tagged with the git commit. Optionally compares against a baseline file.
+#
+# Examples:
+#   storage-bench.py native --fs fat,coffee -o results.jsonl
+#   storage-bench.py serial --port /dev/ttyUSB0 -o results.jsonl
+#   storage-bench.py native --compare baseline.jsonl --threshold 10
+
+from __future__ import print_function
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+CONTIKI = os.path.abspath(os.path.join(os.path.dirname(__file__), '..', '..'))
+BENCH_DIR = os.path.join(CONTIKI, 'examples', 'storage-bench')
+
+# Result fields where a larger value is better
+RATE_FIELDS = ['ops_s', 'bytes_s']
+
+
+def git_commit():
+	try:
+		out = subprocess.check_output(['git', 'rev-parse', '--short', 'HEAD'], cwd=CONTIKI)
+		return out.decode().strip()
+	except (OSError, subprocess.CalledProcessError):
+		return 'unknown'
+
+
+def parse_lines(lines):
+	"""Collects the benchmark objects until the done marker."""
+	results = []
+	for line in lines:
+		if isinstance(line, bytes):
+			line = line.decode('ascii', 'replace')
+		line = line.strip()
+		if not line.startswith('{"bench"'):
+			continue
+		try:
+			obj = json.loads(line)
+		except ValueError:
+			print('ignoring malformed line: %s' % line, file=sys.stderr)
+			continue
+		if obj['bench'] == 'done':
+			return results, True
+		if obj['bench'] == 'error':
+			print('benchmark failed: %s' % obj.get('reason'), file=sys.stderr)
+			return results, False
+		if obj['bench'] != 'start':
+			results.append(obj)
+	return results, False
+
+
+def run_native(fs, timeout):
+	subprocess.check_call(['make', '-s', 'TARGET=native', 'clean'], cwd=BENCH_DIR)
+	subprocess.check_call(['make', '-s', 'TARGET=native', 'CFS=' + fs], cwd=BENCH_DIR)
+
+	# Fresh images for every run
+	tmpdir = tempfile.mkdtemp(prefix='storage-bench-')
+	env = dict(os.environ)
+	env['CONTIKI_SDCARD'] = os.path.join(tmpdir, 'sdcard.img')
+	env['CONTIKI_FLASH'] = os.path.join(tmpdir, 'flash.img')
+
+	proc = subprocess.Popen([os.path.join(BENCH_DIR, 'storage-bench.native')],
+			cwd=BENCH_DIR, env=env, stdout=subprocess.PIPE)
+	start = time.time()
+	try:
+		results, done = parse_lines(iter(proc.stdout.readline, b''))
+	finally:
+		if proc.poll() is None:
+			proc.kill()
+		proc.wait()
+		for name in os.listdir(tmpdir):
+			os.remove(os.path.join(tmpdir, name))
+		os.rmdir(tmpdir)
+
+	if not done or time.time() - start > timeout:
+		raise RuntimeError('native run of %s did not finish' % fs)
+	return results
+
+
+def run_serial(port, baud, timeout):
+	import serial
+
+	conn = serial.Serial(port, baud, timeout=1)
+	deadline = time.time() + timeout
+
+	def lines():
+		while time.time() < deadline:
+			line = conn.readline()
+			if line:
+				yield line
+
+	results, done = parse_lines(lines())
+	conn.close()
+	if not done:
+		raise RuntimeError('no complete benchmark run received from %s' % port)
+	return results
+
+
+def compare(results, baseline_file, threshold):
+	"""Returns the number of results that got worse by more than threshold percent."""
+	baseline = {}
+	with open(baseline_file) as f:
+		for line in f:
+			obj = json.loads(line)
+			# The last entry of a benchmark wins
+			baseline[(obj.get('target'), obj['bench'])] = obj
+
+	regressions = 0
+	for obj in results:
+		old = baseline.get((obj.get('target'), obj['bench']))
+		if old is None:
+			continue
+		for field in RATE_FIELDS:
+			if old.get(field, 0) == 0:
+				continue
+			change = 100.0 * (obj[field] - old[field]) / old[field]
+			marker = ''
+			if change < -threshold:
+				marker = '  REGRESSION'
+				regressions += 1
+			print('%-24s %-8s %10d -> %10d (%+.1f%%)%s' % (obj['bench'], field,
+					old[field], obj[field], change, marker))
+	return regressions
+
+
+def main():
+	parser = argparse.ArgumentParser(description='Run the storage benchmark and record its results')
+	parser.add_argument('mode', choices=['native', 'serial'],
+			help='run on the native simulator or read the output of a node')
+	parser.add_argument('--fs', default='fat,coffee',
+			help='comma separated file systems for native runs (default: fat,coffee)')
+	parser.add_argument('--port', default='/dev/ttyUSB0', help='serial port of the node')
+	parser.add_argument('--baud', type=int, default=38400, help='baud rate of the node')
+	parser.add_argument('--timeout', type=int, default=600, help='timeout of one run in seconds')
+	parser.add_argument('-o', '--output', help='append results as JSON lines to this file')
+	parser.add_argument('--compare', metavar='BASELINE',
+			help='compare against results of an earlier run')
+	parser.add_argument('--threshold', type=float, default=5.0,
+			help='allowed slowdown in percent before reporting a regression (default: 5)')
+	args = parser.parse_args()
+
+	results = []
+	if args.mode == 'native':
+		for fs in args.fs.split(','):
+			for obj in run_native(fs, args.timeout):
+				obj['target'] = 'native'
+				results.append(obj)
+	else:
+		for obj in run_serial(args.port, args.baud, args.timeout):
+			obj['target'] = 'inga'
+			results.append(obj)
+
+	commit = git_commit()
+	now = int(time.time())
+	for obj in results:
+		obj['commit'] = commit
+		obj['timestamp'] = now
+
+	if args.output:
+		with open(args.output, 'a') as f:
+			for obj in results:
+				f.write(json.dumps(obj, sort_keys=True) + '\n')
+	else:
+		for obj in results:
+			print(json.dumps(obj, sort_keys=True))
+
+	if args.compare:
+		if compare(results, args.compare, args.threshold) > 0:
+			sys.exit(1)
+
+
+if __name__ == '__main__':
+	main()